@@ -0,0 +1,140 @@
+#!/usr/bin/perl
+#
+# Run the GEL benchmarks and report the results as JSON.
+#
+# Each workload is run in a single genius process, BenchReps times,
+# see harness.gel.  The results are written to --output and compared
+# to --baseline if it exists.  With --save-baseline the results are
+# written to the baseline file instead.
+#
+# usage: genius-bench.pl [--genius=path] [--reps=num] [--output=file]
+#                        [--baseline=file] [--save-baseline]
+#                        [--threshold=percent] [workload.gel ...]
+
+use strict;
+use warnings;
+use Cwd qw(abs_path getcwd);
+use File::Basename qw(dirname basename);
+use File::Temp qw(tempfile);
+use JSON::PP;
+
+my $benchdir = dirname (abs_path ($0));
+my $genius = "$benchdir/../src/genius";
+my $reps = 5;
+my $output = "bench-results.json";
+my $baseline = "$benchdir/baseline.json";
+my $save_baseline = 0;
+my $threshold = 10;
+my @workloads = ();
+
+foreach my $arg (@ARGV) {
+	if ($arg =~ /^--genius=(.*)$/) {
+		$genius = $1;
+	} elsif ($arg =~ /^--reps=(\d+)$/) {
+		$reps = $1;
+	} elsif ($arg =~ /^--output=(.*)$/) {
+		$output = $1;
+	} elsif ($arg =~ /^--baseline=(.*)$/) {
+		$baseline = $1;
+	} elsif ($arg eq "--save-baseline") {
+		$save_baseline = 1;
+	} elsif ($arg =~ /^--threshold=(\d+)$/) {
+		$threshold = $1;
+	} elsif ($arg =~ /^--/) {
+		die "Unknown argument '$arg'\n";
+	} else {
+		push @workloads, abs_path ($arg);
+	}
+}
+
+if ( ! @workloads) {
+	@workloads = grep { basename ($_) ne "harness.gel" }
+		sort glob ("$benchdir/*.gel");
+}
+
+$genius = abs_path ($genius);
+$output = getcwd () . "/$output" if $output !~ m{^/};
+-x $genius || die "can't find genius binary '$genius'\n";
+
+# genius only uses the uninstalled library when run from the build
+# directory it was built in
+chdir (dirname ($genius)) || die "can't change to the genius directory\n";
+
+my @results = ();
+my $failed = 0;
+
+foreach my $w (@workloads) {
+	my $name = basename ($w, ".gel");
+	my $driver = "load \"$benchdir/harness.gel\"\n" .
+		     "BenchReps = $reps;\n" .
+		     "load \"$w\"\n";
+
+	print STDERR "$name ... ";
+
+	my ($tmp, $tmpname) = tempfile ("genius-bench-XXXXXX",
+					TMPDIR => 1, SUFFIX => ".gel",
+					UNLINK => 1);
+	print $tmp $driver;
+	close ($tmp);
+
+	open (my $in, "-|", $genius, "--maxerrors=0", $tmpname) ||
+		die "can't open pipe!";
+	my $found = 0;
+	while (my $line = <$in>) {
+		if ($line =~ /^BENCH (\{.*\})\s*$/) {
+			push @results, decode_json ($1);
+			$found = 1;
+		}
+	}
+	close ($in);
+
+	if ($found) {
+		print STDERR "$results[-1]{median_us} us\n";
+	} else {
+		print STDERR "\e[01;31mFAILED\e[0m\n";
+		$failed++;
+	}
+}
+
+my $json = JSON::PP->new->pretty->canonical;
+my $report = { genius => $genius, reps => $reps + 0, results => \@results };
+
+my $outfile = $save_baseline ? $baseline : $output;
+open (my $out, ">", $outfile) || die "can't write '$outfile'\n";
+print $out $json->encode ($report);
+close ($out);
+print "Results written to $outfile\n";
+
+my $regressions = 0;
+if ( ! $save_baseline && -e $baseline) {
+	open (my $bf, "<", $baseline) || die "can't read '$baseline'\n";
+	my $base = decode_json (join ("", <$bf>));
+	close ($bf);
+
+	my %old = map { $_->{name} => $_ } @{$base->{results}};
+
+	printf "\n%-20s %12s %12s %8s %12s\n",
+		"workload", "median_us", "baseline", "ratio", "nodes";
+	foreach my $r (@results) {
+		my $o = $old{$r->{name}};
+		if ( ! defined $o || $o->{median_us} <= 0) {
+			printf "%-20s %12d %12s %8s %12d\n",
+				$r->{name}, $r->{median_us}, "-", "-",
+				$r->{nodes};
+			next;
+		}
+		my $ratio = $r->{median_us} / $o->{median_us};
+		my $flag = "";
+		if ($ratio > 1 + $threshold / 100) {
+			$flag = "  \e[01;31mREGRESSION\e[0m";
+			$regressions++;
+		}
+		printf "%-20s %12d %12d %8.2f %12d%s\n",
+			$r->{name}, $r->{median_us}, $o->{median_us},
+			$ratio, $r->{nodes}, $flag;
+	}
+}
+
+print "\nworkloads: " . scalar (@workloads) . ", failed: $failed, " .
+      "regressions: $regressions\n";
+exit (($failed > 0 || $regressions > 0) ? 1 : 0);
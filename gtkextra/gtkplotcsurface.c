@@ -81,6 +81,7 @@ static void gtk_plot_csurface_clone 		(GtkPlotData *data,
 static void update_data                         (GtkPlotData *data);
 static void gtk_plot_csurface_build_polygons 	(GtkPlotSurface *surface);
 static void gtk_plot_csurface_build_contours 	(GtkPlotSurface *surface);
+static gboolean gtk_plot_csurface_build_grid_contours (GtkPlotSurface *surface);
 static void gtk_plot_csurface_get_legend_size	(GtkPlotData *data, 
 						 gint *width, gint *height);
 static void gtk_plot_csurface_draw_legend	(GtkPlotData *data, 
@@ -383,6 +384,9 @@ gtk_plot_csurface_init (GtkPlotCSurface *dataset)
   dataset->projection = GTK_PLOT_PROJECT_EMPTY;
   dataset->levels = NULL; 
   dataset->bg_triangles = NULL; 
+  dataset->grid_lines = NULL;
+  dataset->on_grid = FALSE;
+  dataset->fill_pending = FALSE;
 
   GTK_PLOT_DATA(dataset)->labels_attr.height = 10;
 
@@ -656,6 +660,11 @@ gtk_plot_csurface_draw_lines(GtkPlotData *data)
   clip_area.height = plot->internal_allocation.height;
   gtk_plot_pc_clip(plot->pc, &clip_area);
 
+  if(csurface->projection == GTK_PLOT_PROJECT_FULL && csurface->fill_pending){
+    gtk_plot_csurface_build_contours(GTK_PLOT_SURFACE(csurface));
+    csurface->fill_pending = FALSE;
+  }
+
   if(csurface->projection == GTK_PLOT_PROJECT_FULL){
     gtk_plot_data_get_gradient_level(data, data->gradient->ticks.min - 1., &color); 
     gtk_plot_pc_set_color(data->plot->pc, &color);
@@ -704,6 +713,9 @@ gtk_plot_csurface_draw_lines(GtkPlotData *data)
 
       if(nlines == 0){ polygons = last; continue; }
 
+      /* the lines are already cached from the grid */
+      if(csurface->on_grid) goto fill_level;
+
       contour = g_new0(GtkPlotPoint, ntotal); 
 
       /* Actual contour line */
@@ -728,7 +740,8 @@ gtk_plot_csurface_draw_lines(GtkPlotData *data)
       branch->level = level->level;
       branch->sublevel = level->sublevel;
       lines = g_list_append(lines, branch);
- 
+
+fill_level:
       if(csurface->projection == GTK_PLOT_PROJECT_FULL) {
 	GtkPlotPoint pp[4];
         gtk_plot_data_get_gradient_level(data, level->level == data->gradient->ticks.min ? level->level - 0.1 : level->level, &color); 
@@ -749,6 +762,23 @@ gtk_plot_csurface_draw_lines(GtkPlotData *data)
     list = list->next;
   }
 
+  if(csurface->on_grid){
+    /* lines is still empty here */
+    for(list = csurface->grid_lines; list; list = list->next){
+      GtkPlotContourLine *cached = (GtkPlotContourLine *)list->data;
+      gint i;
+
+      branch = g_new0(GtkPlotContourLine, 1);
+      *branch = *cached;
+      branch->contour = g_new(GtkPlotPoint, cached->n1);
+      for(i = 0; i < cached->n1; i++)
+        gtk_plot_get_pixel(plot, cached->contour[i].x, cached->contour[i].y,
+                           &branch->contour[i].x, &branch->contour[i].y);
+      lines = g_list_prepend(lines, branch);
+    }
+    lines = g_list_reverse(lines);
+  }
+
   if(data->show_labels){
     gtk_plot_pc_clip(plot->pc, NULL);
     list = lines;
@@ -1281,6 +1311,270 @@ triangle_cuts_level(GtkPlotDTtriangle *triangle, gdouble level)
   return(sides_cut_level(triangle, points, side, level));
 }  
 
+/* Contours on a regular grid (which is what a function surface always
+ * is) are extracted by marching squares, all levels in one pass over the
+ * grid, and kept as polylines in data coordinates until the data
+ * changes, so redrawing only has to map them to pixels.  Scattered data
+ * still goes through the triangulation. */
+
+typedef struct
+{
+  gint e[2];		  /* grid edges the segment ends on */
+  GtkPlotPoint p[2];
+} GtkPlotContourSeg;
+
+/* Check that the nodes form an nx by ny grid stored row by row, fill in
+ * the coordinates of the columns and rows */
+static gboolean
+grid_from_nodes(GtkPlotDT *dt, gint nx, gint ny, gdouble *xs, gdouble *ys)
+{
+  gint i, j;
+
+  if(nx < 2 || ny < 2 || dt->node_cnt != nx*ny) return FALSE;
+
+  for(i = 0; i < nx; i++) xs[i] = dt->nodes[i].x;
+  for(j = 0; j < ny; j++) ys[j] = dt->nodes[j*nx].y;
+
+  for(i = 1; i < nx; i++) if(!(xs[i] > xs[i-1])) return FALSE;
+  for(j = 1; j < ny; j++) if(!(ys[j] > ys[j-1])) return FALSE;
+
+  for(j = 0; j < ny; j++)
+    for(i = 0; i < nx; i++){
+      GtkPlotDTnode *node = &dt->nodes[j*nx+i];
+      if(node->x != xs[i] || node->y != ys[j]) return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gint
+compare_levels(gconstpointer a, gconstpointer b)
+{
+  gdouble va = ((const GtkPlotTick *)a)->value;
+  gdouble vb = ((const GtkPlotTick *)b)->value;
+  return (va > vb) - (va < vb);
+}
+
+/* Join the segments of one level into polylines, slot has two entries
+ * per grid edge, all -1 on entry and on return */
+static GList *
+join_segments(GList *lines, GArray *segs, gint *slot,
+              gdouble level, gboolean sublevel)
+{
+  GtkPlotContourSeg *seg = (GtkPlotContourSeg *)segs->data;
+  gint nseg = segs->len;
+  gboolean *used;
+  GArray *fwd, *back;
+  gint s, k;
+
+  if(nseg == 0) return lines;
+
+  for(s = 0; s < nseg; s++)
+    for(k = 0; k < 2; k++){
+      gint e = seg[s].e[k];
+      if(slot[2*e] < 0) slot[2*e] = s; else slot[2*e+1] = s;
+    }
+
+  used = g_new0(gboolean, nseg);
+  fwd = g_array_new(FALSE, FALSE, sizeof(GtkPlotPoint));
+  back = g_array_new(FALSE, FALSE, sizeof(GtkPlotPoint));
+
+  for(s = 0; s < nseg; s++){
+    GtkPlotContourLine *line;
+    gboolean closed = FALSE;
+    gint dir;
+
+    if(used[s]) continue;
+    used[s] = TRUE;
+
+    g_array_set_size(fwd, 0);
+    g_array_set_size(back, 0);
+    g_array_append_val(fwd, seg[s].p[0]);
+    g_array_append_val(fwd, seg[s].p[1]);
+
+    /* follow the line from the second end, then if it did not close
+       up, from the first */
+    for(dir = 1; dir >= 0 && !closed; dir--){
+      GArray *pts = dir ? fwd : back;
+      gint cur = s;
+      gint e = seg[s].e[dir];
+
+      while(TRUE){
+        gint next = slot[2*e] == cur ? slot[2*e+1] : slot[2*e];
+        if(next < 0) break;
+        if(next == s){ closed = TRUE; break; }
+        if(used[next]) break;
+        used[next] = TRUE;
+        if(seg[next].e[0] == e){
+          g_array_append_val(pts, seg[next].p[1]);
+          e = seg[next].e[1];
+        } else {
+          g_array_append_val(pts, seg[next].p[0]);
+          e = seg[next].e[0];
+        }
+        cur = next;
+      }
+    }
+
+    line = g_new0(GtkPlotContourLine, 1);
+    line->n1 = back->len + fwd->len + (closed ? 1 : 0);
+    line->contour = g_new(GtkPlotPoint, line->n1);
+    for(k = 0; k < (gint)back->len; k++)
+      line->contour[k] = g_array_index(back, GtkPlotPoint, back->len-1-k);
+    memcpy(line->contour + back->len, fwd->data, fwd->len * sizeof(GtkPlotPoint));
+    if(closed) line->contour[line->n1-1] = line->contour[0];
+    line->level = level;
+    line->sublevel = sublevel;
+    lines = g_list_prepend(lines, line);
+  }
+
+  for(s = 0; s < nseg; s++)
+    for(k = 0; k < 2; k++){
+      gint e = seg[s].e[k];
+      slot[2*e] = slot[2*e+1] = -1;
+    }
+
+  g_free(used);
+  g_array_free(fwd, TRUE);
+  g_array_free(back, TRUE);
+
+  return lines;
+}
+
+static gboolean
+gtk_plot_csurface_build_grid_contours(GtkPlotSurface *surface)
+{
+  GtkPlotCSurface *csurface = GTK_PLOT_CSURFACE(surface);
+  GtkPlotData *data = GTK_PLOT_DATA(surface);
+  GtkPlotDT *dt = surface->dt;
+  gint nx = surface->nx, ny = surface->ny;
+  gint nlevels = data->gradient->ticks.nticks;
+  gint nh, nedges;
+  gdouble *xs, *ys;
+  GtkPlotTick *levels;
+  GArray **segs;
+  gint *slot;
+  gint i, j, l;
+
+  if(!dt || !dt->nodes || nlevels <= 0) return FALSE;
+
+  xs = g_new(gdouble, MAX(nx, 1));
+  ys = g_new(gdouble, MAX(ny, 1));
+  if(!grid_from_nodes(dt, nx, ny, xs, ys)){
+    g_free(xs);
+    g_free(ys);
+    return FALSE;
+  }
+
+  /* levels ascending, so that each cell only looks at the levels
+     between its lowest and highest corner */
+  levels = g_new(GtkPlotTick, nlevels);
+  memcpy(levels, data->gradient->ticks.values, nlevels * sizeof(GtkPlotTick));
+  qsort(levels, nlevels, sizeof(GtkPlotTick), compare_levels);
+
+  segs = g_new(GArray *, nlevels);
+  for(l = 0; l < nlevels; l++)
+    segs[l] = g_array_new(FALSE, FALSE, sizeof(GtkPlotContourSeg));
+
+  /* edges: the horizontal ones (i,j)-(i+1,j) first, then the vertical
+     ones (i,j)-(i,j+1) */
+  nh = (nx-1)*ny;
+  nedges = nh + nx*(ny-1);
+
+  for(j = 0; j < ny-1; j++){
+    for(i = 0; i < nx-1; i++){
+      /* corners counterclockwise from (i,j), and the edges after
+         each corner */
+      gdouble z[4], cx[4], cy[4], zmin, zmax;
+      gint edge[4];
+      gint lo, hi, mid, k;
+
+      z[0] = dt->nodes[j*nx+i].z;
+      z[1] = dt->nodes[j*nx+i+1].z;
+      z[2] = dt->nodes[(j+1)*nx+i+1].z;
+      z[3] = dt->nodes[(j+1)*nx+i].z;
+      if(!isfinite(z[0]) || !isfinite(z[1]) || !isfinite(z[2]) || !isfinite(z[3]))
+        continue;
+
+      zmin = MIN(MIN(z[0], z[1]), MIN(z[2], z[3]));
+      zmax = MAX(MAX(z[0], z[1]), MAX(z[2], z[3]));
+
+      /* first level above zmin */
+      lo = 0; hi = nlevels;
+      while(lo < hi){
+        mid = (lo + hi) / 2;
+        if(levels[mid].value <= zmin) lo = mid + 1; else hi = mid;
+      }
+      if(lo >= nlevels || levels[lo].value > zmax) continue;
+
+      cx[0] = cx[3] = xs[i];
+      cx[1] = cx[2] = xs[i+1];
+      cy[0] = cy[1] = ys[j];
+      cy[2] = cy[3] = ys[j+1];
+      edge[0] = j*(nx-1)+i;
+      edge[1] = nh + j*nx+i+1;
+      edge[2] = (j+1)*(nx-1)+i;
+      edge[3] = nh + j*nx+i;
+
+      for(l = lo; l < nlevels && levels[l].value <= zmax; l++){
+        gdouble h = levels[l].value;
+        gboolean above[4];
+        GtkPlotPoint p[4];
+        gint cut[4], ncut = 0;
+
+        for(k = 0; k < 4; k++) above[k] = z[k] >= h;
+
+        for(k = 0; k < 4; k++){
+          gint k1 = (k+1)&3;
+          if(above[k] != above[k1]){
+            gdouble t = (h - z[k]) / (z[k1] - z[k]);
+            p[k].x = cx[k] + t * (cx[k1] - cx[k]);
+            p[k].y = cy[k] + t * (cy[k1] - cy[k]);
+            cut[ncut++] = k;
+          }
+        }
+
+        if(ncut == 2){
+          GtkPlotContourSeg s;
+          s.e[0] = edge[cut[0]]; s.p[0] = p[cut[0]];
+          s.e[1] = edge[cut[1]]; s.p[1] = p[cut[1]];
+          g_array_append_val(segs[l], s);
+        } else if(ncut == 4){
+          /* saddle, cut off the corners that are on the other side
+             than the center */
+          gboolean center = (z[0]+z[1]+z[2]+z[3])/4. >= h;
+          for(k = 0; k < 4; k++){
+            gint k0 = (k+3)&3;
+            GtkPlotContourSeg s;
+            if(above[k] == center) continue;
+            s.e[0] = edge[k0]; s.p[0] = p[k0];
+            s.e[1] = edge[k]; s.p[1] = p[k];
+            g_array_append_val(segs[l], s);
+          }
+        }
+      }
+    }
+  }
+
+  slot = g_new(gint, 2*nedges);
+  for(i = 0; i < 2*nedges; i++) slot[i] = -1;
+
+  /* the triangulation version lists the highest level first */
+  for(l = 0; l < nlevels; l++){
+    csurface->grid_lines = join_segments(csurface->grid_lines, segs[l], slot,
+                                         levels[l].value, levels[l].minor);
+    g_array_free(segs[l], TRUE);
+  }
+
+  g_free(slot);
+  g_free(segs);
+  g_free(levels);
+  g_free(xs);
+  g_free(ys);
+
+  return TRUE;
+}
+
 static void
 gtk_plot_csurface_build_polygons(GtkPlotSurface *surface)
 {
@@ -1296,7 +1590,14 @@ gtk_plot_csurface_build_polygons(GtkPlotSurface *surface)
   clear_polygons(GTK_PLOT_CSURFACE(surface));
 
   if(!GTK_IS_PLOT3D(data->plot)){
-    gtk_plot_csurface_build_contours(surface);
+    if(gtk_plot_csurface_build_grid_contours(surface)){
+      /* the filled regions still come from the triangles, only build
+         them if they get drawn */
+      GTK_PLOT_CSURFACE(surface)->on_grid = TRUE;
+      GTK_PLOT_CSURFACE(surface)->fill_pending = TRUE;
+    } else {
+      gtk_plot_csurface_build_contours(surface);
+    }
     return;
   }
 
@@ -1361,7 +1662,7 @@ gtk_plot_csurface_build_polygons(GtkPlotSurface *surface)
             polygon->xyz[2].x = triangle->nc->x;
             polygon->xyz[2].y = triangle->nc->y;
             polygon->xyz[2].z = triangle->nc->z;
-            surface->polygons = g_list_append(surface->polygons, polygon);
+            surface->polygons = g_list_prepend(surface->polygons, polygon);
             break;
         }
     }
@@ -1373,13 +1674,13 @@ gtk_plot_csurface_build_polygons(GtkPlotSurface *surface)
         if((polygon = sides_cut_level(triangle, points, side, h))){  
           polygon->sublevel = ticks[level].minor;
           if(level == 0) polygon->level -= step;
-          surface->polygons = g_list_append(surface->polygons, polygon);
+          surface->polygons = g_list_prepend(surface->polygons, polygon);
         }
 
     }
     list = list->next;
   }
-
+  surface->polygons = g_list_reverse(surface->polygons);
 }
 
 static void
@@ -1596,6 +1897,19 @@ clear_polygons(GtkPlotCSurface *csurface)
     g_list_free(csurface->bg_triangles);
     csurface->bg_triangles = NULL;
   }
+
+  if(csurface->grid_lines){
+    GList *list;
+    for (list = csurface->grid_lines; list; list = list->next){
+      GtkPlotContourLine *line = (GtkPlotContourLine *)list->data;
+      g_free(line->contour);
+      g_free(line);
+    }
+    g_list_free(csurface->grid_lines);
+    csurface->grid_lines = NULL;
+  }
+  csurface->on_grid = FALSE;
+  csurface->fill_pending = FALSE;
 }
 
 static void
@@ -69,6 +69,10 @@ struct _GtkPlotCSurface
   GList *levels;           /* polygons corresponding to each contour level */
   GList *bg_triangles;     /* background triangles, drawn before the contour
                               levels, that are not cut by any contour line */
+  GList *grid_lines;       /* contour lines of data on a regular grid, in
+                              data coordinates, highest level first */
+  gboolean on_grid;        /* lines come from grid_lines */
+  gboolean fill_pending;   /* levels and bg_triangles not built yet */
 
   GtkPlotLine levels_line;
   GtkPlotLine sublevels_line;
@@ -38,6 +38,8 @@
 #include "gtkextra-marshal.h"
 
 #define DEFAULT_FONT_HEIGHT 18
+/* data sets this large are decimated when drawn, see below */
+#define DECIMATE_MIN_POINTS 2048
 #define P_(string) string
 
 static gchar DEFAULT_FONT[] = "Helvetica";
@@ -2654,6 +2656,7 @@ gtk_plot_data_real_real_draw   (GtkPlotData *dataset,
   gdouble x = 0., y = 0., z = 0., a = 0.;
   gdouble dx = 0., dy = 0., dz = 0., da = 0.;
   gdouble a_scale = 1., y_scale = 1., z_scale = 1.;
+  gboolean *keep = NULL;
   gint n;
   gdouble m;
   GtkAllocation allocation;
@@ -2694,8 +2697,38 @@ gtk_plot_data_real_real_draw   (GtkPlotData *dataset,
   z_array = gtk_plot_data_dimension_get_array(dataset, "z");
   if(z_array) z_scale = z_array->scale;
 
+  /* huge data sets, do not draw many symbols over each other, unless
+   * the symbols differ from point to point */
+  if(npoints >= DECIMATE_MIN_POINTS &&
+     dataset->symbol.symbol_type != GTK_PLOT_SYMBOL_NONE &&
+     !array_a && !array_da && !array_dx && !array_dy && !array_dz &&
+     !(dataset->show_labels && array_labels)){
+    GtkPlotPoint *pixels = g_new(GtkPlotPoint, npoints);
+    gint first = dataset->num_points-npoints;
+
+    keep = g_new(gboolean, npoints);
+    for(n=first; n<=dataset->num_points-1; n++){
+      gdouble px, py, pz;
+
+      if(array_x) x = array_x[n];
+      if(array_y) y = array_y[n];
+      if(array_z) z = array_z[n];
+      if(GTK_IS_PLOT3D(plot))
+        gtk_plot3d_get_pixel(GTK_PLOT3D(plot), x, y*y_scale, z*z_scale,
+                             &px, &py, &pz);
+      else
+        gtk_plot_get_pixel(plot, x, y*y_scale, &px, &py);
+      pixels[n-first].x = px;
+      pixels[n-first].y = py;
+    }
+    gtk_plot_data_decimate_symbols(pixels, npoints, keep);
+    g_free(pixels);
+  }
+
   for(n=dataset->num_points-npoints; n<=dataset->num_points-1; n++)
     {
+      if(keep && !keep[n-(dataset->num_points-npoints)]) continue;
+
       if(array_x) x = array_x[n];
       if(array_y) y = array_y[n];
       if(array_z) z = array_z[n];
@@ -2753,6 +2786,8 @@ gtk_plot_data_real_real_draw   (GtkPlotData *dataset,
       }
     }
 
+  g_free(keep);
+
   gtk_plot_pc_grestore(plot->pc);
 }
 
@@ -4658,6 +4693,156 @@ gtk_plot_data_draw_star(GtkPlotData *data, gdouble x, gdouble y, gdouble size)
                         x-s2, y+s2, x+s2, y-s2);
 }
 
+/* Decimate points already in device coordinates before they are handed
+ * to the plot pc.  For lines each run of consecutive points falling in
+ * the same pixel column is replaced by its first, lowest, highest and
+ * last point (in their original order), which draws the same pixels, so
+ * peaks are kept.  For plain points a point is dropped if it lands on the
+ * same pixel as the one before it.  Non finite points are kept since they
+ * break the line.  Works in place and returns the new number of points.
+ * Since it is done on every draw it follows zooming, and for PostScript
+ * the "pixels" are points so the output stays a reasonable size.
+ * -Jiri */
+
+/* write out the first, low, high and last point of a run, low and high
+ * in the order they came and each point only once */
+static void
+decimate_flush_run (GtkPlotPoint *points, gint *out,
+		    const GtkPlotPoint *run, const gint *idx)
+{
+  gint order[4] = { 0, 1, 2, 3 };
+  gint i;
+
+  if(idx[2] < idx[1]){
+    order[1] = 2;
+    order[2] = 1;
+  }
+
+  for(i = 0; i < 4; i++){
+    /* the low or high might be the first or last point */
+    if(i > 0 && idx[order[i]] == idx[order[i-1]]) continue;
+    points[(*out)++] = run[order[i]];
+  }
+}
+
+static gint
+gtk_plot_data_decimate_points (GtkPlotPoint *points, gint num_points,
+			       gboolean lines)
+{
+  GtkPlotPoint run[4]; /* first, low, high, last */
+  gint idx[4];
+  gint out = 0;
+  gint col = 0;
+  gboolean in_run = FALSE;
+  gint i;
+
+  if(num_points < DECIMATE_MIN_POINTS) return num_points;
+
+  if(!lines){
+    gint lastx = 0, lasty = 0;
+    gboolean have_last = FALSE;
+
+    for(i = 0; i < num_points; i++){
+      GtkPlotPoint p = points[i];
+      gint px, py;
+
+      if(!isfinite(p.x) || !isfinite(p.y)){
+        have_last = FALSE;
+        points[out++] = p;
+        continue;
+      }
+      px = (gint)floor(p.x);
+      py = (gint)floor(p.y);
+      if(have_last && px == lastx && py == lasty) continue;
+      lastx = px;
+      lasty = py;
+      have_last = TRUE;
+      points[out++] = p;
+    }
+    return out;
+  }
+
+  for(i = 0; i < num_points; i++){
+    GtkPlotPoint p = points[i];
+    gint c;
+
+    if(!isfinite(p.x) || !isfinite(p.y)){
+      if(in_run) decimate_flush_run(points, &out, run, idx);
+      in_run = FALSE;
+      points[out++] = p;
+      continue;
+    }
+
+    c = (gint)floor(p.x);
+    if(in_run && c == col){
+      if(p.y < run[1].y){ run[1] = p; idx[1] = i; }
+      if(p.y > run[2].y){ run[2] = p; idx[2] = i; }
+      run[3] = p;
+      idx[3] = i;
+      continue;
+    }
+
+    if(in_run) decimate_flush_run(points, &out, run, idx);
+
+    col = c;
+    in_run = TRUE;
+    run[0] = run[1] = run[2] = run[3] = p;
+    idx[0] = idx[1] = idx[2] = idx[3] = i;
+  }
+
+  if(in_run) decimate_flush_run(points, &out, run, idx);
+
+  return out;
+}
+
+/* Mark which symbols need drawing.  A symbol landing on a pixel that
+ * already has one would be drawn right over it, so for large data sets
+ * only the first symbol on each pixel is kept, not just the first of a
+ * run of consecutive ones as for plain points.  Non finite points and
+ * points too far off the page to key are always kept.  Returns the
+ * number of symbols to draw. */
+gint
+gtk_plot_data_decimate_symbols (const GtkPlotPoint *points, gint num_points,
+				gboolean *keep)
+{
+  GHashTable *drawn;
+  gint out = 0;
+  gint i;
+
+  if(num_points < DECIMATE_MIN_POINTS){
+    for(i = 0; i < num_points; i++) keep[i] = TRUE;
+    return num_points;
+  }
+
+  drawn = g_hash_table_new(NULL, NULL);
+
+  for(i = 0; i < num_points; i++){
+    gdouble px = floor(points[i].x);
+    gdouble py = floor(points[i].y);
+    gpointer key;
+
+    keep[i] = TRUE;
+    if(!isfinite(px) || !isfinite(py) ||
+       px < G_MININT16 || px > G_MAXINT16 ||
+       py < G_MININT16 || py > G_MAXINT16){
+      out++;
+      continue;
+    }
+    key = GUINT_TO_POINTER((((guint)(gint)px & 0xffff) << 16) |
+                           ((guint)(gint)py & 0xffff));
+    if(g_hash_table_contains(drawn, key)){
+      keep[i] = FALSE;
+      continue;
+    }
+    g_hash_table_add(drawn, key);
+    out++;
+  }
+
+  g_hash_table_destroy(drawn);
+
+  return out;
+}
+
   /* FIXME: if connector none, draw points, so perhaps bad naming */
 static void
 gtk_plot_data_connect_points(GtkPlotData *dataset, gint npoints)
@@ -4899,6 +5084,12 @@ gtk_plot_data_connect_points(GtkPlotData *dataset, gint npoints)
        return;
     }
 
+  /* huge data sets, no need to send more than a few points per pixel */
+  if(dataset->line_connector == GTK_PLOT_CONNECT_STRAIGHT ||
+     dataset->line_connector == GTK_PLOT_CONNECT_NONE)
+    num_points = gtk_plot_data_decimate_points(points, num_points,
+                                               dataset->line_connector == GTK_PLOT_CONNECT_STRAIGHT);
+
   if(dataset->fill_area){
     if(num_points > 1){
       if(GTK_IS_PLOT3D(plot)){
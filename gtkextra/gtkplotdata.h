@@ -69,6 +69,9 @@ void 		gtk_plot_data_draw_points	(GtkPlotData *data,
 						 gint npoints);
 void 		gtk_plot_data_draw_symbol	(GtkPlotData *data, 
                                                  gdouble px, gdouble py); 
+gint		gtk_plot_data_decimate_symbols	(const GtkPlotPoint *points,
+						 gint num_points,
+						 gboolean *keep);
 GtkPlotArray *  gtk_plot_data_dimension_set_points(GtkPlotData *data,
 						 const gchar *name,
 						 gdouble *points);
@@ -51,6 +51,8 @@ static gboolean	gtk_plot_dt_real_triangulate	(GtkPlotDT *dt);
 static void	gtk_plot_dt_real_clear		(GtkPlotDT *dt);
 static gboolean	gtk_plot_dt_triangulate_tryquad	(GtkPlotDT *dt);
 static void 	gtk_plot_dt_clear_triangles	(GtkPlotDT *data);
+static void	gtk_plot_dt_link_neighbours	(GtkPlotDTtriangle *t1,
+						 GtkPlotDTtriangle *t2);
 
 static GtkWidgetClass *parent_class = NULL;
 
@@ -150,6 +152,7 @@ gtk_plot_dt_init (GtkPlotDT *data)
   data->subsampling= FALSE;
   data->nodes= 0;
   data->tmp_nodes= 0;
+  data->node_hash= NULL;
   data->node_0= 0;
   data->node_cnt= 0;
   data->node_max= 0;
@@ -232,6 +235,8 @@ gtk_plot_dt_real_clear(GtkPlotDT *data)
   data->nodes= NULL;
   if (data->tmp_nodes) g_free(data->tmp_nodes);
   data->tmp_nodes= NULL;
+  if (data->node_hash) g_hash_table_destroy(data->node_hash);
+  data->node_hash= NULL;
   data->node_cnt= data->node_max= data->node_0= 0;
 
   gtk_plot_dt_clear_triangles(data);
@@ -265,31 +270,70 @@ gtk_plot_dt_count_triangles(GtkPlotDT *data)
 
 
 
+/* hash and compare nodes by their coordinates, for rejecting
+ * multiple insertions without going through all the nodes */
+static guint
+gtk_plot_dt_node_hash(gconstpointer key)
+{
+  const gdouble *v= key;
+  guint h= 0;
+  gint i;
+
+  /* hash the bits, g_double_hash just truncates to an integer */
+  for (i=0; i<3; i++) {
+    /* -0.0 == 0.0 so they must hash the same */
+    gdouble d= (v[i] == 0.0) ? 0.0 : v[i];
+    guint64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bits*= G_GUINT64_CONSTANT(0x9E3779B97F4A7C15);
+    h= h*31 + (guint)(bits >> 32);
+  }
+  return h;
+}
+
+static gboolean
+gtk_plot_dt_node_equal(gconstpointer a, gconstpointer b)
+{
+  const gdouble *u= a;
+  const gdouble *v= b;
+  return u[0]==v[0] && u[1]==v[1] && u[2]==v[2];
+}
+
 static gboolean 
 gtk_plot_dt_real_add_node(GtkPlotDT *data, GtkPlotDTnode node)
 {
-  gint i;
   GtkPlotDTnode *n;
+  gdouble *key;
 #ifdef DELAUNAY_DEBUG
   fprintf(stderr,"delaunay: adding node %d\n",data->node_cnt);
 #endif
   if (!data) return FALSE;
-  for (i=0, n= data->nodes; i<data->node_cnt; i++, n++) {
-    /* test for multiple insertions */
-    if (n->x==node.x && n->y==node.y && n->z==node.z) {
+  if (!data->node_hash)
+    data->node_hash= g_hash_table_new_full(gtk_plot_dt_node_hash,
+					   gtk_plot_dt_node_equal,
+					   g_free, NULL);
+  key= g_new(gdouble, 3);
+  key[0]= node.x;
+  key[1]= node.y;
+  key[2]= node.z;
+  /* test for multiple insertions */
+  if (g_hash_table_lookup_extended(data->node_hash, key, NULL, NULL)) {
 #ifdef DELAUNAY_DEBUG
-      fprintf(stderr,"gtk_plot_dt_add_node(): rejecting multiple node %d\n",
+    fprintf(stderr,"gtk_plot_dt_add_node(): rejecting multiple node %d\n",
 	    data->node_cnt);
 #endif
-      return FALSE;	
-    }
+    g_free(key);
+    return FALSE;	
   }
+  /* grow geometrically, else adding n nodes is quadratic */
   if (data->node_cnt+1>=data->node_max && 
-      !gtk_plot_dt_expand(data,data->node_cnt+10)) {
+      !gtk_plot_dt_expand(data,MAX(data->node_cnt+10, 2*data->node_max))) {
     fprintf(stderr,"gtk_plot_dt_add_node(): out of memory on node %d\n",
 	    data->node_cnt);
+    g_free(key);
     return FALSE;
   }
+  g_hash_table_insert(data->node_hash, key, key);
   n= &data->nodes[data->node_cnt];
   memcpy(n, &node, sizeof(GtkPlotDTnode));
   n->id= data->node_cnt;
@@ -418,6 +462,7 @@ gtk_plot_dt_add_triangle(GtkPlotDT *data, gint a, gint b, gint c)
   t->radius= -1.0;
   /* prepending gives the same result in the end but >twice as fast */
   data->triangles = g_list_prepend(data->triangles, t);
+  t->link = data->triangles;
 #ifdef DELAUNAY_DEBUG
   fprintf(stderr,"added triangle : %d/%d/%d c=(%g,%g) r=%g\n",a,b,c,
 	  t->ccenter.x,t->ccenter.y, t->radius);
@@ -428,6 +473,7 @@ gtk_plot_dt_add_triangle(GtkPlotDT *data, gint a, gint b, gint c)
 static gint 
 gtk_plot_dt_update_tmpnodes(GtkPlotDT *data)
 {
+  GtkPlotDTtriangle *t1, *t2;
   gint i;
   gdouble xmin,xmax,ymin,ymax,delta=0.5;
   if (!data || data->node_cnt<3) return 0;
@@ -462,8 +508,11 @@ gtk_plot_dt_update_tmpnodes(GtkPlotDT *data)
   data->tmp_nodes[3].x= xmin-delta*(xmax-xmin);
   data->tmp_nodes[3].y= ymax+delta*(ymax-ymin);
 
-  gtk_plot_dt_add_triangle(data,-1,-2,-3);
-  gtk_plot_dt_add_triangle(data,-1,-3,-4);
+  t1= gtk_plot_dt_add_triangle(data,-1,-2,-3);
+  t2= gtk_plot_dt_add_triangle(data,-1,-3,-4);
+  /* they share the diagonal, the walk in
+   * gtk_plot_dt_triangulate_insert_node needs to know */
+  if (t1 && t2) gtk_plot_dt_link_neighbours(t1, t2);
 
   return 1;
 }
@@ -568,15 +617,86 @@ edges_equal(GtkPlotDTedge *e1, GtkPlotDTedge *e2)
   return FALSE;
 }
 
+/* orientation of a,b,c: positive if counterclockwise */
+static gdouble
+gtk_plot_dt_orientation(GtkPlotDTnode *a, GtkPlotDTnode *b, GtkPlotDTnode *c)
+{
+  return (b->x-a->x)*(c->y-a->y) - (b->y-a->y)*(c->x-a->x);
+}
+
+/* Walk from triangle t towards the node, always stepping over an edge the
+ * node is behind, until we are in the triangle that contains it.  The
+ * neighbour nn[i] is across the edge from node i to node i+1 (a-b, b-c,
+ * c-a) and the triangles are counterclockwise (see
+ * gtk_plot_dt_add_triangle()).  Returns NULL if we fall off the
+ * triangulation or walk too long, then the caller has to look through
+ * all the triangles. */
+static GtkPlotDTtriangle *
+gtk_plot_dt_walk(GtkPlotDT *data, GtkPlotDTtriangle *t, GtkPlotDTnode *node)
+{
+  gint steps, max_steps;
+
+  max_steps= 2*(data->node_cnt - data->node_0) + 16;
+  for (steps=0; t && steps<max_steps; steps++) {
+    GtkPlotDTnode *v[3];
+    gint i, k;
+
+    v[0]= t->na;
+    v[1]= t->nb;
+    v[2]= t->nc;
+    /* start with a different edge each step so that we cannot go
+     * around in circles */
+    for (k=0; k<3; k++) {
+      i= (k+steps)%3;
+      if (gtk_plot_dt_orientation(v[i], v[(i+1)%3], node) < 0.0)
+	break;
+    }
+    if (k==3) return t; /* inside or on the boundary */
+    t= t->nn[i];
+  }
+  return NULL;
+}
+
+/* make t1 and t2 neighbours if they share an edge */
+static void
+gtk_plot_dt_link_neighbours(GtkPlotDTtriangle *t1, GtkPlotDTtriangle *t2)
+{
+  GtkPlotDTedge e1[3], e2[3];
+  gint m, n;
+
+  e1[0].a= t1->a; e1[0].b= t1->b;
+  e1[1].a= t1->b; e1[1].b= t1->c;
+  e1[2].a= t1->c; e1[2].b= t1->a;
+  e2[0].a= t2->a; e2[0].b= t2->b;
+  e2[1].a= t2->b; e2[1].b= t2->c;
+  e2[2].a= t2->c; e2[2].b= t2->a;
+  for (m=0; m<3; m++)
+    for (n=0; n<3; n++)
+      if (edges_equal(&e1[m], &e2[n])) {
+	t1->nn[m]= t2;
+	t2->nn[n]= t1;
+	return;
+      }
+}
+
+/* Insert one node into the triangulation (Bowyer-Watson).  hint is a
+ * triangle to start looking for the node from, usually one made by the
+ * previous insertion, and it is set to one of the new triangles.  When
+ * the nodes come in a spatially coherent order the walk is only a few
+ * steps, and the triangles whose circles contain the node are found by
+ * going through the neighbours, so an insertion takes about constant
+ * time. */
 static void
-gtk_plot_dt_triangulate_insert_node(GtkPlotDT *data, GtkPlotDTnode *node)
+gtk_plot_dt_triangulate_insert_node(GtkPlotDT *data, GtkPlotDTnode *node,
+				    GtkPlotDTtriangle **hint)
 {
-  gint j,k,l, delinquentes;
+  gint j,k, delinquentes;
   GtkPlotDTtriangle *t = NULL;
   gdouble err, min;
-  GList *list = NULL, *doomed = NULL, *last = NULL, *new = NULL, *aux = NULL;
+  GList *list = NULL, *doomed = NULL, *new = NULL, *aux = NULL;
   gint num = 0;
   GtkPlotDTedge *edges = NULL;
+  GtkPlotDTtriangle *found_t = NULL;
 
 #ifdef DELAUNAY_DEBUG
   printf("inserting node %d %f %f\n",node->id,node->x,node->y);
@@ -586,207 +706,127 @@ gtk_plot_dt_triangulate_insert_node(GtkPlotDT *data, GtkPlotDTnode *node)
   num = 0;
   delinquentes = 0;
   doomed = NULL; 
-  min= 1e99; /* minimal inside-triangle criteria found (==1: inside) */
-  list = data->triangles;
-  while(list) {
-    t = (GtkPlotDTtriangle *)list->data;
-    if ((err=gtk_plot_dt_inside_triangle(data,t,node))
-	<min) {
-      min= err; 
-      doomed = list;
-      if (min<1.000001) break; /* need not be better than that! */
+
+  if (hint && *hint)
+    found_t= gtk_plot_dt_walk(data, *hint, node);
+
+  if (!found_t) {
+    min= 1e99; /* minimal inside-triangle criteria found (==1: inside) */
+    list = data->triangles;
+    while(list) {
+      t = (GtkPlotDTtriangle *)list->data;
+      if ((err=gtk_plot_dt_inside_triangle(data,t,node))
+	  <min) {
+	min= err; 
+	found_t= t;
+	if (min<1.000001) break; /* need not be better than that! */
+      }
+      list = list->next;
     }
-    list = list->next;
   }
   
-  if (doomed) { /* triangle found with node inside! */
+  if (found_t) { /* triangle found with node inside! */
     GList *last_doomed;
     /* "doomed" is a new list where all removed triangles go to
      * for finding the outline of the new triangles to be inserted.
      * The first triangle to go there is the one found above.
      * Afterwards the "doomed" list is doomed to die :-)
+     * Doomed triangles are marked as visited.
      */
-    data->triangles= g_list_remove_link(data->triangles, doomed);
-    last_doomed = g_list_last(doomed);
+    doomed= last_doomed= g_list_prepend(NULL, found_t);
+    found_t->visited= TRUE;
     delinquentes++;
 #ifdef DELAUNAY_DEBUG
-    fprintf(stderr,"marking triangle %d/%d/%d doomed (min=%g)\n",
-	    t->a,t->b,t->c,min);
+    fprintf(stderr,"marking triangle %d/%d/%d doomed\n",
+	    found_t->a,found_t->b,found_t->c);
 #endif
-    /* now, find all adjacent triangles with this node in their circles: */
-    list = data->triangles;
-    while(list) {
-      GtkPlotDTtriangle *doomed_t;
-      t = (GtkPlotDTtriangle *)list->data;
-      doomed_t = (GtkPlotDTtriangle *)doomed->data;
-      if ((t->a==doomed_t->a || t->b==doomed_t->a || t->c==doomed_t->a || 
-	   t->a==doomed_t->b || t->b==doomed_t->b || t->c==doomed_t->b || 
-	   t->a==doomed_t->c || t->b==doomed_t->c || t->c==doomed_t->c) &&
-	  gtk_plot_dt_inside_triangle_circle(t,node)) {
-	
-	/* move triangle to "doomed" list */
-	last= list->next;
-	data->triangles= g_list_remove_link(data->triangles, list);
-        /* faster than g_list_concat */
-        list->prev = last_doomed;
-        list->next = NULL;
-        last_doomed->next = list;
-        last_doomed = list;
+    /* now, find all the triangles with this node in their circles,
+     * they are connected to the first one through neighbours: */
+    for (list = doomed; list; list = list->next) {
+      GtkPlotDTtriangle *doomed_t = (GtkPlotDTtriangle *)list->data;
+      for (k = 0; k < 3; k++) {
+	t = doomed_t->nn[k];
+	if (!t || t->visited || !gtk_plot_dt_inside_triangle_circle(t,node))
+	  continue;
+	t->visited= TRUE;
+	/* append to "doomed", faster than g_list_append */
+	aux = g_list_alloc();
+	aux->data = t;
+	aux->prev = last_doomed;
+	aux->next = NULL;
+	last_doomed->next = aux;
+	last_doomed = aux;
 	delinquentes++;
 #ifdef DELAUNAY_DEBUG
 	fprintf(stderr,"marking     also %d/%d/%d doomed\n",t->a,t->b,t->c);
 #endif
-	list = last;
-      } else {
-	list = list->next;
       }
     }
+
+    /* take them out of the triangle list */
+    for (list = doomed; list; list = list->next) {
+      t = (GtkPlotDTtriangle *)list->data;
+      data->triangles= g_list_delete_link(data->triangles, t->link);
+      t->link= NULL;
+    }
+
+    /* The outline of the doomed triangles is made of the edges whose
+     * neighbour is not doomed, connect those to the new node.  Here
+     * edges[].t is the triangle on the other side. */
     edges= (GtkPlotDTedge*)g_malloc(sizeof(GtkPlotDTedge)*delinquentes*3);
     num= 0;
-    
-    list = doomed;
-    while(list){
-      t = (GtkPlotDTtriangle *)list->data;
-      edges[num].a= t->a; edges[num].b= t->b; edges[num].t = t; num++;
-      edges[num].a= t->b; edges[num].b= t->c; edges[num].t = t; num++;
-      edges[num].a= t->c; edges[num].b= t->a; edges[num].t = t; num++;
-      list = list->next;
+    for (list = doomed; list; list = list->next) {
+      GtkPlotDTtriangle *doomed_t = (GtkPlotDTtriangle *)list->data;
+      gint v[3];
+      v[0]= doomed_t->a;
+      v[1]= doomed_t->b;
+      v[2]= doomed_t->c;
+      for (k = 0; k < 3; k++) {
+	t= doomed_t->nn[k];
+	if (t && t->visited) continue;
+	edges[num].a= v[k];
+	edges[num].b= v[(k+1)%3];
+	edges[num].t= t;
+	num++;
+      }
     }
 
 #ifdef DELAUNAY_DEBUG
-    fprintf(stderr,"detected edges: ");
+    fprintf(stderr,"outline edges: ");
     for (j=0; j<num; j++)
       fprintf(stderr,"(%d %d) ",edges[j].a,edges[j].b);
     fprintf(stderr,"\n");
-    fprintf(stderr,"collapsing edges: ");
-    for (j=0; j<num; j++) {
-      l=0; 
-      for (k=0; k<num; k++) 
-	if (edges_equal(&edges[j], &edges[k])) l++;
-      if (l==1)
-	fprintf(stderr,"(%d %d) ",edges[j].a,edges[j].b);
-    }
-    fprintf(stderr,"\n");
 #endif
-    /* for all edges: */
     for (j=0; j<num; j++) {
-      /* count occurences of this edge: */ 
-      for (k=0, l=0; k<num; k++) 
-	if (edges_equal(&edges[j], &edges[k])) l++;
-      /* only one occurence of an edge indicates outline edge! */
-      if (l==1){ 
-        GtkPlotDTtriangle *t;
-	t = gtk_plot_dt_add_triangle(data,node->id,edges[j].a,edges[j].b);
-        if(t) new = g_list_append(new, t);
-      }
+      GtkPlotDTtriangle *outer = edges[j].t;
+      t = gtk_plot_dt_add_triangle(data,node->id,edges[j].a,edges[j].b);
+      if (!t) continue;
+      new = g_list_prepend(new, t);
+      /* the outer neighbour now borders the new triangle instead of
+       * the doomed one */
+      if (outer) gtk_plot_dt_link_neighbours(t, outer);
     }
-    if(edges) g_free(edges);
+    g_free(edges);
 
-
-    /* Find neighbours */
-    list = new;
-    while(list){
-      GtkPlotDTtriangle *t = (GtkPlotDTtriangle *)list->data;
-      GtkPlotDTedge t_edges[3];
-      gint l, m, n;
-      gboolean found = FALSE;
-      t_edges[0].a = t->a;
-      t_edges[0].b = t->b;
-      t_edges[1].a = t->b;
-      t_edges[1].b = t->c;
-      t_edges[2].a = t->c;
-      t_edges[2].b = t->a;
-      /* I look for the neighbours into the doomed triangles' neighbours */
-      aux = doomed;
-      while(aux){
-        GtkPlotDTedge nn[3];
-        GtkPlotDTtriangle *doomed_t = (GtkPlotDTtriangle *)aux->data;
-        /* for each doomed triangles I have 3 neighbours */
-        for(l = 0; l < 3; l++){
-          GtkPlotDTtriangle *doomed_nn = doomed_t->nn[l];
-          GList *aux2; /* verify that doomed_nn is not doomed */
-          for(aux2 = doomed; aux2; aux2 = aux2->next) 
-            if(doomed_nn == aux2->data) doomed_nn = NULL;
-          if(doomed_nn){
-            nn[0].a = doomed_nn->a;
-            nn[0].b = doomed_nn->b;
-            nn[1].a = doomed_nn->b;
-            nn[1].b = doomed_nn->c;
-            nn[2].a = doomed_nn->c;
-            nn[2].b = doomed_nn->a;
-            /* for each of the 3 neighbours I have 3 edges */
-            for(m = 0; m < 3; m++){
-              for(n = 0; n < 3; n++){
-                if(edges_equal(&nn[m], &t_edges[n])){
-                  doomed_nn->nn[m] = t;
-                  t->nn[n] = doomed_nn;
-                  found = TRUE;
-                  break; 
-                }
-              }
-              if(found) break;
-            }
-          }
-          if(found) break;
-        }
-        if(found) break;
-        aux = aux->next;
-      }
-      /* I look for the triangle's neighbours into the new triangles */
-      aux = new;
-      while(aux){
-        GtkPlotDTedge nn[3];
-        GtkPlotDTtriangle *new_t = (GtkPlotDTtriangle *)aux->data;
-        if(new_t != t){
-          nn[0].a = new_t->a;
-          nn[0].b = new_t->b;
-          nn[1].a = new_t->b;
-          nn[1].b = new_t->c;
-          nn[2].a = new_t->c;
-          nn[2].b = new_t->a;
-          /* for each of the triangles I have 3 edges */
-          found = FALSE;
-          for(m = 0; m < 3; m++){
-            for(n = 0; n < 3; n++){
-              if(edges_equal(&nn[m], &t_edges[n])){
-                new_t->nn[m] = t;
-                t->nn[n] = new_t;
-                found = TRUE;
-                break; 
-              }
-              if(found) break;
-            }
-            if(found) break;
-          }
-        }
-        aux = aux->next;
-      }
-
-      list = list->next;
-    }
+    /* the new triangles are a fan around the node, find the neighbours
+     * among them */
+    for (list = new; list; list = list->next)
+      for (aux = list->next; aux; aux = aux->next)
+	gtk_plot_dt_link_neighbours(list->data, aux->data);
   }
 
+  if (hint) {
+    if (new)
+      *hint= (GtkPlotDTtriangle *)new->data;
+    else if (doomed)
+      *hint= NULL;
+  }
   /* now actually delete the "doomed" triangles,
    * we don't need them any longer:
    */
   if(doomed){
-    for (list = doomed; list; list = list->next){
-      GtkPlotDTtriangle *t = (GtkPlotDTtriangle *)list->data;
-      gint i;
-      if(t->nn[0]){
-        for(i = 0; i < 3; i++)
-          if(t->nn[0]->nn[i] == t) t->nn[0]->nn[i] = NULL;
-      }
-      if(t->nn[1]){
-        for(i = 0; i < 3; i++)
-          if(t->nn[1]->nn[i] == t) t->nn[1]->nn[i] = NULL;
-      }
-      if(t->nn[2]){
-        for(i = 0; i < 3; i++)
-          if(t->nn[2]->nn[i] == t) t->nn[2]->nn[i] = NULL;
-      }
+    for (list = doomed; list; list = list->next)
       g_free(list->data);    
-    }
     g_list_free(doomed);
   } 
   if(new) g_list_free(new);
@@ -891,6 +931,7 @@ gtk_plot_dt_triangulate_subsample(GtkPlotDT *data)
   gint node_idx, cnt;
   GList *tmplist, *t, *tmpnodes=NULL;
   GtkPlotDTnode *n= NULL;
+  GtkPlotDTtriangle *hint;
 
   /* for each triangle: walk through the rest of the list, if the triangle
    * and one of the rest are neighbours, store interpolated node 
@@ -916,17 +957,95 @@ gtk_plot_dt_triangulate_subsample(GtkPlotDT *data)
   for (t= tmpnodes; t; t=t->next) { g_free(t->data); }
   g_list_free(tmpnodes);
   data->node_0= -1-cnt;
+  hint= data->triangles ? data->triangles->data : NULL;
   for (node_idx=data->node_0;node_idx<0;node_idx++) 
     gtk_plot_dt_triangulate_insert_node(data, 
-					gtk_plot_dt_get_node(data,node_idx));
+					gtk_plot_dt_get_node(data,node_idx),
+					&hint);
   return gtk_plot_dt_count_triangles(data);
 }
 
+/* distance of (x,y) along the Hilbert curve filling the n by n square,
+ * n a power of two */
+static guint64
+gtk_plot_dt_hilbert(guint32 n, guint32 x, guint32 y)
+{
+  guint64 d= 0;
+  guint32 s, rx, ry, t;
+
+  for (s=n/2; s>0; s/=2) {
+    rx= (x & s) > 0;
+    ry= (y & s) > 0;
+    d+= (guint64)s * s * ((3 * rx) ^ ry);
+    /* rotate the quadrant */
+    if (ry == 0) {
+      if (rx == 1) {
+	x= n-1 - x;
+	y= n-1 - y;
+      }
+      t= x; x= y; y= t;
+    }
+  }
+  return d;
+}
+
+typedef struct {
+  guint64 key;
+  gint idx;
+} GtkPlotDTorder;
+
+static gint
+gtk_plot_dt_compare_order(const void *_a, const void *_b)
+{
+  const GtkPlotDTorder *a= _a;
+  const GtkPlotDTorder *b= _b;
+  if (a->key < b->key) return -1;
+  if (a->key > b->key) return 1;
+  return a->idx - b->idx;
+}
+
+/* indices of the nodes sorted along a Hilbert curve */
+static gint *
+gtk_plot_dt_spatial_order(GtkPlotDT *data)
+{
+  GtkPlotDTorder *o;
+  gint *order;
+  gdouble xmin,xmax,ymin,ymax,sx,sy;
+  const guint32 n= 1<<16;
+  gint i;
+
+  xmin= xmax= data->nodes[0].x;
+  ymin= ymax= data->nodes[0].y;
+  for (i=1; i<data->node_cnt; i++) {
+    if (xmax<data->nodes[i].x) xmax=data->nodes[i].x;
+    if (xmin>data->nodes[i].x) xmin=data->nodes[i].x;
+    if (ymax<data->nodes[i].y) ymax=data->nodes[i].y;
+    if (ymin>data->nodes[i].y) ymin=data->nodes[i].y;
+  }
+  sx= (xmax>xmin) ? (n-1)/(xmax-xmin) : 0.0;
+  sy= (ymax>ymin) ? (n-1)/(ymax-ymin) : 0.0;
+
+  o= g_new(GtkPlotDTorder, data->node_cnt);
+  for (i=0; i<data->node_cnt; i++) {
+    guint32 x= (guint32)((data->nodes[i].x-xmin)*sx);
+    guint32 y= (guint32)((data->nodes[i].y-ymin)*sy);
+    o[i].key= gtk_plot_dt_hilbert(n, MIN(x,n-1), MIN(y,n-1));
+    o[i].idx= i;
+  }
+  qsort(o, data->node_cnt, sizeof(GtkPlotDTorder), gtk_plot_dt_compare_order);
+
+  order= g_new(gint, data->node_cnt);
+  for (i=0; i<data->node_cnt; i++) order[i]= o[i].idx;
+  g_free(o);
+  return order;
+}
+
 static gboolean
 gtk_plot_dt_real_triangulate(GtkPlotDT *data)
 {
-  gint node_idx, tcnt;
-  gdouble max; 
+  gint i, node_idx, tcnt;
+  gint *order;
+  GtkPlotDTtriangle *hint;
 
   if (!data) return FALSE;
   if (!data || ! data->nodes || data->node_cnt<3) return FALSE;
@@ -939,17 +1058,21 @@ gtk_plot_dt_real_triangulate(GtkPlotDT *data)
   /* create auxiliary triangles all to-be-inserted nodes will reside in */
   if (!gtk_plot_dt_update_tmpnodes(data)) return FALSE;
 
-  /* now insert all nodes in the nodelist */
-  max= data->node_cnt-1; max*=max;
-  for (node_idx=0; node_idx<data->node_cnt; node_idx++) {
+  /* now insert all nodes in the nodelist, in the order of a curve
+   * through the plane so that each node is close to the one before */
+  order= gtk_plot_dt_spatial_order(data);
+  hint= data->triangles ? data->triangles->data : NULL;
+  for (i=0; i<data->node_cnt; i++) {
+    node_idx= order[i];
 #ifdef DELAUNAY_DEBUG
     fprintf(stderr,"inserting node %d/%d\n",node_idx,data->node_cnt);
 #endif
-    gtk_plot_dt_triangulate_insert_node(data, &data->nodes[node_idx]);
+    gtk_plot_dt_triangulate_insert_node(data, &data->nodes[node_idx], &hint);
     if (data->pbar) {
-      (*data->pbar) (1.0*node_idx*node_idx/max);
+      (*data->pbar) (1.0*i/data->node_cnt);
     }
   }
+  g_free(order);
 
   /* remove auxiliary triangles: */
   tcnt= gtk_plot_dt_drop_tmpstuff(data);
@@ -1058,26 +1181,11 @@ gtk_plot_dt_compare_nodes_xy_wise(gconstpointer a, gconstpointer b)
   return 0;
 }
 
-static GtkPlotDTtriangle *
-find_neighbor(GtkPlotDT *dt, GtkPlotDTtriangle *t, gint n1, gint n2)
+static int
+gtk_plot_dt_compare_node_ptrs(const void *a, const void *b)
 {
-  GList *list;
-  GtkPlotDTtriangle *triangle;
-
-  list = dt->triangles;
-  while(list) {
-    triangle = (GtkPlotDTtriangle *)list->data;
-    if(triangle != t){
-      if(triangle->na->id == n1 && triangle->nb->id == n2) return triangle;
-      if(triangle->nb->id == n1 && triangle->na->id == n2) return triangle;
-      if(triangle->na->id == n1 && triangle->nc->id == n2) return triangle;
-      if(triangle->nc->id == n1 && triangle->na->id == n2) return triangle;
-      if(triangle->nb->id == n1 && triangle->nc->id == n2) return triangle;
-      if(triangle->nc->id == n1 && triangle->nb->id == n2) return triangle;
-    }
-    list = list->next;
-  }
-  return NULL;
+  return gtk_plot_dt_compare_nodes_xy_wise(*(GtkPlotDTnode * const *)a,
+					   *(GtkPlotDTnode * const *)b);
 }
 
 static gboolean
@@ -1085,7 +1193,8 @@ gtk_plot_dt_triangulate_tryquad(GtkPlotDT *data)
 {
   GList *nodes= NULL, *list= NULL;
   GList *xrow_prev, *xrow_next= NULL, *xrow_sec= NULL;
-  GtkPlotDTnode *node, *x0y0, *x0y1, *x1y0, *x1y1, *center;
+  GtkPlotDTnode *x0y0, *x0y1, *x1y0, *x1y1, *center;
+  GtkPlotDTnode **sorted;
   gint i, nc, nx= 0, ny= 0, x, y, num_mid, m;
   /* double x0;*/
  
@@ -1093,10 +1202,13 @@ gtk_plot_dt_triangulate_tryquad(GtkPlotDT *data)
   if (!data || ! data->nodes || data->node_cnt<3) return 0;
 
   nc= data->node_cnt;
-  node= data->nodes;
-  for (i=0; i<nc; i++,node++) {
-    nodes= g_list_insert_sorted(nodes,node,gtk_plot_dt_compare_nodes_xy_wise);
-  }
+  /* sort an array, inserting into a sorted list one by one is
+   * quadratic */
+  sorted= g_new(GtkPlotDTnode *, nc);
+  for (i=0; i<nc; i++) sorted[i]= &data->nodes[i];
+  qsort(sorted, nc, sizeof(GtkPlotDTnode *), gtk_plot_dt_compare_node_ptrs);
+  for (i=nc-1; i>=0; i--) nodes= g_list_prepend(nodes, sorted[i]);
+  g_free(sorted);
 
   /* x0= ((GtkPlotDTnode *)nodes->data)->x; */
 
@@ -1178,10 +1290,6 @@ gtk_plot_dt_triangulate_tryquad(GtkPlotDT *data)
         t3->nn[1] = t4;
         t4->nn[0] = t3;
         t4->nn[1] = t1;
-        find_neighbor(data, t1, x0y0->id, x1y0->id);
-        find_neighbor(data, t2, x1y0->id, x1y1->id);
-        find_neighbor(data, t3, x1y1->id, x0y1->id);
-        find_neighbor(data, t4, x0y1->id, x0y0->id);
 	m++;
 	y++;
       } else {
@@ -72,6 +72,7 @@ struct _GtkPlotDTtriangle
   GtkPlotDTnode min,max; /* the bounding box */
   GtkPlotDTtriangle *nn[3]; /* neighbours */
   gboolean visited;	 /* auxiliary variable for sweeping though list */
+  GList *link;		 /* our link in the triangles list */
 };
 
 /* a progress indicator function with optional 'cancel' functionality
@@ -99,6 +100,7 @@ struct _GtkPlotDT
   gint node_max;             /* maximum number of nodes */
   GtkPlotDTnode *nodes;     /* the nodes themselves */
   GtkPlotDTnode *tmp_nodes; /* index<0: tmpnodes[-1-index] */
+  GHashTable *node_hash;     /* the (x,y,z) of all nodes, for duplicates */
 
   GList *triangles;
   GCompareFunc compare_func;
@@ -627,6 +627,8 @@ gtk_plot_surface_init (GtkPlotSurface *dataset)
   dataset->recalc_dt = TRUE;
 
   dataset->polygons = NULL;
+  dataset->sort_buf = NULL;
+  dataset->sort_buf_len = 0;
 
   dim = gtk_plot_data_find_dimension(GTK_PLOT_DATA(dataset), "y");
   gtk_plot_array_set_independent(dim, TRUE);
@@ -695,6 +697,10 @@ gtk_plot_surface_destroy(GtkWidget *object)
 
   clear_polygons(surface);
 
+  g_free(surface->sort_buf);
+  surface->sort_buf = NULL;
+  surface->sort_buf_len = 0;
+
   if ( GTK_WIDGET_CLASS (parent_class)->destroy )
     (* GTK_WIDGET_CLASS (parent_class)->destroy) (object);
 }
@@ -1919,10 +1925,11 @@ gtk_plot_surface_build_polygons(GtkPlotSurface *surface)
     polygon->xyz[2].x = triangle->nc->x; 
     polygon->xyz[2].y = triangle->nc->y; 
     polygon->xyz[2].z = triangle->nc->z; 
-    surface->polygons = g_list_append(surface->polygons, polygon);
+    surface->polygons = g_list_prepend(surface->polygons, polygon);
 
     list = list->next;
   };
+  surface->polygons = g_list_reverse(surface->polygons);
 }
 
 /**
@@ -1982,238 +1989,157 @@ gtk_plot_surface_recalc_nodes(GtkPlotSurface *surface)
   
 }
 
+/* PAINTER'S ORDER
+ *
+ * Polygons are drawn back to front by the depth of their triangle (the
+ * sum of the pixel z of its nodes), the ones cut from the same triangle
+ * by the lowest z and then by level.  The depth is turned into an
+ * unsigned key so that the polygons can be radix sorted, and since the
+ * list is kept in the order of the last redraw, which after a small
+ * rotation is nearly sorted already, an insertion sort is tried first. */
+
+typedef struct {
+  guint32 key;
+  GtkPlotPolygon *poly;
+} GtkPlotSurfaceSortItem;
+
+#define SORT_INSERTION_BUDGET 4
+
+static guint32
+depth_key(GtkPlotDTtriangle *t)
+{
+  union { gfloat f; guint32 u; } z;
+
+  z.f = t->na->pz + t->nb->pz + t->nc->pz;
+
+  /* flip so that the unsigned order is the float order, then
+     invert since the deepest polygon goes first */
+  if(z.u & 0x80000000)
+    z.u = ~z.u;
+  else
+    z.u |= 0x80000000;
+
+  return ~z.u;
+}
+
+/* stable, returns FALSE if it would take more than budget moves and
+   then leaves items only partly sorted */
+static gboolean
+insertion_sort_items(GtkPlotSurfaceSortItem *items, gint n, glong budget)
+{
+  gint i, j;
+
+  for(i = 1; i < n; i++){
+    GtkPlotSurfaceSortItem item = items[i];
+    if(items[i-1].key <= item.key) continue;
+    j = i;
+    while(j > 0 && items[j-1].key > item.key){
+      items[j] = items[j-1];
+      j--;
+    }
+    items[j] = item;
+    budget -= i - j;
+    if(budget < 0) return FALSE;
+  }
+  return TRUE;
+}
+
+/* stable LSD radix sort, tmp must have room for n items */
 static void
-gtk_plot_surface_sort_polygons(GtkPlotSurface *surface)
+radix_sort_items(GtkPlotSurfaceSortItem *items, GtkPlotSurfaceSortItem *tmp,
+                 gint n)
 {
-  if(surface->polygons)
-    surface->polygons = g_list_sort(surface->polygons, (GCompareFunc)compare_func);
+  GtkPlotSurfaceSortItem *from = items, *to = tmp, *swap;
+  gint count[256];
+  gint shift, i;
+
+  for(shift = 0; shift < 32; shift += 8){
+    gint sum = 0;
+
+    memset(count, 0, sizeof(count));
+    for(i = 0; i < n; i++) count[(from[i].key >> shift) & 0xff]++;
+
+    /* all the keys agree on this byte */
+    if(count[(from[0].key >> shift) & 0xff] == n) continue;
+
+    for(i = 0; i < 256; i++){
+      gint c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+    for(i = 0; i < n; i++)
+      to[count[(from[i].key >> shift) & 0xff]++] = from[i];
+
+    swap = from; from = to; to = swap;
+  }
+
+  if(from != items)
+    memcpy(items, from, n * sizeof(GtkPlotSurfaceSortItem));
 }
 
-/* PAINTER'S COMPARISON */
+/* order of polygons cut from the same triangle */
 static gint
 compare_func (gpointer a, gpointer b)
 {
   GtkPlotPolygon *pa, *pb;
-  GtkPlotDTtriangle *ta, *tb;
-  gint i, j;
-  //gint na[3], nb[3];
-  gint naz[3], nbz[3];
-  gdouble pax[3], pbx[3];
-  gdouble pay[3], pby[3];
-  gdouble paz[3], pbz[3];
-  gint xg = 0, xl = 0;
-  gint yg = 0, yl = 0;
-  gint zg = 0, zl = 0;
-  GtkPlotDTnode *nda[3], *ndb[3];
-  gdouble cza = 0, czb = 0;
-  
+  gdouble z1, z2;
+  gint i;
+
   pa = (GtkPlotPolygon *)a;
   pb = (GtkPlotPolygon *)b;
 
-  ta = pa->t;
-  tb = pb->t;
-
-  if(ta == tb) {
-    gdouble z1, z2;
-    z1 = pa->p[0].z;
-    z2 = pb->p[0].z;
-    for(i = 1; i < pa->n; i++) z1 = MIN(z1, pa->p[i].z);
-    for(i = 1; i < pb->n; i++) z2 = MIN(z2, pb->p[i].z);
-    if(z1 == z2)
-      return (pa->level > pb->level ? -1 : (pa->level == pb->level ? 0 : 1));
-    else
-      return (z2 > z1 ? -1 : 1);
-  }
+  z1 = pa->p[0].z;
+  z2 = pb->p[0].z;
+  for(i = 1; i < pa->n; i++) z1 = MIN(z1, pa->p[i].z);
+  for(i = 1; i < pb->n; i++) z2 = MIN(z2, pb->p[i].z);
+  if(z1 == z2)
+    return (pa->level > pb->level ? -1 : (pa->level == pb->level ? 0 : 1));
+  else
+    return (z2 > z1 ? -1 : 1);
+}
 
-  naz[0] = nbz[0] = 0;
-  naz[1] = nbz[1] = 1;
-  naz[2] = nbz[2] = 2;
-
-  paz[0] = ta->na->pz;
-  paz[1] = ta->nb->pz;
-  paz[2] = ta->nc->pz;
-  pbz[0] = tb->na->pz;
-  pbz[1] = tb->nb->pz;
-  pbz[2] = tb->nc->pz;
-
-/*
-  paz[0] = pa->p[0].z;
-  paz[1] = pa->p[1].z;
-  paz[2] = pa->p[2].z;
-  if(pa->n == 4) paz[0] = pa->p[3].z;
-  pbz[0] = pb->p[0].z;
-  pbz[1] = pb->p[1].z;
-  pbz[2] = pb->p[2].z;
-  if(pb->n == 4) pbz[0] = pb->p[3].z;
-*/
-
-  zg = zl = 0;
-  for(i = 0; i < 3; i++){
-    for(j = 0; j < 3; j++){
-      if(paz[i] < pbz[j]) zg++;
-      if(paz[i] > pbz[j]) zl++;
-    }
-  }
-  if(zg == 9) return 1;
-  if(zl == 9) return -1;
-
-  //na[0] = nb[0] = 0;
-  //na[1] = nb[1] = 1;
-  //na[2] = nb[2] = 2;
-
-  pax[0] = ta->na->px;
-  pax[1] = ta->nb->px;
-  pax[2] = ta->nc->px;
-  pbx[0] = tb->na->px;
-  pbx[1] = tb->nb->px;
-  pbx[2] = tb->nc->px;
-
-/*
-  pax[0] = pa->p[0].x;
-  pax[1] = pa->p[1].x;
-  pax[2] = pa->p[2].x;
-  if(pa->n == 4) pax[0] = pa->p[3].x;
-  pbx[0] = pb->p[0].x;
-  pbx[1] = pb->p[1].x;
-  pbx[2] = pb->p[2].x;
-  if(pb->n == 4) pbx[0] = pb->p[3].x;
-*/
-
-  xg = xl = 0;
-  for(i = 0; i < 3; i++){
-    for(j = 0; j < 3; j++){
-      if(pax[i] < pbx[j]) xg++;
-      if(pax[i] > pbx[j]) xl++;
-    }
-  }
-  if(xg == 9 || xl == 9){
-    cza = (paz[0] + paz[1] + paz[2]);
-    czb = (pbz[0] + pbz[1] + pbz[2]);
-    return(czb > cza ? 1 : -1);
-  }
+static void
+gtk_plot_surface_sort_polygons(GtkPlotSurface *surface)
+{
+  GtkPlotSurfaceSortItem *items;
+  GList *list;
+  gint n, i, j;
 
-  //na[0] = nb[0] = 0;
-  //na[1] = nb[1] = 1;
-  //na[2] = nb[2] = 2;
-
-  pay[0] = ta->na->py;
-  pay[1] = ta->nb->py;
-  pay[2] = ta->nc->py;
-  pby[0] = tb->na->py;
-  pby[1] = tb->nb->py;
-  pby[2] = tb->nc->py;
-
-/*
-  pay[0] = pa->p[0].y;
-  pay[1] = pa->p[1].y;
-  pay[2] = pa->p[2].y;
-  if(pa->n == 4) pay[0] = pa->p[3].y;
-  pby[0] = pb->p[0].y;
-  pby[1] = pb->p[1].y;
-  pby[2] = pb->p[2].y;
-  if(pb->n == 4) pby[0] = pb->p[3].y;
-*/
-
-  yg = yl = 0;
-  for(i = 0; i < 3; i++){
-    for(j = 0; j < 3; j++){
-      if(pay[i] < pby[j]) yg++;
-      if(pay[i] > pby[j]) yl++;
-    }
+  if(!surface->polygons) return;
+
+  n = g_list_length(surface->polygons);
+  if(surface->sort_buf_len < 2*n){
+    g_free(surface->sort_buf);
+    surface->sort_buf_len = 2*n;
+    surface->sort_buf = g_new(GtkPlotSurfaceSortItem, surface->sort_buf_len);
   }
-  if(yg == 9 || yl == 9){
-    cza = (paz[0] + paz[1] + paz[2]);
-    czb = (pbz[0] + pbz[1] + pbz[2]);
-    return(czb > cza ? 1 : -1);
+  items = (GtkPlotSurfaceSortItem *)surface->sort_buf;
+
+  for(list = surface->polygons, i = 0; list; list = list->next, i++){
+    GtkPlotPolygon *poly = (GtkPlotPolygon *)list->data;
+    items[i].poly = poly;
+    items[i].key = depth_key(poly->t);
   }
 
-  nda[0] = ta->na;
-  nda[1] = ta->nb;
-  nda[2] = ta->nc;
-  ndb[0] = tb->na;
-  ndb[1] = tb->nb;
-  ndb[2] = tb->nc;
-
-/*
-  for(i = 0; i < 3; i++){
-    gdouble n1[3], n2[3];
-    gdouble t1, t2, det;
-    gdouble x1, x2;
-    gdouble y1, y2;
-    gdouble z1, z2;
-    gint ia0 = naz[i];
-    gint ja0 = naz[i == 2 ? 0 : i+1];
-    n1[0] = pax[ja0]-pax[ia0];
-    n1[1] = pay[ja0]-pay[ia0];
-    n1[2] = paz[ja0]-paz[ia0];
-
-    for(j = 0; j < 3; j++){
-      gint ib0 = nbz[j];
-      gint jb0 = nbz[j == 2 ? 0 : j+1];
-      gdouble c1, c2;
-
-      c1 = (pax[ia0]-pbx[ib0]);
-      c2 = (pay[ia0]-pby[ib0]);
-
-      n2[0] = pbx[jb0]-pbx[ib0];
-      n2[1] = pby[jb0]-pby[ib0];
-      n2[2] = pbz[jb0]-pbz[ib0];
-      det = (-n1[0]*n2[1]+n1[1]*n2[0]);
-      if(fabs(det) < 1.e-5){
-        coincide++;
-        if(coincide == 2) return 0;
-      }
-    }
-  }      
-*/
-  for(i = 0; i < 3; i++){
-    gdouble n1[3], n2[3];
-    gdouble t1, t2, det;
-    //gdouble x1, x2;
-    //gdouble y1, y2;
-    gdouble z1, z2;
-    gint ia0 = naz[i];
-    gint ja0 = naz[i == 2 ? 0 : i+1];
-    n1[0] = pax[ja0]-pax[ia0];
-    n1[1] = pay[ja0]-pay[ia0];
-    n1[2] = paz[ja0]-paz[ia0];
-
-    for(j = 0; j < 3; j++){
-      gint ib0 = nbz[j];
-      gint jb0 = nbz[j == 2 ? 0 : j+1];
-      gdouble c1, c2;
-
-      if(nda[ia0] == ndb[ib0] || nda[ia0] == ndb[jb0]) continue;
-      if(nda[ja0] == ndb[ib0] || nda[ja0] == ndb[jb0]) continue;
-      c1 = (pax[ia0]-pbx[ib0]);
-      c2 = (pay[ia0]-pby[ib0]);
-
-      n2[0] = pbx[jb0]-pbx[ib0];
-      n2[1] = pby[jb0]-pby[ib0];
-      n2[2] = pbz[jb0]-pbz[ib0];
-      det = (-n1[0]*n2[1]+n1[1]*n2[0]);
-      if(fabs(det) > 1.e-5){
-        t1 = (c1*n2[1]-c2*n2[0]) / det;
-        t2 = (-n1[0]*c2+n1[1]*c1) / det;
-        if(t1 < -0.0001 || t2 < -0.0001) continue;
-        if(t1 > 1.0001 || t2 > 1.0001) continue;
-        //x1 = pax[ia0] + t1 * n1[0];
-        //y1 = pay[ia0] + t1 * n1[1];
-        z1 = paz[ia0] + t1 * n1[2];
-        //x2 = pbx[ib0] + t2 * n2[0];
-        //y2 = pby[ib0] + t2 * n2[1];
-        z2 = pbz[ib0] + t2 * n2[2];
-        if(z1 < z2) return 1;
-        if(z2 < z1) return -1;
+  if(!insertion_sort_items(items, n, (glong)SORT_INSERTION_BUDGET * n))
+    radix_sort_items(items, items + n, n);
+
+  /* both sorts are stable and all the polygons of one triangle have the
+     same key, so they are still next to each other as built */
+  for(i = 0; i < n; i = j){
+    for(j = i + 1; j < n && items[j].poly->t == items[i].poly->t; j++){
+      GtkPlotSurfaceSortItem item = items[j];
+      gint k = j;
+      while(k > i && compare_func(items[k-1].poly, item.poly) > 0){
+        items[k] = items[k-1];
+        k--;
       }
+      items[k] = item;
     }
   }
 
-  cza = (paz[0] + paz[1] + paz[2]);
-  czb = (pbz[0] + pbz[1] + pbz[2]);
-  return(czb > cza ? 1 : -1);
-
-  return 0;
+  for(list = surface->polygons, i = 0; list; list = list->next, i++)
+    list->data = items[i].poly;
 }
 
 
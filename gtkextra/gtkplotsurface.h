@@ -80,6 +80,8 @@ struct _GtkPlotSurface
   gboolean recalc_dt;
 
   GList *polygons;
+  gpointer sort_buf;		/* scratch space for sorting polygons */
+  gint sort_buf_len;
 
   gboolean show_grid;
   gboolean show_mesh;
@@ -0,0 +1,92 @@
+/* testdecimate - check how many symbols large data sets draw
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <gtk/gtk.h>
+#include "gtkplotdata.h"
+
+#define NUM 100000
+
+static int failed = 0;
+
+static void
+check (const char *what, gint got, gint expected)
+{
+  if (got != expected) {
+    fprintf (stderr, "%s: drew %d symbols, expected %d\n",
+	     what, got, expected);
+    failed = 1;
+  }
+}
+
+static gint
+count_kept (const gboolean *keep, gint n)
+{
+  gint i, cnt = 0;
+  for (i = 0; i < n; i++)
+    if (keep[i]) cnt++;
+  return cnt;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GtkPlotPoint *points = g_new (GtkPlotPoint, NUM);
+  gboolean *keep = g_new (gboolean, NUM);
+  gint i, n;
+
+  /* a sine sampled at 100000 points over a 500 pixel wide plot,
+   * back and forth so that points on a pixel are not consecutive */
+  for (i = 0; i < NUM; i++) {
+    points[i].x = 10.0 + 500.0 * (i % 1000) / 1000.0;
+    points[i].y = 200.0 + 100.0 * sin (points[i].x / 50.0);
+  }
+  n = gtk_plot_data_decimate_symbols (points, NUM, keep);
+  check ("sine", n, count_kept (keep, NUM));
+  /* 500 pixel columns with a few pixels each, nowhere near 100000 */
+  if (n < 500 || n > 2000) {
+    fprintf (stderr, "sine: drew %d symbols\n", n);
+    failed = 1;
+  }
+  /* the first point is always drawn */
+  if ( ! keep[0]) {
+    fprintf (stderr, "sine: first symbol not drawn\n");
+    failed = 1;
+  }
+
+  /* all on one pixel but for a break */
+  for (i = 0; i < NUM; i++) {
+    points[i].x = 3.25;
+    points[i].y = 7.5;
+  }
+  points[NUM/2].x = NAN;
+  n = gtk_plot_data_decimate_symbols (points, NUM, keep);
+  check ("one pixel", n, 2);
+  check ("one pixel", count_kept (keep, NUM), 2);
+
+  /* small data sets are drawn as they are */
+  n = gtk_plot_data_decimate_symbols (points, 100, keep);
+  check ("small", n, 100);
+  check ("small", count_kept (keep, 100), 100);
+
+  g_free (points);
+  g_free (keep);
+
+  return failed;
+}
@@ -87,7 +87,10 @@ static gboolean got_end_too_soon = FALSE;
 GSList *gel_parsestack=NULL;
 
 /*error .. global as well*/
-GeniusError gel_error_num = GEL_NO_ERROR;
+GEL_THREAD_LOCAL GeniusError gel_error_num = GEL_NO_ERROR;
+GEL_THREAD_LOCAL gboolean gel_in_worker_thread = FALSE;
+GEL_THREAD_LOCAL gboolean gel_capture_messages = FALSE;
+GEL_THREAD_LOCAL GSList *gel_captured_messages = NULL;
 gboolean gel_got_eof = FALSE;
 
 /*the current state of the calculator*/
@@ -1206,82 +1209,66 @@ appendmatrix (GelOutput *gelo, GelMatrixW *m)
 static void
 appendpolynomial (GelOutput *gelo, GelETree *n)
 {
-	char vars[] = "xyz";
-	int index[3] = {0,0,0};
-	int stride;
+	int i;
 	gboolean first = TRUE;
+	mpw_t c;
 
-	/* FIXME: what about chop/chop_when */
-
-	if G_UNLIKELY (n->poly.vars > 3) {
-		/* FIXME: */
-		gel_errorout (_("Cannot currently print polynomials of "
-				"more than 3 vars"));
-		gel_output_string (gelo, "(?)");
+	if (n->poly.len == 0) {
+		gel_output_string (gelo, "0");
 		return;
 	}
 
-	stride = n->poly.largest+1;
+	mpw_init (c);
+
+	/* written out the way PolyToString does it, highest term first */
+	for (i = n->poly.len-1; i >= 0; i--) {
+		char *p;
+
+		if (mpw_zero_p (n->poly.coefs[i]))
+			continue;
 
-	for (;;) {
-		int i = index[0] + (index[1]*stride) + (index[2]*stride*stride);
-		int j;
-		if (n->poly.indexes[i] != NULL &&
-		    ! mpw_zero_p (n->poly.indexes[i])) {
-			char *p;
-			gboolean firstvar;
+		mpw_set (c, n->poly.coefs[i]);
+		if ( ! mpw_is_complex (c) && mpw_sgn (c) < 0) {
+			gel_output_string (gelo, first ? "-" : " - ");
+			mpw_neg (c, c);
+		} else if ( ! first) {
+			gel_output_string (gelo, " + ");
+		}
+		first = FALSE;
 
-			if ( ! first)
-				gel_output_string (gelo, " + ");
-			first = FALSE;
+		if (i == 0 || ! mpw_eql_ui (c, 1)) {
+			gboolean complex = mpw_is_complex (c);
 
-			p = mpw_getstring_chop (n->poly.indexes[i],
+			p = mpw_getstring_chop (c,
 						gel_calcstate.max_digits,
 						gel_calcstate.scientific_notation,
 						gel_calcstate.results_as_floats,
 						gel_calcstate.mixed_fractions,
 						gel_calcstate.output_style,
 						gel_calcstate.integer_output_base,
-						TRUE /* add parenths */,
+						FALSE /* add parenths */,
 						gel_calcstate.chop,
 						gel_calcstate.chop_when,
 						gelo->force_chop);
+			/* the coefficient is one factor, so keep a + b*i
+			   or a lone b*i together */
+			if (complex)
+				gel_output_string (gelo, "(");
 			gel_output_string (gelo, p);
+			if (complex)
+				gel_output_string (gelo, ")");
 			g_free (p);
-
-			if (i != 0) {
-				gel_output_string (gelo, " * ");
-
-				firstvar = TRUE;
-				for (j = 0; j < n->poly.vars; j++) {
-					if (index[j] == 0)
-						continue;
-
-					if ( ! firstvar)
-						gel_output_string (gelo, "*");
-					firstvar = FALSE;
-
-					if (index[j] == 1)
-						gel_output_printf (gelo,
-								   "%c",
-								   vars[j]);
-					else
-						gel_output_printf (gelo,
-								   "%c^%d",
-								   vars[j],
-								   index[j]);
-				}
-			}
+			if (i > 0)
+				gel_output_string (gelo, "*");
 		}
-		j = 0;
-		while (index[j] >= stride) {
-			index[j] = 0;
-			j++;
-			if (j >= n->poly.vars)
-				break;
-		}
-		index[j]++;
+
+		if (i == 1)
+			gel_output_string (gelo, "x");
+		else if (i > 1)
+			gel_output_printf (gelo, "x^%d", i);
 	}
+
+	mpw_clear (c);
 }
 
 static gboolean
@@ -3568,6 +3555,16 @@ yyerror (char *s)
 	gel_error_num = GEL_PARSE_ERROR;
 }
 
+/* takes ownership of s */
+static void
+capture_message (gboolean info, char *s)
+{
+	GelCapturedMessage *m = g_new (GelCapturedMessage, 1);
+	m->info = info;
+	m->s = s;
+	gel_captured_messages = g_slist_prepend (gel_captured_messages, m);
+}
+
 void 
 gel_errorout (const char *format, ...)
 {
@@ -3578,6 +3575,11 @@ gel_errorout (const char *format, ...)
     s = g_strdup_vprintf (format, args);
     va_end (args);
 
+    if G_UNLIKELY (gel_capture_messages) {
+	    capture_message (FALSE, s);
+	    return;
+    }
+
     (*errorout) (s);
     
     g_free (s);
@@ -3593,7 +3595,30 @@ gel_infoout (const char *format, ...)
     s = g_strdup_vprintf (format, args);
     va_end (args);
 
+    if G_UNLIKELY (gel_capture_messages) {
+	    capture_message (TRUE, s);
+	    return;
+    }
+
     (*infoout) (s);
     
     g_free (s);
 }
+
+void
+gel_output_captured_messages (GSList *list)
+{
+	GSList *li;
+
+	list = g_slist_reverse (list);
+	for (li = list; li != NULL; li = li->next) {
+		GelCapturedMessage *m = li->data;
+		if (m->info)
+			(*infoout) (m->s);
+		else
+			(*errorout) (m->s);
+		g_free (m->s);
+		g_free (m);
+	}
+	g_slist_free (list);
+}
@@ -42,7 +42,22 @@ typedef enum {
 } GeniusError;
 
 /* FIXME: This should be nicer */
-extern GeniusError gel_error_num;
+extern GEL_THREAD_LOCAL GeniusError gel_error_num;
+
+/* Set in threads evaluating builtins on behalf of the main thread,
+ * these must not run hooks or print anything */
+extern GEL_THREAD_LOCAL gboolean gel_in_worker_thread;
+
+/* When set, gel_errorout and gel_infoout put the messages onto
+ * gel_captured_messages (newest first) instead of printing them,
+ * gel_output_captured_messages prints and frees such a list in order */
+typedef struct {
+	gboolean info;
+	char *s;
+} GelCapturedMessage;
+extern GEL_THREAD_LOCAL gboolean gel_capture_messages;
+extern GEL_THREAD_LOCAL GSList *gel_captured_messages;
+void gel_output_captured_messages (GSList *list);
 
 extern gboolean gel_interrupted;
 
@@ -0,0 +1,616 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "mpwrap.h"
+
+#include "combinat.h"
+
+/* number of factors multiplied directly at the bottom of the splitting */
+#define COMB_LEAF 16
+
+/* Bernoulli numbers up to this index are all found at once from the
+ * tangent numbers, above it one at a time from the zeta function */
+#define BERNOULLI_TANGENT_MAX 256
+
+/* how many bits of powers j^n to keep around for the Stirling numbers of
+ * the second kind, 64MB */
+#define STIRLING2_CACHE_BITS (1UL << 29)
+
+/* prod_{i=lo}^{hi-1} (a+id) */
+static void
+product_split (mpz_ptr rop, mpz_srcptr a, mpz_srcptr d,
+	       unsigned long lo, unsigned long hi)
+{
+	if (hi - lo <= COMB_LEAF) {
+		mpz_t t;
+		unsigned long i;
+
+		mpz_init (t);
+		mpz_set_ui (rop, 1);
+		for (i = lo; i < hi; i++) {
+			mpz_set (t, a);
+			mpz_addmul_ui (t, d, i);
+			mpz_mul (rop, rop, t);
+		}
+		mpz_clear (t);
+	} else {
+		unsigned long mid = lo + (hi - lo) / 2;
+		mpz_t r;
+
+		mpz_init (r);
+		product_split (rop, a, d, lo, mid);
+		product_split (r, a, d, mid, hi);
+		mpz_mul (rop, rop, r);
+		mpz_clear (r);
+	}
+}
+
+void
+gel_comb_product (mpz_ptr rop, mpz_srcptr a, mpz_srcptr d, unsigned long k)
+{
+	mpz_t r;
+
+	mpz_init_set_ui (r, 1);
+	if (k > 0)
+		product_split (r, a, d, 0, k);
+	mpz_swap (rop, r);
+	mpz_clear (r);
+}
+
+/* p/q = sum_{j=lo}^{hi-1} 1/j^r */
+static void
+harmonic_split (mpz_ptr p, mpz_ptr q, unsigned long lo, unsigned long hi,
+		unsigned long r)
+{
+	if (hi - lo <= COMB_LEAF) {
+		mpz_t t;
+		unsigned long j;
+
+		mpz_init (t);
+		mpz_set_ui (p, 0);
+		mpz_set_ui (q, 1);
+		for (j = lo; j < hi; j++) {
+			mpz_ui_pow_ui (t, j, r);
+			mpz_mul (p, p, t);
+			mpz_add (p, p, q);
+			mpz_mul (q, q, t);
+		}
+		mpz_clear (t);
+	} else {
+		unsigned long mid = lo + (hi - lo) / 2;
+		mpz_t p2, q2;
+
+		mpz_init (p2);
+		mpz_init (q2);
+		harmonic_split (p, q, lo, mid, r);
+		harmonic_split (p2, q2, mid, hi, r);
+		mpz_mul (p, p, q2);
+		mpz_addmul (p, p2, q);
+		mpz_mul (q, q, q2);
+		mpz_clear (p2);
+		mpz_clear (q2);
+	}
+}
+
+void
+gel_comb_harmonic (mpq_ptr rop, unsigned long n, unsigned long r)
+{
+	if (n == 0 || r == 0) {
+		mpq_set_ui (rop, n, 1);
+		return;
+	}
+	harmonic_split (mpq_numref (rop), mpq_denref (rop), 1, n+1, r);
+	mpq_canonicalize (rop);
+}
+
+/* B_{2k} at index k, NULL if not known yet */
+static GPtrArray *bernoulli_memo = NULL;
+
+static void
+bernoulli_memo_set (unsigned long k, mpq_srcptr b)
+{
+	mpq_ptr q;
+
+	if (bernoulli_memo == NULL)
+		bernoulli_memo = g_ptr_array_new ();
+	if (bernoulli_memo->len <= k)
+		g_ptr_array_set_size (bernoulli_memo, k+1);
+	if (g_ptr_array_index (bernoulli_memo, k) != NULL)
+		return;
+
+	q = g_new (__mpq_struct, 1);
+	mpq_init (q);
+	mpq_set (q, b);
+	g_ptr_array_index (bernoulli_memo, k) = q;
+}
+
+static mpq_ptr
+bernoulli_memo_get (unsigned long k)
+{
+	if (bernoulli_memo == NULL || bernoulli_memo->len <= k)
+		return NULL;
+	return g_ptr_array_index (bernoulli_memo, k);
+}
+
+/* B_2, ..., B_2m from the tangent numbers, B_2k = (-1)^(k-1) 2k T_k /
+ * (4^k (4^k-1)), with the O(m^2) recurrence of Brent and Harvey (Fast
+ * computation of Bernoulli, Tangent and Secant numbers) */
+static void
+bernoulli_tangent (unsigned long m)
+{
+	mpz_t *t = g_new (mpz_t, m+1);
+	mpq_t b;
+	unsigned long j, k;
+
+	for (k = 0; k <= m; k++)
+		mpz_init (t[k]);
+	mpz_set_ui (t[1], 1);
+	for (k = 2; k <= m; k++)
+		mpz_mul_ui (t[k], t[k-1], k-1);
+	for (k = 2; k <= m; k++) {
+		for (j = k; j <= m; j++) {
+			mpz_mul_ui (t[j], t[j], j-k+2);
+			mpz_addmul_ui (t[j], t[j-1], j-k);
+		}
+	}
+
+	mpq_init (b);
+	for (k = 1; k <= m; k++) {
+		mpz_mul_ui (mpq_numref (b), t[k], 2*k);
+		if ((k & 1) == 0)
+			mpz_neg (mpq_numref (b), mpq_numref (b));
+		mpz_set_ui (mpq_denref (b), 0);
+		mpz_setbit (mpq_denref (b), 2*k);
+		mpz_sub_ui (mpq_denref (b), mpq_denref (b), 1);
+		mpz_mul_2exp (mpq_denref (b), mpq_denref (b), 2*k);
+		mpq_canonicalize (b);
+		bernoulli_memo_set (k, b);
+	}
+	mpq_clear (b);
+
+	for (k = 0; k <= m; k++)
+		mpz_clear (t[k]);
+	g_free (t);
+}
+
+static gboolean
+is_small_prime (unsigned long p)
+{
+	unsigned long i;
+
+	if (p < 2)
+		return FALSE;
+	for (i = 2; i*i <= p; i++)
+		if (p % i == 0)
+			return FALSE;
+	return TRUE;
+}
+
+/* B_n for even n from |B_n| = 2 n! zeta(n) / (2 pi)^n.  By von Staudt and
+ * Clausen the denominator is the product D of the primes p with p-1
+ * dividing n, so the numerator is D|B_n| rounded, and it is enough to
+ * know zeta(n) to that many bits.  zeta(n) is the Euler product over
+ * primes, the p^-n term only needs the precision that is left after its
+ * n log2(p) leading zero bits, which makes the product cheap. */
+static void
+bernoulli_zeta (mpq_ptr rop, unsigned long n)
+{
+	mpz_t den, fac;
+	mpfr_t f, t, z, e, zt;
+	unsigned long d, p, lim;
+	long prec;
+	char *sieve;
+
+	/* the denominator */
+	mpz_init_set_ui (den, 1);
+	for (d = 1; d*d <= n; d++) {
+		if (n % d != 0)
+			continue;
+		if (is_small_prime (d+1))
+			mpz_mul_ui (den, den, d+1);
+		if (d*d != n && is_small_prime (n/d+1))
+			mpz_mul_ui (den, den, n/d+1);
+	}
+
+	/* bits in the numerator, plus guard bits */
+	prec = (long)((lgamma ((double)n + 1.0)
+		       - (double)n * log (2.0 * G_PI)) / G_LN2)
+		+ (long)mpz_sizeinbase (den, 2) + 64;
+	if (prec < 128)
+		prec = 128;
+
+	mpfr_init2 (f, prec);
+	mpfr_init2 (t, prec);
+	mpfr_init2 (z, prec);
+	mpfr_init2 (e, 32);
+	mpfr_init2 (zt, 32);
+
+	mpz_init (fac);
+	mpfr_const_pi (t, GMP_RNDN);
+	mpfr_mul_2ui (t, t, 1, GMP_RNDN);
+	mpfr_pow_ui (t, t, n, GMP_RNDN);
+
+	/* primes up to where p^n is beyond the precision */
+	lim = (unsigned long)ceil (pow (2.0, (double)(prec + 32) / n)) + 1;
+	sieve = g_new0 (char, lim+1);
+	mpfr_set_ui (z, 1, GMP_RNDN);
+	for (p = 2; p <= lim; p++) {
+		long pp;
+		if (sieve[p])
+			continue;
+		for (d = p*p; d <= lim; d += p)
+			sieve[d] = 1;
+		pp = prec + 32 - (long)((double)n * log2 ((double)p));
+		if (pp <= 0)
+			break;
+		if (pp < 32)
+			pp = 32;
+		/* z = z p^n/(p^n-1) */
+		mpfr_set_prec (e, pp);
+		mpfr_set_prec (zt, pp);
+		mpfr_ui_pow_ui (e, p, n, GMP_RNDN);
+		mpfr_sub_ui (e, e, 1, GMP_RNDN);
+		mpfr_set (zt, z, GMP_RNDN);
+		mpfr_div (zt, zt, e, GMP_RNDN);
+		mpfr_add (z, z, zt, GMP_RNDN);
+	}
+	g_free (sieve);
+
+	mpz_fac_ui (fac, n);
+	mpfr_set_z (f, fac, GMP_RNDN);
+	mpfr_mul (f, f, z, GMP_RNDN);
+	mpfr_mul_z (f, f, den, GMP_RNDN);
+	mpfr_mul_2ui (f, f, 1, GMP_RNDN);
+	mpfr_div (f, f, t, GMP_RNDN);
+	mpfr_get_z (mpq_numref (rop), f, GMP_RNDN);
+	if (n % 4 == 0)
+		mpz_neg (mpq_numref (rop), mpq_numref (rop));
+	mpz_set (mpq_denref (rop), den);
+	mpq_canonicalize (rop);
+
+	mpfr_clear (f);
+	mpfr_clear (t);
+	mpfr_clear (z);
+	mpfr_clear (e);
+	mpfr_clear (zt);
+	mpz_clear (fac);
+	mpz_clear (den);
+}
+
+void
+gel_comb_bernoulli (mpq_ptr rop, unsigned long n)
+{
+	mpq_ptr b;
+
+	if (n == 0) {
+		mpq_set_ui (rop, 1, 1);
+		return;
+	} else if (n == 1) {
+		mpq_set_si (rop, -1, 2);
+		return;
+	} else if (n & 1) {
+		mpq_set_ui (rop, 0, 1);
+		return;
+	}
+
+	b = bernoulli_memo_get (n/2);
+	if (b == NULL) {
+		if (n <= BERNOULLI_TANGENT_MAX) {
+			bernoulli_tangent (BERNOULLI_TANGENT_MAX/2);
+		} else {
+			mpq_t q;
+			mpq_init (q);
+			bernoulli_zeta (q, n);
+			bernoulli_memo_set (n/2, q);
+			mpq_clear (q);
+		}
+		b = bernoulli_memo_get (n/2);
+	}
+	mpq_set (rop, b);
+}
+
+/* Polynomials with nonnegative coefficients are multiplied by Kronecker
+ * substitution, packing the coefficients into one big integer in slots
+ * of whole 64 bit words, wide enough for the coefficients of the
+ * product, which are at most the product of the coefficient sums.  Only
+ * the coefficients up to degree dmax are kept. */
+static mpz_t *
+kronecker_mul (mpz_t *a, unsigned long da, mpz_t *b, unsigned long db,
+	       unsigned long dmax, unsigned long *dc)
+{
+	mpz_t x, y;
+	mpz_t *c;
+	guint64 *buf;
+	gsize words, i, d;
+
+	mpz_init (x);
+	mpz_init (y);
+	for (i = 0; i <= da; i++)
+		mpz_add (x, x, a[i]);
+	for (i = 0; i <= db; i++)
+		mpz_add (y, y, b[i]);
+	words = (mpz_sizeinbase (x, 2) + mpz_sizeinbase (y, 2)) / 64 + 1;
+
+	buf = g_new0 (guint64, (MAX (da, db) + 1) * words);
+	for (i = 0; i <= da; i++)
+		mpz_export (buf + i*words, NULL, -1, 8, 0, 0, a[i]);
+	mpz_import (x, (da + 1) * words, -1, 8, 0, 0, buf);
+	memset (buf, 0, sizeof (guint64) * (MAX (da, db) + 1) * words);
+	for (i = 0; i <= db; i++)
+		mpz_export (buf + i*words, NULL, -1, 8, 0, 0, b[i]);
+	mpz_import (y, (db + 1) * words, -1, 8, 0, 0, buf);
+	g_free (buf);
+
+	d = MIN (da + db, dmax);
+	mpz_mul (x, x, y);
+	mpz_tdiv_r_2exp (x, x, (d + 1) * words * 64);
+
+	buf = g_new0 (guint64, (d + 1) * words);
+	mpz_export (buf, NULL, -1, 8, 0, 0, x);
+	c = g_new (mpz_t, d + 1);
+	for (i = 0; i <= d; i++) {
+		mpz_init (c[i]);
+		mpz_import (c[i], words, -1, 8, 0, 0, buf + i*words);
+	}
+	g_free (buf);
+
+	mpz_clear (x);
+	mpz_clear (y);
+	*dc = d;
+	return c;
+}
+
+static void
+poly_free (mpz_t *c, unsigned long d)
+{
+	unsigned long i;
+	for (i = 0; i <= d; i++)
+		mpz_clear (c[i]);
+	g_free (c);
+}
+
+/* prod_{i=lo}^{hi-1} (i+x), or (1+ix) if rev, up to degree dmax */
+static mpz_t *
+linear_product (unsigned long lo, unsigned long hi, gboolean rev,
+		unsigned long dmax, unsigned long *deg)
+{
+	if (hi - lo <= COMB_LEAF) {
+		mpz_t *c = g_new (mpz_t, MIN (hi - lo, dmax) + 1);
+		unsigned long i, k, d = 0;
+
+		for (k = 0; k <= MIN (hi - lo, dmax); k++)
+			mpz_init (c[k]);
+		mpz_set_ui (c[0], 1);
+		for (i = lo; i < hi; i++) {
+			unsigned long c0 = rev ? 1 : i;
+			unsigned long c1 = rev ? i : 1;
+			unsigned long nd = MIN (d + 1, dmax);
+			for (k = nd; k > 0; k--) {
+				mpz_mul_ui (c[k], c[k], c0);
+				mpz_addmul_ui (c[k], c[k-1], c1);
+			}
+			mpz_mul_ui (c[0], c[0], c0);
+			d = nd;
+		}
+		*deg = d;
+		return c;
+	} else {
+		unsigned long mid = lo + (hi - lo) / 2;
+		unsigned long da, db;
+		mpz_t *a, *b, *c;
+
+		a = linear_product (lo, mid, rev, dmax, &da);
+		b = linear_product (mid, hi, rev, dmax, &db);
+		c = kronecker_mul (a, da, b, db, dmax, deg);
+		poly_free (a, da);
+		poly_free (b, db);
+		return c;
+	}
+}
+
+/* |s(n,m)| is the coefficient of x^m in x(x+1)...(x+n-1), that is of
+ * x^(m-1) in (1+x)...(n-1+x) and of x^(n-m) in (1+x)...(1+(n-1)x), we
+ * take the one with the lower degree so everything above can be
+ * dropped. */
+void
+gel_comb_stirling1 (mpz_ptr rop, unsigned long n, unsigned long m)
+{
+	mpz_t *c;
+	unsigned long d, k;
+	gboolean rev;
+
+	if (m > n || (m == 0 && n > 0)) {
+		mpz_set_ui (rop, 0);
+		return;
+	} else if (m == n) {
+		mpz_set_ui (rop, 1);
+		return;
+	}
+
+	rev = (m - 1 > n - m);
+	k = rev ? n - m : m - 1;
+	c = linear_product (1, n, rev, k, &d);
+	if (d >= k)
+		mpz_set (rop, c[k]);
+	else
+		mpz_set_ui (rop, 0);
+	poly_free (c, d);
+
+	if ((n - m) & 1)
+		mpz_neg (rop, rop);
+}
+
+/* The powers j^n for the Stirling numbers of the second kind, asked for
+ * in increasing j.  With a smallest prime factor sieve, a composite
+ * j = p k has j^n = p^n k^n, one multiplication if k^n is still around.
+ * The powers are kept for j up to cached, while they fit in
+ * STIRLING2_CACHE_BITS, the rest are computed with mpz_ui_pow_ui. */
+typedef struct {
+	unsigned long n;
+	unsigned long *spf;	/* smallest prime factor of 2..m */
+	mpz_t *pw;		/* j^n for 2 <= j <= cached */
+	unsigned long cached;
+	gsize bits;
+} Stirling2Powers;
+
+static void
+stirling2_powers_init (Stirling2Powers *sp, unsigned long n, unsigned long m)
+{
+	unsigned long i, j;
+
+	sp->n = n;
+	sp->spf = g_new0 (unsigned long, m+1);
+	for (i = 2; i <= m; i++) {
+		if (sp->spf[i] != 0)
+			continue;
+		for (j = i; j <= m; j += i)
+			if (sp->spf[j] == 0)
+				sp->spf[j] = i;
+	}
+	sp->pw = g_new (mpz_t, m+1);
+	sp->cached = 1;
+	sp->bits = 0;
+}
+
+static void
+stirling2_powers_clear (Stirling2Powers *sp)
+{
+	unsigned long j;
+
+	for (j = 2; j <= sp->cached; j++)
+		mpz_clear (sp->pw[j]);
+	g_free (sp->pw);
+	g_free (sp->spf);
+}
+
+/* rop = j^n */
+static void
+stirling2_power (mpz_ptr rop, unsigned long j, Stirling2Powers *sp)
+{
+	unsigned long p = sp->spf[j];
+
+	if (j == 1) {
+		mpz_set_ui (rop, 1);
+		return;
+	} else if (j <= sp->cached) {
+		mpz_set (rop, sp->pw[j]);
+		return;
+	}
+
+	if (p != j && j / p <= sp->cached)
+		mpz_mul (rop, sp->pw[p], sp->pw[j / p]);
+	else
+		mpz_ui_pow_ui (rop, j, sp->n);
+
+	if (j == sp->cached + 1 && sp->bits < STIRLING2_CACHE_BITS) {
+		mpz_init_set (sp->pw[j], rop);
+		sp->bits += mpz_sizeinbase (rop, 2);
+		sp->cached = j;
+	}
+}
+
+/* With the ratio binomial(m,j+1)/binomial(m,j) = (m-j)/(j+1),
+ * t/q = sum_{j=lo}^{hi-1} (-1)^(m-j) j^n prod_{i=lo}^{j-1} (m-i)/(i+1)
+ * and p = prod_{i=lo}^{hi-1} (m-i), q = prod_{i=lo}^{hi-1} (i+1) */
+static void
+stirling2_split (mpz_ptr p, mpz_ptr q, mpz_ptr t,
+		 unsigned long lo, unsigned long hi, unsigned long m,
+		 Stirling2Powers *sp)
+{
+	if (hi - lo <= COMB_LEAF) {
+		mpz_t a;
+		unsigned long j;
+
+		mpz_init (a);
+		mpz_set_ui (p, 1);
+		mpz_set_ui (q, 1);
+		mpz_set_ui (t, 0);
+		for (j = lo; j < hi; j++) {
+			stirling2_power (a, j, sp);
+			mpz_mul (a, a, p);
+			mpz_mul_ui (a, a, j+1);
+			mpz_mul_ui (t, t, j+1);
+			if ((m - j) & 1)
+				mpz_sub (t, t, a);
+			else
+				mpz_add (t, t, a);
+			mpz_mul_ui (p, p, m - j);
+			mpz_mul_ui (q, q, j+1);
+		}
+		mpz_clear (a);
+	} else {
+		unsigned long mid = lo + (hi - lo) / 2;
+		mpz_t p2, q2, t2;
+
+		mpz_init (p2);
+		mpz_init (q2);
+		mpz_init (t2);
+		stirling2_split (p, q, t, lo, mid, m, sp);
+		stirling2_split (p2, q2, t2, mid, hi, m, sp);
+		mpz_mul (t, t, q2);
+		mpz_addmul (t, p, t2);
+		mpz_mul (p, p, p2);
+		mpz_mul (q, q, q2);
+		mpz_clear (p2);
+		mpz_clear (q2);
+		mpz_clear (t2);
+	}
+}
+
+/* S(n,m) = 1/m! sum_{j=0}^m (-1)^(m-j) binomial(m,j) j^n, the sum is
+ * merged by binary splitting and the j^n come from a sieve */
+void
+gel_comb_stirling2 (mpz_ptr rop, unsigned long n, unsigned long m)
+{
+	Stirling2Powers sp;
+	mpz_t p, q, t;
+
+	if (m > n || (m == 0 && n > 0)) {
+		mpz_set_ui (rop, 0);
+		return;
+	} else if (m == n) {
+		mpz_set_ui (rop, 1);
+		return;
+	}
+
+	stirling2_powers_init (&sp, n, m);
+	mpz_init (p);
+	mpz_init (q);
+	mpz_init (t);
+
+	/* the j=0 term is zero since n > 0, and binomial(m,1) = m */
+	stirling2_split (p, q, t, 1, m+1, m, &sp);
+	mpz_mul_ui (t, t, m);
+	mpz_divexact (t, t, q);
+	mpz_fac_ui (q, m);
+	mpz_divexact (rop, t, q);
+
+	mpz_clear (p);
+	mpz_clear (q);
+	mpz_clear (t);
+	stirling2_powers_clear (&sp);
+}
@@ -0,0 +1,61 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMBINAT_H_
+#define _COMBINAT_H_
+
+#include <glib.h>
+#ifdef HAVE_GMP2_INCLUDE_DIR
+#include <gmp2/gmp.h>
+#else
+#include <gmp.h>
+#endif
+
+/* Exact combinatorial numbers.  Long products and sums are done by binary
+ * splitting so that the multiplications are between numbers of about the
+ * same size, where GMP's fast multiplication pays off. */
+
+/* rop = a(a+d)(a+2d)...(a+(k-1)d), 1 if k is 0 */
+void	gel_comb_product	(mpz_ptr rop,
+				 mpz_srcptr a,
+				 mpz_srcptr d,
+				 unsigned long k);
+
+/* rop = sum_{j=1}^n 1/j^r */
+void	gel_comb_harmonic	(mpq_ptr rop,
+				 unsigned long n,
+				 unsigned long r);
+
+/* rop = the nth Bernoulli number (B_1 = -1/2), values are remembered */
+void	gel_comb_bernoulli	(mpq_ptr rop,
+				 unsigned long n);
+
+/* rop = the signed Stirling number of the first kind s(n,m) */
+void	gel_comb_stirling1	(mpz_ptr rop,
+				 unsigned long n,
+				 unsigned long m);
+
+/* rop = the Stirling number of the second kind S(n,m) */
+void	gel_comb_stirling2	(mpz_ptr rop,
+				 unsigned long n,
+				 unsigned long m);
+
+#endif /* _COMBINAT_H_ */
@@ -31,6 +31,7 @@
 #include "util.h"
 #include "matrix.h"
 #include "matrixw.h"
+#include "polynomial.h"
 
 #include <vicious.h>
 
@@ -105,6 +106,16 @@ gel_compile_node(GelETree *t,GString *gs)
 		g_string_append(gs,s);
 		g_free(s);
 		break;
+	case GEL_POLYNOMIAL_NODE:
+		g_string_append_printf (gs, ";%d", t->poly.len);
+		for (i = 0; i < t->poly.len; i++) {
+			s = mpw_getstring (t->poly.coefs[i], 0, FALSE, FALSE,
+					   FALSE, GEL_OUTPUT_NORMAL, 10, TRUE);
+			g_string_append_c (gs, ';');
+			g_string_append (gs, s);
+			g_free (s);
+		}
+		break;
 	case GEL_MATRIX_NODE:
 		g_string_append_printf (gs, ";%dx%d;%d",
 					gel_matrixw_width (t->mat.matrix),
@@ -254,6 +265,24 @@ gel_decompile_node(char **ptrptr)
 		mpw_init(tmp);
 		mpw_set_str(tmp,p,10);
 		return gel_makenum_use(tmp);
+	case GEL_POLYNOMIAL_NODE: {
+		mpw_t *coefs;
+		int len = -1;
+		p = strtok_r(NULL,";", ptrptr);
+		if G_UNLIKELY (!p) return NULL;
+		sscanf(p,"%d",&len);
+		if G_UNLIKELY (len < 0) return NULL;
+		coefs = gel_poly_new (len);
+		for (i = 0; i < len; i++) {
+			p = strtok_r (NULL,";", ptrptr);
+			if G_UNLIKELY (!p) {
+				gel_poly_free (coefs, len);
+				return NULL;
+			}
+			mpw_set_str (coefs[i], p, 10);
+		}
+		return gel_makenum_polynomial (coefs, len);
+	}
 	case GEL_MATRIX_NODE:
 		p = strtok_r(NULL,";", ptrptr);
 		if G_UNLIKELY (!p) return NULL;
@@ -0,0 +1,1032 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+#include <fenv.h>
+#include <glib.h>
+#include "calc.h"
+#include "mpwrap.h"
+#include "eval.h"
+#include "dict.h"
+
+#include "dfunc.h"
+
+/* how deep we inline calls to user functions, and how long a program
+ * we are willing to make, anything more goes to the interpreter */
+#define DFUNC_MAX_DEPTH 16
+#define DFUNC_MAX_INSNS 4096
+
+typedef enum {
+	DF_MOVE = 0,	/* r[dst] = r[a] */
+	DF_ADD,
+	DF_SUB,
+	DF_MUL,
+	DF_DIV,
+	DF_POW,
+	DF_NEG,
+	DF_ABS,
+	DF_FUNC1,	/* r[dst] = f1 (r[a]) */
+	DF_FUNC2,	/* r[dst] = f2 (r[a], r[b]) */
+	DF_EQ,
+	DF_NE,
+	DF_LT,
+	DF_GT,
+	DF_LE,
+	DF_GE,
+	DF_CMP,		/* r[dst] = -1, 0 or 1 */
+	DF_AND,
+	DF_XOR,
+	DF_NOT,
+	DF_TRUTH,	/* r[dst] = (r[a] != 0) */
+	DF_JUMP,	/* go to u.target */
+	DF_JUMP_FALSE,	/* go to u.target if r[a] == 0 */
+	DF_JUMP_TRUE	/* go to u.target if r[a] != 0 */
+} DFuncOp;
+
+typedef struct {
+	guint8 op;
+	int dst;
+	int a;
+	int b;
+	union {
+		double (*f1) (double);
+		double (*f2) (double, double);
+		int target;
+	} u;
+} DFuncInsn;
+
+/* a function we depend on, if the id is bound to something else then
+ * we are stale */
+typedef struct {
+	GelToken *id;
+	GelEFunc *func;
+	GelETree *body; /* if inlined, else NULL */
+} DFuncGuard;
+
+/* a global variable loaded into a register by gel_dfunc_prepare */
+typedef struct {
+	GelToken *id;
+	int reg;
+} DFuncGlobal;
+
+struct _GelDFunc {
+	int nargs;
+	int nregs;
+	int result;
+
+	/* initial registers, arguments go into the first nargs, then
+	 * come the constants and the global variables */
+	double *regs;
+
+	DFuncInsn *insns;
+	int ninsns;
+
+	DFuncGuard *guards;
+	int nguards;
+
+	DFuncGlobal *globals;
+	int nglobals;
+};
+
+/* the named arguments of an inlined function and the registers
+ * holding them, GEL is dynamically scoped so we look up through the
+ * callers too */
+typedef struct _DFuncScope DFuncScope;
+struct _DFuncScope {
+	GelEFunc *func;
+	int *regs;
+	DFuncScope *up;
+};
+
+typedef struct {
+	GArray *insns;
+	GArray *regs;
+	GArray *isbool;
+	GArray *guards;
+	GArray *globals;
+	int depth;
+} DFuncCompiler;
+
+static double
+df_sign (double x)
+{
+	if (x > 0)
+		return 1.0;
+	else if (x < 0)
+		return -1.0;
+	else
+		return 0.0;
+}
+
+static double df_identity (double x) { return x; }
+/* these are defined this way in the library */
+static double df_cot (double x) { return 1.0/tan (x); }
+static double df_coth (double x) { return 1.0/tanh (x); }
+static double df_sec (double x) { return 1.0/cos (x); }
+static double df_csc (double x) { return 1.0/sin (x); }
+static double df_sech (double x) { return 1.0/cosh (x); }
+static double df_csch (double x) { return 1.0/sinh (x); }
+
+/* Builtins and (protected) library functions we know how to do in
+ * double precision, the results agree with the interpreter for real
+ * arguments, and where the interpreter gives a complex number these
+ * give a NaN */
+static const struct {
+	const char *name;
+	double (*f) (double);
+} dfunc_funcs1[] = {
+	{ "sin", sin },
+	{ "cos", cos },
+	{ "tan", tan },
+	{ "atan", atan },
+	{ "arctan", atan },
+	{ "sinh", sinh },
+	{ "cosh", cosh },
+	{ "tanh", tanh },
+	{ "asin", asin },
+	{ "arcsin", asin },
+	{ "acos", acos },
+	{ "arccos", acos },
+	{ "asinh", asinh },
+	{ "arcsinh", asinh },
+	{ "acosh", acosh },
+	{ "arccosh", acosh },
+	{ "atanh", atanh },
+	{ "arctanh", atanh },
+	{ "cot", df_cot },
+	{ "coth", df_coth },
+	{ "sec", df_sec },
+	{ "csc", df_csc },
+	{ "sech", df_sech },
+	{ "csch", df_csch },
+	{ "exp", exp },
+	{ "ln", log },
+	{ "log2", log2 },
+	{ "log10", log10 },
+	{ "sqrt", sqrt },
+	{ "abs", fabs },
+	{ "AbsoluteValue", fabs },
+	{ "sign", df_sign },
+	{ "Sign", df_sign },
+	{ "round", round },
+	{ "Round", round },
+	{ "floor", floor },
+	{ "Floor", floor },
+	{ "ceil", ceil },
+	{ "Ceiling", ceil },
+	{ "trunc", trunc },
+	{ "Truncate", trunc },
+	{ "IntegerPart", trunc },
+	{ "float", df_identity },
+	{ NULL, NULL }
+};
+
+static const struct {
+	const char *name;
+	double (*f) (double, double);
+} dfunc_funcs2[] = {
+	{ "atan2", atan2 },
+	{ "arctan2", atan2 },
+	{ NULL, NULL }
+};
+
+static const struct {
+	const char *name;
+	double value;
+} dfunc_consts[] = {
+	{ "pi", G_PI },
+	{ "e", G_E },
+	{ "GoldenRatio", 1.6180339887498948482 },
+	{ "EulerConstant", 0.57721566490153286061 },
+	{ NULL, 0.0 }
+};
+
+static int compile_tree (DFuncCompiler *c, GelETree *n, DFuncScope *sc);
+
+static int
+new_reg (DFuncCompiler *c, double init, gboolean isbool)
+{
+	guint8 b = isbool ? 1 : 0;
+	g_array_append_val (c->regs, init);
+	g_array_append_val (c->isbool, b);
+	return c->regs->len - 1;
+}
+
+#define REG_IS_BOOL(c,r) (g_array_index ((c)->isbool, guint8, (r)) != 0)
+
+static int
+emit (DFuncCompiler *c, DFuncOp op, int dst, int a, int b)
+{
+	DFuncInsn in;
+
+	if G_UNLIKELY (c->insns->len >= DFUNC_MAX_INSNS)
+		return -1;
+
+	memset (&in, 0, sizeof (in));
+	in.op = op;
+	in.dst = dst;
+	in.a = a;
+	in.b = b;
+	g_array_append_val (c->insns, in);
+	return c->insns->len - 1;
+}
+
+static void
+patch_jump (DFuncCompiler *c, int jump)
+{
+	g_array_index (c->insns, DFuncInsn, jump).u.target = c->insns->len;
+}
+
+static void
+add_guard (DFuncCompiler *c, GelToken *id, GelEFunc *f, GelETree *body)
+{
+	DFuncGuard g;
+
+	if (id == NULL)
+		return;
+	g.id = id;
+	g.func = f;
+	g.body = body;
+	g_array_append_val (c->guards, g);
+}
+
+static int
+scope_lookup (DFuncScope *sc, GelToken *id)
+{
+	for (; sc != NULL; sc = sc->up) {
+		GSList *li;
+		int i;
+		for (i = 0, li = sc->func->named_args;
+		     li != NULL;
+		     i++, li = li->next) {
+			if (li->data == id)
+				return sc->regs[i];
+		}
+	}
+	return -1;
+}
+
+static gboolean
+get_real_value (GelETree *t, double *d)
+{
+	if (t == NULL ||
+	    t->type != GEL_VALUE_NODE ||
+	    mpw_is_complex (t->val.value))
+		return FALSE;
+
+	*d = mpw_get_double (t->val.value);
+	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
+		gel_error_num = GEL_NO_ERROR;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* compile the arguments in the caller's scope, only numbers allowed */
+static gboolean
+compile_args (DFuncCompiler *c, GelETree *args, int nargs,
+	      DFuncScope *sc, int *regs)
+{
+	int i;
+	GelETree *li;
+
+	for (i = 0, li = args; i < nargs; i++, li = li->any.next) {
+		if (li == NULL)
+			return FALSE;
+		regs[i] = compile_tree (c, li, sc);
+		if (regs[i] < 0 || REG_IS_BOOL (c, regs[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* builtins and library functions we know, they are protected so only
+ * the name matters */
+static int
+compile_known (DFuncCompiler *c, GelToken *id, const int *regs, int nargs)
+{
+	int i, r, in;
+
+	if (id == NULL || ! id->protected_)
+		return -1;
+
+	if (nargs == 0) {
+		for (i = 0; dfunc_consts[i].name != NULL; i++) {
+			if (strcmp (dfunc_consts[i].name, id->token) == 0)
+				return new_reg (c, dfunc_consts[i].value,
+						FALSE);
+		}
+	} else if (nargs == 1) {
+		for (i = 0; dfunc_funcs1[i].name != NULL; i++) {
+			if (strcmp (dfunc_funcs1[i].name, id->token) == 0) {
+				r = new_reg (c, 0.0, FALSE);
+				in = emit (c, DF_FUNC1, r, regs[0], 0);
+				if (in < 0)
+					return -1;
+				g_array_index (c->insns, DFuncInsn, in).u.f1 =
+					dfunc_funcs1[i].f;
+				return r;
+			}
+		}
+	} else if (nargs == 2) {
+		for (i = 0; dfunc_funcs2[i].name != NULL; i++) {
+			if (strcmp (dfunc_funcs2[i].name, id->token) == 0) {
+				r = new_reg (c, 0.0, FALSE);
+				in = emit (c, DF_FUNC2, r, regs[0], regs[1]);
+				if (in < 0)
+					return -1;
+				g_array_index (c->insns, DFuncInsn, in).u.f2 =
+					dfunc_funcs2[i].f;
+				return r;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/* compile the body of a user function with its arguments in regs */
+static int
+compile_inline (DFuncCompiler *c, GelEFunc *f, int *regs, DFuncScope *sc)
+{
+	DFuncScope fsc;
+	int r;
+
+	if (f->type != GEL_USER_FUNC ||
+	    c->depth >= DFUNC_MAX_DEPTH ||
+	    f->extra_dict != NULL)
+		return -1;
+
+	D_ENSURE_USER_BODY (f);
+
+	fsc.func = f;
+	fsc.regs = regs;
+	fsc.up = sc;
+
+	c->depth++;
+	r = compile_tree (c, f->data.user, &fsc);
+	c->depth--;
+
+	return r;
+}
+
+#define DFUNC_MAX_ARGS 16
+
+static int
+compile_call (DFuncCompiler *c, GelEFunc *f, GelToken *id,
+	      GelETree *args, int nargs, DFuncScope *sc)
+{
+	int regs[DFUNC_MAX_ARGS];
+	int r;
+
+	if (f->nargs != nargs || f->vararg || nargs > DFUNC_MAX_ARGS)
+		return -1;
+
+	if ( ! compile_args (c, args, nargs, sc, regs))
+		return -1;
+
+	r = compile_known (c, id, regs, nargs);
+	if (r >= 0) {
+		add_guard (c, id, f, NULL);
+		return r;
+	}
+
+	r = compile_inline (c, f, regs, sc);
+	if (r >= 0)
+		add_guard (c, id, f, f->data.user);
+	return r;
+}
+
+static int
+compile_ident (DFuncCompiler *c, GelToken *id, DFuncScope *sc)
+{
+	GelEFunc *f;
+	int r;
+
+	r = scope_lookup (sc, id);
+	if (r >= 0)
+		return r;
+
+	/* these have their own getters */
+	if (id->built_in_parameter)
+		return -1;
+
+	f = d_lookup_global (id);
+	if (f == NULL)
+		return -1;
+
+	if (f->type == GEL_VARIABLE_FUNC) {
+		DFuncGlobal g;
+		double d;
+
+		D_ENSURE_USER_BODY (f);
+		if ( ! get_real_value (f->data.user, &d))
+			return -1;
+
+		g.id = id;
+		g.reg = new_reg (c, d, FALSE);
+		g_array_append_val (c->globals, g);
+		return g.reg;
+	}
+
+	/* a function with no arguments gets called */
+	if (f->nargs == 0)
+		return compile_call (c, f, id, NULL, 0, sc);
+
+	return -1;
+}
+
+static int
+compile_binary (DFuncCompiler *c, DFuncOp op, GelETree *n, DFuncScope *sc,
+		gboolean bool_ok, gboolean ret_bool)
+{
+	int a, b, r;
+
+	a = compile_tree (c, n->op.args, sc);
+	if (a < 0)
+		return -1;
+	b = compile_tree (c, n->op.args->any.next, sc);
+	if (b < 0)
+		return -1;
+
+	if ( ! bool_ok && (REG_IS_BOOL (c, a) || REG_IS_BOOL (c, b)))
+		return -1;
+
+	r = new_reg (c, 0.0, ret_bool);
+	if (emit (c, op, r, a, b) < 0)
+		return -1;
+	return r;
+}
+
+static int
+compile_unary (DFuncCompiler *c, DFuncOp op, GelETree *n, DFuncScope *sc,
+	       gboolean bool_ok, gboolean ret_bool)
+{
+	int a, r;
+
+	a = compile_tree (c, n->op.args, sc);
+	if (a < 0)
+		return -1;
+	if ( ! bool_ok && REG_IS_BOOL (c, a))
+		return -1;
+
+	r = new_reg (c, 0.0, ret_bool);
+	if (emit (c, op, r, a, 0) < 0)
+		return -1;
+	return r;
+}
+
+static DFuncOp
+cmp_op (int oper)
+{
+	switch (oper) {
+	case GEL_E_EQ_CMP: return DF_EQ;
+	case GEL_E_NE_CMP: return DF_NE;
+	case GEL_E_LT_CMP: return DF_LT;
+	case GEL_E_GT_CMP: return DF_GT;
+	case GEL_E_LE_CMP: return DF_LE;
+	default: return DF_GE;
+	}
+}
+
+/* a < b <= c ... all arguments get evaluated, then compared */
+static int
+compile_comparison (DFuncCompiler *c, GelETree *n, DFuncScope *sc)
+{
+	int regs[32];
+	GelETree *li;
+	GSList *oli;
+	int i, r;
+
+	if (n->comp.nargs > 32)
+		return -1;
+
+	for (i = 0, li = n->comp.args; li != NULL; i++, li = li->any.next) {
+		regs[i] = compile_tree (c, li, sc);
+		if (regs[i] < 0)
+			return -1;
+	}
+
+	r = new_reg (c, 1.0, TRUE);
+	for (i = 0, oli = n->comp.comp; oli != NULL; i++, oli = oli->next) {
+		int oper = GPOINTER_TO_INT (oli->data);
+		int t;
+
+		if ((oper != GEL_E_EQ_CMP && oper != GEL_E_NE_CMP) &&
+		    (REG_IS_BOOL (c, regs[i]) || REG_IS_BOOL (c, regs[i+1])))
+			return -1;
+
+		t = new_reg (c, 0.0, TRUE);
+		if (emit (c, cmp_op (oper), t, regs[i], regs[i+1]) < 0 ||
+		    emit (c, DF_AND, r, r, t) < 0)
+			return -1;
+	}
+
+	return r;
+}
+
+static int
+compile_ifelse (DFuncCompiler *c, GelETree *n, DFuncScope *sc)
+{
+	int cond, a, b, r;
+	int jfalse, jend;
+
+	cond = compile_tree (c, n->op.args, sc);
+	if (cond < 0)
+		return -1;
+
+	r = new_reg (c, 0.0, FALSE);
+
+	jfalse = emit (c, DF_JUMP_FALSE, 0, cond, 0);
+	a = compile_tree (c, n->op.args->any.next, sc);
+	if (jfalse < 0 || a < 0 ||
+	    emit (c, DF_MOVE, r, a, 0) < 0)
+		return -1;
+	jend = emit (c, DF_JUMP, 0, 0, 0);
+	if (jend < 0)
+		return -1;
+
+	patch_jump (c, jfalse);
+	b = compile_tree (c, n->op.args->any.next->any.next, sc);
+	if (b < 0 ||
+	    REG_IS_BOOL (c, a) != REG_IS_BOOL (c, b) ||
+	    emit (c, DF_MOVE, r, b, 0) < 0)
+		return -1;
+	patch_jump (c, jend);
+
+	g_array_index (c->isbool, guint8, r) = REG_IS_BOOL (c, a) ? 1 : 0;
+
+	return r;
+}
+
+/* and/or only evaluate the second argument when needed, just like
+ * the interpreter */
+static int
+compile_andor (DFuncCompiler *c, GelETree *n, DFuncScope *sc, gboolean and)
+{
+	int a, b, r, j;
+
+	a = compile_tree (c, n->op.args, sc);
+	if (a < 0)
+		return -1;
+	r = new_reg (c, 0.0, TRUE);
+	if (emit (c, DF_TRUTH, r, a, 0) < 0)
+		return -1;
+	j = emit (c, and ? DF_JUMP_FALSE : DF_JUMP_TRUE, 0, r, 0);
+	if (j < 0)
+		return -1;
+	b = compile_tree (c, n->op.args->any.next, sc);
+	if (b < 0 ||
+	    emit (c, DF_TRUTH, r, b, 0) < 0)
+		return -1;
+	patch_jump (c, j);
+
+	return r;
+}
+
+static int
+compile_tree (DFuncCompiler *c, GelETree *n, DFuncScope *sc)
+{
+	double d;
+
+	if (n == NULL)
+		return -1;
+
+	switch (n->type) {
+	case GEL_VALUE_NODE:
+		if ( ! get_real_value (n, &d))
+			return -1;
+		return new_reg (c, d, FALSE);
+
+	case GEL_BOOL_NODE:
+		return new_reg (c, n->bool_.bool_ ? 1.0 : 0.0, TRUE);
+
+	case GEL_IDENTIFIER_NODE:
+		return compile_ident (c, n->id.id, sc);
+
+	case GEL_COMPARISON_NODE:
+		return compile_comparison (c, n, sc);
+
+	case GEL_OPERATOR_NODE:
+		break;
+
+	default:
+		return -1;
+	}
+
+	switch (n->op.oper) {
+	case GEL_E_SEPAR:
+		if (compile_tree (c, n->op.args, sc) < 0)
+			return -1;
+		return compile_tree (c, n->op.args->any.next, sc);
+
+	case GEL_E_PLUS:
+	case GEL_E_ELTPLUS:
+		return compile_binary (c, DF_ADD, n, sc, FALSE, FALSE);
+	case GEL_E_MINUS:
+	case GEL_E_ELTMINUS:
+		return compile_binary (c, DF_SUB, n, sc, FALSE, FALSE);
+	case GEL_E_MUL:
+	case GEL_E_ELTMUL:
+		return compile_binary (c, DF_MUL, n, sc, FALSE, FALSE);
+	case GEL_E_DIV:
+	case GEL_E_ELTDIV:
+		return compile_binary (c, DF_DIV, n, sc, FALSE, FALSE);
+	case GEL_E_EXP:
+	case GEL_E_ELTEXP:
+		return compile_binary (c, DF_POW, n, sc, FALSE, FALSE);
+	case GEL_E_NEG:
+		return compile_unary (c, DF_NEG, n, sc, FALSE, FALSE);
+	case GEL_E_ABS:
+		return compile_unary (c, DF_ABS, n, sc, FALSE, FALSE);
+
+	case GEL_E_EQ_CMP:
+	case GEL_E_NE_CMP:
+		return compile_binary (c, cmp_op (n->op.oper), n, sc,
+				       TRUE, TRUE);
+	case GEL_E_LT_CMP:
+	case GEL_E_GT_CMP:
+	case GEL_E_LE_CMP:
+	case GEL_E_GE_CMP:
+		return compile_binary (c, cmp_op (n->op.oper), n, sc,
+				       FALSE, TRUE);
+	case GEL_E_CMP_CMP:
+		return compile_binary (c, DF_CMP, n, sc, FALSE, FALSE);
+
+	case GEL_E_LOGICAL_AND:
+		return compile_andor (c, n, sc, TRUE);
+	case GEL_E_LOGICAL_OR:
+		return compile_andor (c, n, sc, FALSE);
+	case GEL_E_LOGICAL_XOR:
+		return compile_binary (c, DF_XOR, n, sc, TRUE, TRUE);
+	case GEL_E_LOGICAL_NOT:
+		return compile_unary (c, DF_NOT, n, sc, TRUE, TRUE);
+
+	case GEL_E_IFELSE_CONS:
+		return compile_ifelse (c, n, sc);
+
+	case GEL_E_DIRECTCALL: {
+		GelETree *fid = n->op.args;
+		GelEFunc *f;
+
+		if (fid->type != GEL_IDENTIFIER_NODE ||
+		    /* a function passed in as an argument */
+		    scope_lookup (sc, fid->id.id) >= 0)
+			return -1;
+		f = d_lookup_global (fid->id.id);
+		if (f == NULL)
+			return -1;
+		return compile_call (c, f, fid->id.id, fid->any.next,
+				     n->op.nargs - 1, sc);
+	}
+
+	default:
+		return -1;
+	}
+}
+
+GelDFunc *
+gel_dfunc_compile (GelEFunc *f, int nargs)
+{
+	DFuncCompiler c;
+	GelDFunc *df = NULL;
+	int regs[3];
+	int i, r;
+
+	g_return_val_if_fail (f != NULL, NULL);
+
+	if (nargs < 1 || nargs > 3 || f->nargs != nargs || f->vararg)
+		return NULL;
+
+	c.insns = g_array_new (FALSE, FALSE, sizeof (DFuncInsn));
+	c.regs = g_array_new (FALSE, FALSE, sizeof (double));
+	c.isbool = g_array_new (FALSE, FALSE, sizeof (guint8));
+	c.guards = g_array_new (FALSE, FALSE, sizeof (DFuncGuard));
+	c.globals = g_array_new (FALSE, FALSE, sizeof (DFuncGlobal));
+	c.depth = 0;
+
+	/* the arguments are the first registers, the function itself is
+	 * owned by the caller so it needs no guard */
+	for (i = 0; i < nargs; i++)
+		regs[i] = new_reg (&c, 0.0, FALSE);
+
+	r = compile_known (&c, f->id, regs, nargs);
+	if (r < 0)
+		r = compile_inline (&c, f, regs, NULL);
+
+	if (r < 0 || REG_IS_BOOL (&c, r))
+		goto compile_done;
+
+	df = g_new0 (GelDFunc, 1);
+	df->nargs = nargs;
+	df->result = r;
+	df->nregs = c.regs->len;
+	df->regs = (double *)g_array_free (c.regs, FALSE);
+	c.regs = NULL;
+	df->ninsns = c.insns->len;
+	df->insns = (DFuncInsn *)g_array_free (c.insns, FALSE);
+	c.insns = NULL;
+	df->nguards = c.guards->len;
+	df->guards = (DFuncGuard *)g_array_free (c.guards, FALSE);
+	c.guards = NULL;
+	df->nglobals = c.globals->len;
+	df->globals = (DFuncGlobal *)g_array_free (c.globals, FALSE);
+	c.globals = NULL;
+
+compile_done:
+	if (c.insns != NULL)
+		g_array_free (c.insns, TRUE);
+	if (c.regs != NULL)
+		g_array_free (c.regs, TRUE);
+	if (c.guards != NULL)
+		g_array_free (c.guards, TRUE);
+	if (c.globals != NULL)
+		g_array_free (c.globals, TRUE);
+	g_array_free (c.isbool, TRUE);
+
+	return df;
+}
+
+void
+gel_dfunc_free (GelDFunc *df)
+{
+	if (df == NULL)
+		return;
+	g_free (df->regs);
+	g_free (df->insns);
+	g_free (df->guards);
+	g_free (df->globals);
+	g_free (df);
+}
+
+gboolean
+gel_dfunc_prepare (GelDFunc *df)
+{
+	int i;
+
+	g_return_val_if_fail (df != NULL, FALSE);
+
+	for (i = 0; i < df->nguards; i++) {
+		DFuncGuard *g = &df->guards[i];
+		GelEFunc *f = d_lookup_global (g->id);
+
+		if (f != g->func ||
+		    (g->body != NULL &&
+		     (f->type != GEL_USER_FUNC || f->data.user != g->body)) ||
+		    (g->body == NULL && ! g->id->protected_))
+			return FALSE;
+	}
+
+	for (i = 0; i < df->nglobals; i++) {
+		DFuncGlobal *g = &df->globals[i];
+		GelEFunc *f = d_lookup_global (g->id);
+
+		if (f == NULL || f->type != GEL_VARIABLE_FUNC)
+			return FALSE;
+		D_ENSURE_USER_BODY (f);
+		if ( ! get_real_value (f->data.user, &df->regs[g->reg]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+double
+gel_dfunc_eval (const GelDFunc *df, const double *args, gboolean *ex)
+{
+	const DFuncInsn *insns = df->insns;
+	const DFuncInsn *in;
+	const DFuncInsn *end;
+	double *r;
+	double res;
+
+	r = g_newa (double, df->nregs);
+	memcpy (r, df->regs, sizeof (double) * df->nregs);
+	memcpy (r, args, sizeof (double) * df->nargs);
+
+	feclearexcept (FE_INVALID | FE_DIVBYZERO);
+
+	in = insns;
+	end = insns + df->ninsns;
+	while (in < end) {
+		switch (in->op) {
+		case DF_MOVE:
+			r[in->dst] = r[in->a];
+			break;
+		case DF_ADD:
+			r[in->dst] = r[in->a] + r[in->b];
+			break;
+		case DF_SUB:
+			r[in->dst] = r[in->a] - r[in->b];
+			break;
+		case DF_MUL:
+			r[in->dst] = r[in->a] * r[in->b];
+			break;
+		case DF_DIV:
+			r[in->dst] = r[in->a] / r[in->b];
+			break;
+		case DF_POW:
+			r[in->dst] = pow (r[in->a], r[in->b]);
+			break;
+		case DF_NEG:
+			r[in->dst] = - r[in->a];
+			break;
+		case DF_ABS:
+			r[in->dst] = fabs (r[in->a]);
+			break;
+		case DF_FUNC1:
+			r[in->dst] = in->u.f1 (r[in->a]);
+			break;
+		case DF_FUNC2:
+			r[in->dst] = in->u.f2 (r[in->a], r[in->b]);
+			break;
+		case DF_EQ:
+			r[in->dst] = (r[in->a] == r[in->b]);
+			break;
+		case DF_NE:
+			r[in->dst] = (r[in->a] != r[in->b]);
+			break;
+		case DF_LT:
+			r[in->dst] = (r[in->a] < r[in->b]);
+			break;
+		case DF_GT:
+			r[in->dst] = (r[in->a] > r[in->b]);
+			break;
+		case DF_LE:
+			r[in->dst] = (r[in->a] <= r[in->b]);
+			break;
+		case DF_GE:
+			r[in->dst] = (r[in->a] >= r[in->b]);
+			break;
+		case DF_CMP:
+			r[in->dst] = (r[in->a] > r[in->b]) -
+				(r[in->a] < r[in->b]);
+			break;
+		case DF_AND:
+			r[in->dst] = (r[in->a] != 0.0 && r[in->b] != 0.0);
+			break;
+		case DF_XOR:
+			r[in->dst] = ((r[in->a] != 0.0) != (r[in->b] != 0.0));
+			break;
+		case DF_NOT:
+			r[in->dst] = (r[in->a] == 0.0);
+			break;
+		case DF_TRUTH:
+			r[in->dst] = (r[in->a] != 0.0);
+			break;
+		case DF_JUMP:
+			in = insns + in->u.target;
+			continue;
+		case DF_JUMP_FALSE:
+			if (r[in->a] == 0.0) {
+				in = insns + in->u.target;
+				continue;
+			}
+			break;
+		case DF_JUMP_TRUE:
+			if (r[in->a] != 0.0) {
+				in = insns + in->u.target;
+				continue;
+			}
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+		in++;
+	}
+
+	res = r[df->result];
+
+	/* the interpreter would have given an error or a complex number */
+	if G_UNLIKELY (fetestexcept (FE_INVALID | FE_DIVBYZERO) ||
+		       ! isfinite (res)) {
+		*ex = TRUE;
+#ifdef HUGE_VAL
+		return HUGE_VAL;
+#else
+		return 0;
+#endif
+	}
+
+	return res;
+}
+
+/* points handed out to a thread at a time */
+#define DFUNC_CHUNK 64
+/* below this many points don't bother with threads */
+#define DFUNC_MIN_PARALLEL 1024
+
+typedef struct {
+	const GelDFunc *df;
+	int n;
+	const double *args;
+	double *out;
+	gboolean *ex;
+	volatile gint next;
+} DFuncWork;
+
+/* do one chunk, FALSE if there is nothing more to do */
+static gboolean
+eval_chunk (DFuncWork *w)
+{
+	int i, start, end;
+
+	start = g_atomic_int_add (&w->next, DFUNC_CHUNK);
+	if (start >= w->n)
+		return FALSE;
+	end = MIN (start + DFUNC_CHUNK, w->n);
+
+	for (i = start; i < end; i++) {
+		if G_UNLIKELY (gel_interrupted) {
+			w->ex[i] = TRUE;
+			continue;
+		}
+		w->ex[i] = FALSE;
+		w->out[i] = gel_dfunc_eval (w->df,
+					    w->args + (gsize)i * w->df->nargs,
+					    &w->ex[i]);
+	}
+	return TRUE;
+}
+
+static gpointer
+eval_thread (gpointer data)
+{
+	DFuncWork *w = data;
+	while (eval_chunk (w))
+		;
+	return NULL;
+}
+
+void
+gel_dfunc_eval_many (const GelDFunc *df,
+		     int n,
+		     const double *args,
+		     double *out,
+		     gboolean *ex,
+		     int nthreads,
+		     GelHookFunc hook)
+{
+	DFuncWork w;
+	GThread **threads;
+	int i;
+
+	g_return_if_fail (df != NULL);
+
+	if (n <= 0)
+		return;
+
+	if (nthreads <= 0)
+		nthreads = g_get_num_processors ();
+	if (n < DFUNC_MIN_PARALLEL)
+		nthreads = 1;
+	nthreads = MIN (nthreads, (n + DFUNC_CHUNK - 1) / DFUNC_CHUNK);
+
+	w.df = df;
+	w.n = n;
+	w.args = args;
+	w.out = out;
+	w.ex = ex;
+	w.next = 0;
+
+	threads = g_new0 (GThread *, nthreads);
+	for (i = 1; i < nthreads; i++) {
+		threads[i] = g_thread_try_new ("gel-dfunc", eval_thread,
+					       &w, NULL);
+		/* if we can't get a thread we just do more ourselves */
+		if (threads[i] == NULL)
+			break;
+	}
+
+	while (eval_chunk (&w)) {
+		if (hook != NULL)
+			(*hook) ();
+	}
+
+	for (i = 1; i < nthreads; i++) {
+		if (threads[i] != NULL)
+			g_thread_join (threads[i]);
+	}
+	g_free (threads);
+}
@@ -0,0 +1,71 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DFUNC_H_
+#define _DFUNC_H_
+
+#include <glib.h>
+#include "structs.h"
+
+/* A function compiled to a flat double precision program, used to sample
+ * functions for plotting without going through the interpreter.  Only
+ * a subset is handled: real arithmetic, comparisons and logic,
+ * if/then/else, the elementary functions, global variables holding real
+ * numbers and calls to other user functions in this subset (which are
+ * inlined).  Anything else makes gel_dfunc_compile return NULL and the
+ * caller should use the interpreter. */
+typedef struct _GelDFunc GelDFunc;
+
+/* Compile f taking nargs real arguments, NULL if it cannot be done */
+GelDFunc *	gel_dfunc_compile	(GelEFunc *f,
+					 int nargs);
+void		gel_dfunc_free		(GelDFunc *df);
+
+/* Check that the functions that got inlined have not been redefined and
+ * load the current values of global variables.  Must be called (from the
+ * main thread) before gel_dfunc_eval, and again whenever GEL code might
+ * have run.  If FALSE is returned the compiled function is stale and
+ * the interpreter must be used. */
+gboolean	gel_dfunc_prepare	(GelDFunc *df);
+
+/* Evaluate with the given arguments.  Sets *ex to TRUE wherever the
+ * interpreter would not give a real number (domain errors, division by
+ * zero, results that are not finite).  This touches no global state
+ * and so can be called from several threads at once. */
+double		gel_dfunc_eval		(const GelDFunc *df,
+					 const double *args,
+					 gboolean *ex);
+
+/* Evaluate at n points, args holds nargs values for each point.  The
+ * points are split among nthreads threads (<= 0 means one per
+ * processor), the calling thread works too and runs hook (if not NULL)
+ * every now and then so that the UI can be kept alive.  If
+ * gel_interrupted gets set, the points not yet done are marked as
+ * exceptions. */
+void		gel_dfunc_eval_many	(const GelDFunc *df,
+					 int n,
+					 const double *args,
+					 double *out,
+					 gboolean *ex,
+					 int nthreads,
+					 GelHookFunc hook);
+
+#endif /* _DFUNC_H_ */
@@ -43,6 +43,9 @@ static GelDictContext context = {NULL, NULL, -1};
 
 static GHashTable *dictionary;
 
+/*see d_globals_serial*/
+static guint globals_serial = 0;
+
 extern const char *genius_toplevels[];
 extern const char *genius_operators[];
 
@@ -53,6 +56,18 @@ d_curcontext (void) /* PURE! no side effects*/
 	return context.top;
 }
 
+void
+d_globals_changed (void)
+{
+	globals_serial++;
+}
+
+guint
+d_globals_serial (void) /* PURE! no side effects*/
+{
+	return globals_serial;
+}
+
 /*make builtin function and return it*/
 GelEFunc *
 d_makebifunc (GelToken *id, GelBIFunction f, int nargs)
@@ -353,6 +368,9 @@ d_addfunc (GelEFunc *func)
 	
 	g_return_val_if_fail (func->context == context.top, func);
 
+	if (context.top == 0)
+		globals_serial++;
+
 	if (context.stack->local_all)
 		func->is_local = 1;
 	
@@ -383,6 +401,8 @@ d_addfunc_global (GelEFunc *func)
 	
 	g_return_val_if_fail (func->context == 0, func);
 
+	globals_serial++;
+
 	/* get the function in the lowest context */
 	last = g_slist_last (func->id->refs);
 	n = last != NULL ? last->data : NULL;
@@ -540,6 +560,8 @@ d_delete(GelToken *id)
 
 	g_return_val_if_fail (id != NULL && id->token != NULL, FALSE);
 
+	globals_serial++;
+
 	id->protected_ = 0;
 	id->parameter = 0;
 	id->built_in_parameter = 0;
@@ -565,6 +587,8 @@ d_delete_global(GelToken *id)
 
 	g_return_val_if_fail (id != NULL && id->token != NULL, FALSE);
 
+	globals_serial++;
+
 	id->protected_ = 0;
 	id->parameter = 0;
 	id->built_in_parameter = 0;
@@ -731,6 +755,8 @@ d_set_ref(GelEFunc *n,GelEFunc *ref)
 {
 	if(!n || !ref)
 		return;
+	if(n->context == 0)
+		globals_serial++;
 	if(n->type == GEL_USER_FUNC ||
 	   n->type == GEL_VARIABLE_FUNC)
 		gel_freetree(n->data.user);
@@ -759,6 +785,8 @@ d_set_value(GelEFunc *n,GelETree *value)
 {
 	if(!n || !value)
 		return;
+	if(n->context == 0)
+		globals_serial++;
 	if(n->type == GEL_USER_FUNC ||
 	   n->type == GEL_VARIABLE_FUNC)
 		gel_freetree(n->data.user);
@@ -796,6 +824,8 @@ d_addcontext (GelEFunc *func)
 
 	context.top++;
 
+	gel_eval_stats.contexts_pushed++;
+
 	return TRUE;
 }
 
@@ -78,6 +78,12 @@ gboolean d_setvalue (GelToken *id,GelETree *value);
 void d_set_value(GelEFunc *n,GelETree *value);
 void d_set_ref(GelEFunc *n,GelEFunc *ref);
 
+/*something in the global context was set or deleted, the d_ functions
+  call this themselves, only needed when a global is changed in place*/
+void d_globals_changed (void);
+/*bumped on every such change (caches use it to tell they are stale)*/
+guint d_globals_serial (void) G_GNUC_PURE;
+
 /*dictionary functions*/
 
 /*lookup a function in the dictionary, either the whole thing, or just the
@@ -0,0 +1,1021 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calc.h"
+
+#include "dlog.h"
+
+/* Prime orders up to this many bits are done by baby step giant step,
+ * with a table of 2^16 entries at most */
+#define DLOG_BSGS_BITS 32
+/* and up to this many bits by Pollard rho (about 2^19 steps), larger
+ * ones by index calculus which is faster from there on */
+#define DLOG_RHO_BITS 38
+
+/* number of multipliers in the rho walk */
+#define RHO_R 16
+
+/* how many candidates to try when looking for a smooth h g^k */
+#define DLOG_MAX_TRIES 10000000
+
+/* a given factor base that yields fewer relations than one per this
+ * many candidates is not worth it, the usual one does better */
+#define IC_GIVE_UP_TRIES 100000
+
+static gmp_randstate_t dlog_rand_state;
+static gboolean dlog_rand_inited = FALSE;
+
+/* r uniform in [0,n) */
+static void
+dlog_random (mpz_ptr r, mpz_srcptr n)
+{
+	if G_UNLIKELY ( ! dlog_rand_inited) {
+		gmp_randinit_default (dlog_rand_state);
+		gmp_randseed_ui (dlog_rand_state, g_random_int ());
+		dlog_rand_inited = TRUE;
+	}
+	mpz_urandomm (r, dlog_rand_state, n);
+}
+
+static gboolean
+dlog_interrupted (void)
+{
+	static int ii = 0;
+	if (gel_evalnode_hook != NULL &&
+	    G_UNLIKELY ((ii++ & GEL_RUN_HOOK_EVERY_MASK) == GEL_RUN_HOOK_EVERY_MASK)) {
+		(*gel_evalnode_hook)();
+		ii = 0;
+	}
+	return gel_interrupted;
+}
+
+static inline gulong
+dlog_hash (mpz_srcptr a)
+{
+	guint64 k = mpz_get_ui (a);
+	return (gulong)((k * G_GUINT64_CONSTANT (0x9E3779B97F4A7C15)) >> 32);
+}
+
+/* a = a*b mod p */
+static inline void
+mulmod (mpz_ptr a, mpz_srcptr b, mpz_srcptr p)
+{
+	mpz_mul (a, a, b);
+	mpz_mod (a, a, p);
+}
+
+/* a = a+b mod n for a, b in [0,n) */
+static inline void
+addmod (mpz_ptr a, mpz_srcptr b, mpz_srcptr n)
+{
+	mpz_add (a, a, b);
+	if (mpz_cmp (a, n) >= 0)
+		mpz_sub (a, a, n);
+}
+
+gboolean
+gel_dlog_bsgs (mpz_ptr x, mpz_srcptr h, mpz_srcptr g, mpz_srcptr n,
+	       mpz_srcptr p)
+{
+	mpz_t e, y, f;
+	gulong m, i, j, s, size, mask;
+	guint64 *keys;
+	long *vals;
+	gboolean found = FALSE;
+
+	mpz_inits (e, y, f, NULL);
+
+	/* m = ceil(sqrt(n)) */
+	mpz_sqrtrem (e, y, n);
+	if (mpz_sgn (y) != 0)
+		mpz_add_ui (e, e, 1);
+	m = mpz_get_ui (e);
+
+	for (size = 16; size < 2*m; size <<= 1)
+		;
+	mask = size - 1;
+	keys = g_new (guint64, size);
+	vals = g_new (long, size);
+	for (s = 0; s < size; s++)
+		vals[s] = -1;
+
+	/* the baby steps g^j, keyed by the low word */
+	mpz_set_ui (e, 1);
+	for (j = 0; j < m; j++) {
+		s = dlog_hash (e) & mask;
+		while (vals[s] >= 0)
+			s = (s+1) & mask;
+		keys[s] = mpz_get_ui (e);
+		vals[s] = j;
+		mulmod (e, g, p);
+		if G_UNLIKELY (dlog_interrupted ())
+			goto done;
+	}
+
+	/* the giant steps h g^(-im) */
+	if ( ! mpz_invert (f, e, p))
+		goto done;
+	mpz_mod (y, h, p);
+	for (i = 0; i < m; i++) {
+		guint64 k = mpz_get_ui (y);
+		for (s = dlog_hash (y) & mask; vals[s] >= 0; s = (s+1) & mask) {
+			if (keys[s] != k)
+				continue;
+			/* the low word matched, check it really is it */
+			mpz_powm_ui (e, g, vals[s], p);
+			if (mpz_cmp (e, y) == 0) {
+				mpz_set_ui (x, i);
+				mpz_mul_ui (x, x, m);
+				mpz_add_ui (x, x, vals[s]);
+				mpz_mod (x, x, n);
+				found = TRUE;
+				goto done;
+			}
+		}
+		mulmod (y, f, p);
+		if G_UNLIKELY (dlog_interrupted ())
+			goto done;
+	}
+
+done:
+	g_free (keys);
+	g_free (vals);
+	mpz_clears (e, y, f, NULL);
+	return found;
+}
+
+/* One step of the walk y = g^a h^b, multiply by one of the RHO_R
+ * precomputed g^ma h^mb depending on y */
+static inline void
+rho_step (mpz_ptr y, mpz_ptr a, mpz_ptr b,
+	  mpz_t *mm, mpz_t *ma, mpz_t *mb, mpz_srcptr n, mpz_srcptr p)
+{
+	int i = dlog_hash (y) % RHO_R;
+	mulmod (y, mm[i], p);
+	addmod (a, ma[i], n);
+	addmod (b, mb[i], n);
+}
+
+gboolean
+gel_dlog_rho (mpz_ptr x, mpz_srcptr h, mpz_srcptr g, mpz_srcptr n,
+	      mpz_srcptr p)
+{
+	mpz_t mm[RHO_R], ma[RHO_R], mb[RHO_R];
+	mpz_t y, ya, yb, t, ta, tb, tmp;
+	gulong power, lam;
+	int i, tries;
+	gboolean found = FALSE;
+
+	mpz_inits (y, ya, yb, t, ta, tb, tmp, NULL);
+	for (i = 0; i < RHO_R; i++)
+		mpz_inits (mm[i], ma[i], mb[i], NULL);
+
+	mpz_mod (tmp, h, p);
+	if (mpz_cmp_ui (tmp, 1) == 0) {
+		mpz_set_ui (x, 0);
+		found = TRUE;
+		goto done;
+	}
+
+	/* a few restarts in case the collision is useless */
+	for (tries = 0; tries < 10 && ! found; tries++) {
+		for (i = 0; i < RHO_R; i++) {
+			dlog_random (ma[i], n);
+			dlog_random (mb[i], n);
+			mpz_powm (mm[i], g, ma[i], p);
+			mpz_powm (tmp, h, mb[i], p);
+			mulmod (mm[i], tmp, p);
+		}
+		dlog_random (ya, n);
+		dlog_random (yb, n);
+		mpz_powm (y, g, ya, p);
+		mpz_powm (tmp, h, yb, p);
+		mulmod (y, tmp, p);
+
+		/* Brent: t is y at the last power of two */
+		mpz_set (t, y);
+		mpz_set (ta, ya);
+		mpz_set (tb, yb);
+		power = lam = 1;
+		rho_step (y, ya, yb, mm, ma, mb, n, p);
+		while (mpz_cmp (y, t) != 0) {
+			if (power == lam) {
+				mpz_set (t, y);
+				mpz_set (ta, ya);
+				mpz_set (tb, yb);
+				power <<= 1;
+				lam = 0;
+			}
+			rho_step (y, ya, yb, mm, ma, mb, n, p);
+			lam++;
+			if G_UNLIKELY (dlog_interrupted ())
+				goto done;
+		}
+
+		/* g^ya h^yb = g^ta h^tb, so x (yb-tb) = ta-ya mod n */
+		mpz_sub (tmp, yb, tb);
+		mpz_mod (tmp, tmp, n);
+		if (mpz_sgn (tmp) == 0 ||
+		    ! mpz_invert (tmp, tmp, n))
+			continue;
+		mpz_sub (x, ta, ya);
+		mpz_mul (x, x, tmp);
+		mpz_mod (x, x, n);
+
+		mpz_powm (tmp, g, x, p);
+		mpz_mod (t, h, p);
+		found = (mpz_cmp (tmp, t) == 0);
+	}
+
+done:
+	for (i = 0; i < RHO_R; i++)
+		mpz_clears (mm[i], ma[i], mb[i], NULL);
+	mpz_clears (y, ya, yb, t, ta, tb, tmp, NULL);
+	return found;
+}
+
+/* u = v r (mod p) with |u|, |v| <= sqrt(p) and v > 0, from the extended
+ * Euclidean algorithm on p and r stopped halfway */
+static void
+ratrecon (mpz_ptr u, mpz_ptr v, mpz_srcptr r, mpz_srcptr p,
+	  mpz_srcptr bound, mpz_ptr r0, mpz_ptr t0, mpz_ptr q)
+{
+	mpz_set (r0, p);
+	mpz_set (u, r);
+	mpz_set_ui (t0, 0);
+	mpz_set_ui (v, 1);
+	while (mpz_cmp (u, bound) > 0) {
+		mpz_fdiv_qr (q, r0, r0, u);
+		mpz_swap (r0, u);
+		mpz_submul (t0, q, v);
+		mpz_swap (t0, v);
+	}
+	if (mpz_sgn (v) < 0) {
+		mpz_neg (u, u);
+		mpz_neg (v, v);
+	}
+}
+
+struct _GelDlogIC {
+	mpz_t g;
+	mpz_t p;
+	mpz_t l;
+	mpz_t bound;		/* floor(sqrt(p)) */
+	int np;
+	unsigned long *primes;	/* the factor base */
+	mpz_t *logs;		/* their logarithms mod l */
+	gboolean *known;
+	/* for gel_dlog_ic_new_with_base, the index in primes of each
+	 * element of the given base, -1 if not in it */
+	int nbase;
+	int *col;
+	/* all the relations wanted were found */
+	gboolean complete;
+};
+
+/* A relation sum val[i] L_col[i] = rhs (mod l), columns increasing */
+typedef struct {
+	int len;
+	int *col;
+	mpz_t *val;
+	mpz_t rhs;
+} IcRow;
+
+/* Factor |n| over the factor base into prime indices and exponents,
+ * returns their number or -1 if n is not smooth, n is destroyed */
+static int
+ic_factor (GelDlogIC *ic, mpz_ptr n, int *idx, int *ex)
+{
+	int i, cnt = 0;
+
+	mpz_abs (n, n);
+	for (i = 0; i < ic->np && mpz_cmp_ui (n, 1) > 0; i++) {
+		unsigned long q = ic->primes[i];
+		int e = 0;
+		while (mpz_divisible_ui_p (n, q)) {
+			mpz_divexact_ui (n, n, q);
+			e++;
+		}
+		if (e > 0) {
+			idx[cnt] = i;
+			ex[cnt] = e;
+			cnt++;
+		}
+	}
+	return mpz_cmp_ui (n, 1) == 0 ? cnt : -1;
+}
+
+static void
+ic_row_free (IcRow *row)
+{
+	int i;
+	for (i = 0; i < row->len; i++)
+		mpz_clear (row->val[i]);
+	g_free (row->col);
+	g_free (row->val);
+	mpz_clear (row->rhs);
+}
+
+/* row = row - f*piv (mod l) */
+static void
+ic_row_submul (IcRow *row, IcRow *piv, mpz_srcptr f, mpz_srcptr l)
+{
+	int len = 0, i = 0, j = 0;
+	int maxlen = row->len + piv->len;
+	int *col = g_new (int, maxlen);
+	mpz_t *val = g_new (mpz_t, maxlen);
+
+	while (i < row->len || j < piv->len) {
+		if (j >= piv->len ||
+		    (i < row->len && row->col[i] < piv->col[j])) {
+			col[len] = row->col[i];
+			mpz_init_set (val[len], row->val[i]);
+			i++;
+		} else {
+			col[len] = piv->col[j];
+			mpz_init (val[len]);
+			if (i < row->len && row->col[i] == piv->col[j]) {
+				mpz_set (val[len], row->val[i]);
+				i++;
+			}
+			mpz_submul (val[len], f, piv->val[j]);
+			mpz_mod (val[len], val[len], l);
+			j++;
+			if (mpz_sgn (val[len]) == 0) {
+				mpz_clear (val[len]);
+				continue;
+			}
+		}
+		len++;
+	}
+	mpz_submul (row->rhs, f, piv->rhs);
+	mpz_mod (row->rhs, row->rhs, l);
+
+	for (i = 0; i < row->len; i++)
+		mpz_clear (row->val[i]);
+	g_free (row->col);
+	g_free (row->val);
+	row->len = len;
+	row->col = col;
+	row->val = val;
+}
+
+/* Structured elimination: columns from the largest prime (the sparsest)
+ * down, the fill-in then only lands in the columns not yet done.  Each
+ * pivot row only involves its own column and smaller ones so the logs
+ * come out by substitution from the smallest prime up.  Primes without
+ * a determined log are marked unknown. */
+static gboolean
+ic_solve (GelDlogIC *ic, IcRow *rows, int nrows)
+{
+	int *pivot = g_new (int, ic->np);
+	gboolean *used = g_new0 (gboolean, nrows);
+	mpz_t f;
+	int c, r, i;
+	gboolean ret = FALSE;
+
+	mpz_init (f);
+
+	for (c = ic->np-1; c >= 0; c--) {
+		IcRow *piv;
+		int best = -1;
+
+		pivot[c] = -1;
+		for (r = 0; r < nrows; r++) {
+			if ( ! used[r] &&
+			     rows[r].len > 0 &&
+			     rows[r].col[rows[r].len-1] == c &&
+			     (best < 0 || rows[r].len < rows[best].len))
+				best = r;
+		}
+		if (best < 0)
+			continue;
+		used[best] = TRUE;
+		pivot[c] = best;
+		piv = &rows[best];
+
+		/* make the pivot 1 */
+		mpz_invert (f, piv->val[piv->len-1], ic->l);
+		for (i = 0; i < piv->len; i++) {
+			mpz_mul (piv->val[i], piv->val[i], f);
+			mpz_mod (piv->val[i], piv->val[i], ic->l);
+		}
+		mpz_mul (piv->rhs, piv->rhs, f);
+		mpz_mod (piv->rhs, piv->rhs, ic->l);
+
+		for (r = 0; r < nrows; r++) {
+			if (used[r] ||
+			    rows[r].len == 0 ||
+			    rows[r].col[rows[r].len-1] != c)
+				continue;
+			mpz_set (f, rows[r].val[rows[r].len-1]);
+			ic_row_submul (&rows[r], piv, f, ic->l);
+		}
+		if G_UNLIKELY (dlog_interrupted ())
+			goto done;
+	}
+
+	for (c = 0; c < ic->np; c++) {
+		IcRow *piv;
+		ic->known[c] = FALSE;
+		if (pivot[c] < 0)
+			continue;
+		piv = &rows[pivot[c]];
+		mpz_set (f, piv->rhs);
+		for (i = 0; i < piv->len-1; i++) {
+			if ( ! ic->known[piv->col[i]])
+				break;
+			mpz_submul (f, piv->val[i], ic->logs[piv->col[i]]);
+		}
+		if (i < piv->len-1)
+			continue;
+		mpz_mod (ic->logs[c], f, ic->l);
+		ic->known[c] = TRUE;
+		ret = TRUE;
+	}
+
+done:
+	mpz_clear (f);
+	g_free (pivot);
+	g_free (used);
+	return ret;
+}
+
+/* The size of the factor base, about L_p(1/2, 1/2) */
+static unsigned long
+ic_smoothness_bound (mpz_srcptr p)
+{
+	double lp = mpz_sizeinbase (p, 2) * G_LN2;
+	double b = exp (0.5 * sqrt (lp * log (lp)));
+	return (unsigned long) CLAMP (b, 50.0, 1.0e7);
+}
+
+static GelDlogIC *
+ic_alloc (mpz_srcptr g, mpz_srcptr p, mpz_srcptr l)
+{
+	GelDlogIC *ic;
+
+	ic = g_new0 (GelDlogIC, 1);
+	mpz_init_set (ic->g, g);
+	mpz_init_set (ic->p, p);
+	mpz_init_set (ic->l, l);
+	mpz_init (ic->bound);
+	mpz_sqrt (ic->bound, p);
+
+	return ic;
+}
+
+/* Find the logs of ic->primes (increasing) from relations.  If
+ * give_up, stop looking for relations when they come too rarely and
+ * make do with what was found, for a base that was not chosen to fit
+ * p.  Frees ic and returns NULL if no log was found. */
+static GelDlogIC *
+ic_build (GelDlogIC *ic, gboolean give_up)
+{
+	IcRow *rows;
+	int nrows, want, cu, cv, i;
+	int *iu, *eu, *iv, *ev;
+	long tries;
+	mpz_srcptr g = ic->g;
+	mpz_srcptr p = ic->p;
+	mpz_srcptr l = ic->l;
+	mpz_t k, r, s, gs, u, v, t1, t2, t3, N;
+	gboolean ok = FALSE;
+
+	ic->logs = g_new (mpz_t, ic->np);
+	for (i = 0; i < ic->np; i++)
+		mpz_init (ic->logs[i]);
+	ic->known = g_new0 (gboolean, ic->np);
+
+	iu = g_new (int, ic->np);
+	eu = g_new (int, ic->np);
+	iv = g_new (int, ic->np);
+	ev = g_new (int, ic->np);
+	mpz_inits (k, r, s, gs, u, v, t1, t2, t3, N, NULL);
+	mpz_sub_ui (N, p, 1);
+
+	/* relations g^k = u/v, some extra to make up for dependencies */
+	want = ic->np + ic->np/10 + 10;
+	rows = g_new (IcRow, want);
+	nrows = 0;
+	dlog_random (k, N);
+	mpz_powm (r, g, k, p);
+	/* step by a random power of g, stepping by g itself would give
+	 * relations that mostly differ by the factors of g */
+	dlog_random (s, N);
+	mpz_powm (gs, g, s, p);
+	for (tries = 0; nrows < want; tries++) {
+		if (give_up &&
+		    (tries >= DLOG_MAX_TRIES ||
+		     tries >= (long)IC_GIVE_UP_TRIES * (nrows + 1)))
+			break;
+
+		mulmod (r, gs, p);
+		addmod (k, s, N);
+
+		if G_UNLIKELY (dlog_interrupted ())
+			goto done;
+
+		ratrecon (u, v, r, p, ic->bound, t1, t2, t3);
+		if ((cu = ic_factor (ic, u, iu, eu)) < 0 ||
+		    (cv = ic_factor (ic, v, iv, ev)) < 0)
+			continue;
+
+		/* k = log u - log v (mod l), the sign does not matter as
+		 * log(-1) = (p-1)/2 = 0 mod l */
+		{
+			IcRow *row = &rows[nrows++];
+			int a = 0, b = 0;
+			row->col = g_new (int, cu + cv);
+			row->val = g_new (mpz_t, cu + cv);
+			row->len = 0;
+			while (a < cu || b < cv) {
+				int c, e;
+				if (b >= cv || (a < cu && iu[a] < iv[b])) {
+					c = iu[a];
+					e = eu[a++];
+				} else if (a >= cu || iv[b] < iu[a]) {
+					c = iv[b];
+					e = -ev[b++];
+				} else {
+					c = iu[a];
+					e = eu[a++] - ev[b++];
+				}
+				if (e == 0)
+					continue;
+				row->col[row->len] = c;
+				mpz_init_set_si (row->val[row->len], e);
+				mpz_mod (row->val[row->len], row->val[row->len], l);
+				row->len++;
+			}
+			mpz_init (row->rhs);
+			mpz_mod (row->rhs, k, l);
+		}
+	}
+
+	ic->complete = (nrows >= want);
+	ok = ic_solve (ic, rows, nrows);
+
+done:
+	for (i = 0; i < nrows; i++)
+		ic_row_free (&rows[i]);
+	g_free (rows);
+	g_free (iu);
+	g_free (eu);
+	g_free (iv);
+	g_free (ev);
+	mpz_clears (k, r, s, gs, u, v, t1, t2, t3, N, NULL);
+
+	if ( ! ok) {
+		gel_dlog_ic_free (ic);
+		return NULL;
+	}
+	return ic;
+}
+
+GelDlogIC *
+gel_dlog_ic_new (mpz_srcptr g, mpz_srcptr p, mpz_srcptr l)
+{
+	GelDlogIC *ic;
+	unsigned long B, q;
+	int j;
+
+	ic = ic_alloc (g, p, l);
+
+	/* the factor base, primes up to B */
+	B = ic_smoothness_bound (p);
+	ic->primes = g_new (unsigned long, B);
+	ic->np = 0;
+	for (q = 2; q <= B; q++) {
+		for (j = 0; j < ic->np && ic->primes[j]*ic->primes[j] <= q; j++)
+			if (q % ic->primes[j] == 0)
+				break;
+		if (j >= ic->np || ic->primes[j]*ic->primes[j] > q)
+			ic->primes[ic->np++] = q;
+	}
+
+	return ic_build (ic, FALSE /* give_up */);
+}
+
+static int
+ulong_compare (gconstpointer a, gconstpointer b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+	return (x > y) - (x < y);
+}
+
+GelDlogIC *
+gel_dlog_ic_new_with_base (mpz_srcptr g, mpz_srcptr p, mpz_srcptr l,
+			   mpz_t *base, int len)
+{
+	GelDlogIC *ic;
+	int i, j;
+
+	ic = ic_alloc (g, p, l);
+
+	/* the usable elements, sorted and without repeats, anything
+	 * above sqrt(p) never shows up in a relation */
+	ic->primes = g_new (unsigned long, MAX (len, 1));
+	ic->np = 0;
+	for (i = 0; i < len; i++) {
+		if (mpz_cmp_ui (base[i], 2) >= 0 &&
+		    mpz_cmp (base[i], ic->bound) <= 0 &&
+		    mpz_fits_ulong_p (base[i]))
+			ic->primes[ic->np++] = mpz_get_ui (base[i]);
+	}
+	qsort (ic->primes, ic->np, sizeof (unsigned long), ulong_compare);
+	for (i = 0, j = 0; i < ic->np; i++) {
+		if (j == 0 || ic->primes[j-1] != ic->primes[i])
+			ic->primes[j++] = ic->primes[i];
+	}
+	ic->np = j;
+
+	ic->nbase = len;
+	ic->col = g_new (int, MAX (len, 1));
+	for (i = 0; i < len; i++) {
+		unsigned long *c = NULL;
+		if (mpz_fits_ulong_p (base[i])) {
+			unsigned long q = mpz_get_ui (base[i]);
+			c = bsearch (&q, ic->primes, ic->np,
+				     sizeof (unsigned long), ulong_compare);
+		}
+		ic->col[i] = c != NULL ? (int)(c - ic->primes) : -1;
+	}
+
+	if (ic->np == 0) {
+		gel_dlog_ic_free (ic);
+		return NULL;
+	}
+
+	return ic_build (ic, TRUE /* give_up */);
+}
+
+gboolean
+gel_dlog_ic_base_log (GelDlogIC *ic, mpz_ptr x, int i, mpz_srcptr h)
+{
+	g_return_val_if_fail (ic->col != NULL && i >= 0 && i < ic->nbase,
+			      FALSE);
+
+	if (ic->col[i] >= 0 && ic->known[ic->col[i]]) {
+		mpz_set (x, ic->logs[ic->col[i]]);
+		return TRUE;
+	}
+
+	/* the base did well enough to find the rest from it */
+	if (ic->complete)
+		return gel_dlog_ic_log (ic, x, h);
+
+	return FALSE;
+}
+
+gboolean
+gel_dlog_ic_log (GelDlogIC *ic, mpz_ptr x, mpz_srcptr h)
+{
+	int *iu, *eu, *iv, *ev;
+	int cu, cv, i;
+	long tries;
+	mpz_t k, r, s, gs, u, v, t1, t2, t3, N;
+	gboolean found = FALSE;
+
+	iu = g_new (int, ic->np);
+	eu = g_new (int, ic->np);
+	iv = g_new (int, ic->np);
+	ev = g_new (int, ic->np);
+	mpz_inits (k, r, s, gs, u, v, t1, t2, t3, N, NULL);
+	mpz_sub_ui (N, ic->p, 1);
+
+	/* h g^k = u/v with u, v smooth over the known logs */
+	dlog_random (k, N);
+	mpz_powm (r, ic->g, k, ic->p);
+	mulmod (r, h, ic->p);
+	dlog_random (s, N);
+	mpz_powm (gs, ic->g, s, ic->p);
+	for (tries = 0; tries < DLOG_MAX_TRIES; tries++) {
+		if G_UNLIKELY (dlog_interrupted ())
+			break;
+
+		if (tries > 0) {
+			mulmod (r, gs, ic->p);
+			addmod (k, s, N);
+		}
+		ratrecon (u, v, r, ic->p, ic->bound, t1, t2, t3);
+
+		if ((cu = ic_factor (ic, u, iu, eu)) < 0 ||
+		    (cv = ic_factor (ic, v, iv, ev)) < 0)
+			continue;
+		for (i = 0; i < cu && ic->known[iu[i]]; i++)
+			;
+		if (i < cu)
+			continue;
+		for (i = 0; i < cv && ic->known[iv[i]]; i++)
+			;
+		if (i < cv)
+			continue;
+
+		mpz_neg (x, k);
+		for (i = 0; i < cu; i++)
+			mpz_addmul_ui (x, ic->logs[iu[i]], eu[i]);
+		for (i = 0; i < cv; i++)
+			mpz_submul_ui (x, ic->logs[iv[i]], ev[i]);
+		mpz_mod (x, x, ic->l);
+		found = TRUE;
+		break;
+	}
+
+	g_free (iu);
+	g_free (eu);
+	g_free (iv);
+	g_free (ev);
+	mpz_clears (k, r, s, gs, u, v, t1, t2, t3, N, NULL);
+	return found;
+}
+
+void
+gel_dlog_ic_free (GelDlogIC *ic)
+{
+	int i;
+
+	if (ic == NULL)
+		return;
+	if (ic->logs != NULL) {
+		for (i = 0; i < ic->np; i++)
+			mpz_clear (ic->logs[i]);
+	}
+	g_free (ic->logs);
+	g_free (ic->known);
+	g_free (ic->primes);
+	g_free (ic->col);
+	mpz_clears (ic->g, ic->p, ic->l, ic->bound, NULL);
+	g_free (ic);
+}
+
+/* The digits of log_g h mod l^f one at a time, each is a logarithm in
+ * the subgroup of order l generated by gl = g^(ord/l) */
+static gboolean
+dlog_prime_power (mpz_ptr x, mpz_srcptr h, mpz_srcptr g, mpz_srcptr gl,
+		  mpz_srcptr ord, mpz_srcptr l, unsigned long f,
+		  mpz_srcptr p)
+{
+	mpz_t y, e, d, lj, ginv;
+	unsigned long j;
+	gboolean ret = TRUE;
+
+	mpz_inits (y, e, d, ginv, NULL);
+	mpz_init_set_ui (lj, 1);
+	mpz_invert (ginv, g, p);
+	mpz_set_ui (x, 0);
+
+	for (j = 0; j < f; j++) {
+		/* y = (h g^-x)^(ord/l^(j+1)) has order l */
+		mpz_powm (y, ginv, x, p);
+		mulmod (y, h, p);
+		mpz_mul (e, lj, l);
+		mpz_divexact (e, ord, e);
+		mpz_powm (y, y, e, p);
+
+		if (mpz_sizeinbase (l, 2) <= DLOG_BSGS_BITS)
+			ret = gel_dlog_bsgs (d, y, gl, l, p);
+		else
+			ret = gel_dlog_rho (d, y, gl, l, p);
+		if ( ! ret)
+			break;
+
+		mpz_addmul (x, d, lj);
+		mpz_mul (lj, lj, l);
+	}
+
+	mpz_clears (y, e, d, lj, ginv, NULL);
+	return ret;
+}
+
+/* gel_dlog and gel_dlog_table, for the latter the index calculus is
+ * done over h itself as the factor base */
+static gboolean
+dlog_many (mpz_t *x, mpz_t *h, int len, mpz_srcptr g, mpz_srcptr p,
+	   GArray *fact, gboolean table)
+{
+	mpz_t ord, gl, t, xl, pe, m;
+	guint fi;
+	int i;
+	gboolean ret = FALSE;
+
+	mpz_inits (ord, gl, t, xl, pe, NULL);
+	mpz_init_set_ui (m, 1);
+
+	for (i = 0; i < len; i++) {
+		mpz_set_ui (x[i], 0);
+		mpz_mod (t, h[i], p);
+		if (mpz_sgn (t) == 0)
+			goto done;
+	}
+
+	/* the order of g */
+	mpz_sub_ui (ord, p, 1);
+	for (fi = 0; fi < fact->len; fi++) {
+		mpz_srcptr l = g_array_index (fact, GelFactor, fi).num;
+		if (mpz_cmp_ui (l, 1) <= 0)
+			continue;
+		while (mpz_divisible_p (ord, l)) {
+			mpz_divexact (t, ord, l);
+			mpz_powm (gl, g, t, p);
+			if (mpz_cmp_ui (gl, 1) != 0)
+				break;
+			mpz_set (ord, t);
+		}
+	}
+
+	for (fi = 0; fi < fact->len; fi++) {
+		mpz_srcptr l = g_array_index (fact, GelFactor, fi).num;
+		unsigned long f = 0;
+
+		if (mpz_cmp_ui (l, 1) <= 0)
+			continue;
+		mpz_set (t, ord);
+		mpz_set_ui (pe, 1);
+		while (mpz_divisible_p (t, l)) {
+			mpz_divexact (t, t, l);
+			mpz_mul (pe, pe, l);
+			f++;
+		}
+		if (f == 0)
+			continue;
+
+		mpz_divexact (t, ord, l);
+		mpz_powm (gl, g, t, p);
+
+		if (f == 1 && mpz_sizeinbase (l, 2) > DLOG_RHO_BITS) {
+			GelDlogIC *ic = NULL;
+			GelDlogIC *icb = NULL;
+			if (table)
+				icb = gel_dlog_ic_new_with_base (g, p, l,
+								 h, len);
+			else if ((ic = gel_dlog_ic_new (g, p, l)) == NULL)
+				goto done;
+			for (i = 0; i < len; i++) {
+				gboolean got = FALSE;
+				if (icb != NULL)
+					got = gel_dlog_ic_base_log (icb, xl,
+								    i, h[i]);
+				/* not determined by the relations over the
+				 * given base, use the usual one */
+				if ( ! got) {
+					if (ic == NULL)
+						ic = gel_dlog_ic_new (g, p, l);
+					got = (ic != NULL &&
+					       gel_dlog_ic_log (ic, xl, h[i]));
+				}
+				if ( ! got) {
+					gel_dlog_ic_free (ic);
+					gel_dlog_ic_free (icb);
+					goto done;
+				}
+				/* x[i] += m ((xl - x[i]) m^-1 mod pe) */
+				mpz_invert (t, m, pe);
+				mpz_sub (xl, xl, x[i]);
+				mpz_mul (xl, xl, t);
+				mpz_mod (xl, xl, pe);
+				mpz_addmul (x[i], xl, m);
+			}
+			gel_dlog_ic_free (ic);
+			gel_dlog_ic_free (icb);
+		} else {
+			for (i = 0; i < len; i++) {
+				if ( ! dlog_prime_power (xl, h[i], g, gl, ord,
+							 l, f, p))
+					goto done;
+				mpz_invert (t, m, pe);
+				mpz_sub (xl, xl, x[i]);
+				mpz_mul (xl, xl, t);
+				mpz_mod (xl, xl, pe);
+				mpz_addmul (x[i], xl, m);
+			}
+		}
+		mpz_mul (m, m, pe);
+	}
+
+	/* the logarithm may not exist, and the index calculus is only
+	 * right with high probability */
+	for (i = 0; i < len; i++) {
+		mpz_powm (t, g, x[i], p);
+		mpz_mod (xl, h[i], p);
+		if (mpz_cmp (t, xl) != 0)
+			goto done;
+	}
+	ret = TRUE;
+
+done:
+	mpz_clears (ord, gl, t, xl, pe, m, NULL);
+	return ret;
+}
+
+gboolean
+gel_dlog (mpz_t *x, mpz_t *h, int len, mpz_srcptr g, mpz_srcptr p,
+	  GArray *fact)
+{
+	return dlog_many (x, h, len, g, p, fact, FALSE /* table */);
+}
+
+gboolean
+gel_dlog_table (mpz_t *x, mpz_t *base, int len, mpz_srcptr g,
+		mpz_srcptr p, GArray *fact)
+{
+	return dlog_many (x, base, len, g, p, fact, TRUE /* table */);
+}
+
+gboolean
+gel_dlog_with_table (mpz_ptr x, mpz_srcptr h, mpz_srcptr g, mpz_srcptr p,
+		     mpz_t *base, mpz_t *logs, int len)
+{
+	mpz_t N, k, r, s, gs, u, v, bound, logm1, t1, t2, t3;
+	gboolean found = FALSE;
+	gboolean have_logm1;
+	long tries;
+	int i;
+
+	mpz_inits (N, k, r, s, gs, u, v, bound, logm1, t1, t2, t3, NULL);
+	mpz_sub_ui (N, p, 1);
+	mpz_sqrt (bound, p);
+
+	/* log(-1) = (p-1)/2 if g is a generator */
+	mpz_fdiv_q_2exp (logm1, N, 1);
+	mpz_powm (t1, g, logm1, p);
+	have_logm1 = (mpz_cmp (t1, N) == 0);
+
+	dlog_random (k, N);
+	mpz_powm (r, g, k, p);
+	mulmod (r, h, p);
+	dlog_random (s, N);
+	mpz_powm (gs, g, s, p);
+	for (tries = 0; tries < DLOG_MAX_TRIES; tries++) {
+		if G_UNLIKELY (dlog_interrupted ())
+			break;
+
+		if (tries > 0) {
+			mulmod (r, gs, p);
+			addmod (k, s, N);
+		}
+		ratrecon (u, v, r, p, bound, t1, t2, t3);
+
+		/* x = log u - log v - k */
+		mpz_neg (x, k);
+		if (mpz_sgn (u) < 0) {
+			if ( ! have_logm1)
+				continue;
+			mpz_add (x, x, logm1);
+			mpz_neg (u, u);
+		}
+		for (i = 0; i < len && mpz_cmp_ui (u, 1) > 0; i++) {
+			if (mpz_cmp_ui (base[i], 1) <= 0)
+				continue;
+			while (mpz_divisible_p (u, base[i])) {
+				mpz_divexact (u, u, base[i]);
+				mpz_add (x, x, logs[i]);
+			}
+		}
+		if (mpz_cmp_ui (u, 1) != 0)
+			continue;
+		for (i = 0; i < len && mpz_cmp_ui (v, 1) > 0; i++) {
+			if (mpz_cmp_ui (base[i], 1) <= 0)
+				continue;
+			while (mpz_divisible_p (v, base[i])) {
+				mpz_divexact (v, v, base[i]);
+				mpz_sub (x, x, logs[i]);
+			}
+		}
+		if (mpz_cmp_ui (v, 1) != 0)
+			continue;
+
+		mpz_mod (x, x, N);
+		found = TRUE;
+		break;
+	}
+
+	mpz_clears (N, k, r, s, gs, u, v, bound, logm1, t1, t2, t3, NULL);
+	return found;
+}
@@ -0,0 +1,116 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DLOG_H_
+#define _DLOG_H_
+
+#include <glib.h>
+#include "mpzextra.h"
+
+/* Discrete logarithms in (Z/pZ)^* for a prime p.  gel_dlog reduces to
+ * subgroups of prime order by Silver-Pohlig-Hellman, and solves those
+ * by baby step giant step if small, by index calculus if large, and by
+ * Pollard rho when index calculus does not apply.  Everything can be
+ * interrupted by gel_interrupted, in which case FALSE is returned. */
+
+/* x = log_g h where g has order n, by baby step giant step with a hash
+ * table of about sqrt(n) entries.  FALSE if h is not a power of g. */
+gboolean	gel_dlog_bsgs		(mpz_ptr x,
+					 mpz_srcptr h,
+					 mpz_srcptr g,
+					 mpz_srcptr n,
+					 mpz_srcptr p);
+
+/* x = log_g h where g has prime order n, by Pollard rho with an r-adding
+ * walk and Brent's cycle finding.  FALSE if not found (h is likely not
+ * a power of g). */
+gboolean	gel_dlog_rho		(mpz_ptr x,
+					 mpz_srcptr h,
+					 mpz_srcptr g,
+					 mpz_srcptr n,
+					 mpz_srcptr p);
+
+/* Index calculus for logarithms base g modulo l, where l is an odd
+ * prime dividing p-1 and the order of g.  The logarithms of the small
+ * primes are found once from relations g^k = u/v (mod p) with u and v
+ * around sqrt(p) and both smooth, solved by sparse elimination modulo
+ * l, and then any number of logarithms can be taken. */
+typedef struct _GelDlogIC GelDlogIC;
+
+/* NULL if interrupted or the relations do not give the factor base */
+GelDlogIC *	gel_dlog_ic_new		(mpz_srcptr g,
+					 mpz_srcptr p,
+					 mpz_srcptr l);
+/* The same over a given factor base (only elements from 2 to sqrt(p)
+ * are used), which need not be all the primes up to some bound.  The
+ * search for relations is given up after a while, and then only some
+ * of the logs may be known.  NULL if none are. */
+GelDlogIC *	gel_dlog_ic_new_with_base (mpz_srcptr g,
+					 mpz_srcptr p,
+					 mpz_srcptr l,
+					 mpz_t *base,
+					 int len);
+/* x = log_g base[i] mod l (h is base[i]) as found from the relations,
+ * or like gel_dlog_ic_log if all the relations wanted were found.
+ * FALSE if neither works. */
+gboolean	gel_dlog_ic_base_log	(GelDlogIC *ic,
+					 mpz_ptr x,
+					 int i,
+					 mpz_srcptr h);
+/* x = log_g h mod l */
+gboolean	gel_dlog_ic_log		(GelDlogIC *ic,
+					 mpz_ptr x,
+					 mpz_srcptr h);
+void		gel_dlog_ic_free	(GelDlogIC *ic);
+
+/* x[i] = log_g h[i] for 0 <= i < len modulo the order of g, where fact
+ * is the factorization of p-1 (as from mympz_pollard_rho_factorize, the
+ * factors 1 and -1 are ignored).  The index calculus precomputation is
+ * shared by all the h[i].  FALSE if some logarithm does not exist. */
+gboolean	gel_dlog		(mpz_t *x,
+					 mpz_t *h,
+					 int len,
+					 mpz_srcptr g,
+					 mpz_srcptr p,
+					 GArray *fact);
+
+/* x[i] = log_g base[i] as gel_dlog, but with the index calculus run
+ * over base itself as the factor base, the linear algebra then gives all
+ * the logs at once.  This is the table for gel_dlog_with_table. */
+gboolean	gel_dlog_table		(mpz_t *x,
+					 mpz_t *base,
+					 int len,
+					 mpz_srcptr g,
+					 mpz_srcptr p,
+					 GArray *fact);
+
+/* x = log_g h using a table of logarithms logs[i] = log_g base[i] (mod
+ * p-1) by looking for k with h g^k = u/v (mod p) where u and v factor
+ * over the base.  FALSE if not found after many tries. */
+gboolean	gel_dlog_with_table	(mpz_ptr x,
+					 mpz_srcptr h,
+					 mpz_srcptr g,
+					 mpz_srcptr p,
+					 mpz_t *base,
+					 mpz_t *logs,
+					 int len);
+
+#endif /* _DLOG_H_ */
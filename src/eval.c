@@ -23,6 +23,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <glib.h>
 #include "calc.h"
 #include "mpwrap.h"
@@ -32,8 +34,10 @@
 #include "matrix.h"
 #include "matrixw.h"
 #include "matop.h"
+#include "polynomial.h"
 #include "compil.h"
 #include "utype.h"
+#include "geltrace.h"
 
 #ifdef EVAL_DEBUG
 #define EDEBUG(x) puts(x)
@@ -41,9 +45,12 @@
 #define EDEBUG(x) ;
 #endif
 
-GelETree *gel_free_trees = NULL;
+/* per thread, builtins may be run in worker threads */
+GEL_THREAD_LOCAL GelETree *gel_free_trees = NULL;
 static GelEvalStack *free_stack = NULL;
 
+GEL_THREAD_LOCAL GelEvalStats gel_eval_stats = { 0 };
+
 #ifndef MEM_DEBUG_FRIENDLY
 static GelEvalLoop *free_evl = NULL;
 static GelEvalFor *free_evf = NULL;
@@ -64,12 +71,15 @@ ge_add_stack_array(GelCtx *ctx)
 	GelEvalStack *newstack;
 #ifdef MEM_DEBUG_FRIENDLY
 	newstack = g_new0 (GelEvalStack, 1);
+	gel_eval_stats.stack_chunks++;
 #else
 	if (free_stack == NULL) {
 		newstack = g_new (GelEvalStack, 1);
+		gel_eval_stats.stack_chunks++;
 	} else {
 		newstack = free_stack;
 		free_stack = free_stack->next;
+		gel_eval_stats.stack_chunks_reused++;
 	}
 #endif
 	
@@ -531,6 +541,29 @@ gel_makenum_use_from (GelETree *n, mpw_t num)
 	memcpy (n->val.value, num, sizeof (struct _mpw_t));
 }
 
+/* uses up coefs (from g_new), which is trimmed */
+GelETree *
+gel_makenum_polynomial (mpw_t *coefs, int len)
+{
+	GelETree *n;
+	int l = gel_poly_trim_len (coefs, len);
+	int i;
+
+	for (i = l; i < len; i++)
+		mpw_clear (coefs[i]);
+	if (l == 0) {
+		g_free (coefs);
+		coefs = NULL;
+	}
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_POLYNOMIAL_NODE;
+	n->poly.len = l;
+	n->poly.coefs = coefs;
+	n->any.next = NULL;
+	return n;
+}
+
 static inline void
 freetree_full (GelETree *n, gboolean freeargs, gboolean kill)
 {
@@ -544,6 +577,9 @@ freetree_full (GelETree *n, gboolean freeargs, gboolean kill)
 		if(n->mat.matrix)
 			gel_matrixw_free(n->mat.matrix);
 		break;
+	case GEL_POLYNOMIAL_NODE:
+		gel_poly_free (n->poly.coefs, n->poly.len);
+		break;
 	case GEL_OPERATOR_NODE:
 		if(freeargs) {
 			while(n->op.args) {
@@ -611,6 +647,8 @@ freetree_full (GelETree *n, gboolean freeargs, gboolean kill)
 		}
 		*/
 
+		gel_eval_stats.nodes_freed++;
+
 #ifdef MEM_DEBUG_FRIENDLY
 		if (most_recent_ctx != NULL &&
 		    most_recent_ctx->current == n) {
@@ -707,6 +745,12 @@ copynode_to(GelETree *empty, GelETree *o)
 		empty->mat.matrix = gel_matrixw_copy(o->mat.matrix);
 		empty->mat.quoted = o->mat.quoted;
 		break;
+	case GEL_POLYNOMIAL_NODE:
+		empty->type = GEL_POLYNOMIAL_NODE;
+		empty->any.next = o->any.next;
+		empty->poly.len = o->poly.len;
+		empty->poly.coefs = gel_poly_copy (o->poly.coefs, o->poly.len);
+		break;
 	case GEL_OPERATOR_NODE:
 		empty->type = GEL_OPERATOR_NODE;
 		empty->any.next = o->any.next;
@@ -817,6 +861,8 @@ replacenode(GelETree *to, GelETree *from)
 	freetree_full(to,TRUE,FALSE);
 	memcpy(to,from,sizeof(GelETree));
 
+	gel_eval_stats.nodes_freed++;
+
 #ifdef MEM_DEBUG_FRIENDLY
 
 # ifdef EVAL_DEBUG
@@ -1872,6 +1918,7 @@ matrix_scalar_matrix_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 {
 	int i,j;
 	GelMatrixW *m;
+	GelMatrixW *dm;
 	GelETree *node;
 	int order = 0;
 	if(l->type == GEL_MATRIX_NODE) {
@@ -1883,6 +1930,20 @@ matrix_scalar_matrix_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 		node = l;
 	}
 
+	/* float matrices at double precision are done with doubles */
+	if (ctx->modulo == NULL &&
+	    node->type == GEL_VALUE_NODE &&
+	    (dm = gel_value_matrix_scalar_double (m, node->val.value,
+						  order == 1,
+						  n->op.oper)) != NULL) {
+		gel_matrixw_free (m);
+		if (order == 0)
+			l->mat.matrix = dm;
+		else
+			r->mat.matrix = dm;
+		goto done;
+	}
+
 	gel_matrixw_make_private(m, TRUE /* kill_type_caches */);
 
 	for(j=0;j<gel_matrixw_height(m);j++) {
@@ -1905,6 +1966,7 @@ matrix_scalar_matrix_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 				gel_freetree (t);
 		}
 	}
+done:
 	n->op.args = NULL;
 
 	if(l->type == GEL_MATRIX_NODE) {
@@ -2025,7 +2087,7 @@ static gboolean
 pure_matrix_eltbyelt_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 {
 	int i,j;
-	GelMatrixW *m1,*m2;
+	GelMatrixW *m1,*m2,*dm;
 	m1 = l->mat.matrix;
 	m2 = r->mat.matrix;
 	if G_UNLIKELY ((gel_matrixw_width(m1) != gel_matrixw_width(m2)) ||
@@ -2040,6 +2102,16 @@ pure_matrix_eltbyelt_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 		return TRUE;
 	}
 	l->mat.quoted = l->mat.quoted || r->mat.quoted;
+
+	/* float matrices at double precision are done with doubles */
+	if (ctx->modulo == NULL &&
+	    (dm = gel_value_matrix_eltbyelt_double (m1, m2,
+						    n->op.oper)) != NULL) {
+		gel_matrixw_free (m1);
+		l->mat.matrix = dm;
+		goto done;
+	}
+
 	gel_matrixw_make_private(m1, TRUE /* kill_type_caches */);
 	for(j=0;j<gel_matrixw_height(m1);j++) {
 		for(i=0;i<gel_matrixw_width(m1);i++) {
@@ -2053,6 +2125,7 @@ pure_matrix_eltbyelt_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 				freetree_full (t, TRUE, TRUE);
 		}
 	}
+done:
 	/*remove l from arglist*/
 	n->op.args = n->op.args->any.next;
 	/*replace n with l*/
@@ -2221,6 +2294,20 @@ matrix_pow_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 		return TRUE;
 	}
 
+	/* integers mod m are powered without going through mpw */
+	if (ctx->modulo != NULL &&
+	    gel_is_matrix_value_only_integer (m)) {
+		res = gel_matrixw_new ();
+		gel_value_matrix_pow_mod (res, m, power, ctx->modulo);
+		if (free_m)
+			gel_matrixw_free (m);
+		freetree_full (n, TRUE, FALSE);
+		n->type = GEL_MATRIX_NODE;
+		n->mat.matrix = res;
+		n->mat.quoted = quote;
+		return TRUE;
+	}
+
 	while(power>0) {
 		/*if odd*/
 		if(power & 0x1) {
@@ -2404,20 +2491,172 @@ value_matrix_div_op(GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 	return TRUE;
 }
 
+static void
+mod_poly (GelETree *n, mpw_ptr mod)
+{
+	int i, len;
+
+	for (i = 0; i < n->poly.len; i++) {
+		if ( ! gel_mod_integer_rational (n->poly.coefs[i], mod))
+			gel_error_num = GEL_NO_ERROR;
+	}
+	len = gel_poly_trim_len (n->poly.coefs, n->poly.len);
+	for (i = len; i < n->poly.len; i++)
+		mpw_clear (n->poly.coefs[i]);
+	if (len == 0) {
+		g_free (n->poly.coefs);
+		n->poly.coefs = NULL;
+	}
+	n->poly.len = len;
+}
+
+/* The coefficients of a polynomial, or of a number as a constant
+ * polynomial */
+static mpw_t *
+poly_coefs (GelETree *n, int *len)
+{
+	if (n->type == GEL_POLYNOMIAL_NODE) {
+		*len = n->poly.len;
+		return n->poly.coefs;
+	} else {
+		*len = mpw_zero_p (n->val.value) ? 0 : 1;
+		return &n->val.value;
+	}
+}
+
+static void
+poly_set_result (GelCtx *ctx, GelETree *n, mpw_t *coefs, int len)
+{
+	freetree_full (n, TRUE, FALSE);
+	n->type = GEL_POLYNOMIAL_NODE;
+	n->poly.len = len;
+	n->poly.coefs = coefs;
+	if (ctx->modulo != NULL)
+		mod_poly (n, ctx->modulo);
+}
+
 /*add, sub */
 static gboolean
 polynomial_add_sub_op (GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
 {
-	if (l->type == GEL_VALUE_NODE) {
-		/* r->type == GEL_POLYNOMIAL_NODE */
-		/* FIXME implement */
-	} else if (r->type == GEL_VALUE_NODE) {
-		/* l->type == GEL_POLYNOMIAL_NODE */
-		/* FIXME implement */
-	} else {
-		/* FIXME implement */
+	mpw_t *a, *b, *res;
+	int la, lb, len;
+
+	a = poly_coefs (l, &la);
+	b = poly_coefs (r, &lb);
+
+	if (n->op.oper == GEL_E_PLUS ||
+	    n->op.oper == GEL_E_ELTPLUS)
+		res = gel_poly_add (a, la, b, lb, &len);
+	else
+		res = gel_poly_sub (a, la, b, lb, &len);
+
+	poly_set_result (ctx, n, res, len);
+	return TRUE;
+}
+
+static gboolean
+polynomial_mul_op (GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
+{
+	mpw_t *a, *b, *res;
+	int la, lb, len;
+
+	a = poly_coefs (l, &la);
+	b = poly_coefs (r, &lb);
+	res = gel_poly_mul (a, la, b, lb, &len);
+
+	poly_set_result (ctx, n, res, len);
+	return TRUE;
+}
+
+/* the quotient or the remainder of the division */
+static gboolean
+polynomial_div_mod_op (GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
+{
+	mpw_t *a, *b, *res;
+	int la, lb, len;
+	gboolean ret;
+
+	a = poly_coefs (l, &la);
+	b = poly_coefs (r, &lb);
+
+	if (n->op.oper == GEL_E_MOD)
+		ret = gel_poly_divrem (a, la, b, lb, NULL, NULL, &res, &len);
+	else
+		ret = gel_poly_divrem (a, la, b, lb, &res, &len, NULL, NULL);
+	if G_UNLIKELY ( ! ret) {
+		gel_errorout (_("Division by zero!"));
+		return TRUE;
+	}
+
+	poly_set_result (ctx, n, res, len);
+	return TRUE;
+}
+
+static gboolean
+polynomial_neg_op (GelCtx *ctx, GelETree *n, GelETree *l)
+{
+	mpw_t *res;
+	int i, len;
+
+	len = l->poly.len;
+	res = gel_poly_copy (l->poly.coefs, len);
+	for (i = 0; i < len; i++)
+		mpw_neg (res[i], res[i]);
+
+	poly_set_result (ctx, n, res, len);
+	return TRUE;
+}
+
+static gboolean
+polynomial_pow_op (GelCtx *ctx, GelETree *n, GelETree *l, GelETree *r)
+{
+	mpw_t *res;
+	long power;
+	int len;
+
+	if G_UNLIKELY (mpw_is_complex (r->val.value) ||
+		       ! mpw_is_integer (r->val.value) ||
+		       mpw_sgn (r->val.value) < 0) {
+		gel_errorout (_("Powers are defined on (polynomial)^(nonnegative integer) only"));
+		return TRUE;
+	}
+
+	gel_error_num = GEL_NO_ERROR;
+	power = mpw_get_long (r->val.value);
+	if G_UNLIKELY (gel_error_num) {
+		gel_error_num = GEL_NO_ERROR;
+		gel_errorout (_("Exponent too large"));
+		return TRUE;
+	}
+
+	res = gel_poly_pow (l->poly.coefs, l->poly.len, power, &len);
+
+	poly_set_result (ctx, n, res, len);
+	return TRUE;
+}
+
+static gboolean
+eqpoly (GelETree *a, GelETree *b, int *error)
+{
+	mpw_t *ca, *cb;
+	int la, lb, i;
+
+	if G_UNLIKELY (a->type == GEL_BOOL_NODE ||
+		       b->type == GEL_BOOL_NODE) {
+		gel_errorout (_("Cannot compare polynomials and booleans"));
+		*error = TRUE;
+		return FALSE;
 	}
 
+	ca = poly_coefs (a, &la);
+	cb = poly_coefs (b, &lb);
+	if (la != lb)
+		return FALSE;
+	for (i = 0; i < la; i++) {
+		if ( ! mpw_eql (ca[i], cb[i]))
+			return FALSE;
+	}
 	return TRUE;
 }
 
@@ -2461,6 +2700,8 @@ mod_node (GelETree *n, mpw_ptr mod)
 	} else if(n->type == GEL_MATRIX_NODE) {
 		if (n->mat.matrix != NULL)
 			mod_matrix (n->mat.matrix, mod);
+	} else if (n->type == GEL_POLYNOMIAL_NODE) {
+		mod_poly (n, mod);
 	}
 }
 
@@ -3032,6 +3273,8 @@ static const GelOper prim_table[GEL_E_OPER_LAST] = {
 		 {{GO_MATRIX,GO_MATRIX,0},(GelEvalFunc)pure_matrix_mul_op},
 		 {{GO_VALUE|GO_MATRIX,GO_VALUE|GO_MATRIX,0},
 			 (GelEvalFunc)matrix_scalar_matrix_op},
+		 {{GO_VALUE|GO_POLYNOMIAL,GO_VALUE|GO_POLYNOMIAL,0},
+			 (GelEvalFunc)polynomial_mul_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_FUNCTION|GO_IDENTIFIER,0},
 			 (GelEvalFunc)function_bin_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_VALUE|GO_MATRIX,0},
@@ -3060,6 +3303,8 @@ static const GelOper prim_table[GEL_E_OPER_LAST] = {
 		 {{GO_MATRIX,GO_VALUE,0}, (GelEvalFunc)matrix_scalar_matrix_op},
 		 {{GO_VALUE,GO_MATRIX,0}, (GelEvalFunc)value_matrix_div_op},
 		 {{GO_MATRIX,GO_MATRIX,0},(GelEvalFunc)pure_matrix_div_op},
+		 {{GO_VALUE|GO_POLYNOMIAL,GO_VALUE|GO_POLYNOMIAL,0},
+			 (GelEvalFunc)polynomial_div_mod_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_FUNCTION|GO_IDENTIFIER,0},
 			 (GelEvalFunc)function_bin_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_VALUE|GO_MATRIX,0},
@@ -3107,6 +3352,8 @@ static const GelOper prim_table[GEL_E_OPER_LAST] = {
 	/*GEL_E_MOD*/
 	{{
 		 {{GO_VALUE,GO_VALUE,0},(GelEvalFunc)numerical_mod},
+		 {{GO_VALUE|GO_POLYNOMIAL,GO_VALUE|GO_POLYNOMIAL,0},
+			 (GelEvalFunc)polynomial_div_mod_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_FUNCTION|GO_IDENTIFIER,0},
 			 (GelEvalFunc)function_bin_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_VALUE,0},
@@ -3131,6 +3378,7 @@ static const GelOper prim_table[GEL_E_OPER_LAST] = {
 	{{
 		 {{GO_VALUE,0,0},(GelEvalFunc)numerical_neg},
 		 {{GO_MATRIX,0,0},(GelEvalFunc)matrix_absnegfac_op},
+		 {{GO_POLYNOMIAL,0,0},(GelEvalFunc)polynomial_neg_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,0,0},
 			 (GelEvalFunc)function_uni_op},
 		 {{GO_BOOL,0,0},(GelEvalFunc)boolean_neg},
@@ -3139,6 +3387,7 @@ static const GelOper prim_table[GEL_E_OPER_LAST] = {
 	{{
 		 {{GO_VALUE,GO_VALUE,0},(GelEvalFunc)numerical_pow},
 		 {{GO_MATRIX,GO_VALUE,0},(GelEvalFunc)matrix_pow_op},
+		 {{GO_POLYNOMIAL,GO_VALUE,0},(GelEvalFunc)polynomial_pow_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_FUNCTION|GO_IDENTIFIER,0},
 			 (GelEvalFunc)function_bin_op},
 		 {{GO_FUNCTION|GO_IDENTIFIER,GO_VALUE|GO_MATRIX,0},
@@ -3615,7 +3864,7 @@ iter_derefvarop(GelCtx *ctx, GelETree *n)
 	gel_makenum_bool_from(n,x);	\
 	return;
 
-/*returns 0 if all numeric (or bool if bool_ok), 1 if numeric/matrix/null, 2 if contains string, 3 otherwise*/
+/*returns 0 if all numeric (or bool if bool_ok), 1 if numeric/matrix/null, 2 if contains string, 4 if numeric/polynomial, 3 otherwise*/
 static int arglevel (GelETree *r, int cnt, gboolean bool_ok) G_GNUC_PURE;
 static int
 arglevel (GelETree *r, int cnt, gboolean bool_ok)
@@ -3632,6 +3881,9 @@ arglevel (GelETree *r, int cnt, gboolean bool_ok)
 			level = level < 1 ? 1 : level;
 		else if (r->type == GEL_STRING_NODE)
 			level = 2;
+		else if (r->type == GEL_POLYNOMIAL_NODE &&
+			 (level == 0 || level == 4))
+			level = 4;
 		else
 			return 3;
 	}
@@ -3736,6 +3988,31 @@ evalcomp(GelETree *n)
 				return;
 			}
 			break;
+		case 4:
+			switch(oper) {
+			case GEL_E_EQ_CMP:
+				if(!eqpoly(l,r,&err)) {
+					if G_UNLIKELY (err) {
+						gel_error_num = GEL_NO_ERROR;
+						return;
+					}
+					RET_RES(0)
+				}
+				break;
+			case GEL_E_NE_CMP:
+				if(eqpoly(l,r,&err)) {
+					RET_RES(0)
+				} else if G_UNLIKELY (err) {
+					gel_error_num = GEL_NO_ERROR;
+					return;
+				}
+				break;
+			default:
+				gel_errorout (_("Cannot compare polynomials"));
+				gel_error_num = GEL_NO_ERROR;
+				return;
+			}
+			break;
 		case 2:
 			switch(oper) {
 			case GEL_E_EQ_CMP:
@@ -3810,6 +4087,7 @@ ev_free_special_data(GelCtx *ctx, gpointer data, int flag)
 	case GE_FUNCCALL:
 		/*we are crossing a boundary, we need to free a context*/
 		d_popcontext ();
+		GEL_TRACE_LEAVE ();
 		gel_freetree (data);
 		pop_stack_with_whack (ctx);
 		break;
@@ -3989,6 +4267,7 @@ iter_pop_stack(GelCtx *ctx)
 
 				/*pop the context*/
 				d_popcontext ();
+				GEL_TRACE_LEAVE ();
 				
 				GE_POP_STACK(ctx,call,flag);
 
@@ -4711,6 +4990,8 @@ iter_funccallop(GelCtx *ctx, GelETree *n, gboolean *repushed)
 
 		EDEBUG("     USER FUNC PUSHING CONTEXT");
 
+		GEL_TRACE_ENTER (f->id != NULL ? f->id->token : NULL,
+				 FALSE /* builtin */);
 		d_addcontext (f);
 
 		EDEBUG("     USER FUNC TO ADD ARGS TO DICT");
@@ -4733,6 +5014,7 @@ iter_funccallop(GelCtx *ctx, GelETree *n, gboolean *repushed)
 				GelEFunc *rf = d_lookup_global_up1(t->id.id);
 				if G_UNLIKELY (rf == NULL) {
 					d_popcontext ();
+					GEL_TRACE_LEAVE ();
 					gel_errorout (_("Referencing an undefined variable %s!"), t->id.id->token);
 					goto funccall_done_ok;
 				}
@@ -4842,6 +5124,9 @@ iter_funccallop(GelCtx *ctx, GelETree *n, gboolean *repushed)
 			ctx->modulo = NULL;
 		}
 
+		GEL_TRACE_ENTER (f->id != NULL ? f->id->token : NULL,
+				 TRUE /* builtin */);
+
 		if (n->op.nargs > 1) {
 			GelETree **r;
 			GelETree *li;
@@ -4863,6 +5148,9 @@ iter_funccallop(GelCtx *ctx, GelETree *n, gboolean *repushed)
 		} else {
 			ret = (*f->data.func)(ctx,NULL,&exception);
 		}
+
+		GEL_TRACE_LEAVE ();
+
 		if ( ! f->propagate_mod) {
 			g_assert (ctx->modulo == NULL);
 			ctx->modulo = old_modulo;
@@ -4957,6 +5245,7 @@ iter_returnop(GelCtx *ctx, GelETree *n)
 			}
 
 			d_popcontext ();
+			GEL_TRACE_LEAVE ();
 
 			iter_pop_stack(ctx);
 			return;
@@ -5317,6 +5606,7 @@ iter_continue_break_op(GelCtx *ctx, gboolean cont)
 			gel_freetree(data);
 
 			d_popcontext ();
+			GEL_TRACE_LEAVE ();
 
 			/*pop the function call*/
 			GE_POP_STACK(ctx,data,flag);
@@ -5379,6 +5669,7 @@ iter_bailout_op(GelCtx *ctx)
 			gel_freetree(data);
 
 			d_popcontext ();
+			GEL_TRACE_LEAVE ();
 
 			/*pop the function call off the stack*/
 			GE_POP_STACK(ctx,data,flag);
@@ -5534,6 +5825,8 @@ iter_get_matrix_p (GelETree *m)
 			gel_errorout (_("Indexed Lvalue not user function"));
 			return NULL;
 		}
+		if (f->context == 0)
+			d_globals_changed ();
 		D_ENSURE_USER_BODY (f);
 		if(f->data.user->type != GEL_MATRIX_NODE) {
 			GelETree *t;
@@ -5578,6 +5871,8 @@ iter_get_matrix_p (GelETree *m)
 				      f->data.ref->id->token);
 			return NULL;
 		}
+		if (f->data.ref->context == 0)
+			d_globals_changed ();
 		D_ENSURE_USER_BODY (f->data.ref);
 		if(f->data.ref->data.user->type != GEL_MATRIX_NODE) {
 			GelETree *t;
@@ -5604,6 +5899,7 @@ set_parameter (GelToken *token, GelETree *val)
 
 	if (token->built_in_parameter) {
 		ParameterSetFunc setfunc = token->data1;
+		d_globals_changed ();
 		if (setfunc != NULL)
 			return setfunc (val);
 		return gel_makenum_null ();
@@ -5912,6 +6208,8 @@ get_functoset (GelETree *l)
 				else
 					f = d_addfunc (d_makevfunc (l->id.id, gel_makenum_ui (0)));
 			}
+			if (f->context == 0)
+				d_globals_changed ();
 			return f;
 		}
 	} else if(l->op.oper == GEL_E_DEREFERENCE) {
@@ -5941,6 +6239,8 @@ get_functoset (GelETree *l)
 			return NULL;
 		}
 
+		if (f->data.ref->context == 0)
+			d_globals_changed ();
 		return f->data.ref;
 	}
 
@@ -7599,6 +7899,14 @@ iter_eval_etree(GelCtx *ctx)
 		case GEL_VALUE_NODE:
 			EDEBUG(" VALUE NODE");
 
+			if (ctx->modulo != NULL)
+				mod_node (n, ctx->modulo);
+
+			WHACK_SAVEDN_POP;
+			break;
+		case GEL_POLYNOMIAL_NODE:
+			EDEBUG(" POLYNOMIAL NODE");
+
 			if (ctx->modulo != NULL)
 				mod_node (n, ctx->modulo);
 
@@ -8533,8 +8841,17 @@ gel_is_tree_same (GelETree *l, GelETree *r)
 			}
 		}
 		return TRUE;
+	} else if (l->type == GEL_POLYNOMIAL_NODE) {
+		int i;
+		if (l->poly.len != r->poly.len)
+			return FALSE;
+		for (i = 0; i < l->poly.len; i++) {
+			if ( ! mpw_symbolic_eql (l->poly.coefs[i],
+						 r->poly.coefs[i]))
+				return FALSE;
+		}
+		return TRUE;
 	/* FIXME: GEL_SET_NODE */
-	/* FIXME: GEL_POLYNOMIAL_NODE */
 	/* FIXME: GEL_FUNCTION_NODE */
 	/* FIXME: GEL_COMPARISON_NODE */
 	/* FIXME: GEL_USERTYPE_NODE */
@@ -8542,6 +8859,58 @@ gel_is_tree_same (GelETree *l, GelETree *r)
 	return FALSE;
 }
 
+/* A hash of a tree such that trees that are gel_is_tree_same hash the
+ * same, for hashing sets */
+guint
+gel_tree_hash (GelETree *n)
+{
+	guint h;
+	int i, j;
+
+	if (n == NULL)
+		return 0;
+
+	h = n->type;
+	switch (n->type) {
+	case GEL_VALUE_NODE:
+		return h * 1000003 ^ mpw_symbolic_hash (n->val.value);
+	case GEL_OPERATOR_NODE: {
+		GelETree *ali;
+		h = h * 1000003 ^ n->op.oper;
+		for (ali = n->op.args; ali != NULL; ali = ali->any.next)
+			h = h * 1000003 ^ gel_tree_hash (ali);
+		return h;
+	}
+	case GEL_IDENTIFIER_NODE:
+		return h * 1000003 ^ g_direct_hash (n->id.id);
+	case GEL_STRING_NODE:
+		if (n->str.str == NULL)
+			return h;
+		return h * 1000003 ^ g_str_hash (n->str.str);
+	case GEL_BOOL_NODE:
+		return h * 1000003 ^ (n->bool_.bool_ ? 1 : 0);
+	case GEL_MATRIX_NODE:
+		if G_UNLIKELY (n->mat.matrix == NULL)
+			return h;
+		h = h * 1000003 ^ gel_matrixw_width (n->mat.matrix);
+		h = h * 1000003 ^ gel_matrixw_height (n->mat.matrix);
+		for (j = 0; j < gel_matrixw_height (n->mat.matrix); j++) {
+			for (i = 0; i < gel_matrixw_width (n->mat.matrix); i++) {
+				GelETree *t = gel_matrixw_index (n->mat.matrix, i, j);
+				h = h * 1000003 ^ gel_tree_hash (t);
+			}
+		}
+		return h;
+	case GEL_POLYNOMIAL_NODE:
+		for (i = 0; i < n->poly.len; i++)
+			h = h * 1000003 ^ mpw_symbolic_hash (n->poly.coefs[i]);
+		return h;
+	default:
+		/* null, and things that are never the same */
+		return h;
+	}
+}
+
 /* FIXME: this is incomplete and stupid! */
 static gboolean
 oper_reshufle (GelETree *n, int oper)
@@ -8970,7 +9339,16 @@ gel_test_max_nodes_again (void)
 #define GEL_CHUNK_SIZE 4048
 #define ALIGNED_SIZE(t) (sizeof(t) + sizeof (t) % G_MEM_ALIGN)
 
-static long _gel_tree_num = 0;
+/* All the nodes ever allocated, in use or free */
+static gint _gel_tree_num = 0;
+
+/* Nodes freed in one thread and allocated in another would otherwise
+ * pile up on the free list of the thread freeing them, while the other
+ * keeps allocating new chunks.  So threads give their whole free list
+ * back here (gel_spill_free_trees), as one chain so that it need not be
+ * walked, and take a chain from here before allocating new ones. */
+static GSList *spill_trees = NULL;
+static GMutex spill_trees_lock;
 
 void
 _gel_make_free_trees (void)
@@ -8978,7 +9356,8 @@ _gel_make_free_trees (void)
 	guint i;
 	char *p;
 
-	if G_UNLIKELY (_gel_max_nodes_check &&
+	if G_UNLIKELY ( ! gel_in_worker_thread &&
+		       _gel_max_nodes_check &&
 		       gel_calcstate.max_nodes > 0 &&
 		       _gel_tree_num > gel_calcstate.max_nodes) {
 		if (_gel_tree_limit_hook != NULL) {
@@ -8987,6 +9366,19 @@ _gel_make_free_trees (void)
 		_gel_max_nodes_check = FALSE;
 	}
 
+	if (g_atomic_pointer_get (&spill_trees) != NULL) {
+		g_mutex_lock (&spill_trees_lock);
+		if (spill_trees != NULL) {
+			gel_free_trees = spill_trees->data;
+			spill_trees = g_slist_delete_link (spill_trees,
+							   spill_trees);
+		}
+		g_mutex_unlock (&spill_trees_lock);
+
+		if (gel_free_trees != NULL)
+			return;
+	}
+
 	p = g_malloc ((GEL_CHUNK_SIZE / ALIGNED_SIZE (GelETree)) *
 		      ALIGNED_SIZE (GelETree));
 	for (i = 0; i < (GEL_CHUNK_SIZE / ALIGNED_SIZE (GelETree)); i++) {
@@ -8995,8 +9387,21 @@ _gel_make_free_trees (void)
 		t->any.next = gel_free_trees;
 		gel_free_trees = t;
 		p += ALIGNED_SIZE (GelETree);
-		_gel_tree_num ++;
 	}
+	g_atomic_int_add (&_gel_tree_num, i);
+}
+
+void
+gel_spill_free_trees (void)
+{
+	if (gel_free_trees == NULL)
+		return;
+
+	g_mutex_lock (&spill_trees_lock);
+	spill_trees = g_slist_prepend (spill_trees, gel_free_trees);
+	g_mutex_unlock (&spill_trees_lock);
+
+	gel_free_trees = NULL;
 }
 
 static void
@@ -9049,8 +9454,81 @@ _gel_make_free_evfi (void)
 		p += ALIGNED_SIZE (GelEvalForIn);
 	}
 }
+#else /* MEM_DEBUG_FRIENDLY */
+void
+gel_spill_free_trees (void)
+{
+}
 #endif /* ! MEM_DEBUG_FRIENDLY */
 
+void
+gel_eval_stats_add (GelEvalStats *to, MpwStats *mto,
+		    const GelEvalStats *from, const MpwStats *mfrom)
+{
+	to->nodes_allocated += from->nodes_allocated;
+	to->nodes_freed += from->nodes_freed;
+	to->stack_chunks += from->stack_chunks;
+	to->stack_chunks_reused += from->stack_chunks_reused;
+	to->contexts_pushed += from->contexts_pushed;
+	to->matrix_copies += from->matrix_copies;
+
+	mto->real_hits += mfrom->real_hits;
+	mto->real_chunks += mfrom->real_chunks;
+	mto->mpz_hits += mfrom->mpz_hits;
+	mto->mpz_misses += mfrom->mpz_misses;
+	mto->mpq_hits += mfrom->mpq_hits;
+	mto->mpq_misses += mfrom->mpq_misses;
+	mto->mpf_hits += mfrom->mpf_hits;
+	mto->mpf_misses += mfrom->mpf_misses;
+}
+
+#define ADD_STAT(name,value) \
+	if (i < max) {			\
+		names[i] = (name);	\
+		values[i] = (value);	\
+		i++;			\
+	}
+
+int
+gel_eval_stats_collect (const char **names, unsigned long *values, int max)
+{
+	int i = 0;
+	unsigned long free_trees = 0;
+	GelETree *t;
+	struct rusage usage;
+
+	for (t = gel_free_trees; t != NULL; t = t->any.next)
+		free_trees++;
+
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		usage.ru_maxrss = 0;
+
+	ADD_STAT ("NodesAllocated", gel_eval_stats.nodes_allocated);
+	ADD_STAT ("NodesFreed", gel_eval_stats.nodes_freed);
+	ADD_STAT ("FreeTreesSize", free_trees);
+#ifndef MEM_DEBUG_FRIENDLY
+	ADD_STAT ("NodesTotal", (unsigned long)_gel_tree_num);
+#endif
+	ADD_STAT ("RealFreeListHits", mpw_stats.real_hits);
+	ADD_STAT ("RealChunks", mpw_stats.real_chunks);
+	ADD_STAT ("MpzCacheHits", mpw_stats.mpz_hits);
+	ADD_STAT ("MpzCacheMisses", mpw_stats.mpz_misses);
+	ADD_STAT ("MpqCacheHits", mpw_stats.mpq_hits);
+	ADD_STAT ("MpqCacheMisses", mpw_stats.mpq_misses);
+	ADD_STAT ("MpfrCacheHits", mpw_stats.mpf_hits);
+	ADD_STAT ("MpfrCacheMisses", mpw_stats.mpf_misses);
+	ADD_STAT ("StackChunks", gel_eval_stats.stack_chunks);
+	ADD_STAT ("StackChunksReused", gel_eval_stats.stack_chunks_reused);
+	ADD_STAT ("ContextsPushed", gel_eval_stats.contexts_pushed);
+	ADD_STAT ("MatrixCopies", gel_eval_stats.matrix_copies);
+	/* in kilobytes on Linux */
+	ADD_STAT ("PeakRSS", (unsigned long)usage.ru_maxrss);
+
+	return i;
+}
+
+#undef ADD_STAT
+
 #ifdef MEM_DEBUG_FRIENDLY
 # ifdef EVAL_DEBUG
 static GSList *trees_list = NULL;
@@ -69,7 +69,7 @@ GelETree * gel_makenum_identifier (GelToken *id);
 GelETree * gel_makenum_string (const char *str);
 GelETree * gel_makenum_string_use (char *str);
 GelETree * gel_makenum_string_constant (const char *str);
-/* FIXME: implement GelETree * gel_makenum_polynomial (...); */
+GelETree * gel_makenum_polynomial (mpw_t *coefs, int len); /*uses up coefs*/
 GelETree * gel_makeoperator(int oper, GSList **stack);
 
 /*make new node, but don't actually get a new GelETree, just stick it
@@ -129,6 +129,7 @@ void gel_try_to_do_precalc (GelETree *n);
 void gel_simplify (GelETree *n);
 /* is the tree semantically the same? */
 gboolean gel_is_tree_same (GelETree *l, GelETree *r);
+guint gel_tree_hash (GelETree *n);
 
 /* find an identifier */
 gboolean gel_eval_find_identifier (GelETree *n,
@@ -183,7 +184,32 @@ gboolean gel_eqlnodes (GelETree *l, GelETree *r);
 #define GEL_GET_XR(n,r) { (r) = (n)->op.args->any.next; }
 #define GEL_GET_L(n,l) { (l) = (n)->op.args; }
 
-extern GelETree *gel_free_trees;
+extern GEL_THREAD_LOCAL GelETree *gel_free_trees;
+/* give the free nodes of the calling thread to the other threads */
+void gel_spill_free_trees (void);
+
+/* Internal counters, these are reported by EvalStats and --stats */
+typedef struct {
+	unsigned long nodes_allocated;
+	unsigned long nodes_freed;
+	unsigned long stack_chunks;	   /* new chunks in ge_add_stack_array */
+	unsigned long stack_chunks_reused; /* chunks taken off the free list */
+	unsigned long contexts_pushed;	   /* d_addcontext */
+	unsigned long matrix_copies;	   /* copy on write of matrix data */
+} GelEvalStats;
+
+extern GEL_THREAD_LOCAL GelEvalStats gel_eval_stats;
+
+#define GEL_EVAL_STATS_MAX 20
+
+/* Collect all the counters including the mpwrap ones, names are static
+ * strings.  Returns the number of counters filled in, at most max. */
+int gel_eval_stats_collect (const char **names,
+			    unsigned long *values,
+			    int max);
+/* Add the counters from (of a worker thread) to to */
+void gel_eval_stats_add (GelEvalStats *to, MpwStats *mto,
+			 const GelEvalStats *from, const MpwStats *mfrom);
 
 
 #ifdef MEM_DEBUG_FRIENDLY
@@ -195,6 +221,7 @@ void print_live_trees (void);
 void deregister_all_trees (void);
 #  define GEL_GET_NEW_NODE(n) {				\
 	n = g_new0 (GelETree, 1);			\
+	gel_eval_stats.nodes_allocated++;		\
 	printf ("%s NEW NODE %p\n", G_STRLOC, n);	\
 	register_new_tree (n);				\
 }
@@ -202,6 +229,7 @@ void deregister_all_trees (void);
 
 #  define GEL_GET_NEW_NODE(n) {				\
 	n = g_new0 (GelETree, 1);			\
+	gel_eval_stats.nodes_allocated++;		\
 }
 # endif /* EVAL_DEBUG */
 
@@ -213,6 +241,7 @@ void _gel_make_free_trees (void);
 		_gel_make_free_trees ();		\
 	n = gel_free_trees;				\
 	gel_free_trees = gel_free_trees->any.next;	\
+	gel_eval_stats.nodes_allocated++;		\
 }
 #endif
 
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Test exporting plots from the command line genius.  Each test writes to
+# its own file in a private temporary directory, which is removed at the
+# end.  Run from the build directory: sh exporttest.sh [./genius]
+
+GENIUS=${1:-./genius}
+
+tmpdir=`mktemp -d "${TMPDIR:-/tmp}/geniustest-XXXXXX"` || exit 1
+trap 'rm -rf "$tmpdir"' 0
+trap 'exit 1' 1 2 15
+
+tests=0
+errors=0
+
+# export_test name expression, the expression should print true and
+# leave a nonempty $tmpdir/name behind
+export_test () {
+	tests=`expr $tests + 1`
+	file="$tmpdir/$1"
+	rep=`"$GENIUS" --exec="$2;ExportPlot(\"$file\")" | head -n 1`
+	echo "$2 -> $1"
+	echo " (reported)=$rep"
+	if test "x$rep" != "xtrue" || test ! -s "$file"; then
+		echo "ERROR!"
+		errors=`expr $errors + 1`
+	fi
+	rm -f "$file"
+}
+
+export_test plot.png 'LinePlot(sin,-3,3)'
+export_test plot.svg 'function f(x,y)=x*y;SurfacePlot(f)'
+
+echo "tests: $tests, errors: $errors"
+test $errors -eq 0
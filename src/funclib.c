@@ -37,6 +37,14 @@
 #include "matrixw.h"
 #include "matop.h"
 #include "geloutput.h"
+#include "dfunc.h"
+#include "odesolve.h"
+#include "quadrature.h"
+#include "matnum.h"
+#include "polynomial.h"
+#include "normalform.h"
+#include "dlog.h"
+#include "combinat.h"
 
 #include "binreloc.h"
 
@@ -386,6 +394,33 @@ CurrentTime_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	return gel_makenum_use (tm);
 }
 
+static GelETree *
+EvalStats_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	const char *names[GEL_EVAL_STATS_MAX];
+	unsigned long values[GEL_EVAL_STATS_MAX];
+	GelETree *n;
+	GelMatrix *m;
+	int i, cnt;
+
+	cnt = gel_eval_stats_collect (names, values, GEL_EVAL_STATS_MAX);
+
+	m = gel_matrix_new ();
+	gel_matrix_set_size (m, 2, cnt, FALSE /* padding */);
+	for (i = 0; i < cnt; i++) {
+		gel_matrix_index (m, 0, i) =
+			gel_makenum_string_constant (names[i]);
+		gel_matrix_index (m, 1, i) = gel_makenum_ui (values[i]);
+	}
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix (m);
+	n->mat.quoted = FALSE;
+
+	return n;
+}
+
 /*sin function*/
 static GelETree *
 IntegerFromBoolean_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
@@ -615,6 +650,7 @@ SetElement_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 		func->context = 0;
 		d_addfunc_global (func);
 	} else {
+		d_globals_changed ();
 		mat = func->data.user->mat.matrix;
 		if G_UNLIKELY ( ! _gel_iter_set_element (mat, a[3], a[1], a[2])) {
 			return NULL;
@@ -677,6 +713,7 @@ SetVElement_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 		func->context = 0;
 		d_addfunc_global (func);
 	} else {
+		d_globals_changed ();
 		mat = func->data.user->mat.matrix;
 		if G_UNLIKELY ( ! _gel_iter_set_velement (mat, a[2], a[1])) {
 			return NULL;
@@ -1032,6 +1069,300 @@ randint_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	}
 }
 
+/* Builtins over large matrices are run elementwise in worker threads.
+ * Only builtins listed in parallel_funcs (filled in
+ * gel_funclib_addall) are run this way, those must not evaluate GEL
+ * code, look at ctx or keep global state of their own.  The workers get
+ * private copies of the arguments, they keep their own free lists (see
+ * GEL_THREAD_LOCAL in mpwrap.h), and their messages are captured and
+ * output in element order so the result is the same as the serial
+ * loop's. */
+
+/* elements handed out to a thread at a time */
+#define APPLY_CHUNK 64
+/* below this many elements don't bother with threads */
+#define APPLY_MIN_PARALLEL 2048
+
+static GHashTable *parallel_funcs = NULL;
+
+/* persistent threads, so that their free lists get reused */
+static GThreadPool *apply_pool = NULL;
+static int apply_threads = -1;
+/* ParallelThreads, 0 means one thread per processor */
+static int parallel_threads = 0;
+
+typedef struct {
+	GelETree *res;
+	gboolean ex;
+	GeniusError errnum;
+	GSList *msgs;
+} ApplyResult;
+
+typedef struct {
+	GelCtx *ctx;
+	GelBIFunction function;
+	int n;
+	int nargs;
+	GelETree **args;
+	ApplyResult *res;
+	volatile gint next;
+	int running;
+	GMutex lock;
+	GCond cond;
+	/* the counters of the workers, for EvalStats */
+	GelEvalStats eval_stats;
+	MpwStats mpw_stats;
+} ApplyWork;
+
+/* do one chunk, FALSE if there is nothing more to do */
+static gboolean
+apply_chunk (ApplyWork *w)
+{
+	int k, start, end;
+
+	start = g_atomic_int_add (&w->next, APPLY_CHUNK);
+	if (start >= w->n)
+		return FALSE;
+	end = MIN (start + APPLY_CHUNK, w->n);
+
+	for (k = start; k < end; k++) {
+		ApplyResult *r = &w->res[k];
+		if G_UNLIKELY (gel_interrupted) {
+			r->ex = TRUE;
+			continue;
+		}
+		gel_error_num = GEL_NO_ERROR;
+		gel_captured_messages = NULL;
+		r->res = (*w->function) (w->ctx,
+					 w->args + (gsize)k * w->nargs,
+					 &r->ex);
+		r->errnum = gel_error_num;
+		r->msgs = gel_captured_messages;
+	}
+	gel_captured_messages = NULL;
+	return TRUE;
+}
+
+static void
+apply_thread (gpointer data, gpointer user_data)
+{
+	ApplyWork *w = data;
+
+	gel_in_worker_thread = TRUE;
+	gel_capture_messages = TRUE;
+	mpw_thread_sync_prec ();
+	memset (&gel_eval_stats, 0, sizeof (gel_eval_stats));
+	memset (&mpw_stats, 0, sizeof (mpw_stats));
+
+	while (apply_chunk (w))
+		;
+
+	/* what we freed would otherwise only be reused by this thread */
+	gel_spill_free_trees ();
+	mpw_spill_free_reals ();
+
+	g_mutex_lock (&w->lock);
+	gel_eval_stats_add (&w->eval_stats, &w->mpw_stats,
+			    &gel_eval_stats, &mpw_stats);
+	w->running--;
+	g_cond_signal (&w->cond);
+	g_mutex_unlock (&w->lock);
+}
+
+static GelETree *
+unshared_value_node (GelETree *t)
+{
+	GelETree *n;
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_VALUE_NODE;
+	mpw_init_set_unshared (n->val.value, t->val.value);
+	n->any.next = NULL;
+	return n;
+}
+
+/* Number of worker threads to use besides the calling one, 0 if the
+ * elementwise loops should not be run in threads at all */
+static int
+apply_get_threads (void)
+{
+	if (apply_threads >= 0)
+		return apply_threads;
+
+	apply_threads = 0;
+
+	/* the free lists and the error state must be private to each
+	 * thread, and so must the MPFR exponent range and caches */
+#ifdef GEL_HAVE_THREAD_LOCAL
+#if MPFR_VERSION_MAJOR >= 3
+	if (mpfr_buildopt_tls_p ()) {
+		if (parallel_threads > 0)
+			apply_threads = parallel_threads - 1;
+		else
+			apply_threads = g_get_num_processors () - 1;
+	}
+#endif
+#endif
+
+	if (apply_threads > 0) {
+		if (apply_pool == NULL)
+			apply_pool = g_thread_pool_new (apply_thread, NULL,
+							apply_threads,
+							TRUE /* exclusive */,
+							NULL);
+		else if ( ! g_thread_pool_set_max_threads (apply_pool,
+							   apply_threads,
+							   NULL))
+			apply_threads = 0;
+		if (apply_pool == NULL)
+			apply_threads = 0;
+	}
+
+	return apply_threads;
+}
+
+/* Runs function over the elements of m1 (and m2 or re_node, as in
+ * gel_apply_func_to_matrixen) in worker threads.  Returns NULL if it
+ * would not pay off or is not safe, and the serial loop should be used.
+ * Otherwise the results are taken in order with apply_take_result. */
+static ApplyResult *
+apply_parallel (GelCtx *ctx, GelBIFunction function, int nargs,
+		GelMatrixW *m1, GelMatrixW *m2, GelETree *re_node,
+		gboolean reverse)
+{
+	ApplyWork w;
+	GError *error = NULL;
+	GeniusError old_errnum;
+	gboolean old_capture;
+	int i, j, k, wi, h, nthreads;
+
+	wi = gel_matrixw_width (m1);
+	h = gel_matrixw_height (m1);
+
+	if (parallel_funcs == NULL ||
+	    (gsize)wi * h < APPLY_MIN_PARALLEL ||
+	    (gsize)wi * h > G_MAXINT / 2 ||
+	    ! g_hash_table_contains (parallel_funcs, (gpointer)function) ||
+	    gel_find_pre_function_modulo (ctx) != NULL ||
+	    (re_node != NULL && re_node->type != GEL_VALUE_NODE))
+		return NULL;
+
+	if (apply_get_threads () == 0)
+		return NULL;
+
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < wi; i++) {
+			if (gel_matrixw_index (m1, i, j)->type != GEL_VALUE_NODE ||
+			    (m2 != NULL &&
+			     gel_matrixw_index (m2, i, j)->type != GEL_VALUE_NODE))
+				return NULL;
+		}
+	}
+
+	w.ctx = ctx;
+	w.function = function;
+	w.n = wi * h;
+	w.nargs = nargs;
+	w.args = g_new (GelETree *, (gsize)w.n * nargs);
+	w.res = g_new0 (ApplyResult, w.n);
+	w.next = 0;
+	w.running = 0;
+	memset (&w.eval_stats, 0, sizeof (w.eval_stats));
+	memset (&w.mpw_stats, 0, sizeof (w.mpw_stats));
+	g_mutex_init (&w.lock);
+	g_cond_init (&w.cond);
+
+	k = 0;
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < wi; i++) {
+			GelETree *t1 = gel_matrixw_index (m1, i, j);
+			if (nargs == 1) {
+				w.args[k++] = unshared_value_node (t1);
+			} else {
+				GelETree *t2 = m2 ? gel_matrixw_index (m2, i, j)
+					: re_node;
+				w.args[k++] = unshared_value_node
+					(reverse ? t2 : t1);
+				w.args[k++] = unshared_value_node
+					(reverse ? t1 : t2);
+			}
+		}
+	}
+
+	/* the results of earlier runs were allocated by the workers and
+	 * freed by us, let the workers have them back */
+	gel_spill_free_trees ();
+	mpw_spill_free_reals ();
+
+	nthreads = MIN (apply_threads, (w.n + APPLY_CHUNK - 1) / APPLY_CHUNK - 1);
+	g_mutex_lock (&w.lock);
+	for (i = 0; i < nthreads; i++) {
+		g_thread_pool_push (apply_pool, &w, &error);
+		/* if we can't get a thread we just do more ourselves */
+		if (error != NULL) {
+			g_clear_error (&error);
+			break;
+		}
+		w.running++;
+	}
+	g_mutex_unlock (&w.lock);
+
+	old_errnum = gel_error_num;
+	old_capture = gel_capture_messages;
+	gel_capture_messages = TRUE;
+	while (apply_chunk (&w)) {
+		if (gel_evalnode_hook != NULL)
+			(*gel_evalnode_hook) ();
+	}
+	gel_capture_messages = old_capture;
+	gel_error_num = old_errnum;
+
+	g_mutex_lock (&w.lock);
+	while (w.running > 0)
+		g_cond_wait (&w.cond, &w.lock);
+	g_mutex_unlock (&w.lock);
+	g_mutex_clear (&w.lock);
+	g_cond_clear (&w.cond);
+
+	gel_eval_stats_add (&gel_eval_stats, &mpw_stats,
+			    &w.eval_stats, &w.mpw_stats);
+
+	for (k = 0; k < w.n * nargs; k++)
+		gel_freetree (w.args[k]);
+	g_free (w.args);
+
+	return w.res;
+}
+
+/* Take the result of element k, outputting its messages, as if the
+ * function was just called on it.  Once there was an exception the
+ * rest is dropped, just as the serial loop would not call the function
+ * again. */
+static GelETree *
+apply_take_result (ApplyResult *res, int k, gboolean *exception)
+{
+	ApplyResult *r = &res[k];
+
+	if G_UNLIKELY (*exception) {
+		GSList *li;
+		if (r->res != NULL)
+			gel_freetree (r->res);
+		for (li = r->msgs; li != NULL; li = li->next) {
+			GelCapturedMessage *m = li->data;
+			g_free (m->s);
+			g_free (m);
+		}
+		g_slist_free (r->msgs);
+		return NULL;
+	}
+
+	gel_output_captured_messages (r->msgs);
+	if G_UNLIKELY (r->errnum != GEL_NO_ERROR)
+		gel_error_num = r->errnum;
+	if G_UNLIKELY (r->ex)
+		*exception = TRUE;
+	return r->res;
+}
+
 GelETree *
 gel_apply_func_to_matrixen (GelCtx *ctx,
 			    GelETree *mat1,
@@ -1046,6 +1377,7 @@ gel_apply_func_to_matrixen (GelCtx *ctx,
 	GelETree *re_node = NULL;
 	gboolean reverse = FALSE;
 	GelETree *n;
+	ApplyResult *par;
 	int i, j, w, h;
 	int quote = 0;
 	gboolean internal_exception = FALSE; 
@@ -1082,6 +1414,8 @@ gel_apply_func_to_matrixen (GelCtx *ctx,
 	n->mat.quoted = quote;
 	gel_matrixw_set_size (new, w, h);
 
+	par = apply_parallel (ctx, function, 2, m1, m2, re_node, reverse);
+
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
 			GelETree *t[2];
@@ -1093,7 +1427,10 @@ gel_apply_func_to_matrixen (GelCtx *ctx,
 				t[0] = m2?gel_matrixw_index(m2,i,j):re_node;
 				t[1] = gel_matrixw_index(m1,i,j);
 			}
-			if G_LIKELY ( ! internal_exception)
+			if (par != NULL)
+				e = apply_take_result (par, j*w + i,
+						       &internal_exception);
+			else if G_LIKELY ( ! internal_exception)
 				e = (*function) (ctx, t, &internal_exception);
 			else
 				e = NULL;
@@ -1121,6 +1458,7 @@ gel_apply_func_to_matrixen (GelCtx *ctx,
 			}
 		}
 	}
+	g_free (par);
 
 	if G_UNLIKELY (internal_exception) {
 		RAISE_EXCEPTION (exception);
@@ -1139,6 +1477,7 @@ gel_apply_func_to_matrix (GelCtx *ctx,
 	GelMatrixW *m;
 	GelMatrixW *new;
 	GelETree *n;
+	ApplyResult *par;
 	int i, j, w, h;
 	gboolean internal_exception = FALSE; 
 
@@ -1154,13 +1493,18 @@ gel_apply_func_to_matrix (GelCtx *ctx,
 	n->mat.quoted = mat->mat.quoted;
 	gel_matrixw_set_size (new, w, h);
 
+	par = apply_parallel (ctx, function, 1, m, NULL, NULL, FALSE);
+
 	for (j = 0; j < h; j++) {
 		for (i = 0; i < w; i++) {
 			GelETree *t[1];
 			GelETree *e;
 			t[0] = gel_matrixw_index(m,i,j);
 
-			if G_LIKELY ( ! internal_exception)
+			if (par != NULL)
+				e = apply_take_result (par, j*w + i,
+						       &internal_exception);
+			else if G_LIKELY ( ! internal_exception)
 				e = (*function) (ctx, t, &internal_exception);
 			else
 				e = NULL;
@@ -1192,6 +1536,7 @@ gel_apply_func_to_matrix (GelCtx *ctx,
 			}
 		}
 	}
+	g_free (par);
 
 	if G_UNLIKELY (internal_exception) {
 		RAISE_EXCEPTION (exception);
@@ -1200,6 +1545,28 @@ gel_apply_func_to_matrix (GelCtx *ctx,
 	return n;
 }
 
+/* func applied to a float matrix in doubles if the precision allows,
+ * see gel_value_matrix_func_double, NULL otherwise.  Only for correctly
+ * rounded func, such as sqrt, libm sin or cos could be a bit off. */
+static GelETree *
+apply_double_func_to_matrix (GelCtx *ctx, GelETree *mat,
+			     double (*func) (double))
+{
+	GelMatrixW *m;
+	GelETree *n;
+
+	if (gel_find_pre_function_modulo (ctx) != NULL ||
+	    (m = gel_value_matrix_func_double (mat->mat.matrix,
+					       func)) == NULL)
+		return NULL;
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = m;
+	n->mat.quoted = mat->mat.quoted;
+	return n;
+}
+
 /* expand matrix function*/
 static GelETree *
 ExpandMatrix_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
@@ -2475,8 +2842,12 @@ sqrt_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 		return gel_function_from_function (sqrt_function, a[0]);
 	}
 
-	if(a[0]->type==GEL_MATRIX_NODE)
+	if(a[0]->type==GEL_MATRIX_NODE) {
+		GelETree *n = apply_double_func_to_matrix (ctx, a[0], sqrt);
+		if (n != NULL)
+			return n;
 		return gel_apply_func_to_matrix(ctx,a[0],sqrt_op,"sqrt", exception);
+	}
 
 	if G_UNLIKELY ( ! check_argument_number (a, 0, "sqrt"))
 		return NULL;
@@ -3925,18 +4296,219 @@ symbolic_isinmatrix (GelETree *n, GelMatrixW *m)
 			}
 		}
 	}
-	/*int elts, i;
 
-	elts = gel_matrixw_elements (m);
+	return FALSE;
+}
+
+/* Sets are vectors, but the set functions hash the elements into an
+ * open addressing (linear probing) table so that they run in linear
+ * time.  Elements are the same when gel_is_tree_same says so, and
+ * gel_tree_hash is consistent with that.  The table does not own the
+ * nodes. */
+typedef struct {
+	GelETree **nodes;
+	guint *hashes;
+	guint mask; /* size-1, size is a power of two */
+} SetTable;
+
+static void
+set_table_init (SetTable *st, int elements)
+{
+	guint size = 16;
+	/* keep the load under a half */
+	while (size < 2 * (guint)elements)
+		size <<= 1;
+	st->nodes = g_new0 (GelETree *, size);
+	st->hashes = g_new (guint, size);
+	st->mask = size - 1;
+}
+
+static void
+set_table_free (SetTable *st)
+{
+	g_free (st->nodes);
+	g_free (st->hashes);
+}
+
+/* Returns TRUE if the element was already there, otherwise adds it if
+ * add is TRUE.  The table has room, see set_table_init. */
+static gboolean
+set_table_lookup (SetTable *st, GelETree *t, gboolean add)
+{
+	guint hash = gel_tree_hash (t);
+	guint i = hash & st->mask;
 
-	for (i = 0; i < elts; i++) {
-		GelETree *t = gel_matrixw_vindex (m, i);
-		if (gel_is_tree_same (t, n)) {
+	while (st->nodes[i] != NULL) {
+		if (st->hashes[i] == hash &&
+		    gel_is_tree_same (st->nodes[i], t))
 			return TRUE;
+		i = (i + 1) & st->mask;
+	}
+	if (add) {
+		st->nodes[i] = t;
+		st->hashes[i] = hash;
+	}
+	return FALSE;
+}
+
+static void
+set_table_add_matrix (SetTable *st, GelMatrixW *m)
+{
+	int w, h, i, j;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+
+	for (i = 0; i < w; i++)
+		for (j = 0; j < h; j++)
+			set_table_lookup (st, gel_matrixw_index (m, i, j),
+					  TRUE /* add */);
+}
+
+/* Makes a vector out of the elements in list (which is in reverse
+ * order), copying them */
+static GelETree *
+set_make_vector (GSList *list, int len, gboolean vertical, gboolean quoted)
+{
+	GelETree *n;
+	GelMatrix *nm;
+	GSList *li;
+	int i;
+
+	if (list == NULL)
+		return gel_makenum_null ();
+
+	nm = gel_matrix_new ();
+	if (vertical)
+		gel_matrix_set_size (nm, 1, len, FALSE /* padding */);
+	else
+		gel_matrix_set_size (nm, len, 1, FALSE /* padding */);
+	/* go backwards to "preserver order" */
+	li = list;
+	for (i = len-1; i >= 0; i--) {
+		GelETree *t = li->data;
+		t = (t == the_zero) ? NULL : gel_copynode (t);
+		if (vertical)
+			gel_matrix_index (nm, 0, i) = t;
+		else
+			gel_matrix_index (nm, i, 0) = t;
+		li = li->next;
+	}
+	g_slist_free (list);
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix (nm);
+	n->mat.quoted = quoted;
+
+	return n;
+}
+
+/* Adds the elements of a in the order of a for loop (rowwise) that are
+ * not yet in st to list, null has no elements and anything else is
+ * a single element */
+static GSList *
+set_append_new (SetTable *st, GelETree *a, GSList *list, int *len)
+{
+	int w, h, i, j;
+
+	if (a->type == GEL_NULL_NODE)
+		return list;
+
+	if (a->type != GEL_MATRIX_NODE) {
+		if ( ! set_table_lookup (st, a, TRUE /* add */)) {
+			list = g_slist_prepend (list, a);
+			(*len)++;
 		}
-	}*/
+		return list;
+	}
 
-	return FALSE;
+	w = gel_matrixw_width (a->mat.matrix);
+	h = gel_matrixw_height (a->mat.matrix);
+
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			GelETree *t = gel_matrixw_index (a->mat.matrix, i, j);
+			if ( ! set_table_lookup (st, t, TRUE /* add */)) {
+				list = g_slist_prepend (list, t);
+				(*len)++;
+			}
+		}
+	}
+	return list;
+}
+
+static int
+set_elements (GelETree *a)
+{
+	if (a->type == GEL_NULL_NODE)
+		return 0;
+	else if (a->type == GEL_MATRIX_NODE)
+		return gel_matrixw_elements (a->mat.matrix);
+	else
+		return 1;
+}
+
+static GelETree *
+MakeSet_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	SetTable st;
+	GSList *list = NULL;
+	int len = 0;
+	GelETree *n;
+
+	set_table_init (&st, set_elements (a[0]));
+	list = set_append_new (&st, a[0], list, &len);
+	/* always a row vector */
+	n = set_make_vector (list, len, FALSE /* vertical */,
+			     FALSE /* quoted */);
+	set_table_free (&st);
+
+	return n;
+}
+
+static GelETree *
+Union_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	SetTable st;
+	GSList *list = NULL;
+	int len = 0;
+	gboolean vertical;
+	GelETree *n;
+	int w, h, i, j;
+
+	vertical = (a[1]->type == GEL_MATRIX_NODE &&
+		    gel_matrixw_width (a[1]->mat.matrix) == 1 &&
+		    gel_matrixw_height (a[1]->mat.matrix) > 1);
+
+	set_table_init (&st, set_elements (a[0]) + set_elements (a[1]));
+
+	/* All of Y in order (even if it repeats) and then the new
+	 * elements of X */
+	if (a[1]->type == GEL_MATRIX_NODE) {
+		w = gel_matrixw_width (a[1]->mat.matrix);
+		h = gel_matrixw_height (a[1]->mat.matrix);
+		for (j = 0; j < h; j++) {
+			for (i = 0; i < w; i++) {
+				GelETree *t = gel_matrixw_index (a[1]->mat.matrix, i, j);
+				set_table_lookup (&st, t, TRUE /* add */);
+				list = g_slist_prepend (list, t);
+				len++;
+			}
+		}
+	} else if (a[1]->type != GEL_NULL_NODE) {
+		set_table_lookup (&st, a[1], TRUE /* add */);
+		list = g_slist_prepend (list, a[1]);
+		len++;
+	}
+
+	list = set_append_new (&st, a[0], list, &len);
+	n = set_make_vector (list, len, vertical,
+			     a[1]->type == GEL_MATRIX_NODE &&
+			     a[1]->mat.quoted);
+	set_table_free (&st);
+
+	return n;
 }
 
 static GelETree *
@@ -3948,6 +4520,7 @@ IsIn_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	if (a[1]->type == GEL_NULL_NODE)
 		return gel_makenum_bool (FALSE);
 
+	/* a single lookup, hashing would not be faster */
 	return gel_makenum_bool (symbolic_isinmatrix (a[0], a[1]->mat.matrix));
 }
 
@@ -3955,6 +4528,8 @@ static GelETree *
 IsSubset_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
 	GelMatrixW *mX, *mY;
+	SetTable st;
+	gboolean ret = TRUE;
 	int w, h, i, j;
 
 	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "IsSubset") ||
@@ -3973,43 +4548,40 @@ IsSubset_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	mX = a[0]->mat.matrix;
 	mY = a[1]->mat.matrix;
 
+	set_table_init (&st, gel_matrixw_elements (mY));
+	set_table_add_matrix (&st, mY);
+
 	w = gel_matrixw_width (mX);
 	h = gel_matrixw_height (mX);
 
-	for (i = 0; i < w; i++) {
+	for (i = 0; i < w && ret; i++) {
 		for (j = 0; j < h; j++) {
 			GelETree *t = gel_matrixw_index (mX, i, j);
-			if ( ! symbolic_isinmatrix (t, mY)) {
-				return gel_makenum_bool (FALSE);
+			if ( ! set_table_lookup (&st, t, FALSE /* add */)) {
+				ret = FALSE;
+				break;
 			}
 		}
 	}
-	return gel_makenum_bool (TRUE);
+	set_table_free (&st);
 
+	return gel_makenum_bool (ret);
 }
 
+/* The elements of X that are in Y (or not in Y), in order */
 static GelETree *
-SetMinus_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+set_filter (GelETree *X, GelETree *Y, gboolean in)
 {
-	GelMatrixW *m1, *m2;
+	GelMatrixW *m1;
+	SetTable st;
 	int w, h, i, j;
 	int len;
-	GSList *list, *li;
-	GelETree *n;
-	GelMatrix *nm;
-
-	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "SetMinus") ||
-			! check_argument_matrix_or_null (a, 1, "SetMinus"))
-		return NULL;
+	GSList *list;
 
-	if (a[0]->type == GEL_NULL_NODE) {
-		return gel_makenum_null ();
-	} else if (a[1]->type == GEL_NULL_NODE) {
-		return gel_copynode (a[0]);
-	}
+	m1 = X->mat.matrix;
 
-	m1 = a[0]->mat.matrix;
-	m2 = a[1]->mat.matrix;
+	set_table_init (&st, gel_matrixw_elements (Y->mat.matrix));
+	set_table_add_matrix (&st, Y->mat.matrix);
 
 	list = NULL;
 	len = 0;
@@ -4020,98 +4592,48 @@ SetMinus_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	for (i = 0; i < w; i++) {
 		for (j = 0; j < h; j++) {
 			GelETree *t = gel_matrixw_index (m1, i, j);
-			if ( ! symbolic_isinmatrix (t, m2)) {
-				if (t == the_zero)
-					list = g_slist_prepend (list, NULL);
-				else
-					list = g_slist_prepend (list, gel_copynode (t));
+			if (set_table_lookup (&st, t, FALSE /* add */) == in) {
+				list = g_slist_prepend (list, t);
 				len ++;
 			}
 		}
 	}
-	if (list == NULL) {
-		return gel_makenum_null ();
-	}
-
-	nm = gel_matrix_new ();
-	gel_matrix_set_size (nm, len, 1, FALSE /* padding */);
-	/* go backwards to "preserver order" */
-	li = list;
-	for (i = len-1; i >= 0; i--) {
-		gel_matrix_index (nm, i, 0) = li->data;
-		li = li->next;
-	}
-	g_slist_free (list);
-
-	GEL_GET_NEW_NODE (n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_new_with_matrix (nm);
-	n->mat.quoted = a[0]->mat.quoted;
+	set_table_free (&st);
 
-	return n;
+	return set_make_vector (list, len, FALSE /* vertical */,
+				X->mat.quoted);
 }
 
 static GelETree *
-Intersection_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+SetMinus_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelMatrixW *m1, *m2;
-	int w, h, i, j;
-	int len;
-	GSList *list, *li;
-	GelETree *n;
-	GelMatrix *nm;
-
-	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "Intersection") ||
-			! check_argument_matrix_or_null (a, 1, "Intersection"))
+	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "SetMinus") ||
+			! check_argument_matrix_or_null (a, 1, "SetMinus"))
 		return NULL;
 
 	if (a[0]->type == GEL_NULL_NODE) {
 		return gel_makenum_null ();
 	} else if (a[1]->type == GEL_NULL_NODE) {
-		return gel_makenum_null ();
+		return gel_copynode (a[0]);
 	}
 
-	m1 = a[0]->mat.matrix;
-	m2 = a[1]->mat.matrix;
-
-	list = NULL;
-	len = 0;
+	return set_filter (a[0], a[1], FALSE /* in */);
+}
 
-	w = gel_matrixw_width (m1);
-	h = gel_matrixw_height (m1);
+static GelETree *
+Intersection_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "Intersection") ||
+			! check_argument_matrix_or_null (a, 1, "Intersection"))
+		return NULL;
 
-	for (i = 0; i < w; i++) {
-		for (j = 0; j < h; j++) {
-			GelETree *t = gel_matrixw_index (m1, i, j);
-			if (symbolic_isinmatrix (t, m2)) {
-				if (t == the_zero)
-					list = g_slist_prepend (list, NULL);
-				else
-					list = g_slist_prepend (list, gel_copynode (t));
-				len ++;
-			}
-		}
-	}
-	if (list == NULL) {
+	if (a[0]->type == GEL_NULL_NODE) {
+		return gel_makenum_null ();
+	} else if (a[1]->type == GEL_NULL_NODE) {
 		return gel_makenum_null ();
 	}
 
-	nm = gel_matrix_new ();
-	gel_matrix_set_size (nm, len, 1, FALSE /* padding */);
-	/* go backwards to "preserver order" */
-	li = list;
-	for (i = len-1; i >= 0; i--) {
-		gel_matrix_index (nm, i, 0) = li->data;
-		li = li->next;
-	}
-	g_slist_free (list);
-
-	GEL_GET_NEW_NODE (n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_new_with_matrix (nm);
-	n->mat.quoted = a[0]->mat.quoted;
-
-	return n;
+	return set_filter (a[0], a[1], TRUE /* in */);
 }
 
 static GelETree *
@@ -4508,1937 +5030,3849 @@ SolveLinearSystem_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 	}
 }
 
-/* this is utterly stupid, but only used for small primes
- * where it's all ok */
+/*
+ * Numerical linear algebra, the kernels are in matnum.c
+ */
+
+/* Real matrices with entries that fit in a double are done in doubles
+ * if the float precision is not more than that of a double anyway, or
+ * if the matrix is so large that multiple precision would be too slow.
+ * If need_float is set, exact matrices are always done in mpw. */
 static gboolean
-is_prime_small (unsigned int testnum)
+matnum_use_double (GelMatrixW *m, gboolean need_float)
 {
-	int i;
-	unsigned int s = (unsigned int)sqrt(testnum);
-	
-	for(i=0;g_array_index(primes,unsigned int,i)<=s && i<numprimes;i++) {
-		if((testnum%g_array_index(primes,unsigned int,i))==0) {
-			return FALSE;
+	int i, j, n;
+	gboolean any_float = FALSE;
+	mpw_t big, tmp;
+	gboolean ret = TRUE;
+
+	n = gel_matrixw_width (m);
+	if (gel_calcstate.float_prec > 53 &&
+	    n <= GEL_MATNUM_DOUBLE_SIZE)
+		return FALSE;
+
+	mpw_init (big);
+	mpw_init (tmp);
+	mpw_set_d (big, 1e300);
+	for (j = 0; j < n && ret; j++) {
+		for (i = 0; i < n; i++) {
+			GelETree *t = gel_matrixw_get_index (m, i, j);
+			if (t == NULL)
+				continue;
+			if (mpw_is_complex (t->val.value)) {
+				ret = FALSE;
+				break;
+			}
+			if (mpw_is_float (t->val.value))
+				any_float = TRUE;
+			mpw_abs (tmp, t->val.value);
+			if (mpw_cmp (tmp, big) > 0) {
+				ret = FALSE;
+				break;
+			}
 		}
 	}
-	return TRUE;
+	mpw_clear (big);
+	mpw_clear (tmp);
+
+	if (need_float && ! any_float)
+		return FALSE;
+	return ret;
 }
 
-static GelETree *
-Prime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+/* Copy the n by n matrix m into a by columns */
+static void
+matnum_get_d (GelMatrixW *m, int n, double *a)
 {
-	long num;
-	unsigned int i;
-	unsigned int last_prime;
-
-	if(a[0]->type==GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix(ctx,a[0],Prime_op,"prime", exception);
-
-	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "Prime"))
-		return NULL;
-
-	num = gel_get_nonnegative_integer (a[0]->val.value, "Prime");
-	if G_UNLIKELY (num < 0)
-		return NULL;
-	
-	if G_UNLIKELY (primes == NULL) {
-		unsigned int b;
-		primes = g_array_new(FALSE,FALSE,sizeof(unsigned int));
-		b = 2;
-		primes = g_array_append_val(primes,b);
-		b = 3;
-		primes = g_array_append_val(primes,b);
-		b = 5;
-		primes = g_array_append_val(primes,b);
-		b = 7;
-		primes = g_array_append_val(primes,b);
-		numprimes = 4;
-	}
-	
-	if(num-1 < numprimes)
-		return gel_makenum_ui(g_array_index(primes,unsigned int,num-1));
-
-	last_prime = g_array_index (primes, unsigned int, numprimes-1);
-	primes = g_array_set_size(primes,num);
-	for(i=g_array_index(primes,unsigned int,numprimes-1)+2;
-	    numprimes<=num-1 && numprimes <= MAXPRIMES && i<=G_MAXUINT-1;i+=2) {
-		if (is_prime_small (i)) {
-			g_array_index(primes,unsigned int,numprimes++) = i;
-			last_prime = i;
+	int i, j;
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			GelETree *t = gel_matrixw_get_index (m, j, i);
+			a[i + j*n] = (t == NULL) ? 0.0 :
+				mpw_get_double (t->val.value);
 		}
 	}
+}
 
-	if (numprimes <= num-1) {
-		mpw_t prime;
-		mpw_init (prime);
-		mpw_set_ui (prime, last_prime);
-		for (i = numprimes; i <= num-1; i++) {
-			mpw_nextprime (prime, prime);
+static mpw_t *
+matnum_get_mpw (GelMatrixW *m, int n)
+{
+	int i, j;
+	mpw_t *a = g_new (mpw_t, n*n);
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			GelETree *t = gel_matrixw_index (m, j, i);
+			mpw_init_set (a[i + j*n], t->val.value);
 		}
-		return gel_makenum_use (prime);
 	}
-	return gel_makenum_ui(g_array_index(primes,unsigned int,num-1));
+	return a;
 }
 
-static GelETree *
-NextPrime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+static void
+matnum_free_mpw (mpw_t *a, int len)
 {
-	mpw_t ret;
+	int i;
+	for (i = 0; i < len; i++)
+		mpw_clear (a[i]);
+	g_free (a);
+}
 
-	if(a[0]->type==GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix(ctx,a[0],NextPrime_op,"NextPrime", exception);
+/* The w by h matrix stored by columns in a as a matrix node */
+static GelETree *
+matnum_make_d (const double *a, int w, int h)
+{
+	GelETree *n;
+	GelMatrix *m;
+	int i, j;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "NextPrime"))
-		return NULL;
+	m = gel_matrix_new ();
+	gel_matrix_set_size (m, w, h, FALSE /* padding */);
+	for (j = 0; j < w; j++)
+		for (i = 0; i < h; i++)
+			gel_matrix_index (m, j, i) = gel_makenum_d (a[i + j*h]);
 
-	mpw_init (ret);
-	mpw_nextprime (ret, a[0]->val.value);
-	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
-		mpw_clear (ret);
-		/* eek! should not happen */
-		gel_error_num = GEL_NO_ERROR;
-		return NULL;
-	}
-	return gel_makenum_use (ret);
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix_value_only (m);
+	n->mat.quoted = FALSE;
+	return n;
 }
 
+/* The same for mpw numbers, the numbers are used up but not a itself */
 static GelETree *
-LucasNumber_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+matnum_make_mpw (mpw_t *a, int w, int h)
 {
-	mpw_t ret;
-
-	if(a[0]->type==GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix(ctx,a[0],LucasNumber_op,"LucasNumber", exception);
+	GelETree *n;
+	GelMatrix *m;
+	int i, j;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "LucasNumber"))
-		return NULL;
+	m = gel_matrix_new ();
+	gel_matrix_set_size (m, w, h, FALSE /* padding */);
+	for (j = 0; j < w; j++)
+		for (i = 0; i < h; i++)
+			gel_matrix_index (m, j, i) =
+				gel_makenum_use (a[i + j*h]);
 
-	mpw_init (ret);
-	mpw_lucnum (ret, a[0]->val.value);
-	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
-		mpw_clear (ret);
-		gel_error_num = GEL_NO_ERROR;
-		return NULL;
-	}
-	return gel_makenum_use (ret);
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix_value_only (m);
+	n->mat.quoted = FALSE;
+	return n;
 }
 
-static GelETree *
-IsPrime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+static gboolean
+matnum_is_symmetric_d (const double *a, int n)
 {
-	int ret;
-	mpz_ptr num;
-
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix (ctx, a[0], IsPrime_op, "IsPrime", exception);
+	int i, j;
+	for (j = 0; j < n; j++)
+		for (i = j+1; i < n; i++)
+			if (a[i + j*n] != a[j + i*n])
+				return FALSE;
+	return TRUE;
+}
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "IsPrime"))
-		return NULL;
+static gboolean
+matnum_is_hermitian_mpw (mpw_t *a, int n)
+{
+	int i, j;
+	gboolean ret = TRUE;
+	mpw_t tmp;
 
-	num = mpw_peek_real_mpz (a[0]->val.value);
+	mpw_init (tmp);
+	for (j = 0; j < n && ret; j++) {
+		for (i = j; i < n; i++) {
+			mpw_conj (tmp, a[j + i*n]);
+			if ( ! mpw_eql (a[i + j*n], tmp)) {
+				ret = FALSE;
+				break;
+			}
+		}
+	}
+	mpw_clear (tmp);
+	return ret;
+}
 
-	ret = mympz_is_prime (num, -1);
+typedef struct {
+	double re;
+	double im;
+} MatnumComplex;
 
-	return gel_makenum_bool (ret);
+static int
+matnum_complex_cmp (const void *p1, const void *p2)
+{
+	const MatnumComplex *z1 = p1;
+	const MatnumComplex *z2 = p2;
+	if (z1->re != z2->re)
+		return (z1->re < z2->re) ? -1 : 1;
+	if (z1->im != z2->im)
+		return (z1->im < z2->im) ? -1 : 1;
+	return 0;
 }
 
+/* The vector of the eigenvalues, or with vectors set the matrix of the
+ * eigenvectors, evs and mults (if not NULL) then get the eigenvalues
+ * and multiplicities */
 static GelETree *
-StrongPseudoprimeTest_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+matnum_eigen (GelETree **a, gboolean vectors, GelEFunc *evs,
+	      GelEFunc *mults, const char *funcname)
 {
-	int ret;
-	mpz_ptr num;
-	mpz_ptr b;
-
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
-						   StrongPseudoprimeTest_op,
-						   "StrongPseudoprimeTest",
-						   exception);
+	GelMatrixW *m;
+	GelETree *ret = NULL;
+	GelETree *evsval = NULL;
+	int n, i;
 
-	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "StrongPseudoprimeTest") ||
-			! check_argument_positive_integer (a, 1, "StrongPseudoprimeTest"))
+	if G_UNLIKELY ( ! check_argument_value_only_matrix (a, 0, funcname) ||
+			! check_argument_square_matrix (a, 0, funcname))
 		return NULL;
 
-	num = mpw_peek_real_mpz (a[0]->val.value);
-	b = mpw_peek_real_mpz (a[1]->val.value);
+	m = a[0]->mat.matrix;
+	n = gel_matrixw_width (m);
+
+	if (matnum_use_double (m, FALSE)) {
+		double *ad = g_new (double, n*n);
+		double *wr = g_new (double, n);
+		double *wi;
+
+		matnum_get_d (m, n, ad);
+		if (matnum_is_symmetric_d (ad, n)) {
+			if (gel_matnum_symmetric_eigen_d (ad, n, wr,
+							  vectors)) {
+				if (vectors) {
+					ret = matnum_make_d (ad, n, n);
+					evsval = matnum_make_d (wr, 1, n);
+				} else {
+					ret = matnum_make_d (wr, 1, n);
+				}
+			}
+		} else if ( ! vectors) {
+			wi = g_new (double, n);
+			gel_matnum_hessenberg_d (ad, n, NULL);
+			if (gel_matnum_hqr_d (ad, n, wr, wi)) {
+				MatnumComplex *z = g_new (MatnumComplex, n);
+				mpw_t *w = g_new (mpw_t, n);
+				for (i = 0; i < n; i++) {
+					z[i].re = wr[i];
+					z[i].im = wi[i];
+				}
+				qsort (z, n, sizeof (MatnumComplex),
+				       matnum_complex_cmp);
+				for (i = 0; i < n; i++) {
+					mpw_init (w[i]);
+					mpw_set_d_complex (w[i], z[i].re,
+							   z[i].im);
+				}
+				ret = matnum_make_mpw (w, 1, n);
+				g_free (w);
+				g_free (z);
+			}
+			g_free (wi);
+		}
+		g_free (ad);
+		g_free (wr);
+		if G_UNLIKELY (gel_interrupted) {
+			if (ret != NULL)
+				gel_freetree (ret);
+			if (evsval != NULL)
+				gel_freetree (evsval);
+			return NULL;
+		}
+		/* if it did not converge, or for the eigenvectors of a
+		 * nonsymmetric matrix, use the general version */
+	}
+
+	if (ret == NULL) {
+		mpw_t *am = matnum_get_mpw (m, n);
+		mpw_t *w = g_new (mpw_t, n);
+		mpw_t *v = NULL;
+		gboolean hermitian = matnum_is_hermitian_mpw (am, n);
+
+		for (i = 0; i < n; i++)
+			mpw_init (w[i]);
+		if (vectors) {
+			v = g_new (mpw_t, n*n);
+			for (i = 0; i < n*n; i++)
+				mpw_init (v[i]);
+		}
 
-	ret = mympz_strong_pseudoprime_test (num, b);
+		if G_UNLIKELY ( ! gel_matnum_eigen_mpw (am, n, w, v)) {
+			if ( ! gel_interrupted)
+				gel_errorout (_("%s: the QR iteration did not converge"),
+					      funcname);
+			matnum_free_mpw (am, n*n);
+			matnum_free_mpw (w, n);
+			if (v != NULL)
+				matnum_free_mpw (v, n*n);
+			return NULL;
+		}
+		matnum_free_mpw (am, n*n);
 
-	return gel_makenum_bool (ret);
+		/* eigenvalues of Hermitian matrices are real */
+		if (hermitian) {
+			for (i = 0; i < n; i++)
+				mpw_re (w[i], w[i]);
+		}
+
+		if (vectors) {
+			ret = matnum_make_mpw (v, n, n);
+			evsval = matnum_make_mpw (w, 1, n);
+			g_free (v);
+		} else {
+			ret = matnum_make_mpw (w, 1, n);
+		}
+		g_free (w);
+	}
+
+	if (evs != NULL)
+		d_set_value (evs, evsval);
+	else if (evsval != NULL)
+		gel_freetree (evsval);
+
+	/* the numerical eigenvalues are all simple */
+	if (mults != NULL) {
+		GelMatrix *mm = gel_matrix_new ();
+		GelETree *nn;
+		gel_matrix_set_size (mm, 1, n, FALSE /* padding */);
+		for (i = 0; i < n; i++)
+			gel_matrix_index (mm, 0, i) = gel_makenum_ui (1);
+		GEL_GET_NEW_NODE (nn);
+		nn->type = GEL_MATRIX_NODE;
+		nn->mat.matrix = gel_matrixw_new_with_matrix_value_only_integer (mm);
+		nn->mat.quoted = FALSE;
+		d_set_value (mults, nn);
+	}
+
+	return ret;
 }
 
 static GelETree *
-MillerRabinTest_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+NumericalEigenvalues_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	int ret;
-	int reps;
-	mpz_ptr num;
+	return matnum_eigen (a, FALSE, NULL, NULL, "NumericalEigenvalues");
+}
 
-	if (a[0]->type == GEL_MATRIX_NODE ||
-	    a[1]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
-						   MillerRabinTest_op,
-						   "MillerRabinTest",
-						   exception);
+static GelETree *
+NumericalEigenvectors_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelEFunc *evs = NULL;
+	GelEFunc *mults = NULL;
 
-	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "MillerRabinTest") ||
-			! check_argument_positive_integer (a, 1, "MillerRabinTest"))
-		return NULL;
+	if (a[1] != NULL) {
+		evs = get_reference (a[1], _("second argument"),
+				     "NumericalEigenvectors");
+		if G_UNLIKELY (evs == NULL)
+			return NULL;
+		if (a[2] != NULL) {
+			mults = get_reference (a[2], _("third argument"),
+					       "NumericalEigenvectors");
+			if G_UNLIKELY (mults == NULL)
+				return NULL;
+		}
+	}
 
-	reps = gel_get_nonnegative_integer (a[1]->val.value, "MillerRabinTest");
-	if (reps < 0)
+	return matnum_eigen (a, TRUE, evs, mults, "NumericalEigenvectors");
+}
+
+static GelETree *
+QRDecomposition_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelMatrixW *m;
+	GelEFunc *qref = NULL;
+	GelETree *ret;
+	int n, i;
+
+	if G_UNLIKELY ( ! check_argument_value_only_matrix (a, 0, "QRDecomposition") ||
+			! check_argument_square_matrix (a, 0, "QRDecomposition"))
 		return NULL;
+	if (a[1]->type != GEL_NULL_NODE) {
+		qref = get_reference (a[1], _("second argument"),
+				      "QRDecomposition");
+		if G_UNLIKELY (qref == NULL)
+			return NULL;
+	}
 
-	num = mpw_peek_real_mpz (a[0]->val.value);
+	m = a[0]->mat.matrix;
+	n = gel_matrixw_width (m);
+
+	if (matnum_use_double (m, FALSE)) {
+		double *ad = g_new (double, n*n);
+		double *q = NULL;
+
+		if (qref != NULL)
+			q = g_new (double, n*n);
+		matnum_get_d (m, n, ad);
+		gel_matnum_qr_d (ad, n, n, q);
+		ret = matnum_make_d (ad, n, n);
+		if (qref != NULL) {
+			d_set_value (qref, matnum_make_d (q, n, n));
+			g_free (q);
+		}
+		g_free (ad);
+	} else {
+		mpw_t *am = matnum_get_mpw (m, n);
+		mpw_t *q = NULL;
+
+		for (i = 0; i < n*n; i++)
+			mpw_make_float (am[i]);
+		if (qref != NULL) {
+			q = g_new (mpw_t, n*n);
+			for (i = 0; i < n*n; i++)
+				mpw_init (q[i]);
+		}
+		gel_matnum_qr_mpw (am, n, n, q);
+		ret = matnum_make_mpw (am, n, n);
+		g_free (am);
+		if (qref != NULL) {
+			d_set_value (qref, matnum_make_mpw (q, n, n));
+			g_free (q);
+		}
+	}
 
-	ret = mpz_millerrabin (num, reps);
+	return ret;
+}
 
-	return gel_makenum_bool (ret);
+/* Crout form from the LU of gel_matnum_lu_*, L = L1 D and U = D^{-1} U1
+ * where D is the diagonal of U1, so that U has the unit diagonal */
+static void
+matnum_crout_d (const double *lu, int n, double *l, double *u)
+{
+	int i, j;
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			double d = lu[j + j*n];
+			if (i > j) {
+				l[i + j*n] = lu[i + j*n] * d;
+				u[i + j*n] = 0.0;
+			} else if (i == j) {
+				l[i + j*n] = d;
+				u[i + j*n] = 1.0;
+			} else {
+				l[i + j*n] = 0.0;
+				u[i + j*n] = lu[i + j*n] / lu[i + i*n];
+			}
+		}
+	}
 }
 
-static GelETree *
-MillerRabinTestSure_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+static void
+matnum_crout_mpw (mpw_t *lu, int n, mpw_t *l, mpw_t *u)
 {
-	int ret;
-	mpz_ptr num;
+	int i, j;
+	for (j = 0; j < n; j++) {
+		for (i = 0; i < n; i++) {
+			if (i > j) {
+				mpw_init (l[i + j*n]);
+				mpw_mul (l[i + j*n], lu[i + j*n], lu[j + j*n]);
+				mpw_init (u[i + j*n]);
+			} else if (i == j) {
+				mpw_init_set (l[i + j*n], lu[j + j*n]);
+				mpw_init (u[i + j*n]);
+				mpw_set_ui (u[i + j*n], 1);
+			} else {
+				mpw_init (l[i + j*n]);
+				mpw_init (u[i + j*n]);
+				mpw_div (u[i + j*n], lu[i + j*n], lu[i + i*n]);
+			}
+		}
+	}
+}
 
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix (ctx, a[0],
-						 MillerRabinTestSure_op,
-						 "MillerRabinTestSure", exception);
+static GelETree *
+LUDecomposition_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelMatrixW *m;
+	GelEFunc *lref, *uref, *pref = NULL;
+	GelETree *lval = NULL, *uval = NULL;
+	int *perm;
+	int n, i, k;
+	gboolean ret;
 
-	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "MillerRabinTestSure"))
+	if G_UNLIKELY ( ! check_argument_value_only_matrix (a, 0, "LUDecomposition") ||
+			! check_argument_square_matrix (a, 0, "LUDecomposition"))
 		return NULL;
-	if G_UNLIKELY (mpw_cmp_ui (a[0]->val.value, 2) <= 0) {
-		gel_errorout (_("%s: argument must be greater "
-				"than 2"), "MillerRabinTestSure");
+	lref = get_reference (a[1], _("second argument"), "LUDecomposition");
+	if G_UNLIKELY (lref == NULL)
 		return NULL;
+	uref = get_reference (a[2], _("third argument"), "LUDecomposition");
+	if G_UNLIKELY (uref == NULL)
+		return NULL;
+	if (a[3] != NULL) {
+		pref = get_reference (a[3], _("fourth argument"),
+				      "LUDecomposition");
+		if G_UNLIKELY (pref == NULL)
+			return NULL;
 	}
 
-	num = mpw_peek_real_mpz (a[0]->val.value);
+	m = a[0]->mat.matrix;
+	n = gel_matrixw_width (m);
+	perm = g_new (int, n);
+
+	/* exact matrices are decomposed exactly */
+	if (matnum_use_double (m, TRUE /* need_float */)) {
+		double *lu = g_new (double, n*n);
+		matnum_get_d (m, n, lu);
+		ret = gel_matnum_lu_d (lu, n, perm, pref != NULL);
+		if (ret) {
+			double *l = g_new (double, n*n);
+			double *u = g_new (double, n*n);
+			matnum_crout_d (lu, n, l, u);
+			lval = matnum_make_d (l, n, n);
+			uval = matnum_make_d (u, n, n);
+			g_free (l);
+			g_free (u);
+		}
+		g_free (lu);
+	} else {
+		mpw_t *lu = matnum_get_mpw (m, n);
+		ret = gel_matnum_lu_mpw (lu, n, perm, pref != NULL);
+		if (ret) {
+			mpw_t *l = g_new (mpw_t, n*n);
+			mpw_t *u = g_new (mpw_t, n*n);
+			matnum_crout_mpw (lu, n, l, u);
+			lval = matnum_make_mpw (l, n, n);
+			uval = matnum_make_mpw (u, n, n);
+			g_free (l);
+			g_free (u);
+		}
+		matnum_free_mpw (lu, n*n);
+	}
 
-	ret = mympz_miller_rabin_test_sure (num);
+	if G_UNLIKELY (gel_interrupted) {
+		if (ret) {
+			gel_freetree (lval);
+			gel_freetree (uval);
+		}
+		g_free (perm);
+		return NULL;
+	}
 
-	return gel_makenum_bool (ret);
-}
+	if ( ! ret) {
+		d_set_value (lref, gel_makenum_null ());
+		d_set_value (uref, gel_makenum_null ());
+		if (pref != NULL)
+			d_set_value (pref, gel_makenum_null ());
+		g_free (perm);
+		return gel_makenum_bool (FALSE);
+	}
 
-static GelETree *
-Factorize_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
-{
-	mpz_ptr numz;
-	GArray *fact;
-	GelETree *n;
-	GelMatrixW *mn;
-	guint i;
+	d_set_value (lref, lval);
+	d_set_value (uref, uval);
 
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix (ctx, a[0],
-						 Factorize_op,
-						 "Factorize", exception);
+	if (pref != NULL) {
+		/* row i of PA is row idx[i] of A */
+		GelMatrix *pm;
+		GelETree *pval;
+		int *idx = g_new (int, n);
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Factorize"))
-		return NULL;
+		for (i = 0; i < n; i++)
+			idx[i] = i;
+		for (k = 0; k < n; k++) {
+			int tmp = idx[k];
+			idx[k] = idx[perm[k]];
+			idx[perm[k]] = tmp;
+		}
 
-	numz = mpw_peek_real_mpz (a[0]->val.value);
+		pm = gel_matrix_new ();
+		gel_matrix_set_size (pm, n, n, FALSE /* padding */);
+		for (i = 0; i < n; i++)
+			for (k = 0; k < n; k++)
+				gel_matrix_index (pm, k, i) =
+					gel_makenum_ui (idx[i] == k ? 1 : 0);
+		g_free (idx);
 
-	fact = mympz_pollard_rho_factorize (numz);
+		GEL_GET_NEW_NODE (pval);
+		pval->type = GEL_MATRIX_NODE;
+		pval->mat.matrix = gel_matrixw_new_with_matrix_value_only_integer (pm);
+		pval->mat.quoted = FALSE;
+		d_set_value (pref, pval);
+	}
 
-	/* error or interrupt or whatnot */
-	if G_UNLIKELY (fact == NULL) {
-		RAISE_EXCEPTION (exception);
-		return NULL;
+	g_free (perm);
+	return gel_makenum_bool (TRUE);
+}
+
+/* The entries of an integer matrix rowwise (or of its transpose) for
+ * normalform.h */
+static mpz_t *
+nf_get_mpz (GelMatrixW *m, gboolean transpose)
+{
+	int i, j, w, h;
+	mpz_t *a;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	a = g_new (mpz_t, w*h);
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			GelETree *t = gel_matrixw_get_index (m, i, j);
+			mpz_ptr z = transpose ? a[i*h+j] : a[j*w+i];
+			if (t == NULL)
+				mpz_init (z);
+			else
+				mpz_init_set (z, mpw_peek_real_mpz (t->val.value));
+		}
 	}
+	return a;
+}
+
+/* Make an h by w matrix out of rowwise entries, a is freed */
+static GelETree *
+nf_make_matrix (mpz_t *a, int h, int w)
+{
+	GelETree *n;
+	GelMatrix *m;
+	int i, j;
+
+	m = gel_matrix_new ();
+	gel_matrix_set_size (m, w, h, FALSE /* padding */);
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			mpz_ptr z = a[j*w+i];
+			if (mpz_sgn (z) == 0) {
+				mpz_clear (z);
+			} else {
+				mpw_t v;
+				mpw_init (v);
+				mpw_set_mpz_use (v, z);
+				gel_matrix_index (m, i, j) = gel_makenum_use (v);
+			}
+		}
+	}
+	g_free (a);
 
 	GEL_GET_NEW_NODE (n);
 	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new();
+	n->mat.matrix = gel_matrixw_new_with_matrix_value_only (m);
 	n->mat.quoted = FALSE;
-	gel_matrixw_set_size (mn, fact->len, 2);
-	
-	for (i = 0; i < fact->len; i++) {
-		GelFactor f = g_array_index (fact, GelFactor, i);
-		mpw_t num;
-		mpw_init (num);
-		mpw_set_mpz_use (num, f.num);
-		gel_matrixw_set_index (mn, i, 0) = gel_makenum_use (num);
-		gel_matrixw_set_index (mn, i, 1) = gel_makenum_ui (f.exp);
-	}
-
-	g_array_free (fact, TRUE /*free segment */);
-
 	return n;
 }
 
-static GelETree *
-ModInvert_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+static void
+nf_free (mpz_t *a, int len)
 {
-	mpw_t ret;
+	int i;
+	for (i = 0; i < len; i++)
+		mpz_clear (a[i]);
+	g_free (a);
+}
 
-	if (a[0]->type == GEL_MATRIX_NODE ||
-	    a[1]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
-						   ModInvert_op,
-						   "ModInvert",
-						   exception);
+/* The min(w,h) invariant factors of an integer matrix.  The Smith form
+ * of the transpose is the transpose, so we can always make it tall.  If
+ * it has full rank we work modulo a maximal minor, otherwise we do the
+ * exact elimination. */
+static mpz_t *
+nf_invariant_factors (GelMatrixW *m, int *len)
+{
+	int w = gel_matrixw_width (m);
+	int h = gel_matrixw_height (m);
+	gboolean transpose = (h < w);
+	int rows = MAX (w, h);
+	int cols = MIN (w, h);
+	mpz_t *a, *s;
+	mpz_t d;
+	int i;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "ModInvert") ||
-			! check_argument_integer (a, 1, "ModInvert"))
-		return NULL;
+	a = nf_get_mpz (m, transpose);
+	s = g_new (mpz_t, cols);
+	for (i = 0; i < cols; i++)
+		mpz_init (s[i]);
 
-	mpw_init (ret);
-	mpw_invert (ret, a[0]->val.value, a[1]->val.value);
-	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
-		mpw_clear (ret);
-		gel_error_num = GEL_NO_ERROR;
-		return NULL;
+	mpz_init (d);
+	if (gel_int_lattice_det (d, a, rows, cols)) {
+		gel_int_snf_mod (s, a, rows, cols, d);
+	} else {
+		gel_int_snf (a, rows, cols, NULL, NULL);
+		for (i = 0; i < cols; i++)
+			mpz_set (s[i], a[i*cols+i]);
 	}
-	return gel_makenum_use (ret);
+	mpz_clear (d);
+	nf_free (a, w*h);
+
+	*len = cols;
+	return s;
 }
 
 static GelETree *
-Divides_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+SmithNormalFormInteger_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	int ret;
-	mpz_ptr numa, numb;
-
-	if (a[0]->type == GEL_MATRIX_NODE ||
-	    a[1]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1], Divides_op, "Divides", exception);
+	GelMatrixW *m;
+	GelEFunc *uref = NULL, *vref = NULL;
+	mpz_t *s, *u, *v;
+	int i, w, h, len;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Divides") ||
-			! check_argument_integer (a, 1, "Divides"))
+	if G_UNLIKELY ( ! check_argument_integer_matrix (a, 0, "SmithNormalFormInteger"))
 		return NULL;
+	if (a[1] != NULL) {
+		uref = get_reference (a[1], _("second argument"),
+				      "SmithNormalFormInteger");
+		if G_UNLIKELY (uref == NULL)
+			return NULL;
+		if (a[2] != NULL) {
+			vref = get_reference (a[2], _("third argument"),
+					      "SmithNormalFormInteger");
+			if G_UNLIKELY (vref == NULL)
+				return NULL;
+		}
+	}
 
-	numa = mpw_peek_real_mpz (a[0]->val.value);
-	numb = mpw_peek_real_mpz (a[1]->val.value);
+	m = a[0]->mat.matrix;
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
 
-	if (mpz_sgn (numa) == 0) {
-		gel_errorout (_("Division by zero!"));
+	if (uref == NULL && vref == NULL) {
+		mpz_t *d = nf_invariant_factors (m, &len);
+		s = g_new (mpz_t, w*h);
+		for (i = 0; i < w*h; i++)
+			mpz_init (s[i]);
+		for (i = 0; i < len; i++)
+			mpz_swap (s[i*w+i], d[i]);
+		nf_free (d, len);
+		return nf_make_matrix (s, h, w);
+	}
+
+	s = nf_get_mpz (m, FALSE);
+	u = g_new (mpz_t, h*h);
+	for (i = 0; i < h*h; i++)
+		mpz_init (u[i]);
+	v = g_new (mpz_t, w*w);
+	for (i = 0; i < w*w; i++)
+		mpz_init (v[i]);
+
+	gel_int_snf (s, h, w, u, v);
+
+	d_set_value (uref, nf_make_matrix (u, h, h));
+	if (vref != NULL)
+		d_set_value (vref, nf_make_matrix (v, w, w));
+	else
+		nf_free (v, w*w);
+	return nf_make_matrix (s, h, w);
+}
 
+static GelETree *
+HermiteNormalFormInteger_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelMatrixW *m;
+	GelEFunc *uref = NULL;
+	mpz_t *hm, *u;
+	mpz_t d;
+	int i, w, h;
+
+	if G_UNLIKELY ( ! check_argument_integer_matrix (a, 0, "HermiteNormalFormInteger"))
 		return NULL;
+	if (a[1] != NULL) {
+		uref = get_reference (a[1], _("second argument"),
+				      "HermiteNormalFormInteger");
+		if G_UNLIKELY (uref == NULL)
+			return NULL;
 	}
 
-	ret = mpz_divisible_p (numb, numa);
+	m = a[0]->mat.matrix;
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	hm = nf_get_mpz (m, FALSE);
 
-	return gel_makenum_bool (ret);
+	if (uref != NULL) {
+		u = g_new (mpz_t, h*h);
+		for (i = 0; i < h*h; i++)
+			mpz_init (u[i]);
+		gel_int_hnf (hm, h, w, u);
+		d_set_value (uref, nf_make_matrix (u, h, h));
+		return nf_make_matrix (hm, h, w);
+	}
+
+	mpz_init (d);
+	if (gel_int_lattice_det (d, hm, h, w))
+		gel_int_hnf_mod (hm, h, w, d);
+	else
+		gel_int_hnf (hm, h, w, NULL);
+	mpz_clear (d);
+
+	return nf_make_matrix (hm, h, w);
 }
 
 static GelETree *
-ExactDivision_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+InvariantFactorsInteger_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	mpz_ptr numa, numb;
-	mpz_t ret;
-	mpw_t retw;
-
-	if (a[0]->type == GEL_MATRIX_NODE ||
-	    a[1]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1], ExactDivision_op, "ExactDivision", exception);
+	mpz_t *s;
+	int len;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "ExactDivision") ||
-			! check_argument_integer (a, 1, "ExactDivision"))
+	if G_UNLIKELY ( ! check_argument_integer_matrix (a, 0, "InvariantFactorsInteger"))
 		return NULL;
 
-	numa = mpw_peek_real_mpz (a[0]->val.value);
-	numb = mpw_peek_real_mpz (a[1]->val.value);
+	s = nf_invariant_factors (a[0]->mat.matrix, &len);
+	return nf_make_matrix (s, 1, len);
+}
 
-	if (mpz_sgn (numb) == 0) {
-		gel_errorout (_("Division by zero!"));
+static GelETree *
+DeterminantalDivisorsInteger_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	mpz_t *s;
+	int i, len;
 
+	if G_UNLIKELY ( ! check_argument_integer_matrix (a, 0, "DeterminantalDivisorsInteger"))
 		return NULL;
-	}
-
-	mpz_init (ret);
-	mpz_divexact (ret, numa, numb);
-
-	mpw_init (retw);
-	mpw_set_mpz_use (retw, ret);
 
-	return gel_makenum (retw);
+	/* the k-th divisor is s1 s2 ... sk */
+	s = nf_invariant_factors (a[0]->mat.matrix, &len);
+	for (i = 1; i < len; i++)
+		mpz_mul (s[i], s[i], s[i-1]);
+	return nf_make_matrix (s, 1, len);
 }
 
-/* this can return 0! unlike what poly_cut_zeros does */
-static int
-poly_find_cutoff_size (GelMatrixW *m)
+/* this is utterly stupid, but only used for small primes
+ * where it's all ok */
+static gboolean
+is_prime_small (unsigned int testnum)
 {
 	int i;
-	int cutoff;
-	for(i = gel_matrixw_width(m)-1; i >= 0; i--) {
-		GelETree *t = gel_matrixw_get_index(m,i,0);
-	       	if (t != NULL &&
-		    ! mpw_zero_p (t->val.value))
-			break;
+	unsigned int s = (unsigned int)sqrt(testnum);
+	
+	for(i=0;g_array_index(primes,unsigned int,i)<=s && i<numprimes;i++) {
+		if((testnum%g_array_index(primes,unsigned int,i))==0) {
+			return FALSE;
+		}
 	}
-	cutoff = i+1;
-	return cutoff;
+	return TRUE;
 }
 
-static void
-poly_cut_zeros(GelMatrixW *m)
+static GelETree *
+Prime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	int i;
-	int cutoff;
-	for(i=gel_matrixw_width(m)-1;i>=1;i--) {
-		GelETree *t = gel_matrixw_get_index(m,i,0);
-	       	if (t != NULL &&
-		    ! mpw_zero_p (t->val.value))
-			break;
-	}
-	cutoff = i+1;
-	if(cutoff==gel_matrixw_width(m))
-		return;
-	gel_matrixw_set_size(m,cutoff,1);
-}
+	long num;
+	unsigned int i;
+	unsigned int last_prime;
 
-static gboolean
-check_poly(GelETree * *a, int args, const char *func, gboolean complain)
-{
-	int i,j;
+	if(a[0]->type==GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix(ctx,a[0],Prime_op,"prime", exception);
 
-	for (j = 0; j < args; j++) {
-		if (a[j]->type != GEL_MATRIX_NODE ||
-		    gel_matrixw_height (a[j]->mat.matrix) != 1) {
-			if G_UNLIKELY (complain)
-				gel_errorout (_("%s: arguments not horizontal vectors"),
-					      func);
-			return FALSE;
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "Prime"))
+		return NULL;
+
+	num = gel_get_nonnegative_integer (a[0]->val.value, "Prime");
+	if G_UNLIKELY (num < 0)
+		return NULL;
+	
+	if G_UNLIKELY (primes == NULL) {
+		unsigned int b;
+		primes = g_array_new(FALSE,FALSE,sizeof(unsigned int));
+		b = 2;
+		primes = g_array_append_val(primes,b);
+		b = 3;
+		primes = g_array_append_val(primes,b);
+		b = 5;
+		primes = g_array_append_val(primes,b);
+		b = 7;
+		primes = g_array_append_val(primes,b);
+		numprimes = 4;
+	}
+	
+	if(num-1 < numprimes)
+		return gel_makenum_ui(g_array_index(primes,unsigned int,num-1));
+
+	last_prime = g_array_index (primes, unsigned int, numprimes-1);
+	primes = g_array_set_size(primes,num);
+	for(i=g_array_index(primes,unsigned int,numprimes-1)+2;
+	    numprimes<=num-1 && numprimes <= MAXPRIMES && i<=G_MAXUINT-1;i+=2) {
+		if (is_prime_small (i)) {
+			g_array_index(primes,unsigned int,numprimes++) = i;
+			last_prime = i;
 		}
+	}
 
-		for(i=0;i<gel_matrixw_width(a[j]->mat.matrix);i++) {
-			GelETree *t = gel_matrixw_index(a[j]->mat.matrix,i,0);
-			if (t->type != GEL_VALUE_NODE) {
-				if G_UNLIKELY (complain)
-					gel_errorout (_("%s: arguments not numeric only vectors"),
-						      func);
-				return FALSE;
-			}
+	if (numprimes <= num-1) {
+		mpw_t prime;
+		mpw_init (prime);
+		mpw_set_ui (prime, last_prime);
+		for (i = numprimes; i <= num-1; i++) {
+			mpw_nextprime (prime, prime);
 		}
+		return gel_makenum_use (prime);
 	}
-	return TRUE;
+	return gel_makenum_ui(g_array_index(primes,unsigned int,num-1));
 }
 
 static GelETree *
-AddPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+NextPrime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	long size;
-	int i;
-	GelMatrixW *m1,*m2,*mn;
-	
-	if G_UNLIKELY ( ! check_poly(a,2,"AddPoly",TRUE))
-		return NULL;
+	mpw_t ret;
 
-	m1 = a[0]->mat.matrix;
-	m2 = a[1]->mat.matrix;
+	if(a[0]->type==GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix(ctx,a[0],NextPrime_op,"NextPrime", exception);
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new();
-	n->mat.quoted = FALSE;
-	size = MAX(gel_matrixw_width(m1), gel_matrixw_width(m2));
-	gel_matrixw_set_size(mn,size,1);
-	
-	for(i=0;i<size;i++) {
-		if(i<gel_matrixw_width(m1) &&
-		   i<gel_matrixw_width(m2)) {
-			GelETree *l,*r;
-			mpw_t t;
-			mpw_init(t);
-			l = gel_matrixw_index(m1,i,0);
-			r = gel_matrixw_index(m2,i,0);
-			mpw_add(t,l->val.value,r->val.value);
-			gel_matrixw_set_index(mn,i,0) = gel_makenum_use(t);
-		} else if(i<gel_matrixw_width(m1)) {
-			gel_matrixw_set_index(mn,i,0) =
-				gel_copynode(gel_matrixw_get_index(m1,i,0));
-		} else /*if(i<gel_matrixw_width(m2)*/ {
-			gel_matrixw_set_index(mn,i,0) =
-				gel_copynode(gel_matrixw_set_index(m2,i,0));
-		}
-	}
-	
-	poly_cut_zeros(mn);
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "NextPrime"))
+		return NULL;
 
-	return n;
+	mpw_init (ret);
+	mpw_nextprime (ret, a[0]->val.value);
+	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
+		mpw_clear (ret);
+		/* eek! should not happen */
+		gel_error_num = GEL_NO_ERROR;
+		return NULL;
+	}
+	return gel_makenum_use (ret);
 }
 
 static GelETree *
-SubtractPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+LucasNumber_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	long size;
-	int i;
-	GelMatrixW *m1,*m2,*mn;
-	
-	if G_UNLIKELY ( ! check_poly(a,2,"SubtractPoly",TRUE))
-		return NULL;
+	mpw_t ret;
 
-	m1 = a[0]->mat.matrix;
-	m2 = a[1]->mat.matrix;
+	if(a[0]->type==GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix(ctx,a[0],LucasNumber_op,"LucasNumber", exception);
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new();
-	n->mat.quoted = FALSE;
-	size = MAX(gel_matrixw_width(m1), gel_matrixw_width(m2));
-	gel_matrixw_set_size(mn,size,1);
-
-	for(i=0;i<size;i++) {
-		if(i<gel_matrixw_width(m1) &&
-		   i<gel_matrixw_width(m2)) {
-			GelETree *l,*r;
-			mpw_t t;
-			mpw_init(t);
-			l = gel_matrixw_index(m1,i,0);
-			r = gel_matrixw_index(m2,i,0);
-			mpw_sub(t,l->val.value,r->val.value);
-			gel_matrixw_set_index(mn,i,0) = gel_makenum_use(t);
-		} else if(i<gel_matrixw_width(m1)) {
-			gel_matrixw_set_index(mn,i,0) =
-				gel_copynode(gel_matrixw_set_index(m1,i,0));
-		} else /*if(i<gel_matrixw_width(m2))*/ {
-			GelETree *nn,*r;
-			r = gel_matrixw_index(m2,i,0);
-			nn = gel_makenum_ui(0);
-			mpw_neg(nn->val.value,r->val.value);
-			gel_matrixw_set_index(mn,i,0) = nn;
-		}
-	}
-	
-	poly_cut_zeros(mn);
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "LucasNumber"))
+		return NULL;
 
-	return n;
+	mpw_init (ret);
+	mpw_lucnum (ret, a[0]->val.value);
+	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
+		mpw_clear (ret);
+		gel_error_num = GEL_NO_ERROR;
+		return NULL;
+	}
+	return gel_makenum_use (ret);
 }
 
 static GelETree *
-MultiplyPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+IsPrime_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	long size;
-	int i,j;
-	mpw_t accu;
-	GelMatrixW *m1,*m2,*mn;
-	
-	if G_UNLIKELY ( ! check_poly(a,2,"MultiplyPoly",TRUE))
+	int ret;
+	mpz_ptr num;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0], IsPrime_op, "IsPrime", exception);
+
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "IsPrime"))
 		return NULL;
-	m1 = a[0]->mat.matrix;
-	m2 = a[1]->mat.matrix;
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new();
-	n->mat.quoted = FALSE;
-	size = gel_matrixw_width(m1) + gel_matrixw_width(m2);
-	gel_matrixw_set_size(mn,size,1);
-	
-	mpw_init(accu);
-		
-	for(i=0;i<gel_matrixw_width(m1);i++) {
-		for(j=0;j<gel_matrixw_width(m2);j++) {
-			GelETree *l,*r,*nn;
-			l = gel_matrixw_get_index(m1,i,0);
-			r = gel_matrixw_get_index(m2,j,0);
-			if (l == NULL ||
-			    r == NULL ||
-			    mpw_zero_p (l->val.value) ||
-			    mpw_zero_p (r->val.value))
-				continue;
-			mpw_mul(accu,l->val.value,r->val.value);
-			nn = gel_matrixw_get_index(mn,i+j,0);
-			if(nn)
-				mpw_add(nn->val.value,nn->val.value,accu);
-			else 
-				gel_matrixw_set_index(mn,i+j,0) =
-					gel_makenum(accu);
-		}
-	}
+	num = mpw_peek_real_mpz (a[0]->val.value);
 
-	mpw_clear(accu);
-	
-	poly_cut_zeros(mn);
+	ret = mympz_is_prime (num, -1);
 
-	return n;
+	return gel_makenum_bool (ret);
 }
 
 static GelETree *
-DividePoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+StrongPseudoprimeTest_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n, *rn, *ql;
-	long size, sizeq;
-	int i, j;
-	GelMatrixW *pm, *qm, *mn, *rem;
-	GelEFunc *retrem = NULL;
-	mpw_t tmp;
-	
-	if G_UNLIKELY ( ! check_poly (a, 2, "DividePoly", TRUE))
-		return NULL;
-	if (a[2] != NULL) {
-		if (a[2]->type != GEL_NULL_NODE) {
-			retrem = get_reference (a[2], _("third argument"),
-						"DividePoly");
-			if G_UNLIKELY (retrem == NULL)
-				return NULL;
-		}
-		if G_UNLIKELY (a[3] != NULL) {
-			gel_errorout (_("%s: too many arguments"),
-				      "DividePoly");
-			return NULL;
-		}
-	}
-
-	pm = a[0]->mat.matrix;
-	qm = a[1]->mat.matrix;
+	int ret;
+	mpz_ptr num;
+	mpz_ptr b;
 
-	size = poly_find_cutoff_size (pm);
-	sizeq = poly_find_cutoff_size (qm);
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   StrongPseudoprimeTest_op,
+						   "StrongPseudoprimeTest",
+						   exception);
 
-	if (sizeq <= 0) {
-		gel_errorout ("%s: %s",
-			      "DividePoly",
-			      _("Division by zero!"));
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "StrongPseudoprimeTest") ||
+			! check_argument_positive_integer (a, 1, "StrongPseudoprimeTest"))
 		return NULL;
-	}
 
-	GEL_GET_NEW_NODE (n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new ();
-	n->mat.quoted = FALSE;
+	num = mpw_peek_real_mpz (a[0]->val.value);
+	b = mpw_peek_real_mpz (a[1]->val.value);
 
-	/* nothing to do */
-	if (size < sizeq) {
-		gel_matrixw_set_size (mn, 1, 1);
+	ret = mympz_strong_pseudoprime_test (num, b);
 
-		if (retrem != NULL) {
-			GEL_GET_NEW_NODE(rn);
-			rn->type = GEL_MATRIX_NODE;
-			rn->mat.matrix = gel_matrixw_copy (pm);
-			poly_cut_zeros (rn->mat.matrix);
-			rn->mat.quoted = FALSE;
-			d_set_value (retrem, rn);
-		}
+	return gel_makenum_bool (ret);
+}
 
-		return n;
-	}
+static GelETree *
+MillerRabinTest_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	int ret;
+	int reps;
+	mpz_ptr num;
 
-	gel_matrixw_set_size (mn, size, 1);
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   MillerRabinTest_op,
+						   "MillerRabinTest",
+						   exception);
 
-	rem = gel_matrixw_copy (pm);
-	gel_matrixw_make_private (rem, TRUE /* kill_type_caches */);
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "MillerRabinTest") ||
+			! check_argument_positive_integer (a, 1, "MillerRabinTest"))
+		return NULL;
 
-	/* we know ql can't be zero */
-	ql = gel_matrixw_index (qm, sizeq-1, 0);
+	reps = gel_get_nonnegative_integer (a[1]->val.value, "MillerRabinTest");
+	if (reps < 0)
+		return NULL;
 
-	mpw_init (tmp);
+	num = mpw_peek_real_mpz (a[0]->val.value);
 
-	for (i = size-sizeq; i >= 0; i--) {
-		GelETree *pt;
-		pt = gel_matrixw_get_index (rem, i+sizeq-1, 0);
-		if (pt == NULL || mpw_zero_p (pt->val.value)) {
-			/* Leave mn[i,0] at NULL (zero) */
-			continue;
-		}
-		gel_matrixw_set_index (mn, i, 0) = pt;
-		gel_matrixw_set_index (rem, i+sizeq-1, 0) = NULL;
-		mpw_div (pt->val.value,
-			 pt->val.value, ql->val.value);
+	ret = mpz_millerrabin (num, reps);
 
-		for (j = 0; j < sizeq-1; j++) {
-			GelETree *rv, *qt;
-			rv = gel_matrixw_get_index (rem, i+j, 0);
-			if (rv == NULL)
-				rv = gel_matrixw_set_index (rem, i+j, 0)
-					= gel_makenum_ui (0);
-			qt = gel_matrixw_index (qm, j, 0);
-			mpw_mul (tmp, pt->val.value, qt->val.value);
-			mpw_sub (rv->val.value, rv->val.value, tmp);
-		}
-	}
+	return gel_makenum_bool (ret);
+}
 
-	mpw_clear (tmp);
+static GelETree *
+MillerRabinTestSure_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	int ret;
+	mpz_ptr num;
 
-	poly_cut_zeros (mn);
-
-	if (retrem != NULL) {
-		poly_cut_zeros (rem);
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0],
+						 MillerRabinTestSure_op,
+						 "MillerRabinTestSure", exception);
 
-		GEL_GET_NEW_NODE (rn);
-		rn->type = GEL_MATRIX_NODE;
-		rn->mat.matrix = rem;
-		rn->mat.quoted = FALSE;
-		d_set_value (retrem, rn);
-	} else {
-		gel_matrixw_free (rem);
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "MillerRabinTestSure"))
+		return NULL;
+	if G_UNLIKELY (mpw_cmp_ui (a[0]->val.value, 2) <= 0) {
+		gel_errorout (_("%s: argument must be greater "
+				"than 2"), "MillerRabinTestSure");
+		return NULL;
 	}
 
-	return n;
+	num = mpw_peek_real_mpz (a[0]->val.value);
+
+	ret = mympz_miller_rabin_test_sure (num);
+
+	return gel_makenum_bool (ret);
 }
 
 static GelETree *
-PolyDerivative_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+Factorize_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
+	mpz_ptr numz;
+	GArray *fact;
 	GelETree *n;
-	int i;
-	GelMatrixW *m,*mn;
-	
-	if G_UNLIKELY ( ! check_poly(a,1,"PolyDerivative",TRUE))
+	GelMatrixW *mn;
+	guint i;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0],
+						 Factorize_op,
+						 "Factorize", exception);
+
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Factorize"))
 		return NULL;
 
-	m = a[0]->mat.matrix;
+	numz = mpw_peek_real_mpz (a[0]->val.value);
 
-	GEL_GET_NEW_NODE(n);
+	fact = mympz_pollard_rho_factorize (numz);
+
+	/* error or interrupt or whatnot */
+	if G_UNLIKELY (fact == NULL) {
+		RAISE_EXCEPTION (exception);
+		return NULL;
+	}
+
+	GEL_GET_NEW_NODE (n);
 	n->type = GEL_MATRIX_NODE;
 	n->mat.matrix = mn = gel_matrixw_new();
 	n->mat.quoted = FALSE;
-	if(gel_matrixw_width(m)==1) {
-		gel_matrixw_set_size(mn,1,1);
-		return n;
-	}
-	gel_matrixw_set_size(mn,gel_matrixw_width(m)-1,1);
+	gel_matrixw_set_size (mn, fact->len, 2);
 	
-	for(i=1;i<gel_matrixw_width(m);i++) {
-		GelETree *r;
-		mpw_t t;
-		mpw_init(t);
-		r = gel_matrixw_index(m,i,0);
-		mpw_mul_ui(t,r->val.value,i);
-		gel_matrixw_set_index(mn,i-1,0) = gel_makenum_use(t);
+	for (i = 0; i < fact->len; i++) {
+		GelFactor f = g_array_index (fact, GelFactor, i);
+		mpw_t num;
+		mpw_init (num);
+		mpw_set_mpz_use (num, f.num);
+		gel_matrixw_set_index (mn, i, 0) = gel_makenum_use (num);
+		gel_matrixw_set_index (mn, i, 1) = gel_makenum_ui (f.exp);
 	}
-	
-	poly_cut_zeros(mn);
+
+	g_array_free (fact, TRUE /*free segment */);
 
 	return n;
 }
 
-static GelETree *
-Poly2ndDerivative_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+/* b and q of the discrete logarithm functions, q should be a prime */
+static gboolean
+dlog_check_args (GelETree **a, int bi, int qi, const char *funcname)
 {
-	GelETree *n;
-	int i;
-	GelMatrixW *m,*mn;
-	
-	if G_UNLIKELY ( ! check_poly(a,1,"Poly2ndDerivative",TRUE))
-		return NULL;
-
-	m = a[0]->mat.matrix;
-
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = mn = gel_matrixw_new();
-	n->mat.quoted = FALSE;
-	if(gel_matrixw_width(m)<=2) {
-		gel_matrixw_set_size(mn,1,1);
-		return n;
-	}
-	gel_matrixw_set_size(mn,gel_matrixw_width(m)-2,1);
-	
-	for(i=2;i<gel_matrixw_width(m);i++) {
-		GelETree *r;
-		mpw_t t;
-		r = gel_matrixw_index(m,i,0);
-		mpw_init(t);
-		mpw_mul_ui(t,r->val.value,i*(i-1));
-		gel_matrixw_set_index(mn,i-2,0) = gel_makenum_use(t);
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, bi, funcname) ||
+			! check_argument_positive_integer (a, qi, funcname))
+		return FALSE;
+	if G_UNLIKELY (mpz_cmp_ui (mpw_peek_real_mpz (a[bi]->val.value), 2) < 0 ||
+		       mpz_cmp_ui (mpw_peek_real_mpz (a[qi]->val.value), 2) < 0) {
+		gel_errorout (_("%s: Bad arguments"), funcname);
+		return FALSE;
 	}
-	
-	poly_cut_zeros(mn);
-
-	return n;
+	return TRUE;
 }
 
 static GelETree *
-TrimPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+dlog_make_num (mpz_ptr x)
 {
-	GelETree *n;
-	
-	if G_UNLIKELY ( ! check_poly(a,1,"TrimPoly",TRUE))
-		return NULL;
+	mpw_t num;
+	mpw_init (num);
+	mpw_set_mpz_use (num, x);
+	return gel_makenum_use (num);
+}
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_copy(a[0]->mat.matrix);
-	n->mat.quoted = FALSE;
-	
-	poly_cut_zeros(n->mat.matrix);
+/* x[i] = log_b h[i] mod q (prime), using the factorization f of q-1 if
+ * not NULL, with the error already printed on failure.  If table, the h
+ * are a factor base for index calculus (see gel_dlog_table). */
+static gboolean
+dlog_run (mpz_t *x, mpz_t *h, int len, mpz_srcptr b, mpz_srcptr q,
+	  GArray *f, gboolean table, const char *funcname)
+{
+	GArray *fact = f;
+	gboolean ret;
 
-	return n;
+	if (fact == NULL) {
+		mpz_t qm1;
+		mpz_init (qm1);
+		mpz_sub_ui (qm1, q, 1);
+		fact = mympz_pollard_rho_factorize (qm1);
+		mpz_clear (qm1);
+		if (fact == NULL)
+			return FALSE;
+	}
+
+	if (table)
+		ret = gel_dlog_table (x, h, len, b, q, fact);
+	else
+		ret = gel_dlog (x, h, len, b, q, fact);
+	if ( ! ret && ! gel_interrupted)
+		gel_errorout (_("%s: Error finding log, probably bogus arguments"),
+			      funcname);
+
+	if (f == NULL)
+		mympz_factorization_free (fact);
+	return ret;
 }
 
 static GelETree *
-IsPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+DiscreteLog_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	if(check_poly(a,1,"IsPoly",FALSE))
-		return gel_makenum_bool (1);
-	else
-		return gel_makenum_bool (0);
+	mpz_t x, h;
+	gboolean ret;
+
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "DiscreteLog") ||
+			! dlog_check_args (a, 1, 2, "DiscreteLog"))
+		return NULL;
+
+	mpz_init (x);
+	mpz_init_set (h, mpw_peek_real_mpz (a[0]->val.value));
+	ret = dlog_run (&x, &h, 1,
+			mpw_peek_real_mpz (a[1]->val.value),
+			mpw_peek_real_mpz (a[2]->val.value),
+			NULL, FALSE /* table */, "DiscreteLog");
+	mpz_clear (h);
+	if ( ! ret) {
+		mpz_clear (x);
+		return NULL;
+	}
+	return dlog_make_num (x);
 }
 
 static GelETree *
-QuadraticFormula_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+SilverPohligHellmanWithFactorization_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
 	GelMatrixW *m;
-	GelMatrix *nm;
-
-	mpw_ptr aa, bb, cc;
-	mpw_t r1, r2;
-
-	if G_UNLIKELY (a[0]->type == GEL_NULL_NODE)
-		return gel_makenum_null ();
+	GArray *fact;
+	mpz_t x, h;
+	int i, w;
+	gboolean ret;
 
-	if G_UNLIKELY ( ! check_poly(a,1,"QuadraticFormula",TRUE))
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "SilverPohligHellmanWithFactorization") ||
+			! dlog_check_args (a, 1, 2, "SilverPohligHellmanWithFactorization") ||
+			! check_argument_integer_matrix (a, 3, "SilverPohligHellmanWithFactorization"))
 		return NULL;
 
-	m = a[0]->mat.matrix;
+	/* the primes are the first row, as from Factorize */
+	m = a[3]->mat.matrix;
+	w = gel_matrixw_width (m);
+	fact = g_array_new (FALSE /* zero_terminated */,
+			    FALSE /* clear */,
+			    sizeof (GelFactor) /* element_size */);
+	for (i = 0; i < w; i++) {
+		GelFactor f;
+		GelETree *t = gel_matrixw_get_index (m, i, 0);
+		if (t == NULL)
+			mpz_init (f.num);
+		else
+			mpz_init_set (f.num, mpw_peek_real_mpz (t->val.value));
+		f.exp = 1;
+		g_array_append_val (fact, f);
+	}
 
-	if G_UNLIKELY (gel_matrixw_elements (m) != 3 ||
-		       mpw_zero_p (gel_matrixw_index(m,2,0)->val.value)) {
-		gel_errorout (_("%s: argument 1 must be a quadratic polynomial"),
-			      "QuadraticFormula");
+	mpz_init (x);
+	mpz_init_set (h, mpw_peek_real_mpz (a[0]->val.value));
+	ret = dlog_run (&x, &h, 1,
+			mpw_peek_real_mpz (a[1]->val.value),
+			mpw_peek_real_mpz (a[2]->val.value),
+			fact, FALSE /* table */,
+			"SilverPohligHellmanWithFactorization");
+	mpz_clear (h);
+	mympz_factorization_free (fact);
+	if ( ! ret) {
+		mpz_clear (x);
 		return NULL;
 	}
+	return dlog_make_num (x);
+}
 
-	aa = gel_matrixw_index(m,2,0)->val.value;
-	bb = gel_matrixw_index(m,1,0)->val.value;
-	cc = gel_matrixw_index(m,0,0)->val.value;
+/* A column of the table [S,logs] */
+static mpz_t *
+dlog_get_base (GelMatrixW *m, int col)
+{
+	int i, h = gel_matrixw_height (m);
+	mpz_t *base = g_new (mpz_t, h);
 
-	mpw_init (r1);
-	mpw_init (r2);
+	for (i = 0; i < h; i++) {
+		GelETree *t = gel_matrixw_get_index (m, col, i);
+		if (t == NULL)
+			mpz_init (base[i]);
+		else
+			mpz_init_set (base[i], mpw_peek_real_mpz (t->val.value));
+	}
+	return base;
+}
 
-	if (mpw_zero_p (cc)) {
-		mpw_div (r1, bb, aa);
-		mpw_neg (r1, r1);
-		mpw_set_ui (r2, 0);
-	} else if (mpw_zero_p (bb)) {
-		mpw_mul (r1, aa, cc);
-		mpw_neg (r1, r1);
-		mpw_sqrt (r1, r1);
-		mpw_div (r1, r1, aa);
-		mpw_neg (r2, r1);
-	} else {
-		mpw_mul (r1, bb, bb);
-		mpw_mul (r2, aa, cc);
-		mpw_mul_ui (r2, r2, 4);
-		mpw_sub (r1, r1, r2);
-		mpw_sqrt (r1, r1);
-		/* r1 is now the sqrt of the discriminant */
+/* The factor base S, a row or a column vector.  NULL and the error
+ * printed if it is neither. */
+static mpz_t *
+dlog_get_vector (GelMatrixW *m, int *len, const char *funcname)
+{
+	int i;
+	mpz_t *base;
 
-		/* try to avoid instability */
-		if (mpw_re_sgn (r1) != mpw_re_sgn (bb)) {
-			mpw_neg (r1, r1);
-		}
+	if G_UNLIKELY (gel_matrixw_width (m) != 1 &&
+		       gel_matrixw_height (m) != 1) {
+		gel_errorout (_("%s: S should be a vector"), funcname);
+		return NULL;
+	}
 
-		mpw_add (r1, r1, bb);
-		mpw_div_ui (r1, r1, 2);
-		mpw_neg (r1, r1);
+	*len = gel_matrixw_elements (m);
+	base = g_new (mpz_t, *len);
+	for (i = 0; i < *len; i++) {
+		GelETree *t = gel_matrixw_get_vindex (m, i);
+		if (t == NULL)
+			mpz_init (base[i]);
+		else
+			mpz_init_set (base[i], mpw_peek_real_mpz (t->val.value));
+	}
+	return base;
+}
 
-		/* r1 = (bb + s * sqrt(bb^2 - 4*aa*cc)) / (-2); */
+static void
+dlog_free_base (mpz_t *base, int len)
+{
+	int i;
+	for (i = 0; i < len; i++)
+		mpz_clear (base[i]);
+	g_free (base);
+}
 
-		/* set r2 first */
-		mpw_div (r2, cc, r1);
+/* The table [S,logs] for the factor base S (a vector), the logs of the
+ * elements of S come from index calculus relations over S itself */
+static GelETree *
+dlog_precalculate (GelMatrixW *m, mpz_srcptr b, mpz_srcptr q,
+		   const char *funcname)
+{
+	GelETree *n;
+	GelMatrixW *mn;
+	mpz_t *base, *logs;
+	int i, h;
 
-		mpw_div (r1, r1, aa);
-	}
+	base = dlog_get_vector (m, &h, funcname);
+	if (base == NULL)
+		return NULL;
+	logs = g_new (mpz_t, h);
+	for (i = 0; i < h; i++)
+		mpz_init (logs[i]);
 
-	nm = gel_matrix_new ();
-	gel_matrix_set_size (nm, 1, 2, FALSE /* padding */);
-	gel_matrix_index (nm, 0, 0) = gel_makenum_use (r1);
-	gel_matrix_index (nm, 0, 1) = gel_makenum_use (r2);
+	if ( ! dlog_run (logs, base, h, b, q, NULL, TRUE /* table */,
+			 funcname)) {
+		dlog_free_base (base, h);
+		dlog_free_base (logs, h);
+		return NULL;
+	}
 
 	GEL_GET_NEW_NODE (n);
 	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_new_with_matrix_value_only (nm);
+	n->mat.matrix = mn = gel_matrixw_new ();
 	n->mat.quoted = FALSE;
+	gel_matrixw_set_size (mn, 2, h);
+	for (i = 0; i < h; i++) {
+		gel_matrixw_set_index (mn, 0, i) = dlog_make_num (base[i]);
+		gel_matrixw_set_index (mn, 1, i) = dlog_make_num (logs[i]);
+	}
+	g_free (base);
+	g_free (logs);
 
 	return n;
 }
 
+static GelETree *
+IndexCalculusPrecalculation_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	if G_UNLIKELY ( ! dlog_check_args (a, 0, 1, "IndexCalculusPrecalculation") ||
+			! check_argument_integer_matrix (a, 2, "IndexCalculusPrecalculation"))
+		return NULL;
+
+	return dlog_precalculate (a[2]->mat.matrix,
+				  mpw_peek_real_mpz (a[0]->val.value),
+				  mpw_peek_real_mpz (a[1]->val.value),
+				  "IndexCalculusPrecalculation");
+}
 
 static GelETree *
-PolyToString_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+IndexCalculus_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	int i;
-	GString *gs;
-	gboolean any = FALSE;
+	GelETree *table = NULL;
 	GelMatrixW *m;
-	const char *var;
-	GelOutput *gelo;
-	char *r;
-	
-	if G_UNLIKELY ( ! check_poly(a,1,"PolyToString",TRUE))
-		return NULL;
+	mpz_t *base, *logs;
+	mpz_t x;
+	int h;
+	gboolean ret;
 
-	if (a[1] == NULL) {
-		var = "x";
-	} else if G_UNLIKELY ( ! check_argument_string (a, 1, "PolyToString")) {
+	if G_UNLIKELY ( ! check_argument_positive_integer (a, 0, "IndexCalculus") ||
+			! dlog_check_args (a, 1, 2, "IndexCalculus") ||
+			! check_argument_integer_matrix (a, 3, "IndexCalculus"))
 		return NULL;
-	} else {
-		if G_UNLIKELY (a[2] != NULL) {
-			gel_errorout (_("%s: too many arguments"),
-				      "PolyToString");
+
+	/* two columns is a table from IndexCalculusPrecalculation,
+	 * otherwise make the table first */
+	m = a[3]->mat.matrix;
+	if (gel_matrixw_width (m) != 2) {
+		table = dlog_precalculate (m,
+					   mpw_peek_real_mpz (a[1]->val.value),
+					   mpw_peek_real_mpz (a[2]->val.value),
+					   "IndexCalculus");
+		if (table == NULL)
 			return NULL;
-		}
-		var = a[1]->str.str;
+		m = table->mat.matrix;
 	}
-	
-	m = a[0]->mat.matrix;
-	
-	gs = g_string_new("");
 
-	gelo = gel_output_new();
-	gel_output_setup_string(gelo, 0, NULL);
-	gel_output_set_gstring(gelo, gs);
+	h = gel_matrixw_height (m);
+	base = dlog_get_base (m, 0);
+	logs = dlog_get_base (m, 1);
+	mpz_init (x);
+	ret = gel_dlog_with_table (x, mpw_peek_real_mpz (a[0]->val.value),
+				   mpw_peek_real_mpz (a[1]->val.value),
+				   mpw_peek_real_mpz (a[2]->val.value),
+				   base, logs, h);
+	dlog_free_base (base, h);
+	dlog_free_base (logs, h);
+	if (table != NULL)
+		gel_freetree (table);
 
-	for(i=gel_matrixw_width(m)-1;i>=0;i--) {
-		GelETree *t;
-		t = gel_matrixw_index(m,i,0);
-		if (mpw_zero_p (t->val.value))
-			continue;
-		/*positive (or complex) */
-		if (mpw_is_complex (t->val.value) ||
-		    mpw_sgn (t->val.value) > 0) {
-			if(any) g_string_append(gs," + ");
-			if (MPW_IS_COMPLEX (t->val.value)) {
-				g_string_append_c (gs, '(');
-				if (i==0) {
-					gel_print_etree (gelo, t, FALSE);
-					g_string_append_c (gs, ')');
-				} else if ( ! mpw_eql_ui(t->val.value,1)) {
-					gel_print_etree (gelo, t, FALSE);
-					g_string_append_c (gs, ')');
-					g_string_append_c(gs,'*');
-				}
-			} else {
-				if (i == 0) {
-					gel_print_etree (gelo, t, FALSE);
-				} else if ( ! mpw_eql_ui (t->val.value, 1)) {
-					gel_print_etree (gelo, t, FALSE);
-					g_string_append_c(gs,'*');
-				}
-			}
-			/*negative*/
-		} else {
-			if(any) g_string_append(gs," - ");
-			else g_string_append_c(gs,'-');
-			mpw_neg(t->val.value,t->val.value);
-			if (i == 0) {
-				gel_print_etree (gelo, t, FALSE);
-			} else if ( ! mpw_eql_ui (t->val.value, 1)) {
-				gel_print_etree (gelo, t, FALSE);
-				g_string_append_c(gs,'*');
-			}
-			mpw_neg(t->val.value,t->val.value);
-		}
-		if(i==1)
-			g_string_append_printf (gs, "%s", var);
-		else if(i>1)
-			g_string_append_printf (gs, "%s^%d", var, i);
-		any = TRUE;
+	if ( ! ret) {
+		if ( ! gel_interrupted)
+			gel_errorout (_("%s: Error finding log, probably bogus arguments"),
+				      "IndexCalculus");
+		mpz_clear (x);
+		return NULL;
 	}
-	if(!any)
-		g_string_append(gs,"0");
-
-	r = gel_output_snarf_string (gelo);
-	gel_output_unref (gelo);
-
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_STRING_NODE;
-	n->str.str = r;
-	n->str.constant = FALSE;
-	
-	return n;
+	return dlog_make_num (x);
 }
 
 static GelETree *
-ptf_makenew_power(GelToken *id, int power)
+ModInvert_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	GelETree *tokn;
-	GEL_GET_NEW_NODE(tokn);
-	tokn->type = GEL_IDENTIFIER_NODE;
-	tokn->id.id = id;
-	tokn->id.uninitialized = FALSE;
+	mpw_t ret;
 
-	if(power == 1)
-		return tokn;
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   ModInvert_op,
+						   "ModInvert",
+						   exception);
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_OPERATOR_NODE;
-	n->op.oper = GEL_E_EXP;
-	n->op.args = tokn;
-	n->op.args->any.next = gel_makenum_ui(power);
-	n->op.args->any.next->any.next = NULL;
-	n->op.nargs = 2;
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "ModInvert") ||
+			! check_argument_integer (a, 1, "ModInvert"))
+		return NULL;
 
-	return n;
+	mpw_init (ret);
+	mpw_invert (ret, a[0]->val.value, a[1]->val.value);
+	if G_UNLIKELY (gel_error_num != GEL_NO_ERROR) {
+		mpw_clear (ret);
+		gel_error_num = GEL_NO_ERROR;
+		return NULL;
+	}
+	return gel_makenum_use (ret);
 }
 
 static GelETree *
-ptf_makenew_term(mpw_t mul, GelToken *id, int power)
+Divides_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	
-	if (power == 0) {
-		return gel_makenum (mul);
-	} else if (mpw_eql_ui (mul, 1)) {
-		n = ptf_makenew_power(id,power);
-	} else {
-		GEL_GET_NEW_NODE(n);
-		n->type = GEL_OPERATOR_NODE;
-		n->op.oper = GEL_E_MUL;
-		n->op.args = gel_makenum (mul);
-		n->op.args->any.next = ptf_makenew_power(id,power);
-		n->op.args->any.next->any.next = NULL;
-		n->op.nargs = 2;
+	int ret;
+	mpz_ptr numa, numb;
+
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1], Divides_op, "Divides", exception);
+
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Divides") ||
+			! check_argument_integer (a, 1, "Divides"))
+		return NULL;
+
+	numa = mpw_peek_real_mpz (a[0]->val.value);
+	numb = mpw_peek_real_mpz (a[1]->val.value);
+
+	if (mpz_sgn (numa) == 0) {
+		gel_errorout (_("Division by zero!"));
+
+		return NULL;
 	}
-	return n;
+
+	ret = mpz_divisible_p (numb, numa);
+
+	return gel_makenum_bool (ret);
 }
 
 static GelETree *
-PolyToFunction_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+ExactDivision_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	GelETree *nn = NULL;
-	int i;
-	GelMatrixW *m;
+	mpz_ptr numa, numb;
+	mpz_t ret;
+	mpw_t retw;
 
-	static GelToken *var = NULL;
-	
-	if G_UNLIKELY ( ! check_poly(a,1,"PolyToFunction",TRUE))
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1], ExactDivision_op, "ExactDivision", exception);
+
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "ExactDivision") ||
+			! check_argument_integer (a, 1, "ExactDivision"))
 		return NULL;
-	
-	if G_UNLIKELY (var == NULL)
-		var = d_intern("x");
-	
-	m = a[0]->mat.matrix;
 
-	for(i=gel_matrixw_width(m)-1;i>=0;i--) {
-		GelETree *t;
-		t = gel_matrixw_index(m,i,0);
-		if (mpw_zero_p (t->val.value))
-			continue;
-		
-		if(!nn)
-			nn = ptf_makenew_term(t->val.value,var,i);
-		else {
-			GelETree *nnn;
-			GEL_GET_NEW_NODE(nnn);
-			nnn->type = GEL_OPERATOR_NODE;
-			nnn->op.oper = GEL_E_PLUS;
-			nnn->op.args = nn;
-			nnn->op.args->any.next =
-				ptf_makenew_term(t->val.value,var,i);
-			nnn->op.args->any.next->any.next = NULL;
-			nnn->op.nargs = 2;
-			nn = nnn;
-		}
+	numa = mpw_peek_real_mpz (a[0]->val.value);
+	numb = mpw_peek_real_mpz (a[1]->val.value);
+
+	if (mpz_sgn (numb) == 0) {
+		gel_errorout (_("Division by zero!"));
+
+		return NULL;
 	}
-	if(!nn)
-		nn = gel_makenum_ui(0);
 
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_FUNCTION_NODE;
-	n->func.func = d_makeufunc(NULL,nn,g_slist_append(NULL,var),1, NULL);
-	n->func.func->context = -1;
+	mpz_init (ret);
+	mpz_divexact (ret, numa, numb);
 
-	return n;
+	mpw_init (retw);
+	mpw_set_mpz_use (retw, ret);
+
+	return gel_makenum (retw);
+}
+
+static void
+poly_cut_zeros(GelMatrixW *m)
+{
+	int i;
+	int cutoff;
+	for(i=gel_matrixw_width(m)-1;i>=1;i--) {
+		GelETree *t = gel_matrixw_get_index(m,i,0);
+	       	if (t != NULL &&
+		    ! mpw_zero_p (t->val.value))
+			break;
+	}
+	cutoff = i+1;
+	if(cutoff==gel_matrixw_width(m))
+		return;
+	gel_matrixw_set_size(m,cutoff,1);
 }
 
+/* A polynomial as a vector of coefficients, [0] for the zero polynomial,
+ * uses up coefs */
 static GelETree *
-StringToASCII_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+poly_make_vector (mpw_t *coefs, int len)
 {
 	GelETree *n;
-	const char *s;
-	int size;
-	int i;
 	GelMatrixW *m;
+	int i;
 
-	if G_UNLIKELY ( ! check_argument_string (a, 0, "StringToASCII"))
-		return NULL;
-
-	s = a[0]->str.str;
-	size = strlen(s);
-	if (size == 0)
-		return gel_makenum_null ();
-
-	GEL_GET_NEW_NODE(n);
+	GEL_GET_NEW_NODE (n);
 	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = m = gel_matrixw_new();
+	n->mat.matrix = m = gel_matrixw_new ();
 	n->mat.quoted = FALSE;
-	gel_matrixw_set_size (m, size, 1);
-	
-	for (i = 0; i < size; i++) {
-		gel_matrixw_set_index (m, i, 0) = gel_makenum_si (s[i]);
+
+	if (len == 0) {
+		gel_matrixw_set_size (m, 1, 1);
+		return n;
 	}
 
+	gel_matrixw_set_size (m, len, 1);
+	for (i = 0; i < len; i++)
+		gel_matrixw_set_index (m, i, 0) = gel_makenum_use (coefs[i]);
+	g_free (coefs);
+
 	return n;
 }
 
-static GelETree *
-ASCIIToString_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+/* The trimmed coefficients of a polynomial vector (as passed by
+ * check_poly) in a new array */
+static mpw_t *
+poly_get_coefs (GelETree *t, int *len)
 {
-	char *s;
-	int size;
-	int i;
-	GelMatrixW *m;
+	GelMatrixW *m = t->mat.matrix;
+	mpw_t *coefs;
+	int i, l;
 
-	if (a[0]->type == GEL_NULL_NODE)
-		return gel_makenum_string ("");
+	l = gel_matrixw_width (m);
+	coefs = gel_poly_new (l);
+	for (i = 0; i < l; i++) {
+		GelETree *c = gel_matrixw_get_index (m, i, 0);
+		if (c != NULL)
+			mpw_set (coefs[i], c->val.value);
+	}
+	*len = gel_poly_trim_len (coefs, l);
+	for (i = *len; i < l; i++)
+		mpw_clear (coefs[i]);
+	if (*len == 0) {
+		g_free (coefs);
+		coefs = NULL;
+	}
+	return coefs;
+}
 
-	if G_UNLIKELY ( ! check_argument_matrix (a, 0, "ASCIIToString"))
-		return NULL;
+static gboolean
+check_poly(GelETree * *a, int args, const char *func, gboolean complain)
+{
+	int i,j;
 
-	m = a[0]->mat.matrix;
-
-	size = gel_matrixw_elements (m);
+	for (j = 0; j < args; j++) {
+		/* the polynomial type is accepted wherever vectors are */
+		if (a[j]->type == GEL_POLYNOMIAL_NODE) {
+			gel_replacenode (a[j],
+					 poly_make_vector
+					   (gel_poly_copy (a[j]->poly.coefs,
+							   a[j]->poly.len),
+					    a[j]->poly.len),
+					 FALSE /* copy */);
+			continue;
+		}
 
-	s = g_new0 (char, size+1);
+		if (a[j]->type != GEL_MATRIX_NODE ||
+		    gel_matrixw_height (a[j]->mat.matrix) != 1) {
+			if G_UNLIKELY (complain)
+				gel_errorout (_("%s: arguments not horizontal vectors"),
+					      func);
+			return FALSE;
+		}
 
-	for (i = 0; i < size; i++) {
-		GelETree *t;
-		t = gel_matrixw_vindex (m, i);
-		if (t->type != GEL_VALUE_NODE ||
-		    mpw_is_complex (t->val.value) ||
-		    ! mpw_is_integer (t->val.value) ||
-		    mpw_sgn (t->val.value) < 0 ||
-		    mpw_cmp_ui (t->val.value, 256) >= 0) {
-			g_free (s);
-			gel_errorout (_("%s: value out of range"),
-				      "ASCIIToString");
-			return NULL;
+		for(i=0;i<gel_matrixw_width(a[j]->mat.matrix);i++) {
+			GelETree *t = gel_matrixw_index(a[j]->mat.matrix,i,0);
+			if (t->type != GEL_VALUE_NODE) {
+				if G_UNLIKELY (complain)
+					gel_errorout (_("%s: arguments not numeric only vectors"),
+						      func);
+				return FALSE;
+			}
 		}
-		s[i] = mpw_get_long (t->val.value);
 	}
-
-	return gel_makenum_string_use (s);
+	return TRUE;
 }
 
-static int
-alphabet_value (char a, const char *alph)
+static GelETree *
+AddPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	int i;
-	for (i = 0; alph[i] != '\0'; i++) {
-		if (alph[i] == a)
-			return i;
-	}
-	return -1;
+	mpw_t *p, *q, *r;
+	int lp, lq, lr;
+	
+	if G_UNLIKELY ( ! check_poly(a,2,"AddPoly",TRUE))
+		return NULL;
+
+	p = poly_get_coefs (a[0], &lp);
+	q = poly_get_coefs (a[1], &lq);
+	r = gel_poly_add (p, lp, q, lq, &lr);
+	gel_poly_free (p, lp);
+	gel_poly_free (q, lq);
+
+	return poly_make_vector (r, lr);
 }
 
 static GelETree *
-StringToAlphabet_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+SubtractPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *n;
-	const char *s;
-	const char *alph;
-	int size;
-	int i;
-	GelMatrixW *m;
-
-	if G_UNLIKELY ( ! check_argument_string (a, 0, "AlphabetToString") ||
-			! check_argument_string (a, 1, "AlphabetToString"))
+	mpw_t *p, *q, *r;
+	int lp, lq, lr;
+	
+	if G_UNLIKELY ( ! check_poly(a,2,"SubtractPoly",TRUE))
 		return NULL;
 
-	s = a[0]->str.str;
-	alph = a[1]->str.str;
-	size = strlen(s);
-	if (size == 0)
-		return gel_makenum_null ();
-
-	GEL_GET_NEW_NODE(n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = m = gel_matrixw_new();
-	n->mat.quoted = FALSE;
-	gel_matrixw_set_size (m, size, 1);
-	
-	for (i = 0; i < size; i++) {
-		int val = alphabet_value (s[i], alph);
-		gel_matrixw_set_index (m, i, 0) = gel_makenum_si (val);
-	}
+	p = poly_get_coefs (a[0], &lp);
+	q = poly_get_coefs (a[1], &lq);
+	r = gel_poly_sub (p, lp, q, lq, &lr);
+	gel_poly_free (p, lp);
+	gel_poly_free (q, lq);
 
-	return n;
+	return poly_make_vector (r, lr);
 }
 
 static GelETree *
-AlphabetToString_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+MultiplyPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	char *s;
-	const char *alph;
-	int size;
-	int alph_size;
-	int i;
-	GelMatrixW *m;
-
-	if (a[0]->type == GEL_NULL_NODE)
-		return gel_makenum_string ("");
-
-	if G_UNLIKELY ( ! check_argument_matrix (a, 0, "AlphabetToString") ||
-			! check_argument_string (a, 1, "AlphabetToString"))
+	mpw_t *p, *q, *r;
+	int lp, lq, lr;
+	
+	if G_UNLIKELY ( ! check_poly(a,2,"MultiplyPoly",TRUE))
 		return NULL;
 
-	m = a[0]->mat.matrix;
-	alph = a[1]->str.str;
-
-	size = gel_matrixw_elements (m);
-	alph_size = strlen (alph);
+	p = poly_get_coefs (a[0], &lp);
+	q = poly_get_coefs (a[1], &lq);
+	r = gel_poly_mul (p, lp, q, lq, &lr);
+	gel_poly_free (p, lp);
+	gel_poly_free (q, lq);
 
-	s = g_new0 (char, size+1);
+	return poly_make_vector (r, lr);
+}
 
-	for (i = 0; i < size; i++) {
-		GelETree *t;
-		t = gel_matrixw_vindex (m, i);
-		if G_UNLIKELY (t->type != GEL_VALUE_NODE ||
-			       mpw_is_complex (t->val.value) ||
-			       ! mpw_is_integer (t->val.value) ||
-			       mpw_sgn (t->val.value) < 0 ||
-			       mpw_cmp_ui (t->val.value, alph_size) >= 0) {
-			g_free (s);
-			gel_errorout (_("%s: value out of range"),
-				      "AlphabetToString");
+static GelETree *
+DividePoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	mpw_t *p, *q, *quot, *rem;
+	int lp, lq, lquot, lrem;
+	GelEFunc *retrem = NULL;
+	gboolean ret;
+	
+	if G_UNLIKELY ( ! check_poly (a, 2, "DividePoly", TRUE))
+		return NULL;
+	if (a[2] != NULL) {
+		if (a[2]->type != GEL_NULL_NODE) {
+			retrem = get_reference (a[2], _("third argument"),
+						"DividePoly");
+			if G_UNLIKELY (retrem == NULL)
+				return NULL;
+		}
+		if G_UNLIKELY (a[3] != NULL) {
+			gel_errorout (_("%s: too many arguments"),
+				      "DividePoly");
 			return NULL;
 		}
-		s[i] = alph[mpw_get_long (t->val.value)];
 	}
 
-	return gel_makenum_string_use (s);
+	p = poly_get_coefs (a[0], &lp);
+	q = poly_get_coefs (a[1], &lq);
+	ret = gel_poly_divrem (p, lp, q, lq,
+			       &quot, &lquot,
+			       retrem != NULL ? &rem : NULL, &lrem);
+	gel_poly_free (p, lp);
+	gel_poly_free (q, lq);
+
+	if (! ret) {
+		gel_errorout ("%s: %s",
+			      "DividePoly",
+			      _("Division by zero!"));
+		return NULL;
+	}
+
+	if (retrem != NULL)
+		d_set_value (retrem, poly_make_vector (rem, lrem));
+
+	return poly_make_vector (quot, lquot);
 }
 
 static GelETree *
-SetHelp_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+PolyDerivative_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	const char *fname;
-
-	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetHelp") ||
-			! check_argument_string (a, 1, "SetHelp") ||
-			! check_argument_string (a, 2, "SetHelp"))
+	GelETree *n;
+	int i;
+	GelMatrixW *m,*mn;
+	
+	if G_UNLIKELY ( ! check_poly(a,1,"PolyDerivative",TRUE))
 		return NULL;
 
-	if (a[0]->type == GEL_IDENTIFIER_NODE) {
-		fname = a[0]->id.id->token;
-	} else /* GEL_STRING_NODE */ {
-		fname = a[0]->str.str;
+	m = a[0]->mat.matrix;
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = mn = gel_matrixw_new();
+	n->mat.quoted = FALSE;
+	if(gel_matrixw_width(m)==1) {
+		gel_matrixw_set_size(mn,1,1);
+		return n;
 	}
+	gel_matrixw_set_size(mn,gel_matrixw_width(m)-1,1);
 	
-	gel_add_category (fname, a[1]->str.str);
-	gel_add_description (fname, a[2]->str.str);
+	for(i=1;i<gel_matrixw_width(m);i++) {
+		GelETree *r;
+		mpw_t t;
+		mpw_init(t);
+		r = gel_matrixw_index(m,i,0);
+		mpw_mul_ui(t,r->val.value,i);
+		gel_matrixw_set_index(mn,i-1,0) = gel_makenum_use(t);
+	}
+	
+	poly_cut_zeros(mn);
 
-	return gel_makenum_null();
+	return n;
 }
 
 static GelETree *
-SetHelpAlias_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+Poly2ndDerivative_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	const char *fname1;
-	const char *fname2;
+	GelETree *n;
+	int i;
+	GelMatrixW *m,*mn;
 	
-	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetHelpAlias") ||
-			! check_argument_string_or_identifier (a, 1, "SetHelpAlias"))
+	if G_UNLIKELY ( ! check_poly(a,1,"Poly2ndDerivative",TRUE))
 		return NULL;
 
-	if (a[0]->type == GEL_IDENTIFIER_NODE) {
-		fname1 = a[0]->id.id->token;
-	} else /* GEL_STRING_NODE */ {
-		fname1 = a[0]->str.str;
-	}
+	m = a[0]->mat.matrix;
 
-	if (a[1]->type == GEL_IDENTIFIER_NODE) {
-		fname2 = a[1]->id.id->token;
-	} else /* GEL_STRING_NODE */ {
-		fname2 = a[1]->str.str;
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = mn = gel_matrixw_new();
+	n->mat.quoted = FALSE;
+	if(gel_matrixw_width(m)<=2) {
+		gel_matrixw_set_size(mn,1,1);
+		return n;
 	}
+	gel_matrixw_set_size(mn,gel_matrixw_width(m)-2,1);
 	
-	gel_add_alias (fname1, fname2);
-
-	return gel_makenum_null();
-}
+	for(i=2;i<gel_matrixw_width(m);i++) {
+		GelETree *r;
+		mpw_t t;
+		r = gel_matrixw_index(m,i,0);
+		mpw_init(t);
+		mpw_mul_ui(t,r->val.value,i*(i-1));
+		gel_matrixw_set_index(mn,i-2,0) = gel_makenum_use(t);
+	}
+	
+	poly_cut_zeros(mn);
 
-static GelETree *
-Identity_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
-{
-	/*
-	 * Evil optimization to avoid copying the node from the argument
-	 */
-	return gel_stealnode (a[0]);
+	return n;
 }
 
 static GelETree *
-etree_out_of_int_vector (int *vec, int len)
+TrimPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelMatrix *mm;
-	int i;
 	GelETree *n;
+	
+	if G_UNLIKELY ( ! check_poly(a,1,"TrimPoly",TRUE))
+		return NULL;
 
-	mm = gel_matrix_new ();
-	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
-
-	for (i = 0; i < len; i++) {
-		gel_matrix_index (mm, i, 0) = gel_makenum_si (vec[i]);
-	}
-
-	GEL_GET_NEW_NODE (n);
+	GEL_GET_NEW_NODE(n);
 	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_new_with_matrix_value_only_integer (mm);
+	n->mat.matrix = gel_matrixw_copy(a[0]->mat.matrix);
 	n->mat.quoted = FALSE;
+	
+	poly_cut_zeros(n->mat.matrix);
 
 	return n;
 }
 
-/* eats the glist and frees it */
 static GelETree *
-etree_out_of_etree_list (GSList *list, int len)
+IsPoly_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelMatrix *mm;
-	GSList *li;
-	int i;
-	GelETree *n;
+	if(check_poly(a,1,"IsPoly",FALSE))
+		return gel_makenum_bool (1);
+	else
+		return gel_makenum_bool (0);
+}
 
-	mm = gel_matrix_new ();
-	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+static GelETree *
+Polynomial_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	mpw_t *p;
+	int lp;
 
-	li = list;
-	for (i = 0; i < len; i++) {
-		gel_matrix_index (mm, i, 0) = li->data;
-		li = li->next;
+	if (a[0]->type == GEL_POLYNOMIAL_NODE)
+		return gel_copynode (a[0]);
+
+	if (a[0]->type == GEL_VALUE_NODE) {
+		p = gel_poly_new (1);
+		mpw_set (p[0], a[0]->val.value);
+		return gel_makenum_polynomial (p, 1);
 	}
-	g_slist_free (list);
 
-	GEL_GET_NEW_NODE (n);
-	n->type = GEL_MATRIX_NODE;
-	n->mat.matrix = gel_matrixw_new_with_matrix (mm);
-	n->mat.quoted = FALSE;
+	if G_UNLIKELY ( ! check_poly (a, 1, "Polynomial", TRUE))
+		return NULL;
 
-	return n;
+	p = poly_get_coefs (a[0], &lp);
+	return gel_makenum_polynomial (p, lp);
 }
 
-static gboolean
-comb_get_next_combination (int *vec, int len, int n)
+static GelETree *
+PolyToVector_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	int i = len;
-	int j;
+	mpw_t *p;
+	int lp;
 
-	/* do you like my gel -> C porting? */
+	if G_UNLIKELY ( ! check_poly (a, 1, "PolyToVector", TRUE))
+		return NULL;
 
-	while (i > 0 && vec[i-1] == n-(len-i)) {
-		i--;
-	}
-	if (i == 0) {
-		return FALSE;
-	} else {
-		vec[i-1] ++;
-		for (j = i+1; j <= len; j++)
-			vec[j-1] = vec[j-2]+1;
-	}
-	return TRUE;
+	p = poly_get_coefs (a[0], &lp);
+	return poly_make_vector (p, lp);
 }
 
-static gboolean
-perm_is_pos_mobile (int *perm, char *arrow, int pos, int n)
+static GelETree *
+PolyEvaluate_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	if (arrow[pos]=='L' && pos==0)
-		return FALSE;
-	else if (arrow[pos]=='R' && pos==n-1)
-		return FALSE;
-	else if (arrow[pos]=='L' && perm[pos] > perm[pos-1])
-		return TRUE;
-	else if (arrow[pos]=='R' && perm[pos] > perm[pos+1])
-		return TRUE;
-	else
-		return FALSE;
-}
+	mpw_t *p;
+	int lp;
+	mpw_t ret;
 
-static int
-perm_get_highest_mobile (int *perm, char *arrow, int n)
-{
-	int highest = -1;
-	int i;
-	for (i = 0; i < n; i++) {
-		if (perm_is_pos_mobile (perm, arrow, i, n) &&
-		    (highest == -1 || perm[highest] < perm[i]))
-			highest = i;
-	}
-	return highest;
-}
+	if G_UNLIKELY ( ! check_poly (a, 1, "PolyEvaluate", TRUE) ||
+			! check_argument_number (a, 1, "PolyEvaluate"))
+		return NULL;
 
-static void
-perm_move_pos (int *perm, char *arrow, int pos, int n)
-{
-	if (arrow[pos] == 'L') {
-		char t;
-		g_assert (pos > 0);
-		t = perm[pos];
-		perm[pos] = perm[pos-1];
-		perm[pos-1] = t;
-		t = arrow[pos];
-		arrow[pos] = arrow[pos-1];
-		arrow[pos-1] = t;
-	} else {
-		char t;
-		g_assert (pos < n-1);
-		t = perm[pos];
-		perm[pos] = perm[pos+1];
-		perm[pos+1] = t;
-		t = arrow[pos];
-		arrow[pos] = arrow[pos+1];
-		arrow[pos+1] = t;
-	}
-}
+	p = poly_get_coefs (a[0], &lp);
+	mpw_init (ret);
+	gel_poly_eval (ret, p, lp, a[1]->val.value);
+	gel_poly_free (p, lp);
 
-static void
-perm_switch_all_above (int *perm, char *arrow, int pos, int n)
-{
-	int i;
-	for (i = 0; i < n; i++) {
-		if (perm[i] > perm[pos]) {
-			if (arrow[i] == 'L')
-				arrow[i] = 'R';
-			else
-				arrow[i] = 'L';
-		}
-	}
+	return gel_makenum_use (ret);
 }
 
-static int
-nPr (unsigned int n, unsigned int k)
+static GelETree *
+PolyGCD_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	/* assume k+1 <= n */
-	guint64 m = 1;
-	guint s = n-k+1;
-	while (s <= n) {
-		m *= (guint64)s;
-		if (m > G_MAXINT32) return -1;
-		s += 1;
-	}
-	return (int)m;
-}
+	mpw_t *p, *q, *r;
+	int lp, lq, lr;
+	gboolean as_poly = (a[0]->type == GEL_POLYNOMIAL_NODE);
 
-static int
-nCr (unsigned int n, unsigned int k)
-{
-	mpz_t ret;
-	int r;
-	mpz_init (ret);
+	if G_UNLIKELY ( ! check_poly (a, 2, "PolyGCD", TRUE))
+		return NULL;
 
-	mpz_bin_uiui (ret, n, k);
-	if (mpz_fits_sint_p (ret)) {
-		r = mpz_get_si (ret);
-	} else {
-		r = -1;
-	}
-	mpz_clear (ret);
-	return r;
+	p = poly_get_coefs (a[0], &lp);
+	q = poly_get_coefs (a[1], &lq);
+	r = gel_poly_gcd (p, lp, q, lq, &lr);
+	gel_poly_free (p, lp);
+	gel_poly_free (q, lq);
+
+	if (as_poly)
+		return gel_makenum_polynomial (r, lr);
+	else
+		return poly_make_vector (r, lr);
 }
 
 static GelETree *
-Combinations_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+QuadraticFormula_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	long k, n;
-	int *comb;
-	int i;
-	int len;
-	GelMatrix *mm;
-	GelETree *r;
+	GelETree *n;
+	GelMatrixW *m;
+	GelMatrix *nm;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Combinations") ||
-			! check_argument_integer (a, 1, "Combinations"))
-		return NULL;
+	mpw_ptr aa, bb, cc;
+	mpw_t r1, r2;
 
-	gel_error_num = 0;
-	k = mpw_get_long(a[0]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		gel_error_num = 0;
-		return NULL;
-	}
-	n = mpw_get_long(a[1]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		gel_error_num = 0;
-		return NULL;
-	}
-	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
-		gel_errorout (_("%s: value out of range"),
-			      "Combinations");
+	if G_UNLIKELY (a[0]->type == GEL_NULL_NODE)
+		return gel_makenum_null ();
+
+	if G_UNLIKELY ( ! check_poly(a,1,"QuadraticFormula",TRUE))
 		return NULL;
-	}
 
-	len = nCr (n, k);
-	if (len < 0) {
-		gel_errorout (_("%s: value out of range"),
-			      "Combinations");
+	m = a[0]->mat.matrix;
+
+	if G_UNLIKELY (gel_matrixw_elements (m) != 3 ||
+		       mpw_zero_p (gel_matrixw_index(m,2,0)->val.value)) {
+		gel_errorout (_("%s: argument 1 must be a quadratic polynomial"),
+			      "QuadraticFormula");
 		return NULL;
 	}
 
-	comb = g_new (int, k);
-	for (i = 0; i < k; i++)
-		comb[i] = i+1;
+	aa = gel_matrixw_index(m,2,0)->val.value;
+	bb = gel_matrixw_index(m,1,0)->val.value;
+	cc = gel_matrixw_index(m,0,0)->val.value;
 
-	mm = gel_matrix_new ();
-	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+	mpw_init (r1);
+	mpw_init (r2);
 
-	GEL_GET_NEW_NODE (r);
-	r->type = GEL_MATRIX_NODE;
-	r->mat.matrix = gel_matrixw_new_with_matrix (mm);
-	r->mat.quoted = FALSE;
+	if (mpw_zero_p (cc)) {
+		mpw_div (r1, bb, aa);
+		mpw_neg (r1, r1);
+		mpw_set_ui (r2, 0);
+	} else if (mpw_zero_p (bb)) {
+		mpw_mul (r1, aa, cc);
+		mpw_neg (r1, r1);
+		mpw_sqrt (r1, r1);
+		mpw_div (r1, r1, aa);
+		mpw_neg (r2, r1);
+	} else {
+		mpw_mul (r1, bb, bb);
+		mpw_mul (r2, aa, cc);
+		mpw_mul_ui (r2, r2, 4);
+		mpw_sub (r1, r1, r2);
+		mpw_sqrt (r1, r1);
+		/* r1 is now the sqrt of the discriminant */
 
-	i = 0;
-	do {
-		gel_matrix_index (mm, i, 0) = etree_out_of_int_vector (comb, k);
-		i++;
-	} while (comb_get_next_combination (comb, k, n));
+		/* try to avoid instability */
+		if (mpw_re_sgn (r1) != mpw_re_sgn (bb)) {
+			mpw_neg (r1, r1);
+		}
 
-	g_free (comb);
+		mpw_add (r1, r1, bb);
+		mpw_div_ui (r1, r1, 2);
+		mpw_neg (r1, r1);
 
-	return r;
+		/* r1 = (bb + s * sqrt(bb^2 - 4*aa*cc)) / (-2); */
+
+		/* set r2 first */
+		mpw_div (r2, cc, r1);
+
+		mpw_div (r1, r1, aa);
+	}
+
+	nm = gel_matrix_new ();
+	gel_matrix_set_size (nm, 1, 2, FALSE /* padding */);
+	gel_matrix_index (nm, 0, 0) = gel_makenum_use (r1);
+	gel_matrix_index (nm, 0, 1) = gel_makenum_use (r2);
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix_value_only (nm);
+	n->mat.quoted = FALSE;
+
+	return n;
 }
 
+
 static GelETree *
-Permutations_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+PolyToString_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelETree *r;
-	long k, n, len;
-	int *comb;
+	GelETree *n;
+	int i;
+	GString *gs;
+	gboolean any = FALSE;
+	GelMatrixW *m;
+	const char *var;
+	GelOutput *gelo;
+	char *r;
+	
+	if G_UNLIKELY ( ! check_poly(a,1,"PolyToString",TRUE))
+		return NULL;
+
+	if (a[1] == NULL) {
+		var = "x";
+	} else if G_UNLIKELY ( ! check_argument_string (a, 1, "PolyToString")) {
+		return NULL;
+	} else {
+		if G_UNLIKELY (a[2] != NULL) {
+			gel_errorout (_("%s: too many arguments"),
+				      "PolyToString");
+			return NULL;
+		}
+		var = a[1]->str.str;
+	}
+	
+	m = a[0]->mat.matrix;
+	
+	gs = g_string_new("");
+
+	gelo = gel_output_new();
+	gel_output_setup_string(gelo, 0, NULL);
+	gel_output_set_gstring(gelo, gs);
+
+	for(i=gel_matrixw_width(m)-1;i>=0;i--) {
+		GelETree *t;
+		t = gel_matrixw_index(m,i,0);
+		if (mpw_zero_p (t->val.value))
+			continue;
+		/*positive (or complex) */
+		if (mpw_is_complex (t->val.value) ||
+		    mpw_sgn (t->val.value) > 0) {
+			if(any) g_string_append(gs," + ");
+			if (MPW_IS_COMPLEX (t->val.value)) {
+				g_string_append_c (gs, '(');
+				if (i==0) {
+					gel_print_etree (gelo, t, FALSE);
+					g_string_append_c (gs, ')');
+				} else if ( ! mpw_eql_ui(t->val.value,1)) {
+					gel_print_etree (gelo, t, FALSE);
+					g_string_append_c (gs, ')');
+					g_string_append_c(gs,'*');
+				}
+			} else {
+				if (i == 0) {
+					gel_print_etree (gelo, t, FALSE);
+				} else if ( ! mpw_eql_ui (t->val.value, 1)) {
+					gel_print_etree (gelo, t, FALSE);
+					g_string_append_c(gs,'*');
+				}
+			}
+			/*negative*/
+		} else {
+			if(any) g_string_append(gs," - ");
+			else g_string_append_c(gs,'-');
+			mpw_neg(t->val.value,t->val.value);
+			if (i == 0) {
+				gel_print_etree (gelo, t, FALSE);
+			} else if ( ! mpw_eql_ui (t->val.value, 1)) {
+				gel_print_etree (gelo, t, FALSE);
+				g_string_append_c(gs,'*');
+			}
+			mpw_neg(t->val.value,t->val.value);
+		}
+		if(i==1)
+			g_string_append_printf (gs, "%s", var);
+		else if(i>1)
+			g_string_append_printf (gs, "%s^%d", var, i);
+		any = TRUE;
+	}
+	if(!any)
+		g_string_append(gs,"0");
+
+	r = gel_output_snarf_string (gelo);
+	gel_output_unref (gelo);
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_STRING_NODE;
+	n->str.str = r;
+	n->str.constant = FALSE;
+	
+	return n;
+}
+
+static GelETree *
+ptf_makenew_power(GelToken *id, int power)
+{
+	GelETree *n;
+	GelETree *tokn;
+	GEL_GET_NEW_NODE(tokn);
+	tokn->type = GEL_IDENTIFIER_NODE;
+	tokn->id.id = id;
+	tokn->id.uninitialized = FALSE;
+
+	if(power == 1)
+		return tokn;
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_OPERATOR_NODE;
+	n->op.oper = GEL_E_EXP;
+	n->op.args = tokn;
+	n->op.args->any.next = gel_makenum_ui(power);
+	n->op.args->any.next->any.next = NULL;
+	n->op.nargs = 2;
+
+	return n;
+}
+
+static GelETree *
+ptf_makenew_term(mpw_t mul, GelToken *id, int power)
+{
+	GelETree *n;
+	
+	if (power == 0) {
+		return gel_makenum (mul);
+	} else if (mpw_eql_ui (mul, 1)) {
+		n = ptf_makenew_power(id,power);
+	} else {
+		GEL_GET_NEW_NODE(n);
+		n->type = GEL_OPERATOR_NODE;
+		n->op.oper = GEL_E_MUL;
+		n->op.args = gel_makenum (mul);
+		n->op.args->any.next = ptf_makenew_power(id,power);
+		n->op.args->any.next->any.next = NULL;
+		n->op.nargs = 2;
+	}
+	return n;
+}
+
+static GelETree *
+PolyToFunction_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelETree *n;
+	GelETree *nn = NULL;
+	int i;
+	GelMatrixW *m;
+
+	static GelToken *var = NULL;
+	
+	if G_UNLIKELY ( ! check_poly(a,1,"PolyToFunction",TRUE))
+		return NULL;
+	
+	if G_UNLIKELY (var == NULL)
+		var = d_intern("x");
+	
+	m = a[0]->mat.matrix;
+
+	for(i=gel_matrixw_width(m)-1;i>=0;i--) {
+		GelETree *t;
+		t = gel_matrixw_index(m,i,0);
+		if (mpw_zero_p (t->val.value))
+			continue;
+		
+		if(!nn)
+			nn = ptf_makenew_term(t->val.value,var,i);
+		else {
+			GelETree *nnn;
+			GEL_GET_NEW_NODE(nnn);
+			nnn->type = GEL_OPERATOR_NODE;
+			nnn->op.oper = GEL_E_PLUS;
+			nnn->op.args = nn;
+			nnn->op.args->any.next =
+				ptf_makenew_term(t->val.value,var,i);
+			nnn->op.args->any.next->any.next = NULL;
+			nnn->op.nargs = 2;
+			nn = nnn;
+		}
+	}
+	if(!nn)
+		nn = gel_makenum_ui(0);
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_FUNCTION_NODE;
+	n->func.func = d_makeufunc(NULL,nn,g_slist_append(NULL,var),1, NULL);
+	n->func.func->context = -1;
+
+	return n;
+}
+
+static GelETree *
+StringToASCII_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelETree *n;
+	const char *s;
+	int size;
+	int i;
+	GelMatrixW *m;
+
+	if G_UNLIKELY ( ! check_argument_string (a, 0, "StringToASCII"))
+		return NULL;
+
+	s = a[0]->str.str;
+	size = strlen(s);
+	if (size == 0)
+		return gel_makenum_null ();
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = m = gel_matrixw_new();
+	n->mat.quoted = FALSE;
+	gel_matrixw_set_size (m, size, 1);
+	
+	for (i = 0; i < size; i++) {
+		gel_matrixw_set_index (m, i, 0) = gel_makenum_si (s[i]);
+	}
+
+	return n;
+}
+
+static GelETree *
+ASCIIToString_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	char *s;
+	int size;
+	int i;
+	GelMatrixW *m;
+
+	if (a[0]->type == GEL_NULL_NODE)
+		return gel_makenum_string ("");
+
+	if G_UNLIKELY ( ! check_argument_matrix (a, 0, "ASCIIToString"))
+		return NULL;
+
+	m = a[0]->mat.matrix;
+
+	size = gel_matrixw_elements (m);
+
+	s = g_new0 (char, size+1);
+
+	for (i = 0; i < size; i++) {
+		GelETree *t;
+		t = gel_matrixw_vindex (m, i);
+		if (t->type != GEL_VALUE_NODE ||
+		    mpw_is_complex (t->val.value) ||
+		    ! mpw_is_integer (t->val.value) ||
+		    mpw_sgn (t->val.value) < 0 ||
+		    mpw_cmp_ui (t->val.value, 256) >= 0) {
+			g_free (s);
+			gel_errorout (_("%s: value out of range"),
+				      "ASCIIToString");
+			return NULL;
+		}
+		s[i] = mpw_get_long (t->val.value);
+	}
+
+	return gel_makenum_string_use (s);
+}
+
+static int
+alphabet_value (char a, const char *alph)
+{
+	int i;
+	for (i = 0; alph[i] != '\0'; i++) {
+		if (alph[i] == a)
+			return i;
+	}
+	return -1;
+}
+
+static GelETree *
+StringToAlphabet_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelETree *n;
+	const char *s;
+	const char *alph;
+	int size;
+	int i;
+	GelMatrixW *m;
+
+	if G_UNLIKELY ( ! check_argument_string (a, 0, "AlphabetToString") ||
+			! check_argument_string (a, 1, "AlphabetToString"))
+		return NULL;
+
+	s = a[0]->str.str;
+	alph = a[1]->str.str;
+	size = strlen(s);
+	if (size == 0)
+		return gel_makenum_null ();
+
+	GEL_GET_NEW_NODE(n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = m = gel_matrixw_new();
+	n->mat.quoted = FALSE;
+	gel_matrixw_set_size (m, size, 1);
+	
+	for (i = 0; i < size; i++) {
+		int val = alphabet_value (s[i], alph);
+		gel_matrixw_set_index (m, i, 0) = gel_makenum_si (val);
+	}
+
+	return n;
+}
+
+static GelETree *
+AlphabetToString_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	char *s;
+	const char *alph;
+	int size;
+	int alph_size;
+	int i;
+	GelMatrixW *m;
+
+	if (a[0]->type == GEL_NULL_NODE)
+		return gel_makenum_string ("");
+
+	if G_UNLIKELY ( ! check_argument_matrix (a, 0, "AlphabetToString") ||
+			! check_argument_string (a, 1, "AlphabetToString"))
+		return NULL;
+
+	m = a[0]->mat.matrix;
+	alph = a[1]->str.str;
+
+	size = gel_matrixw_elements (m);
+	alph_size = strlen (alph);
+
+	s = g_new0 (char, size+1);
+
+	for (i = 0; i < size; i++) {
+		GelETree *t;
+		t = gel_matrixw_vindex (m, i);
+		if G_UNLIKELY (t->type != GEL_VALUE_NODE ||
+			       mpw_is_complex (t->val.value) ||
+			       ! mpw_is_integer (t->val.value) ||
+			       mpw_sgn (t->val.value) < 0 ||
+			       mpw_cmp_ui (t->val.value, alph_size) >= 0) {
+			g_free (s);
+			gel_errorout (_("%s: value out of range"),
+				      "AlphabetToString");
+			return NULL;
+		}
+		s[i] = alph[mpw_get_long (t->val.value)];
+	}
+
+	return gel_makenum_string_use (s);
+}
+
+static GelETree *
+SetHelp_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	const char *fname;
+
+	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetHelp") ||
+			! check_argument_string (a, 1, "SetHelp") ||
+			! check_argument_string (a, 2, "SetHelp"))
+		return NULL;
+
+	if (a[0]->type == GEL_IDENTIFIER_NODE) {
+		fname = a[0]->id.id->token;
+	} else /* GEL_STRING_NODE */ {
+		fname = a[0]->str.str;
+	}
+	
+	gel_add_category (fname, a[1]->str.str);
+	gel_add_description (fname, a[2]->str.str);
+
+	return gel_makenum_null();
+}
+
+static GelETree *
+SetHelpAlias_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	const char *fname1;
+	const char *fname2;
+	
+	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetHelpAlias") ||
+			! check_argument_string_or_identifier (a, 1, "SetHelpAlias"))
+		return NULL;
+
+	if (a[0]->type == GEL_IDENTIFIER_NODE) {
+		fname1 = a[0]->id.id->token;
+	} else /* GEL_STRING_NODE */ {
+		fname1 = a[0]->str.str;
+	}
+
+	if (a[1]->type == GEL_IDENTIFIER_NODE) {
+		fname2 = a[1]->id.id->token;
+	} else /* GEL_STRING_NODE */ {
+		fname2 = a[1]->str.str;
+	}
+	
+	gel_add_alias (fname1, fname2);
+
+	return gel_makenum_null();
+}
+
+static GelETree *
+Identity_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	/*
+	 * Evil optimization to avoid copying the node from the argument
+	 */
+	return gel_stealnode (a[0]);
+}
+
+static GelETree *
+etree_out_of_int_vector (int *vec, int len)
+{
+	GelMatrix *mm;
+	int i;
+	GelETree *n;
+
+	mm = gel_matrix_new ();
+	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+
+	for (i = 0; i < len; i++) {
+		gel_matrix_index (mm, i, 0) = gel_makenum_si (vec[i]);
+	}
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix_value_only_integer (mm);
+	n->mat.quoted = FALSE;
+
+	return n;
+}
+
+/* eats the glist and frees it */
+static GelETree *
+etree_out_of_etree_list (GSList *list, int len)
+{
+	GelMatrix *mm;
+	GSList *li;
+	int i;
+	GelETree *n;
+
+	mm = gel_matrix_new ();
+	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+
+	li = list;
+	for (i = 0; i < len; i++) {
+		gel_matrix_index (mm, i, 0) = li->data;
+		li = li->next;
+	}
+	g_slist_free (list);
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix (mm);
+	n->mat.quoted = FALSE;
+
+	return n;
+}
+
+static gboolean
+comb_get_next_combination (int *vec, int len, int n)
+{
+	int i = len;
+	int j;
+
+	/* do you like my gel -> C porting? */
+
+	while (i > 0 && vec[i-1] == n-(len-i)) {
+		i--;
+	}
+	if (i == 0) {
+		return FALSE;
+	} else {
+		vec[i-1] ++;
+		for (j = i+1; j <= len; j++)
+			vec[j-1] = vec[j-2]+1;
+	}
+	return TRUE;
+}
+
+static gboolean
+perm_is_pos_mobile (int *perm, char *arrow, int pos, int n)
+{
+	if (arrow[pos]=='L' && pos==0)
+		return FALSE;
+	else if (arrow[pos]=='R' && pos==n-1)
+		return FALSE;
+	else if (arrow[pos]=='L' && perm[pos] > perm[pos-1])
+		return TRUE;
+	else if (arrow[pos]=='R' && perm[pos] > perm[pos+1])
+		return TRUE;
+	else
+		return FALSE;
+}
+
+static int
+perm_get_highest_mobile (int *perm, char *arrow, int n)
+{
+	int highest = -1;
+	int i;
+	for (i = 0; i < n; i++) {
+		if (perm_is_pos_mobile (perm, arrow, i, n) &&
+		    (highest == -1 || perm[highest] < perm[i]))
+			highest = i;
+	}
+	return highest;
+}
+
+static void
+perm_move_pos (int *perm, char *arrow, int pos, int n)
+{
+	if (arrow[pos] == 'L') {
+		char t;
+		g_assert (pos > 0);
+		t = perm[pos];
+		perm[pos] = perm[pos-1];
+		perm[pos-1] = t;
+		t = arrow[pos];
+		arrow[pos] = arrow[pos-1];
+		arrow[pos-1] = t;
+	} else {
+		char t;
+		g_assert (pos < n-1);
+		t = perm[pos];
+		perm[pos] = perm[pos+1];
+		perm[pos+1] = t;
+		t = arrow[pos];
+		arrow[pos] = arrow[pos+1];
+		arrow[pos+1] = t;
+	}
+}
+
+static void
+perm_switch_all_above (int *perm, char *arrow, int pos, int n)
+{
+	int i;
+	for (i = 0; i < n; i++) {
+		if (perm[i] > perm[pos]) {
+			if (arrow[i] == 'L')
+				arrow[i] = 'R';
+			else
+				arrow[i] = 'L';
+		}
+	}
+}
+
+static int
+nPr (unsigned int n, unsigned int k)
+{
+	/* assume k+1 <= n */
+	guint64 m = 1;
+	guint s = n-k+1;
+	while (s <= n) {
+		m *= (guint64)s;
+		if (m > G_MAXINT32) return -1;
+		s += 1;
+	}
+	return (int)m;
+}
+
+static int
+nCr (unsigned int n, unsigned int k)
+{
+	mpz_t ret;
+	int r;
+	mpz_init (ret);
+
+	mpz_bin_uiui (ret, n, k);
+	if (mpz_fits_sint_p (ret)) {
+		r = mpz_get_si (ret);
+	} else {
+		r = -1;
+	}
+	mpz_clear (ret);
+	return r;
+}
+
+static GelETree *
+Combinations_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	long k, n;
+	int *comb;
+	int i;
+	int len;
+	GelMatrix *mm;
+	GelETree *r;
+
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Combinations") ||
+			! check_argument_integer (a, 1, "Combinations"))
+		return NULL;
+
+	gel_error_num = 0;
+	k = mpw_get_long(a[0]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	n = mpw_get_long(a[1]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
+		gel_errorout (_("%s: value out of range"),
+			      "Combinations");
+		return NULL;
+	}
+
+	len = nCr (n, k);
+	if (len < 0) {
+		gel_errorout (_("%s: value out of range"),
+			      "Combinations");
+		return NULL;
+	}
+
+	comb = g_new (int, k);
+	for (i = 0; i < k; i++)
+		comb[i] = i+1;
+
+	mm = gel_matrix_new ();
+	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+
+	GEL_GET_NEW_NODE (r);
+	r->type = GEL_MATRIX_NODE;
+	r->mat.matrix = gel_matrixw_new_with_matrix (mm);
+	r->mat.quoted = FALSE;
+
+	i = 0;
+	do {
+		gel_matrix_index (mm, i, 0) = etree_out_of_int_vector (comb, k);
+		i++;
+	} while (comb_get_next_combination (comb, k, n));
+
+	g_free (comb);
+
+	return r;
+}
+
+static GelETree *
+Permutations_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelETree *r;
+	long k, n, len;
+	int *comb;
 	int *perm;
 	char *arrow;
 	int i, j;
 	GelMatrix *mm;
 
-	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Permutations") ||
-			! check_argument_integer (a, 1, "Permutations"))
+	if G_UNLIKELY ( ! check_argument_integer (a, 0, "Permutations") ||
+			! check_argument_integer (a, 1, "Permutations"))
+		return NULL;
+
+	gel_error_num = 0;
+	k = mpw_get_long(a[0]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	n = mpw_get_long(a[1]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
+		gel_errorout (_("%s: value out of range"),
+			      "Permutations");
+		return NULL;
+	}
+
+	len = nPr (n, k);
+	if (len < 0) {
+		gel_errorout (_("%s: value out of range"),
+			      "Permutations");
+		return NULL;
+	}
+
+	arrow = g_new (char, k);
+	perm = g_new (int, k);
+	comb = g_new (int, k);
+
+	for (i = 0; i < k; i++)
+		comb[i] = i+1;
+
+	mm = gel_matrix_new ();
+	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+
+	GEL_GET_NEW_NODE (r);
+	r->type = GEL_MATRIX_NODE;
+	r->mat.matrix = gel_matrixw_new_with_matrix (mm);
+	r->mat.quoted = FALSE;
+
+	j = 0;
+	do {
+		for (i = 0; i < k; i++)
+			perm[i] = comb[i];
+		for (i = 0; i < k; i++)
+			arrow[i] = 'L';
+		for (;;) {
+			int m;
+
+			gel_matrix_index (mm, j, 0) =
+				etree_out_of_int_vector (perm, k);
+			j++;
+
+			m = perm_get_highest_mobile (perm, arrow, k);
+			if (m == -1)
+				break;
+			perm_switch_all_above (perm, arrow, m, k);
+			perm_move_pos (perm, arrow, m, k);
+		}
+	} while (comb_get_next_combination (comb, k, n));
+
+	g_free (comb);
+	g_free (perm);
+	g_free (arrow);
+
+	return r;
+}
+
+static GelETree *
+NextCombination_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	long k, n;
+	int *comb;
+	int i;
+	GelETree *r;
+	GelMatrixW *m;
+
+	if G_UNLIKELY ( ! check_argument_value_only_matrix (a, 0, "NextCombination") ||
+			! check_argument_integer (a, 1, "NextCombination"))
+		return NULL;
+
+	m = a[0]->mat.matrix;
+	k = gel_matrixw_elements (m);
+
+	gel_error_num = 0;
+	n = mpw_get_long(a[1]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
+		gel_errorout (_("%s: value out of range"),
+			      "NextCombination");
+		return NULL;
+	}
+
+	comb = g_new (int, k);
+	for (i = 0; i < k; i++) {
+		int j = mpw_get_long (gel_matrixw_vindex (m, i)->val.value);
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			g_free (comb);
+			return NULL;
+		} else if G_UNLIKELY (j < 1 || j > n) {
+			g_free (comb);
+			gel_errorout (_("%s: value out of range"),
+				      "NextCombination");
+			return NULL;
+		}
+		comb[i] = j;
+	}
+	if (comb_get_next_combination (comb, k, n))
+		r = etree_out_of_int_vector (comb, k);
+	else
+		r = gel_makenum_null ();
+	g_free (comb);
+
+	return r;
+}
+
+
+/* Get a nonnegative integer argument that fits into an unsigned long */
+static gboolean
+comb_get_ulong (GelETree **a, int argnum, const char *funcname,
+		unsigned long *r)
+{
+	if G_UNLIKELY ( ! check_argument_nonnegative_integer (a, argnum, funcname))
+		return FALSE;
+
+	gel_error_num = 0;
+	*r = mpw_get_ulong (a[argnum]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static GelETree *
+comb_make_mpz (mpz_ptr z)
+{
+	mpw_t num;
+	mpw_init (num);
+	mpw_set_mpz_use (num, z);
+	return gel_makenum_use (num);
+}
+
+static GelETree *
+comb_make_mpq (mpq_ptr q)
+{
+	mpw_t num;
+	mpw_init (num);
+	mpw_set_mpq_use (num, q);
+	mpw_make_int (num);
+	return gel_makenum_use (num);
+}
+
+static GelETree *
+Factorial_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n;
+	mpz_t z;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0], Factorial_op, "Factorial", exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "Factorial", &n))
+		return NULL;
+
+	mpz_init (z);
+	mpz_fac_ui (z, n);
+	return comb_make_mpz (z);
+}
+
+static GelETree *
+Catalan_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n;
+	mpz_t z;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0], Catalan_op, "Catalan", exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "Catalan", &n))
+		return NULL;
+	if G_UNLIKELY (n > G_MAXULONG / 2) {
+		gel_errorout (_("%s: value out of range"), "Catalan");
+		return NULL;
+	}
+
+	mpz_init (z);
+	mpz_bin_uiui (z, 2*n, n);
+	mpz_divexact_ui (z, z, n+1);
+	return comb_make_mpz (z);
+}
+
+/* F(n) mod m by doubling, F(2k) = F(k)(2F(k+1)-F(k)),
+ * F(2k+1) = F(k)^2+F(k+1)^2 */
+static void
+fib_mod (mpz_ptr rop, mpz_srcptr n, mpz_srcptr m)
+{
+	mpz_t f, g, t;
+	long i;
+
+	mpz_init_set_ui (f, 0);
+	mpz_init_set_ui (g, 1);
+	mpz_init (t);
+	for (i = (long)mpz_sizeinbase (n, 2) - 1; i >= 0; i--) {
+		/* t = F(2k), g = F(2k+1) */
+		mpz_mul_2exp (t, g, 1);
+		mpz_sub (t, t, f);
+		mpz_mul (t, t, f);
+		mpz_mod (t, t, m);
+		mpz_mul (f, f, f);
+		mpz_mul (g, g, g);
+		mpz_add (g, g, f);
+		mpz_mod (g, g, m);
+		if (mpz_tstbit (n, i)) {
+			mpz_add (f, t, g);
+			mpz_mod (f, f, m);
+			mpz_swap (f, g);
+		} else {
+			mpz_swap (f, t);
+		}
+	}
+	mpz_swap (rop, f);
+	mpz_clear (f);
+	mpz_clear (g);
+	mpz_clear (t);
+}
+
+static GelETree *
+Fibonacci_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	mpw_ptr modulo;
+	mpz_t z;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0], Fibonacci_op, "Fibonacci", exception);
+
+	if G_UNLIKELY ( ! check_argument_nonnegative_integer (a, 0, "Fibonacci"))
+		return NULL;
+
+	mpz_init (z);
+	modulo = gel_find_pre_function_modulo (ctx);
+	if (modulo != NULL && mpw_is_integer (modulo)) {
+		/* any index works modulo something */
+		fib_mod (z, mpw_peek_real_mpz (a[0]->val.value),
+			 mpw_peek_real_mpz (modulo));
+	} else {
+		unsigned long n;
+		if G_UNLIKELY ( ! comb_get_ulong (a, 0, "Fibonacci", &n)) {
+			mpz_clear (z);
+			return NULL;
+		}
+		mpz_fib_ui (z, n);
+	}
+	return comb_make_mpz (z);
+}
+
+static GelETree *
+HarmonicNumber_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n;
+
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   HarmonicNumber_op,
+						   "HarmonicNumber",
+						   exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "HarmonicNumber", &n) ||
+			! check_argument_number (a, 1, "HarmonicNumber"))
+		return NULL;
+
+	if (mpw_is_integer (a[1]->val.value) &&
+	    mpw_sgn (a[1]->val.value) >= 0) {
+		unsigned long r;
+		mpq_t q;
+		if G_UNLIKELY ( ! comb_get_ulong (a, 1, "HarmonicNumber", &r))
+			return NULL;
+		mpq_init (q);
+		gel_comb_harmonic (q, n, r);
+		return comb_make_mpq (q);
+	} else {
+		mpw_t sum, x, t, e;
+		unsigned long i;
+
+		/* sum of x^(-r) */
+		mpw_init (sum);
+		mpw_init (x);
+		mpw_init (t);
+		mpw_init (e);
+		mpw_neg (e, a[1]->val.value);
+		for (i = 1; i <= n; i++) {
+			mpw_set_ui (x, i);
+			mpw_pow (t, x, e);
+			mpw_add (sum, sum, t);
+			if G_UNLIKELY (gel_interrupted) {
+				mpw_clear (sum);
+				mpw_clear (x);
+				mpw_clear (t);
+				mpw_clear (e);
+				return NULL;
+			}
+		}
+		mpw_clear (x);
+		mpw_clear (t);
+		mpw_clear (e);
+		return gel_makenum_use (sum);
+	}
+}
+
+static GelETree *
+BernoulliNumber_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n;
+	mpq_t q;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix (ctx, a[0], BernoulliNumber_op, "BernoulliNumber", exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "BernoulliNumber", &n))
+		return NULL;
+
+	mpq_init (q);
+	gel_comb_bernoulli (q, n);
+	return comb_make_mpq (q);
+}
+
+static GelETree *
+StirlingNumberFirst_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n, m;
+	mpz_t z;
+
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   StirlingNumberFirst_op,
+						   "StirlingNumberFirst",
+						   exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "StirlingNumberFirst", &n) ||
+			! comb_get_ulong (a, 1, "StirlingNumberFirst", &m))
+		return NULL;
+
+	mpz_init (z);
+	gel_comb_stirling1 (z, n, m);
+	return comb_make_mpz (z);
+}
+
+static GelETree *
+StirlingNumberSecond_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long n, m;
+	mpz_t z;
+
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   StirlingNumberSecond_op,
+						   "StirlingNumberSecond",
+						   exception);
+
+	if G_UNLIKELY ( ! comb_get_ulong (a, 0, "StirlingNumberSecond", &n) ||
+			! comb_get_ulong (a, 1, "StirlingNumberSecond", &m))
+		return NULL;
+
+	mpz_init (z);
+	gel_comb_stirling2 (z, n, m);
+	return comb_make_mpz (z);
+}
+
+static GelETree *
+nCr_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	unsigned long r;
+
+	if (a[0]->type == GEL_MATRIX_NODE ||
+	    a[1]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
+						   nCr_op,
+						   "nCr",
+						   exception);
+
+	if G_UNLIKELY ( ! check_argument_real_number (a, 0, "nCr") ||
+			! check_argument_nonnegative_integer (a, 1, "nCr"))
+		return NULL;
+
+	gel_error_num = 0;
+	r = mpw_get_ulong(a[1]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		return NULL;
+	}
+
+	if (mpw_is_integer (a[0]->val.value)) {
+		mpw_t num;
+		mpw_init (num);
+		mpw_bin_ui (num, a[0]->val.value, r);
+		return gel_makenum_use(num);
+	} else if (mpw_is_rational (a[0]->val.value)) {
+		/* for n = p/q this is p(p-q)...(p-(r-1)q) / (q^r r!) */
+		mpq_ptr nq = mpw_peek_real_mpq (a[0]->val.value);
+		mpz_t d, t;
+		mpq_t q;
+
+		mpz_init (d);
+		mpz_neg (d, mpq_denref (nq));
+		mpq_init (q);
+		gel_comb_product (mpq_numref (q), mpq_numref (nq), d, r);
+		mpz_init (t);
+		mpz_pow_ui (mpq_denref (q), mpq_denref (nq), r);
+		mpz_fac_ui (t, r);
+		mpz_mul (mpq_denref (q), mpq_denref (q), t);
+		mpq_canonicalize (q);
+		mpz_clear (d);
+		mpz_clear (t);
+		return comb_make_mpq (q);
+	} else {
+		unsigned long i;
+		mpw_t num, nm;
+		mpw_init (num);
+		mpw_set_ui (num, 1);
+		mpw_init_set (nm, a[0]->val.value);
+		for (i=0;i<=r-1;i++) {
+			mpw_mul (num, num, nm);
+			mpw_sub_ui (nm, nm, 1);
+		}
+		mpw_fac_ui (nm, r);
+		mpw_div (num, num, nm);
+		mpw_clear (nm);
+		return gel_makenum_use(num);
+	}
+}
+
+static GelETree *
+NonzeroColumns_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelMatrixW *m;
+	int i, j, w, h;
+	int cnt;
+	GSList *cols;
+
+	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "NonzeroColumns"))
+		return NULL;
+
+	if (a[0]->type == GEL_NULL_NODE)
+		return gel_makenum_null ();
+
+	m = a[0]->mat.matrix;
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	cnt = 0;
+	cols = NULL;
+	/* Must be done in this order and not rowise as is usual for genius! */
+	for (i = 0; i < w; i++) {
+		for (j = 0; j < h; j++) {
+			GelETree *t = gel_matrixw_get_index (m, i, j);
+			if ( ! ( t == NULL ||
+				 t->type == GEL_NULL_NODE ||
+				 (t->type == GEL_VALUE_NODE &&
+				  mpw_zero_p (t->val.value)))) {
+				cols = g_slist_prepend (cols,
+							gel_makenum_ui(i+1));
+				cnt++;
+				break;
+			}
+		}
+	}
+
+	if (cnt == 0) {
+		return gel_makenum_null ();
+	} else {
+		cols = g_slist_reverse (cols);
+		return etree_out_of_etree_list (cols, cnt);
+	}
+}
+
+static GelETree *
+NonzeroElements_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelMatrixW *m;
+	int i, e;
+	int cnt;
+	GSList *elts;
+
+	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "NonzeroElements"))
+		return NULL;
+
+	if (a[0]->type == GEL_NULL_NODE)
+		return gel_makenum_null ();
+
+	m = a[0]->mat.matrix;
+	e = gel_matrixw_elements (m);
+	cnt = 0;
+	elts = NULL;
+	/* Must be done in this order and not rowise as is usual for genius! */
+	for (i = 0; i < e; i++) {
+		GelETree *t = gel_matrixw_get_vindex (m, i);
+		if ( ! (t == NULL ||
+			t->type == GEL_NULL_NODE ||
+			(t->type == GEL_VALUE_NODE &&
+			 mpw_zero_p (t->val.value)))) {
+			elts = g_slist_prepend (elts,
+						gel_makenum_ui(i+1));
+			cnt++;
+		}
+	}
+
+	if (cnt == 0) {
+		return gel_makenum_null ();
+	} else {
+		elts = g_slist_reverse (elts);
+		return etree_out_of_etree_list (elts, cnt);
+	}
+}
+
+static GelETree *
+protect_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelToken *tok;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix
+			(ctx, a[0], protect_op, "protect",
+			 exception);
+
+	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "protect"))
+		return NULL;
+
+	if (a[0]->type == GEL_IDENTIFIER_NODE) {
+		tok = a[0]->id.id;
+	} else /* GEL_STRING_NODE */ {
+		tok = d_intern (a[0]->str.str);
+	}
+	
+	tok->protected_ = 1;
+
+	return gel_makenum_null();
+}
+
+static GelETree *
+unprotect_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelToken *tok;
+
+	if (a[0]->type == GEL_MATRIX_NODE)
+		return gel_apply_func_to_matrix
+			(ctx, a[0], unprotect_op, "unprotect",
+			 exception);
+
+	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "unprotect"))
+		return NULL;
+
+	if (a[0]->type == GEL_IDENTIFIER_NODE) {
+		tok = a[0]->id.id;
+	} else /* GEL_STRING_NODE */ {
+		tok = d_intern (a[0]->str.str);
+	}
+	
+	tok->protected_ = 0;
+
+	return gel_makenum_null();
+}
+
+static GelETree *
+SetFunctionFlags_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	GelEFunc *f;
+	GelToken *tok;
+	int i;
+
+	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetFunctionFlags"))
 		return NULL;
 
-	gel_error_num = 0;
-	k = mpw_get_long(a[0]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		gel_error_num = 0;
-		return NULL;
-	}
-	n = mpw_get_long(a[1]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		gel_error_num = 0;
-		return NULL;
+	if (a[0]->type == GEL_IDENTIFIER_NODE) {
+		tok = a[0]->id.id;
+	} else /* GEL_STRING_NODE */ {
+		tok = d_intern (a[0]->str.str);
 	}
-	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
-		gel_errorout (_("%s: value out of range"),
-			      "Permutations");
+
+	f = d_lookup_global (tok);
+	if G_UNLIKELY (f == NULL) {
+		gel_errorout (_("%s: undefined function"), "SetFunctionFlags");
 		return NULL;
 	}
 
-	len = nPr (n, k);
-	if (len < 0) {
-		gel_errorout (_("%s: value out of range"),
-			      "Permutations");
-		return NULL;
+	for (i = 1; a[i] != NULL; i++) {
+		if G_UNLIKELY (a[i]->type != GEL_STRING_NODE) {
+			gel_errorout (_("%s: flags argument must be a string"),
+				      "SetFunctionFlags");
+		} else if (a[i]->str.str != NULL) {
+			if (g_ascii_strcasecmp (a[i]->str.str, "PropagateMod") == 0)
+				f->propagate_mod = 1;
+			else if (g_ascii_strcasecmp (a[i]->str.str, "NoModuloArguments") == 0)
+				f->no_mod_all_args = 1;
+		}
 	}
 
-	arrow = g_new (char, k);
-	perm = g_new (int, k);
-	comb = g_new (int, k);
+	return gel_makenum_null();
+}
 
-	for (i = 0; i < k; i++)
-		comb[i] = i+1;
+static GelETree *
+GetCurrentModulo_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	mpw_ptr modulo = gel_find_pre_function_modulo (ctx);
+	if (modulo == NULL)
+		return gel_makenum_null ();
+	else
+		return gel_makenum (modulo);
+}
 
-	mm = gel_matrix_new ();
-	gel_matrix_set_size (mm, len, 1, FALSE /* padding */);
+static gboolean
+call_func (GelCtx *ctx,
+	   mpw_ptr retn,
+	   GelEFunc *func,
+	   mpw_ptr argnum)
+{
+	GelETree arg;
+	GelETree *ret;
+	GelETree *args[2];
 
-	GEL_GET_NEW_NODE (r);
-	r->type = GEL_MATRIX_NODE;
-	r->mat.matrix = gel_matrixw_new_with_matrix (mm);
-	r->mat.quoted = FALSE;
+	arg.type = GEL_VALUE_NODE;
+	arg.val.next = NULL;
+	mpw_init_set (arg.val.value, argnum);
 
-	j = 0;
-	do {
-		for (i = 0; i < k; i++)
-			perm[i] = comb[i];
-		for (i = 0; i < k; i++)
-			arrow[i] = 'L';
-		for (;;) {
-			int m;
+	args[0] = &arg;
+	args[1] = NULL;
 
-			gel_matrix_index (mm, j, 0) =
-				etree_out_of_int_vector (perm, k);
-			j++;
+	ret = gel_funccall (ctx, func, args, 1);
 
-			m = perm_get_highest_mobile (perm, arrow, k);
-			if (m == -1)
-				break;
-			perm_switch_all_above (perm, arrow, m, k);
-			perm_move_pos (perm, arrow, m, k);
-		}
-	} while (comb_get_next_combination (comb, k, n));
+	mpw_clear (arg.val.value);
 
-	g_free (comb);
-	g_free (perm);
-	g_free (arrow);
+	if G_UNLIKELY (gel_error_num != 0 ||
+		       ret == NULL ||
+		       ret->type != GEL_VALUE_NODE) {
+		gel_freetree (ret);
+		return FALSE;
+	}
 
-	return r;
+	mpw_set (retn, ret->val.value);
+	
+	gel_freetree (ret);
+	return TRUE;
 }
 
+/*
+# The algorithms are described in:
+# Numerical Analysis, 5th edition
+# by Richard L. Burden and J. Douglas Faires
+# PWS Publishing Company, Boston, 1993.
+# Library of congress: QA 297 B84 1993
+
+# In the below, f indicates the function whose integral we wish to determine,
+# a,b indicate the left and right endpoints of the interval over which
+# we wish to integrate, and n is the number of intervals into which we
+# divide [a,b]
+
+# These methods all return one value, the value of the integral
+
+# Currently only works for real functions of a real variable
+
+# Composite Simpson's Rule, Section 4.4, Algorithm 4.1, p. 186
+# Note that this has error term = max(f'''')*h^4*(b-a)/180,
+# where h=(b-a)/n
+# If we can get maximums and derivatives, this would allow us to determine
+# automatically what n should be.
+*/
+
+/* ported from the GEL version for speed */
 static GelETree *
-NextCombination_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+CompositeSimpsonsRule_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	long k, n;
-	int *comb;
-	int i;
-	GelETree *r;
-	GelMatrixW *m;
+	GelEFunc *f;
+	mpw_ptr ia, ib, in;
+	long n, i;
+	mpw_t X, XI0, XI1, XI2, h, fret;
+	GelETree *ret = NULL;
+	gboolean do_neg = FALSE;
 
-	if G_UNLIKELY ( ! check_argument_value_only_matrix (a, 0, "NextCombination") ||
-			! check_argument_integer (a, 1, "NextCombination"))
+	if G_UNLIKELY ( ! check_argument_function_or_identifier (a, 0, "CompositeSimpsonsRule") ||
+			! check_argument_real_number (a, 1, "CompositeSimpsonsRule") ||
+			! check_argument_real_number (a, 2, "CompositeSimpsonsRule") ||
+			! check_argument_positive_integer (a, 3, "CompositeSimpsonsRule"))
 		return NULL;
 
-	m = a[0]->mat.matrix;
-	k = gel_matrixw_elements (m);
+	ia = a[1]->val.value;
+	ib = a[2]->val.value;
+	in = a[3]->val.value;
+	if (mpw_odd_p (in))
+		mpw_add_ui (in, in, 1);
 
-	gel_error_num = 0;
-	n = mpw_get_long(a[1]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
+	n = mpw_get_long (in);
+	if G_UNLIKELY (gel_error_num) {
 		gel_error_num = 0;
 		return NULL;
 	}
-	if G_UNLIKELY (n < 1 || n > G_MAXINT || k < 1 || k > n) {
-		gel_errorout (_("%s: value out of range"),
-			      "NextCombination");
+
+	if (mpw_cmp (ia, ib) == 0) {
+		return gel_makenum_ui (0);
+	}
+
+	if (mpw_cmp (ia, ib) > 0) {
+		mpw_ptr tmp = ia;
+		ia = ib;
+		ib = tmp;
+		do_neg = TRUE;
+	}
+
+	if (a[0]->type == GEL_FUNCTION_NODE) {
+		f = a[0]->func.func;
+	} else /* (a[0]->type == GEL_IDENTIFIER_NODE) */ {
+		f = d_lookup_global (a[0]->id.id);
+	}
+
+	if G_UNLIKELY (f == NULL ||
+		       f->nargs != 1) {
+		gel_errorout (_("%s: argument not a function of one variable"),
+			      "CompositeSimpsonsRule");
 		return NULL;
 	}
 
-	comb = g_new (int, k);
-	for (i = 0; i < k; i++) {
-		int j = mpw_get_long (gel_matrixw_vindex (m, i)->val.value);
-		if G_UNLIKELY (gel_error_num != 0) {
-			gel_error_num = 0;
-			g_free (comb);
-			return NULL;
-		} else if G_UNLIKELY (j < 1 || j > n) {
-			g_free (comb);
-			gel_errorout (_("%s: value out of range"),
-				      "NextCombination");
-			return NULL;
+	mpw_init (fret);
+	mpw_init (X);
+	mpw_init (XI0);
+	mpw_init (XI1);
+	mpw_init (XI2);
+	mpw_init (h);
+
+	/*
+	h=(b-a)/n;       # Subdivision interval
+	*/
+	mpw_sub (h, ib, ia);
+	mpw_div (h, h, in);
+	mpw_make_float (h);
+
+	/*
+	XI0=f(a)+f(b);   # End points
+	*/
+	if ( ! call_func (ctx, XI0, f, ia))
+		goto end_of_simpson;
+	if ( ! call_func (ctx, fret, f, ib))
+		goto end_of_simpson;
+	mpw_add (XI0, XI0, fret);
+
+	/*
+	XI1=0;           # odd points
+	XI2=0;           # even points
+        X=a;             # current position
+	*/
+	mpw_set_d (XI1, 0);
+	mpw_set_d (XI2, 0);
+	mpw_set (X, ia);
+	mpw_make_float (X);
+
+	/* FIXME: */
+	for (i = 1; i < n; i++) {
+		/*
+		   X=X+h;
+		   if i%2 == 0
+		   then XI2=XI2+f(X)
+		   else XI1=XI1+f(X)
+		   */
+		mpw_add (X, X, h);
+		if ( ! call_func (ctx, fret, f, X))
+			goto end_of_simpson;
+		if (i & 0x1 /* odd */) {
+			mpw_add (XI1, XI1, fret);
+		} else /* even */ {
+			mpw_add (XI2, XI2, fret);
+		}
+
+		if (gel_evalnode_hook) {
+			if G_UNLIKELY ((i & 0x3FF) == 0x3FF) {
+				(*gel_evalnode_hook)();
+			}
 		}
-		comb[i] = j;
 	}
-	if (comb_get_next_combination (comb, k, n))
-		r = etree_out_of_int_vector (comb, k);
-	else
-		r = gel_makenum_null ();
-	g_free (comb);
 
-	return r;
-}
+	/*
+        h*(XI0+2*XI2+4*XI1)/3
+	*/
+	mpw_mul_ui (XI1, XI1, 4);
+	mpw_mul_ui (XI2, XI2, 2);
+	mpw_add (fret, XI0, XI1);
+	mpw_add (fret, fret, XI2);
+	mpw_mul (fret, fret, h);
+	mpw_div_ui (fret, fret, 3);
 
+	if (do_neg)
+		mpw_neg (fret, fret);
 
-static GelETree *
-nCr_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
-{
-	unsigned long r;
+	ret = gel_makenum (fret);
 
-	if (a[0]->type == GEL_MATRIX_NODE ||
-	    a[1]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrixen (ctx, a[0], a[1],
-						   nCr_op,
-						   "nCr",
-						   exception);
+end_of_simpson:
+	mpw_clear (X);
+	mpw_clear (fret);
+	mpw_clear (XI0);
+	mpw_clear (XI1);
+	mpw_clear (XI2);
+	mpw_clear (h);
 
-	if G_UNLIKELY ( ! check_argument_real_number (a, 0, "nCr") ||
-			! check_argument_nonnegative_integer (a, 1, "nCr"))
-		return NULL;
+	return ret;
+}
 
-	gel_error_num = 0;
-	r = mpw_get_ulong(a[1]->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		gel_error_num = 0;
-		return NULL;
-	}
+/* Adaptive integration, see quadrature.h.  The integrand is evaluated a
+ * batch at a time, with the compiled double program (see dfunc.h) when
+ * f compiles and doubles are precise enough, otherwise with the
+ * interpreter. */
 
-	if (mpw_is_integer (a[0]->val.value)) {
-		mpw_t num;
-		mpw_init (num);
-		mpw_bin_ui (num, a[0]->val.value, r);
-		return gel_makenum_use(num);
-	} else {
-		unsigned long i;
-		mpw_t num, nm;
-		mpw_init (num);
-		mpw_set_ui (num, 1);
-		mpw_init_set (nm, a[0]->val.value);
-		for (i=0;i<=r-1;i++) {
-			mpw_mul (num, num, nm);
-			mpw_sub_ui (nm, nm, 1);
+typedef struct {
+	GelCtx *ctx;
+	GelEFunc *f;
+	GelDFunc *df;
+	gboolean not_real;
+} QuadData;
+
+static gboolean
+quad_eval_df (QuadData *qd, const double *x, double *y, int n)
+{
+	gboolean *ex = g_new0 (gboolean, n);
+	gboolean ret = TRUE;
+	int i;
+
+	gel_dfunc_eval_many (qd->df, n, x, y, ex,
+			     0 /* nthreads */, gel_evalnode_hook);
+	for (i = 0; i < n; i++) {
+		if (ex[i]) {
+			ret = FALSE;
+			break;
 		}
-		mpw_fac_ui (nm, r);
-		mpw_div (num, num, nm);
-		mpw_clear (nm);
-		return gel_makenum_use(num);
 	}
+	g_free (ex);
+
+	return ret;
 }
 
-static GelETree *
-NonzeroColumns_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+static gboolean
+quad_func_d (const double *x, double *y, int n, gpointer data)
 {
-	GelMatrixW *m;
-	int i, j, w, h;
-	int cnt;
-	GSList *cols;
+	QuadData *qd = data;
+	mpw_t xx, fret;
+	gboolean ret = TRUE;
+	int i;
 
-	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "NonzeroColumns"))
-		return NULL;
+	if (qd->df != NULL)
+		return quad_eval_df (qd, x, y, n);
 
-	if (a[0]->type == GEL_NULL_NODE)
-		return gel_makenum_null ();
+	mpw_init (xx);
+	mpw_init (fret);
+	for (i = 0; i < n; i++) {
+		mpw_set_d (xx, x[i]);
+		if ( ! call_func (qd->ctx, fret, qd->f, xx)) {
+			ret = FALSE;
+			break;
+		}
+		if (mpw_is_complex (fret)) {
+			qd->not_real = TRUE;
+			ret = FALSE;
+			break;
+		}
+		y[i] = mpw_get_double (fret);
+		if G_UNLIKELY (gel_error_num != 0) {
+			ret = FALSE;
+			break;
+		}
 
-	m = a[0]->mat.matrix;
-	w = gel_matrixw_width (m);
-	h = gel_matrixw_height (m);
-	cnt = 0;
-	cols = NULL;
-	/* Must be done in this order and not rowise as is usual for genius! */
-	for (i = 0; i < w; i++) {
-		for (j = 0; j < h; j++) {
-			GelETree *t = gel_matrixw_get_index (m, i, j);
-			if ( ! ( t == NULL ||
-				 t->type == GEL_NULL_NODE ||
-				 (t->type == GEL_VALUE_NODE &&
-				  mpw_zero_p (t->val.value)))) {
-				cols = g_slist_prepend (cols,
-							gel_makenum_ui(i+1));
-				cnt++;
+		if (gel_evalnode_hook != NULL &&
+		    (i & 0x3F) == 0x3F) {
+			(*gel_evalnode_hook)();
+			if G_UNLIKELY (gel_interrupted) {
+				ret = FALSE;
 				break;
 			}
 		}
 	}
+	mpw_clear (xx);
+	mpw_clear (fret);
 
-	if (cnt == 0) {
-		return gel_makenum_null ();
-	} else {
-		cols = g_slist_reverse (cols);
-		return etree_out_of_etree_list (cols, cnt);
-	}
+	return ret;
 }
 
-static GelETree *
-NonzeroElements_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+static gboolean
+quad_func_mpw (mpw_t *x, mpw_t *y, int n, gpointer data)
 {
-	GelMatrixW *m;
-	int i, e;
-	int cnt;
-	GSList *elts;
+	QuadData *qd = data;
+	int i;
 
-	if G_UNLIKELY ( ! check_argument_matrix_or_null (a, 0, "NonzeroElements"))
-		return NULL;
+	if (qd->df != NULL) {
+		double *xd = g_new (double, n);
+		double *yd = g_new (double, n);
+		gboolean ret;
+
+		for (i = 0; i < n; i++)
+			xd[i] = mpw_get_double (x[i]);
+		ret = quad_eval_df (qd, xd, yd, n);
+		if (ret) {
+			for (i = 0; i < n; i++)
+				mpw_set_d (y[i], yd[i]);
+		}
+		g_free (xd);
+		g_free (yd);
 
-	if (a[0]->type == GEL_NULL_NODE)
-		return gel_makenum_null ();
+		return ret;
+	}
 
-	m = a[0]->mat.matrix;
-	e = gel_matrixw_elements (m);
-	cnt = 0;
-	elts = NULL;
-	/* Must be done in this order and not rowise as is usual for genius! */
-	for (i = 0; i < e; i++) {
-		GelETree *t = gel_matrixw_get_vindex (m, i);
-		if ( ! (t == NULL ||
-			t->type == GEL_NULL_NODE ||
-			(t->type == GEL_VALUE_NODE &&
-			 mpw_zero_p (t->val.value)))) {
-			elts = g_slist_prepend (elts,
-						gel_makenum_ui(i+1));
-			cnt++;
+	for (i = 0; i < n; i++) {
+		if ( ! call_func (qd->ctx, y[i], qd->f, x[i]))
+			return FALSE;
+
+		if (gel_evalnode_hook != NULL &&
+		    (i & 0x3F) == 0x3F) {
+			(*gel_evalnode_hook)();
+			if G_UNLIKELY (gel_interrupted)
+				return FALSE;
 		}
 	}
 
-	if (cnt == 0) {
-		return gel_makenum_null ();
-	} else {
-		elts = g_slist_reverse (elts);
-		return etree_out_of_etree_list (elts, cnt);
-	}
+	return TRUE;
 }
 
-static GelETree *
-protect_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+/* f,a,b and the optional tolerance, returns f or NULL */
+static GelEFunc *
+quad_get_args (GelETree **a, double *tol, const char *funcname)
 {
-	GelToken *tok;
-
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix
-			(ctx, a[0], protect_op, "protect",
-			 exception);
+	GelEFunc *f;
 
-	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "protect"))
+	if G_UNLIKELY ( ! check_argument_function_or_identifier (a, 0, funcname) ||
+			! check_argument_real_number (a, 1, funcname) ||
+			! check_argument_real_number (a, 2, funcname))
 		return NULL;
 
-	if (a[0]->type == GEL_IDENTIFIER_NODE) {
-		tok = a[0]->id.id;
-	} else /* GEL_STRING_NODE */ {
-		tok = d_intern (a[0]->str.str);
+	*tol = 1e-10;
+	if (a[3] != NULL) {
+		if G_UNLIKELY (a[4] != NULL) {
+			gel_errorout (_("%s: Too many arguments, should be at most %d"),
+				      funcname, 4);
+			return NULL;
+		}
+		if G_UNLIKELY (a[3]->type != GEL_VALUE_NODE ||
+			       mpw_is_complex (a[3]->val.value) ||
+			       mpw_sgn (a[3]->val.value) <= 0) {
+			gel_errorout (_("%s: tolerance must be a positive real number"),
+				      funcname);
+			return NULL;
+		}
+		*tol = mpw_get_double (a[3]->val.value);
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			return NULL;
+		}
 	}
-	
-	tok->protected_ = 1;
-
-	return gel_makenum_null();
-}
-
-static GelETree *
-unprotect_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
-{
-	GelToken *tok;
 
-	if (a[0]->type == GEL_MATRIX_NODE)
-		return gel_apply_func_to_matrix
-			(ctx, a[0], unprotect_op, "unprotect",
-			 exception);
+	if (a[0]->type == GEL_FUNCTION_NODE) {
+		f = a[0]->func.func;
+	} else /* (a[0]->type == GEL_IDENTIFIER_NODE) */ {
+		f = d_lookup_global (a[0]->id.id);
+	}
 
-	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "unprotect"))
+	if G_UNLIKELY (f == NULL ||
+		       f->nargs != 1) {
+		gel_errorout (_("%s: argument not a function of one variable"),
+			      funcname);
 		return NULL;
-
-	if (a[0]->type == GEL_IDENTIFIER_NODE) {
-		tok = a[0]->id.id;
-	} else /* GEL_STRING_NODE */ {
-		tok = d_intern (a[0]->str.str);
 	}
-	
-	tok->protected_ = 0;
 
-	return gel_makenum_null();
+	return f;
+}
+
+static void
+quad_error (GelQuadResult res, QuadData *qd, const char *funcname)
+{
+	if (qd->not_real) {
+		gel_errorout (_("%s: f must have real values"), funcname);
+	} else if (res == GEL_QUAD_NOT_CONVERGED) {
+		gel_errorout (_("%s: cannot reach the given tolerance"),
+			      funcname);
+	} else if (res == GEL_QUAD_FAILED) {
+		if (gel_error_num == 0)
+			gel_errorout (_("%s: cannot evaluate f on the interval"),
+				      funcname);
+	}
 }
 
 static GelETree *
-SetFunctionFlags_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+AdaptiveGaussKronrod_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
-	GelEFunc *f;
-	GelToken *tok;
-	int i;
+	QuadData qd = { NULL };
+	GelQuadResult res;
+	double tol, ad, bd, result;
 
-	if G_UNLIKELY ( ! check_argument_string_or_identifier (a, 0, "SetFunctionFlags"))
+	qd.f = quad_get_args (a, &tol, "AdaptiveGaussKronrod");
+	if (qd.f == NULL)
 		return NULL;
+	qd.ctx = ctx;
 
-	if (a[0]->type == GEL_IDENTIFIER_NODE) {
-		tok = a[0]->id.id;
-	} else /* GEL_STRING_NODE */ {
-		tok = d_intern (a[0]->str.str);
+	if (mpw_cmp (a[1]->val.value, a[2]->val.value) == 0)
+		return gel_makenum_ui (0);
+
+	if G_UNLIKELY (tol < 1e-14) {
+		gel_errorout (_("%s: tolerance too small for double precision, "
+				"use TanhSinhQuadrature"),
+			      "AdaptiveGaussKronrod");
+		return NULL;
 	}
 
-	f = d_lookup_global (tok);
-	if G_UNLIKELY (f == NULL) {
-		gel_errorout (_("%s: undefined function"), "SetFunctionFlags");
+	ad = mpw_get_double (a[1]->val.value);
+	bd = mpw_get_double (a[2]->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
 		return NULL;
 	}
 
-	for (i = 1; a[i] != NULL; i++) {
-		if G_UNLIKELY (a[i]->type != GEL_STRING_NODE) {
-			gel_errorout (_("%s: flags argument must be a string"),
-				      "SetFunctionFlags");
-		} else if (a[i]->str.str != NULL) {
-			if (g_ascii_strcasecmp (a[i]->str.str, "PropagateMod") == 0)
-				f->propagate_mod = 1;
-			else if (g_ascii_strcasecmp (a[i]->str.str, "NoModuloArguments") == 0)
-				f->no_mod_all_args = 1;
+	qd.df = gel_dfunc_compile (qd.f, 1);
+	if (qd.df != NULL && ! gel_dfunc_prepare (qd.df)) {
+		gel_dfunc_free (qd.df);
+		qd.df = NULL;
+	}
+	if (qd.df != NULL) {
+		res = gel_quad_gk15 (quad_func_d, &qd, ad, bd, tol, tol,
+				     &result, NULL, NULL);
+		gel_dfunc_free (qd.df);
+		qd.df = NULL;
+		if (res == GEL_QUAD_DONE)
+			return gel_makenum_d (result);
+		if (res == GEL_QUAD_INTERRUPTED)
+			return NULL;
+		/* some point is not real or not defined, let the
+		 * interpreter figure out what is wrong */
+	}
+
+	res = gel_quad_gk15 (quad_func_d, &qd, ad, bd, tol, tol,
+			     &result, NULL, NULL);
+	if (res == GEL_QUAD_DONE)
+		return gel_makenum_d (result);
+
+	quad_error (res, &qd, "AdaptiveGaussKronrod");
+	return NULL;
+}
+
+static GelETree *
+TanhSinhQuadrature_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	QuadData qd = { NULL };
+	GelQuadResult res;
+	GelETree *ret = NULL;
+	mpw_t result;
+	double tol;
+
+	qd.f = quad_get_args (a, &tol, "TanhSinhQuadrature");
+	if (qd.f == NULL)
+		return NULL;
+	qd.ctx = ctx;
+
+	if (mpw_cmp (a[1]->val.value, a[2]->val.value) == 0)
+		return gel_makenum_ui (0);
+
+	mpw_init (result);
+
+	/* doubles are good enough */
+	if (tol >= 1e-13 &&
+	    (qd.df = gel_dfunc_compile (qd.f, 1)) != NULL &&
+	    gel_dfunc_prepare (qd.df)) {
+		res = gel_quad_tanh_sinh_mpw (quad_func_mpw, &qd,
+					      a[1]->val.value, a[2]->val.value,
+					      tol, result, NULL, NULL);
+		if (res == GEL_QUAD_DONE || res == GEL_QUAD_INTERRUPTED) {
+			gel_dfunc_free (qd.df);
+			if (res == GEL_QUAD_DONE)
+				ret = gel_makenum (result);
+			mpw_clear (result);
+			return ret;
 		}
+		/* no luck, perhaps f is singular at an endpoint or leaves
+		 * the reals, do it in full precision */
+		gel_error_num = 0;
+	}
+	if (qd.df != NULL) {
+		gel_dfunc_free (qd.df);
+		qd.df = NULL;
 	}
 
-	return gel_makenum_null();
+	res = gel_quad_tanh_sinh_mpw (quad_func_mpw, &qd,
+				      a[1]->val.value, a[2]->val.value,
+				      tol, result, NULL, NULL);
+	if (res == GEL_QUAD_DONE)
+		ret = gel_makenum (result);
+	else
+		quad_error (res, &qd, "TanhSinhQuadrature");
+
+	mpw_clear (result);
+	return ret;
 }
 
+/* Adaptive Dormand-Prince, see odesolve.h.  If everything is a real
+ * number and f compiles to doubles (see dfunc.h) the integration is done
+ * in doubles, otherwise in the current float precision with f called
+ * through the interpreter, which also allows y to be a vector. */
+
+typedef struct {
+	GelCtx *ctx;
+	GelEFunc *f;
+	GelDFunc *df;
+	int w, h;		/* size of y, 0 if y is a plain number */
+	gboolean bad_return;
+	gboolean f_error;	/* f failed and already said why */
+	/* for the Full version */
+	GelMatrix *out;
+	int row;
+	int rows;
+} RKAData;
+
+/* a node with the value of y (same shape as y0) */
 static GelETree *
-GetCurrentModulo_op(GelCtx *ctx, GelETree * * a, gboolean *exception)
+rka_make_y (RKAData *data, mpw_t *y)
 {
-	mpw_ptr modulo = gel_find_pre_function_modulo (ctx);
-	if (modulo == NULL)
-		return gel_makenum_null ();
-	else
-		return gel_makenum (modulo);
+	GelMatrix *m;
+	GelETree *n;
+	int i, j;
+
+	if (data->w == 0)
+		return gel_makenum (y[0]);
+
+	m = gel_matrix_new ();
+	gel_matrix_set_size (m, data->w, data->h, FALSE /* padding */);
+	for (j = 0; j < data->h; j++)
+		for (i = 0; i < data->w; i++)
+			gel_matrix_index (m, i, j) =
+				gel_makenum (y[i + j * data->w]);
+
+	GEL_GET_NEW_NODE (n);
+	n->type = GEL_MATRIX_NODE;
+	n->mat.matrix = gel_matrixw_new_with_matrix (m);
+	n->mat.quoted = FALSE;
+
+	return n;
 }
 
 static gboolean
-call_func (GelCtx *ctx,
-	   mpw_ptr retn,
-	   GelEFunc *func,
-	   mpw_ptr argnum)
+rka_func_mpw (mpw_ptr t, mpw_t *y, mpw_t *dy, gpointer data)
 {
+	RKAData *rd = data;
 	GelETree arg;
+	GelETree *yn;
 	GelETree *ret;
-	GelETree *args[2];
+	GelETree *args[3];
+	int n = (rd->w == 0) ? 1 : rd->w * rd->h;
+	int i;
 
 	arg.type = GEL_VALUE_NODE;
 	arg.val.next = NULL;
-	mpw_init_set (arg.val.value, argnum);
+	mpw_init_set (arg.val.value, t);
+
+	yn = rka_make_y (rd, y);
 
 	args[0] = &arg;
-	args[1] = NULL;
+	args[1] = yn;
+	args[2] = NULL;
 
-	ret = gel_funccall (ctx, func, args, 1);
+	ret = gel_funccall (rd->ctx, rd->f, args, 2);
 
 	mpw_clear (arg.val.value);
+	gel_freetree (yn);
+
+	if G_UNLIKELY (gel_error_num != 0 || ret == NULL) {
+		/* the solver tries a smaller step, so don't let the
+		 * error stick around for the next call */
+		if (gel_error_num != 0) {
+			rd->f_error = TRUE;
+			gel_error_num = GEL_NO_ERROR;
+		}
+		gel_freetree (ret);
+		return FALSE;
+	}
 
-	if G_UNLIKELY (gel_error_num != 0 ||
-		       ret == NULL ||
-		       ret->type != GEL_VALUE_NODE) {
+	if (ret->type == GEL_VALUE_NODE && n == 1) {
+		mpw_set (dy[0], ret->val.value);
+	} else if (ret->type == GEL_MATRIX_NODE &&
+		   gel_matrixw_elements (ret->mat.matrix) == n &&
+		   gel_is_matrix_value_only (ret->mat.matrix)) {
+		for (i = 0; i < n; i++) {
+			GelETree *t = gel_matrixw_vindex (ret->mat.matrix, i);
+			mpw_set (dy[i], t->val.value);
+		}
+	} else {
+		rd->bad_return = TRUE;
 		gel_freetree (ret);
 		return FALSE;
 	}
 
-	mpw_set (retn, ret->val.value);
-	
 	gel_freetree (ret);
+
+	if (gel_evalnode_hook != NULL)
+		(*gel_evalnode_hook)();
+
 	return TRUE;
 }
 
-/*
-# The algorithms are described in:
-# Numerical Analysis, 5th edition
-# by Richard L. Burden and J. Douglas Faires
-# PWS Publishing Company, Boston, 1993.
-# Library of congress: QA 297 B84 1993
+static gboolean
+rka_out_mpw (mpw_ptr t, mpw_t *y, gpointer data)
+{
+	RKAData *rd = data;
+	GelETree *tn;
 
-# In the below, f indicates the function whose integral we wish to determine,
-# a,b indicate the left and right endpoints of the interval over which
-# we wish to integrate, and n is the number of intervals into which we
-# divide [a,b]
+	/* rounding could give one point too many, the last one (at x1)
+	 * always wins */
+	if (rd->row >= rd->rows) {
+		rd->row = rd->rows - 1;
+		gel_freetree (gel_matrix_index (rd->out, 0, rd->row));
+		gel_freetree (gel_matrix_index (rd->out, 1, rd->row));
+	}
 
-# These methods all return one value, the value of the integral
+	tn = gel_makenum (t);
+	mpw_make_float (tn->val.value);
+	gel_matrix_index (rd->out, 0, rd->row) = tn;
+	gel_matrix_index (rd->out, 1, rd->row) = rka_make_y (rd, y);
+	rd->row++;
 
-# Currently only works for real functions of a real variable
+	return TRUE;
+}
 
-# Composite Simpson's Rule, Section 4.4, Algorithm 4.1, p. 186
-# Note that this has error term = max(f'''')*h^4*(b-a)/180,
-# where h=(b-a)/n
-# If we can get maximums and derivatives, this would allow us to determine
-# automatically what n should be.
-*/
+static gboolean
+rka_func_d (double t, const double *y, double *dy, gpointer data)
+{
+	RKAData *rd = data;
+	gboolean ex = FALSE;
+	double args[2];
+
+	args[0] = t;
+	args[1] = y[0];
+	dy[0] = gel_dfunc_eval (rd->df, args, &ex);
+
+	return ! ex;
+}
+
+static gboolean
+rka_out_d (double t, const double *y, gpointer data)
+{
+	RKAData *rd = data;
+
+	if (rd->row >= rd->rows) {
+		rd->row = rd->rows - 1;
+		gel_freetree (gel_matrix_index (rd->out, 0, rd->row));
+		gel_freetree (gel_matrix_index (rd->out, 1, rd->row));
+	}
+
+	gel_matrix_index (rd->out, 0, rd->row) = gel_makenum_d (t);
+	gel_matrix_index (rd->out, 1, rd->row) = gel_makenum_d (y[0]);
+	rd->row++;
+
+	return TRUE;
+}
 
-/* ported from the GEL version for speed */
 static GelETree *
-CompositeSimpsonsRule_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+runge_kutta_adaptive (GelCtx *ctx, GelETree **a, gboolean full,
+		      const char *funcname)
 {
 	GelEFunc *f;
-	mpw_ptr ia, ib, in;
-	long n, i;
-	mpw_t X, XI0, XI1, XI2, h, fret;
+	RKAData rd = { NULL };
+	GelOdeResult res;
 	GelETree *ret = NULL;
-	gboolean do_neg = FALSE;
+	GelETree *tola;
+	double tol = 1e-10;
+	mpw_t *y;
+	mpw_t outstep;
+	long nout = 0;
+	int n, i;
 
-	if G_UNLIKELY ( ! check_argument_function_or_identifier (a, 0, "CompositeSimpsonsRule") ||
-			! check_argument_real_number (a, 1, "CompositeSimpsonsRule") ||
-			! check_argument_real_number (a, 2, "CompositeSimpsonsRule") ||
-			! check_argument_positive_integer (a, 3, "CompositeSimpsonsRule"))
+	if G_UNLIKELY ( ! check_argument_function_or_identifier (a, 0, funcname) ||
+			! check_argument_real_number (a, 1, funcname) ||
+			! check_argument_real_number (a, 3, funcname))
 		return NULL;
-
-	ia = a[1]->val.value;
-	ib = a[2]->val.value;
-	in = a[3]->val.value;
-	if (mpw_odd_p (in))
-		mpw_add_ui (in, in, 1);
-
-	n = mpw_get_long (in);
-	if G_UNLIKELY (gel_error_num) {
-		gel_error_num = 0;
+	if G_UNLIKELY (a[2]->type != GEL_VALUE_NODE &&
+		       ! check_argument_value_only_matrix (a, 2, funcname))
 		return NULL;
-	}
 
-	if (mpw_cmp (ia, ib) == 0) {
-		return gel_makenum_ui (0);
+	if (full) {
+		if G_UNLIKELY ( ! check_argument_positive_integer (a, 4, funcname))
+			return NULL;
+		nout = mpw_get_long (a[4]->val.value);
+		if G_UNLIKELY (gel_error_num != 0 || nout > G_MAXINT - 1) {
+			gel_error_num = 0;
+			gel_errorout (_("%s: n too large"), funcname);
+			return NULL;
+		}
+		tola = a[5];
+	} else {
+		tola = a[4];
 	}
 
-	if (mpw_cmp (ia, ib) > 0) {
-		mpw_ptr tmp = ia;
-		ia = ib;
-		ib = tmp;
-		do_neg = TRUE;
+	if (tola != NULL) {
+		if G_UNLIKELY (a[full ? 6 : 5] != NULL) {
+			gel_errorout (_("%s: Too many arguments, should be at most %d"),
+				      funcname, full ? 6 : 5);
+			return NULL;
+		}
+		if G_UNLIKELY (tola->type != GEL_VALUE_NODE ||
+			       mpw_is_complex (tola->val.value) ||
+			       mpw_sgn (tola->val.value) <= 0) {
+			gel_errorout (_("%s: tolerance must be a positive real number"),
+				      funcname);
+			return NULL;
+		}
+		tol = mpw_get_double (tola->val.value);
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			return NULL;
+		}
 	}
 
 	if (a[0]->type == GEL_FUNCTION_NODE) {
@@ -6448,95 +8882,151 @@ CompositeSimpsonsRule_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 	}
 
 	if G_UNLIKELY (f == NULL ||
-		       f->nargs != 1) {
-		gel_errorout (_("%s: argument not a function of one variable"),
-			      "CompositeSimpsonsRule");
+		       f->nargs != 2) {
+		gel_errorout (_("%s: argument not a function of two variables"),
+			      funcname);
 		return NULL;
 	}
 
-	mpw_init (fret);
-	mpw_init (X);
-	mpw_init (XI0);
-	mpw_init (XI1);
-	mpw_init (XI2);
-	mpw_init (h);
-
-	/*
-	h=(b-a)/n;       # Subdivision interval
-	*/
-	mpw_sub (h, ib, ia);
-	mpw_div (h, h, in);
-	mpw_make_float (h);
-
-	/*
-	XI0=f(a)+f(b);   # End points
-	*/
-	if ( ! call_func (ctx, XI0, f, ia))
-		goto end_of_simpson;
-	if ( ! call_func (ctx, fret, f, ib))
-		goto end_of_simpson;
-	mpw_add (XI0, XI0, fret);
-
-	/*
-	XI1=0;           # odd points
-	XI2=0;           # even points
-        X=a;             # current position
-	*/
-	mpw_set_d (XI1, 0);
-	mpw_set_d (XI2, 0);
-	mpw_set (X, ia);
-	mpw_make_float (X);
-
-	/* FIXME: */
-	for (i = 1; i < n; i++) {
-		/*
-		   X=X+h;
-		   if i%2 == 0
-		   then XI2=XI2+f(X)
-		   else XI1=XI1+f(X)
-		   */
-		mpw_add (X, X, h);
-		if ( ! call_func (ctx, fret, f, X))
-			goto end_of_simpson;
-		if (i & 0x1 /* odd */) {
-			mpw_add (XI1, XI1, fret);
-		} else /* even */ {
-			mpw_add (XI2, XI2, fret);
+	rd.ctx = ctx;
+	rd.f = f;
+	if (a[2]->type == GEL_MATRIX_NODE) {
+		rd.w = gel_matrixw_width (a[2]->mat.matrix);
+		rd.h = gel_matrixw_height (a[2]->mat.matrix);
+		n = rd.w * rd.h;
+	} else {
+		rd.w = rd.h = 0;
+		n = 1;
+	}
+
+	if (full) {
+		rd.rows = nout + 1;
+		rd.out = gel_matrix_new ();
+		gel_matrix_set_size (rd.out, 2, rd.rows, FALSE /* padding */);
+	}
+
+	/* try doubles first if it is precise enough */
+	if (n == 1 && rd.w == 0 &&
+	    ! mpw_is_complex (a[2]->val.value) &&
+	    tol >= 1e-12 &&
+	    (rd.df = gel_dfunc_compile (f, 2)) != NULL &&
+	    gel_dfunc_prepare (rd.df)) {
+		double t0 = mpw_get_double (a[1]->val.value);
+		double t1 = mpw_get_double (a[3]->val.value);
+		double yd = mpw_get_double (a[2]->val.value);
+
+		if (gel_error_num == 0) {
+			res = gel_ode_dopri5 (rka_func_d, &rd, 1, t0, &yd, t1,
+					      tol, tol, 0.0,
+					      full ? fabs (t1 - t0) / nout : 0.0,
+					      full ? rka_out_d : NULL,
+					      NULL);
+			if (res == GEL_ODE_DONE) {
+				gel_dfunc_free (rd.df);
+				if (full)
+					goto make_full;
+				return gel_makenum_d (yd);
+			}
+			if (res == GEL_ODE_INTERRUPTED) {
+				gel_dfunc_free (rd.df);
+				goto out_of_here;
+			}
 		}
-
-		if (gel_evalnode_hook) {
-			if G_UNLIKELY ((i & 0x3FF) == 0x3FF) {
-				(*gel_evalnode_hook)();
+		/* no luck, perhaps f leaves the reals, do it in
+		 * full precision */
+		gel_error_num = 0;
+		rd.row = 0;
+		if (full) {
+			for (i = 0; i < rd.rows; i++) {
+				gel_freetree (gel_matrix_index (rd.out, 0, i));
+				gel_freetree (gel_matrix_index (rd.out, 1, i));
+				gel_matrix_index (rd.out, 0, i) = NULL;
+				gel_matrix_index (rd.out, 1, i) = NULL;
 			}
 		}
 	}
+	if (rd.df != NULL) {
+		gel_dfunc_free (rd.df);
+		rd.df = NULL;
+	}
 
-	/*
-        h*(XI0+2*XI2+4*XI1)/3
-	*/
-	mpw_mul_ui (XI1, XI1, 4);
-	mpw_mul_ui (XI2, XI2, 2);
-	mpw_add (fret, XI0, XI1);
-	mpw_add (fret, fret, XI2);
-	mpw_mul (fret, fret, h);
-	mpw_div_ui (fret, fret, 3);
-
-	if (do_neg)
-		mpw_neg (fret, fret);
+	y = g_new (mpw_t, n);
+	if (rd.w == 0) {
+		mpw_init_set (y[0], a[2]->val.value);
+	} else {
+		for (i = 0; i < n; i++) {
+			GelETree *t = gel_matrixw_vindex (a[2]->mat.matrix, i);
+			mpw_init_set (y[i], t->val.value);
+		}
+	}
+	if (full) {
+		mpw_init (outstep);
+		mpw_sub (outstep, a[3]->val.value, a[1]->val.value);
+		mpw_abs (outstep, outstep);
+		mpw_div_ui (outstep, outstep, nout);
+		mpw_make_float (outstep);
+	}
+
+	res = gel_ode_dopri5_mpw (rka_func_mpw, &rd, n,
+				  a[1]->val.value, y, a[3]->val.value,
+				  tol, tol,
+				  full ? outstep : NULL,
+				  full ? rka_out_mpw : NULL,
+				  NULL);
+
+	if (res == GEL_ODE_DONE && ! full)
+		ret = rka_make_y (&rd, y);
+
+	for (i = 0; i < n; i++)
+		mpw_clear (y[i]);
+	g_free (y);
+	if (full)
+		mpw_clear (outstep);
+
+	if (res == GEL_ODE_DONE) {
+		if (full)
+			goto make_full;
+		return ret;
+	}
 
-	ret = gel_makenum (fret);
+	if (rd.bad_return) {
+		gel_errorout (_("%s: f must return a value of the same size as y0"),
+			      funcname);
+	} else if (res == GEL_ODE_FAILED ||
+		   res == GEL_ODE_STEP_TOO_SMALL) {
+		if ( ! rd.f_error)
+			gel_errorout (_("%s: cannot reach the given tolerance, "
+					"perhaps the equation is singular"),
+				      funcname);
+	} else if (res == GEL_ODE_TOO_MANY_STEPS) {
+		gel_errorout (_("%s: too many steps needed"), funcname);
+	}
 
-end_of_simpson:
-	mpw_clear (X);
-	mpw_clear (fret);
-	mpw_clear (XI0);
-	mpw_clear (XI1);
-	mpw_clear (XI2);
-	mpw_clear (h);
+out_of_here:
+	if (full)
+		gel_matrix_free (rd.out);
+	return NULL;
 
+make_full:
+	GEL_GET_NEW_NODE (ret);
+	ret->type = GEL_MATRIX_NODE;
+	ret->mat.matrix = gel_matrixw_new_with_matrix (rd.out);
+	ret->mat.quoted = FALSE;
 	return ret;
 }
 
+static GelETree *
+RungeKuttaAdaptive_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	return runge_kutta_adaptive (ctx, a, FALSE, "RungeKuttaAdaptive");
+}
+
+static GelETree *
+RungeKuttaAdaptiveFull_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
+{
+	return runge_kutta_adaptive (ctx, a, TRUE, "RungeKuttaAdaptiveFull");
+}
+
 static GelETree *
 Parse_op (GelCtx *ctx, GelETree * * a, gboolean *exception)
 {
@@ -6983,6 +9473,39 @@ get_IsPrimeMillerRabinReps (void)
 	return gel_makenum_ui (mympz_is_prime_miller_rabin_reps);
 }
 
+static GelETree *
+set_ParallelThreads (GelETree * a)
+{
+	long threads;
+
+	if G_UNLIKELY ( ! check_argument_nonnegative_integer (&a, 0, "set_ParallelThreads"))
+		return NULL;
+
+	threads = mpw_get_long (a->val.value);
+	if G_UNLIKELY (gel_error_num) {
+		gel_error_num = 0;
+		return NULL;
+	}
+	if G_UNLIKELY (threads > 256) {
+		gel_errorout (_("%s: argument should be between %d and %d"),
+			      "set_ParallelThreads", 0, 256);
+		return NULL;
+	}
+
+	if (parallel_threads != threads) {
+		parallel_threads = threads;
+		/* apply_get_threads resizes the pool */
+		apply_threads = -1;
+	}
+
+	return gel_makenum_ui (parallel_threads);
+}
+static GelETree *
+get_ParallelThreads (void)
+{
+	return gel_makenum_ui (parallel_threads);
+}
+
 int
 gel_count_arguments (GelETree **a)
 {
@@ -7033,6 +9556,7 @@ gel_funclib_addall(void)
 	ALIAS (False, 0, false);
 
 	FUNC (CurrentTime, 0, "", "basic", N_("Unix time in seconds as a floating point number"));
+	FUNC (EvalStats, 0, "", "basic", N_("Return internal allocation and evaluation counters as a matrix of names and values"));
 
 	/* FIXME: TRUE, FALSE aliases can't be done with the macros in funclibhelper.cP! */
 	d_addfunc (d_makebifunc (d_intern ("TRUE"), true_op, 0));
@@ -7078,6 +9602,8 @@ gel_funclib_addall(void)
 
 	PARAMETER (IsPrimeMillerRabinReps, N_("Number of extra Miller-Rabin tests to run on a number before declaring it a prime in IsPrime"));
 
+	PARAMETER (ParallelThreads, N_("Number of threads for builtins applied to large matrices elementwise, 1 means no threads, 0 means one per processor"));
+
 	/* secret functions */
 	d_addfunc(d_makebifunc(d_intern("ninini"),ninini_op,0));
 	d_addfunc(d_makebifunc(d_intern("shrubbery"),shrubbery_op,0));
@@ -7233,6 +9759,10 @@ gel_funclib_addall(void)
 	FUNC (MillerRabinTest, 2, "n,reps", "number_theory", N_("Use the Miller-Rabin primality test on n, reps number of times.  The probability of false positive is (1/4)^reps"));
 	FUNC (MillerRabinTestSure, 1, "n", "number_theory", N_("Use the Miller-Rabin primality test on n with enough bases that assuming the Generalized Riemann Hypothesis the result is deterministic"));
 	FUNC (Factorize, 1, "n", "number_theory", N_("Return factorization of a number as a matrix"));
+	FUNC (DiscreteLog, 3, "n,b,q", "number_theory", N_("Find discrete log of n base b in F_q where q is a prime using the Silver-Pohlig-Hellman algorithm"));
+	FUNC (SilverPohligHellmanWithFactorization, 4, "n,b,q,f", "number_theory", N_("Find discrete log of n base b in F_q where q is a prime using the Silver-Pohlig-Hellman algorithm, given f being the factorization of q-1"));
+	FUNC (IndexCalculusPrecalculation, 3, "b,q,S", "number_theory", N_("Run the precalculation step of IndexCalculus for logarithms base b in F_q (q a prime) for the factor base S (where S is a column vector of primes).  The logs will be precalculated and returned in the second column."));
+	FUNC (IndexCalculus, 4, "n,b,q,S", "number_theory", N_("Compute discrete log base b of n in F_q (q a prime) using the factor base S.  S should be a column of primes possibly with second column precalculated by IndexCalculusPrecalculation."));
 
 	VFUNC (max, 2, "a,args", "numeric", N_("Returns the maximum of arguments or matrix"));
 	VALIAS (Max, 2, max);
@@ -7290,6 +9820,15 @@ gel_funclib_addall(void)
 	FUNC (det, 1, "M", "linear_algebra", N_("Get the determinant of a matrix"));
 	ALIAS (Determinant, 1, det);
 
+	FUNC (QRDecomposition, 2, "A,Q", "linear_algebra", N_("Get the QR decomposition of A, returns R and Q can be a reference"));
+	VFUNC (LUDecomposition, 4, "A,L,U,args", "linear_algebra", N_("Get the LU decomposition of A and store the result in the L and U which should be references.  With a fourth reference P, rows are pivoted and PA=LU.  If not possible returns false."));
+	FUNC (NumericalEigenvalues, 1, "M", "linear_algebra", N_("Get the eigenvalues of a matrix by the QR algorithm in floating point"));
+	VFUNC (NumericalEigenvectors, 2, "M,args", "linear_algebra", N_("Get the eigenvectors of a matrix by the QR algorithm in floating point, optionally store eigenvalues and multiplicities in references"));
+	VFUNC (SmithNormalFormInteger, 2, "M,args", "linear_algebra", N_("Smith normal form of an integer matrix, optionally store the transformations U and V (S=UMV) in references"));
+	VFUNC (HermiteNormalFormInteger, 2, "M,args", "linear_algebra", N_("Hermite normal form (row echelon over the integers) of an integer matrix, optionally store the transformation U (H=UM) in a reference"));
+	FUNC (InvariantFactorsInteger, 1, "M", "linear_algebra", N_("Get the invariant factors of an integer matrix"));
+	FUNC (DeterminantalDivisorsInteger, 1, "M", "linear_algebra", N_("Get the determinantal divisors of an integer matrix"));
+
 	FUNC (PivotColumns, 1, "M", "linear_algebra", N_("Return pivot columns of a matrix, that is columns which have a leading 1 in rref form, also returns the row where they occur"));
 
 	FUNC (NullSpace, 1, "M", "linear_algebra", N_("Get the nullspace of a matrix"))
@@ -7309,6 +9848,8 @@ gel_funclib_addall(void)
 	FUNC (IsZero, 1, "x", "matrix", N_("Check if a number or a matrix is all zeros"));
 	FUNC (IsIdentity, 1, "x", "matrix", N_("Check if a number or a matrix is 1 or identity respectively"));
 
+	FUNC (MakeSet, 1, "X", "sets", N_("Returns a set where every element of X appears only once"));
+	FUNC (Union, 2, "X,Y", "sets", N_("Returns a set theoretic union of X and Y (X and Y are vectors pretending to be sets)"));
 	FUNC (IsIn, 2, "x,X", "sets", N_("Returns true if the element x is in the set X (where X is a vector pretending to be a set)"));
 	FUNC (IsSubset, 2, "X,Y", "sets", N_("Returns true if X is a subset of Y"));
 	FUNC (SetMinus, 2, "X,Y", "sets", N_("Returns a set theoretic difference X-Y (X and Y are vectors pretending to be sets)"));
@@ -7343,10 +9884,16 @@ gel_funclib_addall(void)
 	FUNC (Poly2ndDerivative, 1, "p", "polynomial", N_("Take second polynomial (as vector) derivative"));
 	FUNC (TrimPoly, 1, "p", "polynomial", N_("Trim zeros from a vector pretending to be a polynomial, that is trim trailing zero elements"));
 	FUNC (IsPoly, 1, "p", "polynomial", N_("Check if a vector is usable as a polynomial"));
+	FUNC (Polynomial, 1, "v", "polynomial", N_("Make a polynomial from a vector of coefficients (constant term first) or a number"));
+	FUNC (PolyToVector, 1, "p", "polynomial", N_("Get the vector of coefficients of a polynomial"));
+	FUNC (PolyEvaluate, 2, "p,x", "polynomial", N_("Evaluate a polynomial at x"));
+	FUNC (PolyGCD, 2, "p,q", "polynomial", N_("Monic greatest common divisor of two polynomials"));
 	VFUNC (PolyToString, 2, "p,var", "polynomial", N_("Make string out of a polynomial (as vector)"));
 	FUNC (PolyToFunction, 1, "p", "polynomial", N_("Make function out of a polynomial (as vector)"));
 
 	FUNC (QuadraticFormula, 1, "p", "equation_solving", N_("Find roots of a quadratic polynomial (given as vector of coefficients)"));
+	VFUNC (RungeKuttaAdaptive, 5, "f,x0,y0,x1,tol", "equation_solving", N_("Use the adaptive Dormand-Prince method with error control to numerically solve y'=f(x,y) for initial x0,y0 going to x1, returns y at x1"));
+	VFUNC (RungeKuttaAdaptiveFull, 6, "f,x0,y0,x1,n,tol", "equation_solving", N_("Use the adaptive Dormand-Prince method with error control to numerically solve y'=f(x,y) for initial x0,y0 going to x1, returns an n+1 by 2 matrix of values at n equally spaced points"));
 
 	FUNC (Combinations, 2, "k,n", "combinatorics", N_("Get all combinations of k numbers from 1 to n as a vector of vectors"));
 	FUNC (NextCombination, 2, "v,n", "combinatorics", N_("Get combination that would come after v in call to combinations, first combination should be [1:k]."));
@@ -7354,6 +9901,17 @@ gel_funclib_addall(void)
 
 	FUNC (nCr, 2, "n,r", "combinatorics", N_("Calculate combinations (binomial coefficient)"));
 	ALIAS (Binomial, 2, nCr);
+	FUNC (Factorial, 1, "n", "combinatorics", N_("Factorial: n(n-1)(n-2)..."));
+	FUNC (Catalan, 1, "n", "combinatorics", N_("Get nth Catalan number"));
+	FUNC (Fibonacci, 1, "x", "combinatorics", N_("Calculate nth Fibonacci number"));
+	ALIAS (fib, 1, Fibonacci);
+	FUNC (HarmonicNumber, 2, "n,r", "combinatorics", N_("Harmonic Number, the nth harmonic number of order r"));
+	ALIAS (HarmonicH, 2, HarmonicNumber);
+	FUNC (StirlingNumberFirst, 2, "n,m", "combinatorics", N_("Stirling number of the first kind"));
+	ALIAS (StirlingS1, 2, StirlingNumberFirst);
+	FUNC (StirlingNumberSecond, 2, "n,m", "combinatorics", N_("Stirling number of the second kind"));
+	ALIAS (StirlingS2, 2, StirlingNumberSecond);
+	FUNC (BernoulliNumber, 1, "n", "number_theory", N_("Return the nth Bernoulli number"));
 
 	FUNC (StringToASCII, 1, "str", "misc", N_("Convert a string to a vector of ASCII values"));
 	FUNC (ASCIIToString, 1, "vec", "misc", N_("Convert a vector of ASCII values to a string"));
@@ -7380,6 +9938,10 @@ gel_funclib_addall(void)
 
 	FUNC (CompositeSimpsonsRule, 4, "f,a,b,n", "calculus", N_("Integration of f by Composite Simpson's Rule on the interval [a,b] with n subintervals with error of max(f'''')*h^4*(b-a)/180, note that n should be even"));
 	f->no_mod_all_args = 1;
+	VFUNC (AdaptiveGaussKronrod, 4, "f,a,b,tol", "calculus", N_("Integration of f on the interval [a,b] by the adaptive Gauss-Kronrod 7-15 rule in double precision, with the estimated error at most tol (default 1e-10)"));
+	f->no_mod_all_args = 1;
+	VFUNC (TanhSinhQuadrature, 4, "f,a,b,tol", "calculus", N_("Integration of f on the interval [a,b] by the tanh-sinh (double exponential) rule in the current float precision, handles singularities at the endpoints, the estimated error is at most tol (default 1e-10) times the integral of |f|"));
+	f->no_mod_all_args = 1;
 
 	/*temporary until well done internal functions are done*/
 	/* Search also for _internal_exp_function above, it's done on
@@ -7395,6 +9957,30 @@ gel_funclib_addall(void)
 					    NULL);
 #endif
 
+	/* builtins that may be run over matrices in worker threads, see
+	 * apply_parallel */
+	parallel_funcs = g_hash_table_new (NULL, NULL);
+#define PARALLEL(name) \
+	g_hash_table_add (parallel_funcs, (gpointer)name##_op)
+	PARALLEL (sin);
+	PARALLEL (cos);
+	PARALLEL (tan);
+	PARALLEL (sinh);
+	PARALLEL (cosh);
+	PARALLEL (atan);
+	PARALLEL (GammaFunction);
+	PARALLEL (IsPrime);
+	PARALLEL (StrongPseudoprimeTest);
+	PARALLEL (IsPerfectSquare);
+	PARALLEL (IsPerfectPower);
+	PARALLEL (Factorial);
+	PARALLEL (Catalan);
+	PARALLEL (Fibonacci);
+	PARALLEL (nCr);
+	PARALLEL (StirlingNumberFirst);
+	PARALLEL (StirlingNumberSecond);
+#undef PARALLEL
+
 	gel_add_symbolic_functions ();
 
 	/*protect EVERYthing up to this point*/
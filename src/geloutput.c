@@ -22,6 +22,7 @@
 #include "config.h"
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "structs.h"
 
@@ -74,11 +75,57 @@ gel_output_putchar(GelOutput *gelo, char ch, gboolean limit, int ll)
 	g_string_append_c(gelo->outs, ch);
 }
 
+/* write out the buffered output in blocks this large when printing
+ * very long strings */
+#define GEL_OUTPUT_BLOCK 65536
+
+/* Append a run of n ordinary characters (no newline, tab or escape, and
+ * not inside an escape).  Does the same truncation as putting the
+ * characters through gel_output_putchar one at a time. */
+static void
+gel_output_put_run (GelOutput *gelo, const char *s, int n,
+		    gboolean limit, int ll)
+{
+	int pos = gelo->cur_line_pos;
+	int k;
+
+	if ( ! limit) {
+		g_string_append_len (gelo->outs, s, n);
+		gelo->cur_line_pos += n;
+		return;
+	}
+
+	if (pos > ll)
+		return;
+
+	/* characters landing before column ll-3 get printed, column ll-3
+	 * gets the "..." and the rest is swallowed, though the position
+	 * still counts up to ll+1 */
+	k = ll - 4 - pos;
+	if (k > 0)
+		g_string_append_len (gelo->outs, s, MIN (k, n));
+	k = ll - 3 - pos;
+	if (k >= 1 && k <= n)
+		g_string_append (gelo->outs, "...");
+
+	gelo->cur_line_pos = MIN (pos + n, ll + 1);
+}
+
+static void
+gel_output_write_out (GelOutput *gelo)
+{
+	if (gelo->outs->len > 0) {
+		fwrite (gelo->outs->str, 1, gelo->outs->len, gelo->outfp);
+		g_string_truncate (gelo->outs, 0);
+	}
+}
+
 static void
 gel_output_print_string (GelOutput *gelo, const char *string, gboolean limit)
 {
 	int ll;
 	const char *p;
+	gboolean file;
 
 	if (gelo->output_type == GEL_OUTPUT_BLACK_HOLE) {
 		if (gelo->notify != NULL &&
@@ -96,13 +143,32 @@ gel_output_print_string (GelOutput *gelo, const char *string, gboolean limit)
 		limit = FALSE;
 	}
 
-	for (p = string; *p != '\0'; p++) {
+	if (*string != '\0' && gelo->outs == NULL)
+		gelo->outs = g_string_new (NULL);
+
+	file = (gelo->output_type == GEL_OUTPUT_FILE);
+	if (file)
+		g_assert (gelo->outfp != NULL);
+
+	p = string;
+	while (*p != '\0') {
+		/* copy runs of ordinary characters in one go */
+		if ( ! gelo->inside_escape &&
+		     *p != '\n' && *p != '\t' && *p != '\e') {
+			int n = strcspn (p, "\n\t\e");
+			gel_output_put_run (gelo, p, n, limit, ll);
+			p += n;
+			if (file && gelo->outs->len >= GEL_OUTPUT_BLOCK)
+				gel_output_write_out (gelo);
+			continue;
+		}
+
 		if (*p=='\n') {
 			gel_output_putchar (gelo, '\n', limit, ll);
 		} else if (limit &&
 			   gelo->cur_line_pos > ll &&
 			   ! gelo->inside_escape) {
-			continue;
+			;
 		} else if(*p=='\t') {
 			int n;
 			int left = (8-(gelo->cur_line_pos%8));
@@ -111,17 +177,18 @@ gel_output_print_string (GelOutput *gelo, const char *string, gboolean limit)
 		} else {
 			gel_output_putchar (gelo, *p, limit, ll);
 		}
+		p++;
 	}
 
-	if (gelo->output_type == GEL_OUTPUT_FILE &&
-	    gelo->outs != NULL) {
-		g_assert (gelo->outfp != NULL);
-		fputs (gelo->outs->str, gelo->outfp);
-		g_string_truncate (gelo->outs, 0);
-	}
+	/* inside a push/pop_nonotify the whole thing being printed is
+	 * collected and written out once by gel_output_pop_nonotify */
+	if (gelo->no_notify > 0)
+		return;
 
-	if (gelo->notify != NULL &&
-	    ! gelo->no_notify)
+	if (file && gelo->outs != NULL)
+		gel_output_write_out (gelo);
+
+	if (gelo->notify != NULL)
 		gelo->notify (gelo);
 }
 
@@ -195,6 +262,10 @@ gel_output_destroy (GelOutput *gelo)
 {
 	g_return_if_fail (gelo!=NULL);
 
+	if (gelo->output_type == GEL_OUTPUT_FILE &&
+	    gelo->outs != NULL)
+		gel_output_write_out (gelo);
+
 	if (gelo->outs != NULL)
 		g_string_free (gelo->outs, TRUE);
 
@@ -391,10 +462,8 @@ gel_output_flush(GelOutput *gelo)
 
 	if(gelo->output_type == GEL_OUTPUT_FILE) {
 		g_assert (gelo->outfp != NULL);
-		if (gelo->outs != NULL) {
-			fputs (gelo->outs->str, gelo->outfp);
-			g_string_truncate (gelo->outs, 0);
-		}
+		if (gelo->outs != NULL)
+			gel_output_write_out (gelo);
 		fflush(gelo->outfp);
 	}
 }
@@ -411,7 +480,11 @@ gel_output_pop_nonotify (GelOutput *gelo)
 {
 	g_return_if_fail (gelo != NULL);
 	gelo->no_notify--;
-	if (gelo->no_notify <= 0 &&
-	    gelo->notify != NULL)
+	if (gelo->no_notify > 0)
+		return;
+	if (gelo->output_type == GEL_OUTPUT_FILE &&
+	    gelo->outs != NULL)
+		gel_output_write_out (gelo);
+	if (gelo->notify != NULL)
 		gelo->notify (gelo);
 }
@@ -0,0 +1,400 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "calc.h"
+
+#include "geltrace.h"
+
+/* A finished span, kept in the ring buffer */
+typedef struct {
+	const char *name;
+	const char *file;
+	guint path; /* folded stack, only with GEL_TRACE_FOLDED */
+	gint64 start;
+	gint64 dur;
+	gint64 self;
+	int line;
+	guint16 depth;
+	guint8 builtin;
+} GelTraceSpan;
+
+/* A span that is still open */
+typedef struct {
+	const char *name;
+	const char *file;
+	guint path;
+	gint64 start;
+	gint64 children;
+	int line;
+	guint8 builtin;
+} GelTraceFrame;
+
+gboolean gel_trace_on = FALSE;
+
+static FILE *trace_fp = NULL;
+static GelTraceFormat trace_format = GEL_TRACE_CHROME;
+static gint64 trace_epoch = 0;
+
+static GelTraceSpan *ring = NULL;
+static int ring_size = 0;
+static int ring_head = 0;
+static int ring_count = 0;
+static long ring_dropped = 0;
+
+static GelTraceFrame *frames = NULL;
+static int frames_size = 0;
+static int frames_top = 0;
+
+/* interned file names, these must survive gel_pop_file_info */
+static GHashTable *strings = NULL;
+
+/* A folded stack path is its innermost name and the path of the
+ * caller, so a path costs the same however deep it is.  Paths are
+ * numbered from 1 in the order seen, 0 is the empty path. */
+typedef struct {
+	guint parent;
+	const char *name;
+} GelTracePath;
+
+static GPtrArray *paths = NULL;
+static GHashTable *path_ids = NULL;
+
+static const char *
+intern (const char *s)
+{
+	char *r;
+
+	if (s == NULL)
+		return NULL;
+
+	r = g_hash_table_lookup (strings, s);
+	if (r == NULL) {
+		r = g_strdup (s);
+		g_hash_table_insert (strings, r, r);
+	}
+	return r;
+}
+
+static guint
+path_hash (gconstpointer key)
+{
+	const GelTracePath *p = key;
+	return g_direct_hash (p->name) ^ (p->parent * 31);
+}
+
+static gboolean
+path_equal (gconstpointer a, gconstpointer b)
+{
+	const GelTracePath *pa = a;
+	const GelTracePath *pb = b;
+	return pa->parent == pb->parent && pa->name == pb->name;
+}
+
+/* name is an interned token, compared by address */
+static guint
+intern_path (guint parent, const char *name)
+{
+	GelTracePath key;
+	GelTracePath *p;
+	gpointer id;
+
+	key.parent = parent;
+	key.name = name;
+	id = g_hash_table_lookup (path_ids, &key);
+	if (id != NULL)
+		return GPOINTER_TO_UINT (id);
+
+	p = g_new (GelTracePath, 1);
+	*p = key;
+	g_ptr_array_add (paths, p);
+	g_hash_table_insert (path_ids, p, GUINT_TO_POINTER (paths->len));
+	return paths->len;
+}
+
+/* The folded stack for a path, outermost name first */
+static char *
+path_string (guint id)
+{
+	GString *gs = g_string_new (NULL);
+	GSList *names = NULL, *li;
+
+	while (id != 0) {
+		GelTracePath *p = g_ptr_array_index (paths, id-1);
+		names = g_slist_prepend (names, (gpointer)p->name);
+		id = p->parent;
+	}
+
+	for (li = names; li != NULL; li = li->next) {
+		if (li != names)
+			g_string_append_c (gs, ';');
+		g_string_append (gs, li->data);
+	}
+	g_slist_free (names);
+
+	return g_string_free (gs, FALSE);
+}
+
+gboolean
+gel_trace_start (const char *file, GelTraceFormat format, int nspans)
+{
+	FILE *fp;
+
+	g_return_val_if_fail (file != NULL, FALSE);
+
+	if (gel_trace_on)
+		gel_trace_stop ();
+
+	fp = fopen (file, "w");
+	if (fp == NULL)
+		return FALSE;
+
+	if (nspans <= 0)
+		nspans = GEL_TRACE_DEFAULT_SPANS;
+
+	trace_fp = fp;
+	trace_format = format;
+	trace_epoch = g_get_monotonic_time ();
+
+	ring = g_new (GelTraceSpan, nspans);
+	ring_size = nspans;
+	ring_head = 0;
+	ring_count = 0;
+	ring_dropped = 0;
+
+	frames_size = 256;
+	frames = g_new (GelTraceFrame, frames_size);
+	frames_top = 0;
+
+	strings = g_hash_table_new_full (g_str_hash, g_str_equal,
+					 g_free, NULL);
+	paths = g_ptr_array_new_with_free_func (g_free);
+	path_ids = g_hash_table_new (path_hash, path_equal);
+
+	gel_trace_on = TRUE;
+
+	return TRUE;
+}
+
+void
+gel_trace_enter (const char *name, gboolean builtin)
+{
+	GelTraceFrame *fr;
+	char *file;
+	int line;
+
+	if (frames_top >= frames_size) {
+		frames_size *= 2;
+		frames = g_renew (GelTraceFrame, frames, frames_size);
+	}
+
+	gel_get_file_info (&file, &line);
+
+	fr = &frames[frames_top];
+	fr->name = name != NULL ? name : "anonymous";
+	fr->file = intern (file);
+	fr->line = line;
+	fr->builtin = builtin ? 1 : 0;
+	fr->children = 0;
+	if (trace_format == GEL_TRACE_FOLDED)
+		fr->path = intern_path (frames_top > 0 ?
+					frames[frames_top-1].path : 0,
+					fr->name);
+	else
+		fr->path = 0;
+
+	frames_top++;
+
+	/* take the time last so that we don't count our own overhead */
+	fr->start = g_get_monotonic_time ();
+}
+
+void
+gel_trace_leave (void)
+{
+	GelTraceFrame *fr;
+	GelTraceSpan *sp;
+	gint64 now;
+	gint64 dur;
+
+	/* unbalanced leave, for example the context stack was reset
+	 * after an error */
+	if (frames_top <= 0)
+		return;
+
+	now = g_get_monotonic_time ();
+
+	frames_top--;
+	fr = &frames[frames_top];
+	dur = now - fr->start;
+
+	if (frames_top > 0)
+		frames[frames_top-1].children += dur;
+
+	if (ring_count == ring_size)
+		ring_dropped++;
+	else
+		ring_count++;
+
+	sp = &ring[ring_head];
+	ring_head = (ring_head + 1) % ring_size;
+
+	sp->name = fr->name;
+	sp->file = fr->file;
+	sp->path = fr->path;
+	sp->line = fr->line;
+	sp->builtin = fr->builtin;
+	sp->depth = MIN (frames_top, G_MAXUINT16);
+	sp->start = fr->start - trace_epoch;
+	sp->dur = dur;
+	sp->self = MAX (dur - fr->children, 0);
+}
+
+static void
+print_json_string (FILE *fp, const char *s)
+{
+	const char *p;
+
+	fputc ('"', fp);
+	for (p = s; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf (fp, "\\%c", *p);
+		else if ((unsigned char)*p < 0x20)
+			fprintf (fp, "\\u%04x", (unsigned int)(unsigned char)*p);
+		else
+			fputc (*p, fp);
+	}
+	fputc ('"', fp);
+}
+
+static void
+write_chrome (void)
+{
+	int i;
+	gboolean first = TRUE;
+
+	fprintf (trace_fp, "{\"traceEvents\":[\n");
+	for (i = 0; i < ring_count; i++) {
+		GelTraceSpan *sp;
+		sp = &ring[(ring_head - ring_count + i + ring_size) % ring_size];
+
+		if ( ! first)
+			fprintf (trace_fp, ",\n");
+		first = FALSE;
+
+		fprintf (trace_fp, "{\"name\":");
+		print_json_string (trace_fp, sp->name);
+		fprintf (trace_fp, ",\"cat\":\"%s\",\"ph\":\"X\","
+			 "\"ts\":%" G_GINT64_FORMAT ","
+			 "\"dur\":%" G_GINT64_FORMAT ","
+			 "\"pid\":1,\"tid\":1,\"args\":{",
+			 sp->builtin ? "builtin" : "user",
+			 sp->start, sp->dur);
+		if (sp->file != NULL) {
+			fprintf (trace_fp, "\"file\":");
+			print_json_string (trace_fp, sp->file);
+			fprintf (trace_fp, ",");
+		}
+		fprintf (trace_fp, "\"line\":%d,\"depth\":%d}}",
+			 sp->line, (int)sp->depth);
+	}
+	fprintf (trace_fp, "\n],\"displayTimeUnit\":\"ms\","
+		 "\"otherData\":{\"dropped_spans\":\"%ld\"}}\n",
+		 ring_dropped);
+}
+
+static void
+write_folded_cb (gpointer key, gpointer value, gpointer data)
+{
+	gint64 *self = value;
+	if (*self > 0) {
+		char *path = path_string (GPOINTER_TO_UINT (key));
+		fprintf (trace_fp, "%s %" G_GINT64_FORMAT "\n",
+			 path, *self);
+		g_free (path);
+	}
+}
+
+static void
+write_folded (void)
+{
+	GHashTable *sums;
+	int i;
+
+	/* sum the self time (in microseconds) for each stack */
+	sums = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+				      NULL, g_free);
+	for (i = 0; i < ring_count; i++) {
+		GelTraceSpan *sp = &ring[i];
+		gint64 *self;
+
+		self = g_hash_table_lookup (sums, GUINT_TO_POINTER (sp->path));
+		if (self == NULL) {
+			self = g_new0 (gint64, 1);
+			g_hash_table_insert (sums, GUINT_TO_POINTER (sp->path),
+					     self);
+		}
+		*self += sp->self;
+	}
+
+	g_hash_table_foreach (sums, write_folded_cb, NULL);
+	g_hash_table_destroy (sums);
+}
+
+void
+gel_trace_stop (void)
+{
+	if ( ! gel_trace_on)
+		return;
+
+	while (frames_top > 0)
+		gel_trace_leave ();
+
+	gel_trace_on = FALSE;
+
+	if (trace_format == GEL_TRACE_FOLDED)
+		write_folded ();
+	else
+		write_chrome ();
+
+	fclose (trace_fp);
+	trace_fp = NULL;
+
+	g_free (ring);
+	ring = NULL;
+	ring_size = ring_count = ring_head = 0;
+
+	g_free (frames);
+	frames = NULL;
+	frames_size = frames_top = 0;
+
+	g_hash_table_destroy (strings);
+	strings = NULL;
+	g_hash_table_destroy (path_ids);
+	path_ids = NULL;
+	g_ptr_array_free (paths, TRUE);
+	paths = NULL;
+}
@@ -0,0 +1,62 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GELTRACE_H_
+#define _GELTRACE_H_
+
+#include <glib.h>
+
+typedef enum {
+	GEL_TRACE_CHROME = 0, /* chrome://tracing trace-event json */
+	GEL_TRACE_FOLDED      /* folded stacks for flamegraph.pl */
+} GelTraceFormat;
+
+/* default number of spans kept in the ring buffer */
+#define GEL_TRACE_DEFAULT_SPANS 262144
+
+/* Don't set directly, only read this to avoid calling in when
+ * tracing is off */
+extern gboolean gel_trace_on;
+
+/* Start tracing into the given file, at most nspans of the most recent
+ * finished spans are kept (<= 0 means the default).  Returns FALSE if
+ * the file cannot be opened. */
+gboolean	gel_trace_start		(const char *file,
+					 GelTraceFormat format,
+					 int nspans);
+/* Write out the trace and stop tracing, any spans still open are
+ * closed at the current time */
+void		gel_trace_stop		(void);
+
+/* Open a span for a function call, name is expected to be an interned
+ * token string (it is not copied), the file and line are taken from
+ * gel_get_file_info */
+void		gel_trace_enter		(const char *name,
+					 gboolean builtin);
+/* Close the innermost open span */
+void		gel_trace_leave		(void);
+
+#define GEL_TRACE_ENTER(name,builtin) \
+	{ if G_UNLIKELY (gel_trace_on) gel_trace_enter ((name), (builtin)); }
+#define GEL_TRACE_LEAVE() \
+	{ if G_UNLIKELY (gel_trace_on) gel_trace_leave (); }
+
+#endif /* _GELTRACE_H_ */
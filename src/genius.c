@@ -36,6 +36,9 @@
 #include <locale.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <poll.h>
 
 #include "calc.h"
 #include "eval.h"
@@ -44,6 +47,8 @@
 #include "inter.h"
 #include "geloutput.h"
 #include "lexer.h"
+#include "geltrace.h"
+#include "plotrender.h"
 
 #include "plugin.h"
 
@@ -341,6 +346,393 @@ interrupt (int sig)
 	signal (SIGINT, interrupt);
 }
 
+static void
+print_stats (void)
+{
+	const char *names[GEL_EVAL_STATS_MAX];
+	unsigned long values[GEL_EVAL_STATS_MAX];
+	int i, cnt;
+
+	cnt = gel_eval_stats_collect (names, values, GEL_EVAL_STATS_MAX);
+
+	g_printerr (_("Evaluation statistics:\n"));
+	for (i = 0; i < cnt; i++)
+		g_printerr ("  %-20s %lu\n", names[i], values[i]);
+}
+
+/* Options that change the calculator state and that fit in one argument,
+ * these can also appear on OPTIONS lines of a --batch file */
+static gboolean
+set_state_option (GelCalcState *state, const char *arg)
+{
+	int val;
+
+	if (sscanf (arg, "--precision=%d", &val) == 1) {
+		if (val < 60 || val > 16384) {
+			g_printerr (_("%s should be between %d and %d, using %d"),
+				    "--precision", 60, 16384, 128);
+			val = 128;
+		}
+		state->float_prec = val;
+	} else if (sscanf (arg, "--maxdigits=%d", &val) == 1) {
+		if (val < 0 || val > 256) {
+			g_printerr (_("%s should be between %d and %d, using %d"),
+				    "--maxdigits", 0, 256, 12);
+			val = 12;
+		}
+		state->max_digits = val;
+	} else if (strcmp (arg, "--floatresult") == 0)
+		state->results_as_floats = TRUE;
+	else if (strcmp (arg, "--nofloatresult") == 0)
+		state->results_as_floats = FALSE;
+	else if (strcmp (arg, "--scinot") == 0)
+		state->scientific_notation = TRUE;
+	else if (strcmp (arg, "--noscinot") == 0)
+		state->scientific_notation = FALSE;
+	else if (strcmp (arg, "--fullexp") == 0)
+		state->full_expressions = TRUE;
+	else if (strcmp (arg, "--nofullexp") == 0)
+		state->full_expressions = FALSE;
+	else if (sscanf (arg, "--maxerrors=%d", &val) == 1) {
+		if (val < 0) {
+			g_printerr (_("%s should be greater then or equal to %d, using %d"),
+				    "--maxerrors", 0, 5);
+			val = 5;
+		}
+		state->max_errors = val;
+	} else if (strcmp (arg, "--mixed") == 0)
+		state->mixed_fractions = TRUE;
+	else if (strcmp (arg, "--nomixed") == 0)
+		state->mixed_fractions = FALSE;
+	else if (sscanf (arg, "--intoutbase=%d", &val) == 1)
+		state->integer_output_base = val;
+	else if (sscanf (arg, "--chop=%d", &val) == 1)
+		state->chop = val;
+	else if (sscanf (arg, "--chopwhen=%d", &val) == 1)
+		state->chop_when = val;
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Batch testing, reads the geniustests.txt format:
+ *
+ *	OPTIONS --maxdigits=12
+ *	expression<tabs>expected first line of output
+ *
+ * The library is loaded just once, each entry is then evaluated in a
+ * child forked off of this process, so every entry starts from the same
+ * pristine state and a runaway entry can simply be killed.
+ */
+
+typedef struct {
+	char *expr;
+	char *expected;
+	char *reported;
+	int line;
+	GelCalcState state;
+	gboolean failed;
+	gboolean timed_out;
+} BatchEntry;
+
+typedef struct {
+	pid_t pid;
+	int fd;
+	GString *out;
+	gint64 start;
+	BatchEntry *entry;
+} BatchJob;
+
+static GPtrArray *
+batch_read (const char *file)
+{
+	GPtrArray *entries;
+	GelCalcState state = curstate;
+	char *contents;
+	char **lines;
+	int i;
+
+	if ( ! g_file_get_contents (file, &contents, NULL, NULL))
+		return NULL;
+
+	entries = g_ptr_array_new ();
+	lines = g_strsplit (contents, "\n", -1);
+	g_free (contents);
+
+	for (i = 0; lines[i] != NULL; i++) {
+		BatchEntry *e;
+		char *p = lines[i];
+		char *tab;
+
+		if (strncmp (p, "OPTIONS", strlen ("OPTIONS")) == 0 &&
+		    (p[7] == ' ' || p[7] == '\t')) {
+			char **opts;
+			int j;
+
+			/* options replace the previous OPTIONS line */
+			state = curstate;
+			opts = g_strsplit_set (p + 7, " \t", -1);
+			for (j = 0; opts[j] != NULL; j++) {
+				if (opts[j][0] == '\0')
+					continue;
+				if ( ! set_state_option (&state, opts[j]))
+					g_printerr (_("%s:%d: Unknown option '%s'\n"),
+						    file, i+1, opts[j]);
+			}
+			g_strfreev (opts);
+			continue;
+		}
+
+		if (p[0] == '\0' || p[0] == '\t')
+			continue;
+
+		e = g_new0 (BatchEntry, 1);
+		e->line = i+1;
+		e->state = state;
+		tab = strchr (p, '\t');
+		if (tab == NULL) {
+			e->expr = g_strdup (p);
+			e->expected = g_strdup ("");
+		} else {
+			char *exp = tab;
+			while (*exp == '\t')
+				exp++;
+			/* a stray tab in the expected output, the
+			 * format does not allow it */
+			if (strchr (exp, '\t') != NULL || *exp == '\0') {
+				g_free (e);
+				continue;
+			}
+			e->expr = g_strndup (p, tab - p);
+			e->expected = g_strdup (exp);
+		}
+		g_ptr_array_add (entries, e);
+	}
+	g_strfreev (lines);
+
+	return entries;
+}
+
+static void
+batch_child (BatchEntry *e, int fd)
+{
+	int null;
+
+	/* everything that would go to stdout goes to the parent, errors
+	 * are not part of the comparison */
+	dup2 (fd, 1);
+	close (fd);
+	null = open ("/dev/null", O_WRONLY);
+	if (null >= 0) {
+		dup2 (null, 2);
+		close (null);
+	}
+	signal (SIGINT, SIG_DFL);
+
+	gel_set_new_calcstate (e->state);
+	gel_push_file_info ("expr", 1);
+
+	line_len_cache = -1;
+	gel_evalexp (e->expr, NULL, gel_main_out, NULL, FALSE, NULL);
+	gel_output_flush (gel_main_out);
+	fflush (stdout);
+
+	/* don't run any atexit handlers or save plugins */
+	_exit (0);
+}
+
+static gboolean
+batch_start (BatchJob *job, BatchEntry *e)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (pipe (fds) < 0)
+		return FALSE;
+
+	/* don't duplicate anything buffered in the children */
+	fflush (stdout);
+	fflush (stderr);
+
+	pid = fork ();
+	if (pid < 0) {
+		close (fds[0]);
+		close (fds[1]);
+		return FALSE;
+	} else if (pid == 0) {
+		close (fds[0]);
+		batch_child (e, fds[1]);
+	}
+
+	close (fds[1]);
+	job->pid = pid;
+	job->fd = fds[0];
+	job->out = g_string_new (NULL);
+	job->start = g_get_monotonic_time ();
+	job->entry = e;
+
+	return TRUE;
+}
+
+static void
+batch_finish (BatchJob *job, gboolean timed_out)
+{
+	BatchEntry *e = job->entry;
+	char *nl;
+
+	if (timed_out)
+		kill (job->pid, SIGKILL);
+	close (job->fd);
+	waitpid (job->pid, NULL, 0);
+
+	nl = strchr (job->out->str, '\n');
+	if (nl != NULL)
+		*nl = '\0';
+	e->reported = g_string_free (job->out, FALSE);
+	e->timed_out = timed_out;
+	e->failed = timed_out || strcmp (e->reported, e->expected) != 0;
+
+	job->pid = 0;
+	job->fd = -1;
+	job->out = NULL;
+	job->entry = NULL;
+}
+
+static int
+run_batch (const char *file, int jobs, int timeout)
+{
+	GPtrArray *entries;
+	BatchJob *running;
+	struct pollfd *pfds;
+	gint64 start;
+	int next = 0;
+	int nrunning = 0;
+	int errors = 0;
+	int timeouts = 0;
+	int not_run;
+	int i;
+
+	entries = batch_read (file);
+	if (entries == NULL) {
+		g_printerr (_("Can't open file '%s'\n"), file);
+		return 1;
+	}
+
+	if (jobs < 1)
+		jobs = 1;
+	running = g_new0 (BatchJob, jobs);
+	pfds = g_new0 (struct pollfd, jobs);
+	for (i = 0; i < jobs; i++)
+		running[i].fd = -1;
+
+	start = g_get_monotonic_time ();
+
+	while (next < entries->len || nrunning > 0) {
+		gint64 now;
+
+		for (i = 0; i < jobs && next < entries->len; i++) {
+			if (running[i].pid != 0)
+				continue;
+			if ( ! batch_start (&running[i],
+					    g_ptr_array_index (entries, next))) {
+				/* try again once something finishes */
+				if (nrunning == 0) {
+					g_printerr (_("Can't start a batch process\n"));
+					gel_interrupted = TRUE;
+				}
+				break;
+			}
+			next++;
+			nrunning++;
+		}
+
+		for (i = 0; i < jobs; i++) {
+			pfds[i].fd = running[i].fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+		if (poll (pfds, jobs, 100) < 0 && errno != EINTR)
+			break;
+
+		now = g_get_monotonic_time ();
+		for (i = 0; i < jobs; i++) {
+			BatchJob *job = &running[i];
+
+			if (job->pid == 0)
+				continue;
+
+			if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				char buf[4096];
+				ssize_t n = read (job->fd, buf, sizeof (buf));
+				if (n > 0) {
+					/* only the first line is compared */
+					if (strchr (job->out->str, '\n') == NULL)
+						g_string_append_len (job->out, buf, n);
+				} else if (n == 0 || errno != EINTR) {
+					batch_finish (job, FALSE);
+					nrunning--;
+					continue;
+				}
+			}
+
+			if (timeout > 0 &&
+			    now - job->start > (gint64)timeout * G_USEC_PER_SEC) {
+				batch_finish (job, TRUE);
+				nrunning--;
+			}
+		}
+
+		if G_UNLIKELY (gel_interrupted) {
+			for (i = 0; i < jobs; i++) {
+				if (running[i].pid != 0)
+					batch_finish (&running[i], TRUE);
+			}
+			break;
+		}
+	}
+
+	not_run = entries->len - next;
+
+	for (i = 0; i < entries->len; i++) {
+		BatchEntry *e = g_ptr_array_index (entries, i);
+
+		if ( ! e->failed)
+			continue;
+
+		errors++;
+		if (e->timed_out)
+			timeouts++;
+		g_print ("%s:%d: %s\n", file, e->line, e->expr);
+		g_print (" (should be)=%s\n", e->expected);
+		if (e->timed_out)
+			g_print (_("TIMEOUT after %d seconds\n\n"), timeout);
+		else
+			g_print (" (reported)=%s\n\n", ve_sure_string (e->reported));
+	}
+
+	g_print (_("tests: %d, errors: %d, timeouts: %d, not run: %d "
+		   "(%.2f seconds, %d jobs)\n"),
+		 (int)entries->len, errors, timeouts,
+		 not_run,
+		 (g_get_monotonic_time () - start) / (double)G_USEC_PER_SEC,
+		 jobs);
+
+	for (i = 0; i < entries->len; i++) {
+		BatchEntry *e = g_ptr_array_index (entries, i);
+		g_free (e->expr);
+		g_free (e->expected);
+		g_free (e->reported);
+		g_free (e);
+	}
+	g_ptr_array_free (entries, TRUE);
+	g_free (running);
+	g_free (pfds);
+
+	return (errors > 0 || not_run > 0) ? 1 : 0;
+}
+
 static const char *
 get_version_details (void)
 {
@@ -360,6 +752,13 @@ main(int argc, char *argv[])
 	gboolean do_gettext = FALSE;
 	gboolean be_quiet = FALSE;
 	char *exec = NULL;
+	char *trace_file = NULL;
+	GelTraceFormat trace_format = GEL_TRACE_CHROME;
+	int trace_spans = 0;
+	gboolean do_stats = FALSE;
+	char *batch_file = NULL;
+	int batch_jobs = 0;
+	int batch_timeout = 60;
 
 	g_set_prgname ("genius");
 	g_set_application_name (_("Genius"));
@@ -393,14 +792,9 @@ main(int argc, char *argv[])
 			files = g_slist_append(files,argv[i]);
 		else if(strcmp(argv[i],"--")==0)
 			lastarg = TRUE;
-		else if(sscanf(argv[i],"--precision=%d",&val)==1) {
-			if (val < 60 || val > 16384) {
-				g_printerr (_("%s should be between %d and %d, using %d"),
-					    "--precision", 60, 16384, 128);
-				val = 128;
-			}
-			curstate.float_prec = val;
-		} else if (strcmp (argv[i], "--precision")==0 && i+1 < argc) {
+		else if (set_state_option (&curstate, argv[i]))
+			;
+		else if (strcmp (argv[i], "--precision")==0 && i+1 < argc) {
 			val = 0;
 			sscanf (argv[++i],"%d",&val);
 			if (val < 60 || val > 16384) {
@@ -409,13 +803,6 @@ main(int argc, char *argv[])
 				val = 128;
 			}
 			curstate.float_prec = val;
-		} else if(sscanf(argv[i],"--maxdigits=%d",&val)==1) {
-			if (val < 0 || val > 256) {
-				g_printerr (_("%s should be between %d and %d, using %d"),
-					    "--maxdigits", 0, 256, 12);
-				val = 12;
-			}
-			curstate.max_digits = val;
 		} else if (strcmp (argv[i], "--maxdigits")==0 && i+1 < argc) {
 			val = -1;
 			sscanf (argv[++i],"%d",&val);
@@ -425,25 +812,6 @@ main(int argc, char *argv[])
 				val = 12;
 			}
 			curstate.max_digits = val;
-		} else if(strcmp(argv[i],"--floatresult")==0)
-			curstate.results_as_floats = TRUE;
-		else if(strcmp(argv[i],"--nofloatresult")==0)
-			curstate.results_as_floats = FALSE;
-		else if(strcmp(argv[i],"--scinot")==0)
-			curstate.scientific_notation = TRUE;
-		else if(strcmp(argv[i],"--noscinot")==0)
-			curstate.scientific_notation = FALSE;
-		else if(strcmp(argv[i],"--fullexp")==0)
-			curstate.full_expressions = TRUE;
-		else if(strcmp(argv[i],"--nofullexp")==0)
-			curstate.full_expressions = FALSE;
-		else if(sscanf(argv[i],"--maxerrors=%d",&val)==1) {
-			if (val < 0) {
-				g_printerr (_("%s should be greater then or equal to %d, using %d"),
-					    "--maxerrors", 0, 5);
-				val = 5;
-			}
-			curstate.max_errors = val;
 		} else if (strcmp (argv[i], "--maxerrors")==0 && i+1 < argc) {
 			val = -1;
 			sscanf (argv[++i],"%d",&val);
@@ -453,24 +821,14 @@ main(int argc, char *argv[])
 				val = 5;
 			}
 			curstate.max_errors = val;
-		} else if(strcmp(argv[i],"--mixed")==0)
-			curstate.mixed_fractions = TRUE;
-		else if(strcmp(argv[i],"--nomixed")==0)
-			curstate.mixed_fractions = FALSE;
-		else if(sscanf(argv[i],"--intoutbase=%d",&val)==1) {
-			curstate.integer_output_base = val;
 		} else if (strcmp (argv[i], "--intoutbase")==0 && i+1 < argc) {
 			val = 10;
 			sscanf (argv[++i],"%d",&val);
 			curstate.integer_output_base = val;
-		} else if(sscanf(argv[i],"--chop=%d",&val)==1) {
-			curstate.integer_output_base = val;
 		} else if (strcmp (argv[i], "--chop")==0 && i+1 < argc) {
 			val = 20;
 			sscanf (argv[++i],"%d",&val);
 			curstate.chop = val;
-		} else if(sscanf(argv[i],"--chopwhen=%d",&val)==1) {
-			curstate.integer_output_base = val;
 		} else if (strcmp (argv[i], "--chopwhen")==0 && i+1 < argc) {
 			val = 10;
 			sscanf (argv[++i],"%d",&val);
@@ -491,7 +849,45 @@ main(int argc, char *argv[])
 			be_quiet = TRUE;
 		else if(strcmp(argv[i],"--noquiet")==0)
 			be_quiet = FALSE;
-		else if (strncmp (argv[i], "--exec=", strlen ("--exec=")) == 0) {
+		else if(strcmp(argv[i],"--stats")==0)
+			do_stats = TRUE;
+		else if(strcmp(argv[i],"--nostats")==0)
+			do_stats = FALSE;
+		else if (strncmp (argv[i], "--trace=", strlen ("--trace=")) == 0) {
+			g_free (trace_file);
+			trace_file = g_strdup ((argv[i])+strlen("--trace="));
+		} else if (strcmp (argv[i], "--trace-format=chrome") == 0)
+			trace_format = GEL_TRACE_CHROME;
+		else if (strcmp (argv[i], "--trace-format=folded") == 0)
+			trace_format = GEL_TRACE_FOLDED;
+		else if (sscanf (argv[i], "--trace-spans=%d", &val) == 1) {
+			if (val < 1) {
+				g_printerr (_("%s should be greater then or equal to %d, using %d"),
+					    "--trace-spans", 1, GEL_TRACE_DEFAULT_SPANS);
+				val = GEL_TRACE_DEFAULT_SPANS;
+			}
+			trace_spans = val;
+		} else if (strncmp (argv[i], "--batch=", strlen ("--batch=")) == 0) {
+			g_free (batch_file);
+			batch_file = g_strdup ((argv[i])+strlen("--batch="));
+		} else if (strcmp (argv[i], "--batch") == 0 && i+1 < argc) {
+			g_free (batch_file);
+			batch_file = g_strdup (argv[++i]);
+		} else if (sscanf (argv[i], "--batch-jobs=%d", &val) == 1) {
+			if (val < 1) {
+				g_printerr (_("%s should be greater then or equal to %d, using %d"),
+					    "--batch-jobs", 1, 1);
+				val = 1;
+			}
+			batch_jobs = val;
+		} else if (sscanf (argv[i], "--batch-timeout=%d", &val) == 1) {
+			if (val < 0) {
+				g_printerr (_("%s should be greater then or equal to %d, using %d"),
+					    "--batch-timeout", 0, 60);
+				val = 60;
+			}
+			batch_timeout = val;
+		} else if (strncmp (argv[i], "--exec=", strlen ("--exec=")) == 0) {
 			exec = g_strdup ((argv[i])+strlen("--exec="));
 		} else if (strcmp (argv[i], "--exec") && i+1 < argc) {
 			exec = g_strdup (argv[++i]);
@@ -527,8 +923,17 @@ main(int argc, char *argv[])
 				   "\t                  \tstdout (for use with gettext) [OFF]\n"
 				   "\t--[no]quiet       \tBe quiet during non-interactive mode,\n"
 				   "\t                  \t(always on when compiling) [OFF]\n"
-				   "\t--exec=expr       \tExecute an expression\n\n"),
-				 VERSION);
+				   "\t--exec=expr       \tExecute an expression\n"
+				   "\t--[no]stats       \tPrint evaluation statistics on exit [OFF]\n"
+				   "\t--trace=file      \tWrite a trace of function calls to file\n"
+				   "\t--trace-format=fmt\tTrace format, chrome or folded [chrome]\n"
+				   "\t--trace-spans=num \tKeep at most num most recent calls\n"
+				   "\t                  \tin the trace [%d]\n"
+				   "\t--batch=file      \tRun the tests in file, in the format of\n"
+				   "\t                  \tgeniustests.txt, and print a summary\n"
+				   "\t--batch-jobs=num  \tRun num tests at once [number of CPUs]\n"
+				   "\t--batch-timeout=s \tKill a test after s seconds (0=never) [60]\n\n"),
+				 VERSION, GEL_TRACE_DEFAULT_SPANS);
 			if (strcmp (argv[i], "--help") != 0)
 				exit (1);
 			else
@@ -540,6 +945,22 @@ main(int argc, char *argv[])
 		g_printerr (_("Can't specify both an expression and files to execute on the command line"));
 		exit (1);
 	}
+	if (batch_file != NULL && (files != NULL || exec != NULL)) {
+		g_printerr (_("Can't specify a batch file together with an expression or files to execute on the command line"));
+		exit (1);
+	}
+	if (batch_file != NULL && (do_stats || trace_file != NULL)) {
+		g_printerr (_("Can't use --stats or --trace together with a batch file, each test runs in its own process"));
+		exit (1);
+	}
+	if (batch_file != NULL) {
+		be_quiet = FALSE;
+		do_compile = do_gettext = FALSE;
+		if (batch_jobs <= 0) {
+			long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+			batch_jobs = ncpu > 0 ? ncpu : 1;
+		}
+	}
 
 	/* ensure the directory, if it is a file, no worries not saving the properties is not fatal at all */
 	file = g_build_filename (g_get_home_dir (), ".genius", NULL);
@@ -552,7 +973,8 @@ main(int argc, char *argv[])
 
 	if (do_compile || do_gettext)
 		be_quiet = TRUE;
-	inter = isatty(0) && !files && !exec && !(do_compile || do_gettext);
+	inter = isatty(0) && !files && !exec && !batch_file &&
+		!(do_compile || do_gettext);
 	/*interactive mode, print welcome message*/
 	if (inter) {
 		g_print (_("Genius %s\n"
@@ -586,6 +1008,8 @@ main(int argc, char *argv[])
 
 	gel_init ();
 
+	gel_add_headless_graph_functions ();
+
 	if ( ! (do_compile || do_gettext)) {
 		/*
 		 * Read main library
@@ -639,6 +1063,12 @@ main(int argc, char *argv[])
 		gel_restore_plugins ();
 	}
 
+	if (batch_file != NULL) {
+		int ret = run_batch (batch_file, batch_jobs, batch_timeout);
+		g_free (batch_file);
+		return ret;
+	}
+
 	if (files != NULL) {
 		GSList *t;
 		do {
@@ -664,6 +1094,11 @@ main(int argc, char *argv[])
 		fp = stdin;
 		gel_push_file_info(NULL,1);
 	}
+	if (trace_file != NULL) {
+		if ( ! gel_trace_start (trace_file, trace_format, trace_spans))
+			puterror (_("Can't open trace file"));
+	}
+
 	if (fp != NULL)
 		gel_lexer_open(fp);
 	if(inter && use_readline) {
@@ -734,6 +1169,12 @@ main(int argc, char *argv[])
 after_exec:
 	gel_test_max_nodes_again ();
 
+	gel_trace_stop ();
+	g_free (trace_file);
+
+	if (do_stats)
+		print_stats ();
+
 	gel_printout_infos ();
 	
 	if (fp != NULL)
@@ -4464,6 +4464,9 @@ gel_set_state (GelCalcState state)
 static void
 check_events (void)
 {
+	/* only the main thread may touch gtk */
+	if G_UNLIKELY (gel_in_worker_thread)
+		return;
 	while (gtk_events_pending ())
 		gtk_main_iteration ();
 }
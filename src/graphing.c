@@ -44,6 +44,9 @@
 #include "geloutput.h"
 #include "mpwrap.h"
 #include "matop.h"
+#include "dfunc.h"
+#include "plotcommon.h"
+#include "odesolve.h"
 
 #include "gnome-genius.h"
 
@@ -309,7 +312,13 @@ static GelETree *plot_arg3 = NULL;
 static int plot_in_progress = 0;
 static gboolean whack_window_after_plot = FALSE;
 
+/* only a quick first sampling, the rest is left to the plot job */
+static gboolean plot_coarse = FALSE;
+
 static void plot_axis (void);
+static void plot_axis_progressive (void);
+static void plot_job_cancel (void);
+static void plot_job_finish (void);
 
 /* lineplots */
 static void plot_functions (gboolean do_window_present,
@@ -319,6 +328,7 @@ static void recompute_functions (gboolean fitting);
 
 /* surfaces */
 static void plot_surface_functions (gboolean do_window_present, gboolean fit_function);
+static void surface_build_mesh (void);
 
 /* replot the slope/vector fields after zoom or other axis changing event */
 static void replot_fields (void);
@@ -868,6 +878,8 @@ plot_print_cb (void)
 
 	gtk_widget_destroy (req);
 
+	plot_job_finish ();
+
 	tmpfile = g_build_filename (g_get_tmp_dir (), "genius-ps-XXXXXX", NULL);
 	fd = g_mkstemp (tmpfile);
 	if (fd < 0) {
@@ -958,6 +970,8 @@ really_export_cb (GtkFileChooser *fs, int response, gpointer data)
 		return;
 	}
 
+	plot_job_finish ();
+
 	/* run epsi checkbox */
 	if (export_type == EXPORT_EPS) {
 		w = gtk_file_chooser_get_extra_widget (GTK_FILE_CHOOSER (fs));
@@ -1115,6 +1129,8 @@ really_export_png_cb (GtkFileChooser *fs, int response, gpointer data)
 		return;
 	}
 
+	plot_job_finish ();
+
 	s = g_strdup (gtk_file_chooser_get_filename (fs));
 	if (s == NULL)
 		return;
@@ -1328,7 +1344,7 @@ plot_zoomin_cb (void)
 			surfacez1 += len/4.0;
 		}
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -1373,7 +1389,7 @@ plot_zoomout_cb (void)
 			surfacez1 -= len/2.0;
 		}
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -1399,6 +1415,9 @@ plot_zoomfit_cb (void)
 		double size;
 		long last_errnum = total_errors;
 
+		/* fit to the full sampling, not the coarse one */
+		plot_job_finish ();
+
 		if (plot_mode == MODE_LINEPLOT) {
 			size = plot_maxy - plot_miny;
 			if (size <= 0.0) {
@@ -1478,7 +1497,7 @@ plot_zoomfit_cb (void)
 				surfacez2 = (G_MAXDOUBLE/2);
 		}
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -1514,7 +1533,7 @@ plot_resetzoom_cb (void)
 			surfacez2 = reset_surfacez2;
 		}
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -1546,7 +1565,7 @@ lineplot_move_graph (double horiz, double vert)
 		ploty1 = ploty1 + vert * len;
 		ploty2 = ploty2 + vert* len;
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -1605,7 +1624,7 @@ dozoom_idle (gpointer data)
 		if (ploty2 - ploty1 < MINPLOT)
 			ploty2 = ploty1 + MINPLOT;
 
-		plot_axis ();
+		plot_axis_progressive ();
 
 		if (gel_interrupted)
 			gel_interrupted = FALSE;
@@ -2098,6 +2117,7 @@ static void
 graph_window_destroyed (GtkWidget *w, gpointer data)
 {
 	graph_window = NULL;
+	plot_job_cancel ();
 	if (solver_dialog != NULL)
 		gtk_widget_destroy (solver_dialog);
 }
@@ -2356,6 +2376,7 @@ clear_graph (void)
 	int i;
 
 	stop_rotate_anim_cb (NULL, NULL);
+	plot_job_cancel ();
 
 	gtk_widget_hide (errors_label_box);
 
@@ -2621,15 +2642,19 @@ surface_setup_axis (void)
 	gtk_plot_axis_thaw (z);
 }
 
+#define SURFACE_STEPS 30
+
 /* FIXME: perhaps should be smarter ? */
 static void
 surface_setup_steps (void)
 {
+	int steps = plot_coarse ? SURFACE_STEPS/3 : SURFACE_STEPS;
+
 	gtk_plot3d_set_xrange (GTK_PLOT3D (surface_plot), surfacex1, surfacex2);
 	gtk_plot3d_set_yrange (GTK_PLOT3D (surface_plot), surfacey1, surfacey2);
 	if (surface_data != NULL) {
-		gtk_plot_surface_set_xstep (GTK_PLOT_SURFACE (surface_data), (surfacex2-surfacex1)/30);
-		gtk_plot_surface_set_ystep (GTK_PLOT_SURFACE (surface_data), (surfacey2-surfacey1)/30);
+		gtk_plot_surface_set_xstep (GTK_PLOT_SURFACE (surface_data), (surfacex2-surfacex1)/steps);
+		gtk_plot_surface_set_ystep (GTK_PLOT_SURFACE (surface_data), (surfacey2-surfacey1)/steps);
 	}
 }
 
@@ -2672,6 +2697,9 @@ surface_setup_gradient (void)
 static void
 plot_axis (void)
 {
+	if ( ! plot_coarse)
+		plot_job_cancel ();
+
 	plot_in_progress ++;
 	gel_calc_running ++;
 	plot_window_setup ();
@@ -2697,7 +2725,7 @@ plot_axis (void)
 		surface_setup_axis ();
 		surface_setup_steps ();
 		if (surface_data != NULL)
-			gtk_plot_surface_build_mesh (GTK_PLOT_SURFACE (surface_data));
+			surface_build_mesh ();
 		surface_setup_gradient ();
 		/* FIXME: this doesn't work (crashes) must fix in GtkExtra, then
 		   we can always just autoscale stuff
@@ -2717,201 +2745,64 @@ plot_axis (void)
 	plot_window_setup ();
 }
 
-static double
-call_func3 (GelCtx *ctx,
-	    GelEFunc *func,
-	    GelETree *arg,
-	    GelETree *arg2,
-	    GelETree *arg3,
-	    gboolean *ex,
-	    GelETree **func_ret)
-{
-	GelETree *ret;
-	double retd;
-	GelETree *args[4];
-
-	args[0] = arg;
-	args[1] = arg2;
-	args[2] = arg3;
-	args[3] = NULL;
-
-	ret = gel_funccall (ctx, func, args, 3);
-
-	/* FIXME: handle errors! */
-	if G_UNLIKELY (gel_error_num != 0)
-		gel_error_num = 0;
-
-	/* only do one level of indirection to avoid infinite loops */
-	if (ret != NULL && ret->type == GEL_FUNCTION_NODE) {
-		if (ret->func.func->nargs == 3) {
-			GelETree *ret2;
-			ret2 = gel_funccall (ctx, ret->func.func, args, 3);
-			gel_freetree (ret);
-			ret = ret2;
-			/* FIXME: handle errors! */
-			if G_UNLIKELY (gel_error_num != 0)
-				gel_error_num = 0;
-		} else if (func_ret != NULL) {
-			*func_ret = ret;
-#ifdef HUGE_VAL
-			return HUGE_VAL;
-#else
-			return 0;
-#endif
-		}
-
-	}
+/* Plotted functions compiled to double precision (see dfunc.h), keyed
+ * by the GelEFunc, the value is NULL if it could not be compiled and the
+ * interpreter is used.  Must be cleared whenever a plotted function is
+ * freed. */
+static GHashTable *plot_dfuncs = NULL;
 
-	if (ret == NULL || ret->type != GEL_VALUE_NODE) {
-		*ex = TRUE;
-		gel_freetree (ret);
-#ifdef HUGE_VAL
-		return HUGE_VAL;
-#else
-		return 0;
-#endif
-	}
+static void
+plot_dfuncs_clear (void)
+{
+	/* the job might still be evaluating the old functions */
+	plot_job_cancel ();
 
-	retd = mpw_get_double (ret->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		*ex = TRUE;
-		gel_error_num = 0;
-#ifdef HUGE_VAL
-		retd = HUGE_VAL;
-#endif
+	if (plot_dfuncs != NULL) {
+		g_hash_table_destroy (plot_dfuncs);
+		plot_dfuncs = NULL;
 	}
-	
-	gel_freetree (ret);
-	return retd;
 }
 
-static double
-call_func2 (GelCtx *ctx,
-	    GelEFunc *func,
-	    GelETree *arg,
-	    GelETree *arg2,
-	    gboolean *ex,
-	    GelETree **func_ret)
+static GelDFunc *
+plot_get_dfunc (GelEFunc *f, int nargs)
 {
-	GelETree *ret;
-	double retd;
-	GelETree *args[3];
-
-	args[0] = arg;
-	args[1] = arg2;
-	args[2] = NULL;
-
-	ret = gel_funccall (ctx, func, args, 2);
+	GelDFunc *df;
 
-	/* FIXME: handle errors! */
-	if G_UNLIKELY (gel_error_num != 0)
-		gel_error_num = 0;
+	if (plot_dfuncs == NULL)
+		plot_dfuncs = g_hash_table_new_full
+			(NULL, NULL, NULL, (GDestroyNotify)gel_dfunc_free);
 
-	/* only do one level of indirection to avoid infinite loops */
-	if (ret != NULL && ret->type == GEL_FUNCTION_NODE) {
-		if (ret->func.func->nargs == 2) {
-			GelETree *ret2;
-			ret2 = gel_funccall (ctx, ret->func.func, args, 2);
-			gel_freetree (ret);
-			ret = ret2;
-			/* FIXME: handle errors! */
-			if G_UNLIKELY (gel_error_num != 0)
-				gel_error_num = 0;
-		} else if (func_ret != NULL) {
-			*func_ret = ret;
-#ifdef HUGE_VAL
-			return HUGE_VAL;
-#else
-			return 0;
-#endif
-		}
+	if ( ! g_hash_table_lookup_extended (plot_dfuncs, f, NULL,
+					     (gpointer *)&df)) {
+		df = gel_dfunc_compile (f, nargs);
+		g_hash_table_insert (plot_dfuncs, f, df);
 	}
 
-	if (ret == NULL || ret->type != GEL_VALUE_NODE) {
-		*ex = TRUE;
-		gel_freetree (ret);
-#ifdef HUGE_VAL
-		return HUGE_VAL;
-#else
-		return 0;
-#endif
+	if (df != NULL && ! gel_dfunc_prepare (df)) {
+		/* something got redefined, try again with the new
+		 * definitions */
+		df = gel_dfunc_compile (f, nargs);
+		if (df != NULL && ! gel_dfunc_prepare (df)) {
+			gel_dfunc_free (df);
+			df = NULL;
+		}
+		g_hash_table_insert (plot_dfuncs, f, df);
 	}
 
-	retd = mpw_get_double (ret->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		*ex = TRUE;
-		gel_error_num = 0;
-#ifdef HUGE_VAL
-		retd = HUGE_VAL;
-#endif
-	}
-	
-	gel_freetree (ret);
-	return retd;
+	return df;
 }
 
+/* a function of one real variable */
 static double
-call_func (GelCtx *ctx,
-	   GelEFunc *func,
-	   GelETree *arg,
-	   gboolean *ex,
-	   GelETree **func_ret)
+call_func_x (GelEFunc *f, double x, gboolean *ex)
 {
-	GelETree *ret;
-	double retd;
-	GelETree *args[2];
-
-	args[0] = arg;
-	args[1] = NULL;
+	GelDFunc *df = plot_get_dfunc (f, 1);
 
-	ret = gel_funccall (ctx, func, args, 1);
+	if (df != NULL)
+		return gel_dfunc_eval (df, &x, ex);
 
-	/* FIXME: handle errors! */
-	if G_UNLIKELY (gel_error_num != 0)
-		gel_error_num = 0;
-
-	/* only do one level of indirection to avoid infinite loops */
-	if (ret != NULL && ret->type == GEL_FUNCTION_NODE) {
-		if (ret->func.func->nargs == 1) {
-			GelETree *ret2;
-			ret2 = gel_funccall (ctx, ret->func.func, args, 1);
-			gel_freetree (ret);
-			ret = ret2;
-			/* FIXME: handle errors! */
-			if G_UNLIKELY (gel_error_num != 0)
-				gel_error_num = 0;
-		} else if (func_ret != NULL) {
-			*func_ret = ret;
-#ifdef HUGE_VAL
-			return HUGE_VAL;
-#else
-			return 0;
-#endif
-		}
-
-	}
-
-	if (ret == NULL || ret->type != GEL_VALUE_NODE) {
-		*ex = TRUE;
-		gel_freetree (ret);
-#ifdef HUGE_VAL
-		return HUGE_VAL;
-#else
-		return 0;
-#endif
-	}
-
-	retd = mpw_get_double (ret->val.value);
-	if G_UNLIKELY (gel_error_num != 0) {
-		*ex = TRUE;
-		gel_error_num = 0;
-#ifdef HUGE_VAL
-		retd = HUGE_VAL;
-#endif
-	}
-	
-	gel_freetree (ret);
-	return retd;
+	mpw_set_d (plot_arg->val.value, x);
+	return gel_plot_call_func (plot_ctx, f, &plot_arg, 1, ex, NULL);
 }
 
 static void
@@ -3017,7 +2908,7 @@ plot_func_data (GtkPlot *plot, GtkPlotData *data, double x, gboolean *error)
 	}
 
 	mpw_set_d (plot_arg->val.value, x);
-	y = call_func (plot_ctx, plot_func[i], plot_arg, &ex, NULL);
+	y = gel_plot_call_func (plot_ctx, plot_func[i], &plot_arg, 1, &ex, NULL);
 
 	if G_UNLIKELY (ex) {
 		if (error != NULL)
@@ -3057,50 +2948,168 @@ plot_func_data (GtkPlot *plot, GtkPlotData *data, double x, gboolean *error)
 static double
 call_xy_or_z_function (GelEFunc *f, double x, double y, gboolean *ex)
 {
+	GelETree *fargs[3];
+	int n;
 	GelETree *func_ret = NULL;
 	double z;
 
+	if (f->nargs == 2) {
+		GelDFunc *df = plot_get_dfunc (f, 2);
+		if (df != NULL) {
+			double args[2];
+			args[0] = x;
+			args[1] = y;
+			return gel_dfunc_eval (df, args, ex);
+		}
+	}
+
+	fargs[0] = plot_arg;
+	fargs[1] = plot_arg2;
+	fargs[2] = plot_arg3;
+
 	/* complex function */
 	if (f->nargs == 1) {
 		mpw_set_d_complex (plot_arg->val.value, x, y);
-		z = call_func (plot_ctx, f, plot_arg, ex,
-			       &func_ret);
+		n = 1;
 	} else if (f->nargs == 2) {
 		mpw_set_d (plot_arg->val.value, x);
 		mpw_set_d (plot_arg2->val.value, y);
-		z = call_func2 (plot_ctx, f, plot_arg, plot_arg2,
-				ex, &func_ret);
+		n = 2;
 	} else {
 		mpw_set_d (plot_arg->val.value, x);
 		mpw_set_d (plot_arg2->val.value, y);
 		mpw_set_d_complex (plot_arg3->val.value, x, y);
-		z = call_func3 (plot_ctx, f, plot_arg, plot_arg2,
-				plot_arg3, ex, &func_ret);
+		n = 3;
 	}
+	z = gel_plot_call_func (plot_ctx, f, fargs, n, ex, &func_ret);
 	if (func_ret != NULL) {
+		GelEFunc *g = func_ret->func.func;
 		/* complex function */
-		if (func_ret->func.func->nargs == 1) {
+		if (g->nargs == 1) {
 			mpw_set_d_complex (plot_arg->val.value, x, y);
-			z = call_func (plot_ctx, func_ret->func.func, plot_arg, ex,
-				       NULL);
-		} else if (func_ret->func.func->nargs == 2) {
+			n = 1;
+		} else if (g->nargs == 2) {
 			mpw_set_d (plot_arg->val.value, x);
 			mpw_set_d (plot_arg2->val.value, y);
-			z = call_func2 (plot_ctx, func_ret->func.func, plot_arg, plot_arg2,
-					ex, NULL);
+			n = 2;
 		} else {
 			mpw_set_d (plot_arg->val.value, x);
 			mpw_set_d (plot_arg2->val.value, y);
 			mpw_set_d_complex (plot_arg3->val.value, x, y);
-			z = call_func3 (plot_ctx, func_ret->func.func, plot_arg, plot_arg2,
-					plot_arg3, ex, NULL);
+			n = 3;
 		}
+		z = gel_plot_call_func (plot_ctx, g, fargs, n, ex, NULL);
+		gel_freetree (func_ret);
 	}
 
 	return z;
 }
 
 
+/* The surface grid sampled ahead of time (in parallel) for
+ * surface_func_data, GtkPlotSurface asks for the points in the same order
+ * we store them */
+static double *surface_grid_args = NULL;
+static double *surface_grid_z = NULL;
+static gboolean *surface_grid_ex = NULL;
+static int surface_grid_len = 0;
+static int surface_grid_pos = 0;
+
+static void
+surface_grid_free (void)
+{
+	g_free (surface_grid_args);
+	surface_grid_args = NULL;
+	g_free (surface_grid_z);
+	surface_grid_z = NULL;
+	g_free (surface_grid_ex);
+	surface_grid_ex = NULL;
+	surface_grid_len = 0;
+	surface_grid_pos = 0;
+}
+
+/* The (x,y) points at which gtk_plot_surface_build_mesh will ask for
+ * the function with the given steps, in that order, computed the same
+ * way so that we get precisely the same doubles */
+static double *
+surface_grid_make_args (double xstep, double ystep, int *len)
+{
+	GtkPlot *plot = GTK_PLOT (surface_plot);
+	double *args;
+	double x, y;
+	int nx, ny, i, j, k;
+
+	nx = (int)((plot->xmax - plot->xmin) / xstep + .50999999471) + 1;
+	ny = (int)((plot->ymax - plot->ymin) / ystep + .50999999471) + 1;
+	if (nx <= 0 || ny <= 0) {
+		*len = 0;
+		return NULL;
+	}
+
+	*len = nx * ny;
+	args = g_new (double, 2 * nx * ny);
+
+	k = 0;
+	y = plot->ymin;
+	for (j = 0; j < ny; j++) {
+		x = plot->xmin;
+		for (i = 0; i < nx; i++) {
+			args[2*k] = x;
+			args[2*k+1] = y;
+			x += xstep;
+			k++;
+		}
+		y += ystep;
+	}
+
+	return args;
+}
+
+/* Sample the grid that gtk_plot_surface_build_mesh is about to ask for,
+ * only possible if the function compiles, the interpreter can only be
+ * run from one thread */
+static void
+surface_grid_sample (void)
+{
+	GtkPlotSurface *surface;
+	GelDFunc *df;
+
+	surface_grid_free ();
+
+	if (surface_func == NULL ||
+	    surface_data == NULL ||
+	    surface_func->nargs != 2)
+		return;
+
+	df = plot_get_dfunc (surface_func, 2);
+	if (df == NULL)
+		return;
+
+	surface = GTK_PLOT_SURFACE (surface_data);
+	surface_grid_args = surface_grid_make_args (surface->xstep,
+						    surface->ystep,
+						    &surface_grid_len);
+	if (surface_grid_args == NULL)
+		return;
+
+	surface_grid_z = g_new (double, surface_grid_len);
+	surface_grid_ex = g_new0 (gboolean, surface_grid_len);
+
+	gel_dfunc_eval_many (df, surface_grid_len, surface_grid_args,
+			     surface_grid_z, surface_grid_ex,
+			     0 /* nthreads */, gel_evalnode_hook);
+}
+
+static void
+surface_build_mesh (void)
+{
+	/* the plot job might have left us the grid already */
+	if (surface_grid_args == NULL)
+		surface_grid_sample ();
+	gtk_plot_surface_build_mesh (GTK_PLOT_SURFACE (surface_data));
+	surface_grid_free ();
+}
+
 static double
 surface_func_data (GtkPlot *plot, GtkPlotData *data, double x, double y, gboolean *error)
 {
@@ -3117,7 +3126,27 @@ surface_func_data (GtkPlot *plot, GtkPlotData *data, double x, double y, gboolea
 		return 0.0;
 	}
 
-	z = call_xy_or_z_function (surface_func, x, y, &ex);
+	if (surface_grid_pos < surface_grid_len &&
+	    surface_grid_args[2*surface_grid_pos] == x &&
+	    surface_grid_args[2*surface_grid_pos+1] == y) {
+		z = surface_grid_z[surface_grid_pos];
+		ex = surface_grid_ex[surface_grid_pos];
+		surface_grid_pos++;
+	} else {
+		z = call_xy_or_z_function (surface_func, x, y, &ex);
+
+		if G_UNLIKELY (hookrun++ >= 10) {
+			if (gel_evalnode_hook != NULL) {
+				hookrun = 0;
+				(*gel_evalnode_hook)();
+				if G_UNLIKELY (gel_interrupted) {
+					if (error != NULL)
+						*error = TRUE;
+					return z;
+				}
+			}
+		}
+	}
 
 	if G_UNLIKELY (ex) {
 		if (error != NULL)
@@ -3136,19 +3165,42 @@ surface_func_data (GtkPlot *plot, GtkPlotData *data, double x, double y, gboolea
 			*error = TRUE;
 	}
 
+	return z;
+}
 
-	if G_UNLIKELY (hookrun++ >= 10) {
-		if (gel_evalnode_hook != NULL) {
-			hookrun = 0;
-			(*gel_evalnode_hook)();
-			if G_UNLIKELY (gel_interrupted) {
-				if (error != NULL)
-					*error = TRUE;
-				return z;
-			}
+/* Sample an (x,y) function at the centers of the field grid all at
+ * once, NULL if the function does not compile and has to be done point
+ * by point with the interpreter */
+static double *
+field_grid_sample (GelEFunc *f, double ht, double vt, gboolean **ex)
+{
+	GelDFunc *df;
+	double *args, *z;
+	int i, j, k, n;
+
+	if (f->nargs != 2)
+		return NULL;
+	df = plot_get_dfunc (f, 2);
+	if (df == NULL)
+		return NULL;
+
+	n = plotHtick * plotVtick;
+	args = g_new (double, 2*n);
+	k = 0;
+	for (i = 0; i < plotHtick; i++) {
+		for (j = 0; j < plotVtick; j++) {
+			args[2*k] = plotx1 + ht*(i+0.5);
+			args[2*k+1] = ploty1 + vt*(j+0.5);
+			k++;
 		}
 	}
 
+	z = g_new (double, n);
+	*ex = g_new0 (gboolean, n);
+	gel_dfunc_eval_many (df, n, args, z, *ex,
+			     0 /* nthreads */, gel_evalnode_hook);
+	g_free (args);
+
 	return z;
 }
 
@@ -3162,6 +3214,9 @@ get_slopefield_points (void)
 	double xmul, ymul;
 	double sz;
 	double mt;
+	double *zs;
+	gboolean *exs = NULL;
+	int n;
 
 	/* FIXME: evil, see the AAAARGH below! */
 
@@ -3185,14 +3240,23 @@ get_slopefield_points (void)
 	plot_points_dx = g_new (double, (plotHtick)*(plotVtick));
 	plot_points_dy = g_new (double, (plotHtick)*(plotVtick));
 
+	zs = field_grid_sample (slopefield_func, ht, vt, &exs);
+
 	k = 0;
+	n = 0;
 	for (i = 0; i < plotHtick; i++) {
 		for (j = 0; j < plotVtick; j++) {
 			x = plotx1 + ht*(i+0.5);
 			y = ploty1 + vt*(j+0.5);
 			ex = FALSE;
-			z = call_xy_or_z_function (slopefield_func,
-						   x, y, &ex);
+			if (zs != NULL) {
+				z = zs[n];
+				ex = exs[n];
+			} else {
+				z = call_xy_or_z_function (slopefield_func,
+							   x, y, &ex);
+			}
+			n++;
 
 			if G_LIKELY ( ! ex) {
 				/* gtkextra fluxplot is nuts, it does the
@@ -3218,6 +3282,9 @@ get_slopefield_points (void)
 		}
 	}
 
+	g_free (zs);
+	g_free (exs);
+
 	plot_points_num = k;
 }
 
@@ -3231,6 +3298,9 @@ get_vectorfield_points (void)
 	double pw, ph;
 	double xmul, ymul;
 	double mt, sz;
+	double *dxs, *dys = NULL;
+	gboolean *exxs = NULL, *exys = NULL;
+	int n;
 
 	/* FIXME: evil, see the AAAARGH below! */
 
@@ -3254,16 +3324,36 @@ get_vectorfield_points (void)
 	plot_points_dx = g_new (double, (plotHtick)*(plotVtick));
 	plot_points_dy = g_new (double, (plotHtick)*(plotVtick));
 
+	/* only use the bulk samples if both functions compile */
+	dxs = field_grid_sample (vectorfield_func_x, ht, vt, &exxs);
+	if (dxs != NULL) {
+		dys = field_grid_sample (vectorfield_func_y, ht, vt, &exys);
+		if (dys == NULL) {
+			g_free (dxs);
+			dxs = NULL;
+			g_free (exxs);
+			exxs = NULL;
+		}
+	}
+
 	k = 0;
+	n = 0;
 	for (i = 0; i < plotHtick; i++) {
 		for (j = 0; j < plotVtick; j++) {
 			x = plotx1 + ht*(i+0.5);
 			y = ploty1 + vt*(j+0.5);
 			ex = FALSE;
-			dx = call_xy_or_z_function (vectorfield_func_x,
-						    x, y, &ex);
-			dy = call_xy_or_z_function (vectorfield_func_y,
-						    x, y, &ex);
+			if (dxs != NULL) {
+				dx = dxs[n];
+				dy = dys[n];
+				ex = exxs[n] || exys[n];
+			} else {
+				dx = call_xy_or_z_function (vectorfield_func_x,
+							    x, y, &ex);
+				dy = call_xy_or_z_function (vectorfield_func_y,
+							    x, y, &ex);
+			}
+			n++;
 
 			if G_LIKELY ( ! ex) {
 				/* gtkextra fluxplot is nuts, it does the
@@ -3297,6 +3387,11 @@ get_vectorfield_points (void)
 		}
 	}
 
+	g_free (dxs);
+	g_free (dys);
+	g_free (exxs);
+	g_free (exys);
+
 	plot_points_num = k;
 
 	if ( ! vectorfield_normalize_arrow_length) {
@@ -3309,60 +3404,6 @@ get_vectorfield_points (void)
 	}
 }
 
-static char *
-label_func (int i, GelEFunc *func, const char *var, const char *name)
-{
-	char *text = NULL;
-
-	if (name != NULL) {
-		return g_strdup (name);
-	} else if (func->id != NULL) {
-		text = g_strdup_printf ("%s(%s)", func->id->token, var);
-	} else if (func->type == GEL_USER_FUNC) {
-		int old_style, len;
-		GelOutput *out = gel_output_new ();
-		D_ENSURE_USER_BODY (func);
-		gel_output_setup_string (out, 0, NULL);
-
-		/* FIXME: the push/pop of style is UGLY */
-		old_style = gel_calcstate.output_style;
-		gel_calcstate.output_style = GEL_OUTPUT_NORMAL;
-		gel_print_etree (out, func->data.user, TRUE /* toplevel */);
-		gel_calcstate.output_style = old_style;
-
-		text = gel_output_snarf_string (out);
-		gel_output_unref (out);
-
-		len = strlen (text);
-
-		if (len > 2 &&
-		    text[0] == '(' &&
-		    text[len-1] == ')') {
-			char *s;
-			text[len-1] = '\0';
-			s = g_strdup (&text[1]);
-			g_free (text);
-			text = s;
-			len-=2;
-		}
-
-		/* only print bodies of short functions */
-		if (len > 64) {
-			g_free (text);
-			text = NULL;
-		}
-	}
-
-	if (text == NULL) {
-		if (i < 0)
-			text = g_strdup_printf (_("Function"));
-		else
-			text = g_strdup_printf (_("Function #%d"), i+1);
-	}
-
-	return text;
-}
-
 #define GET_DOUBLE(var,argnum,func) \
 	{ \
 	if (a[argnum]->type != GEL_VALUE_NODE) { \
@@ -3764,13 +3805,13 @@ parametric_get_value (double *x, double *y, double t)
 	static int hookrun = 0;
 	gboolean ex = FALSE;
 
-	mpw_set_d (plot_arg->val.value, t);
 	if (parametric_func_z != NULL) {
+		mpw_set_d (plot_arg->val.value, t);
 		call_func_z (plot_ctx, parametric_func_z, plot_arg, x, y, &ex, NULL);
 	} else {
-		*x = call_func (plot_ctx, parametric_func_x, plot_arg, &ex, NULL);
+		*x = call_func_x (parametric_func_x, t, &ex);
 		if G_LIKELY ( ! ex)
-			*y = call_func (plot_ctx, parametric_func_y, plot_arg, &ex, NULL);
+			*y = call_func_x (parametric_func_y, t, &ex);
 	}
 
 	if G_UNLIKELY (ex) {
@@ -4004,20 +4045,73 @@ solution_destroyed (GtkWidget *plotdata, gpointer data)
 	solutions_list = g_slist_remove (solutions_list, plotdata);
 }
 
+/* Solution curves are integrated with the adaptive Dormand-Prince method
+ * (see odesolve.h) taking steps of at most dx (or dt) and a point is
+ * drawn at the end of each step */
+typedef struct {
+	GArray *xx;
+	GArray *yy;
+	double ylo, yhi;	/* stop once the solution leaves these */
+} SolutionCurve;
+
+static gboolean
+slopefield_solution_func (double t, const double *y, double *dy,
+			  gpointer data)
+{
+	gboolean ex = FALSE;
+
+	dy[0] = call_xy_or_z_function (slopefield_func, t, y[0], &ex);
+
+	return ! ex;
+}
+
+static gboolean
+slopefield_solution_out (double t, const double *y, gpointer data)
+{
+	SolutionCurve *sc = data;
+
+	g_array_append_val (sc->xx, t);
+	g_array_append_val (sc->yy, y[0]);
+
+	return y[0] > sc->ylo && y[0] < sc->yhi;
+}
+
+static gboolean
+vectorfield_solution_func (double t, const double *y, double *dy,
+			   gpointer data)
+{
+	gboolean ex = FALSE;
+
+	dy[0] = call_xy_or_z_function (vectorfield_func_x, y[0], y[1], &ex);
+	if G_UNLIKELY (ex)
+		return FALSE;
+	dy[1] = call_xy_or_z_function (vectorfield_func_y, y[0], y[1], &ex);
+
+	return ! ex;
+}
+
+static gboolean
+vectorfield_solution_out (double t, const double *y, gpointer data)
+{
+	SolutionCurve *sc = data;
+
+	g_array_append_val (sc->xx, y[0]);
+	g_array_append_val (sc->yy, y[1]);
+
+	return TRUE;
+}
+
 static void
 slopefield_draw_solution (double x, double y, double dx, gboolean is_gui)
 {
 	double *xx, *yy;
-	double cx, cy;
+	double cy;
 	int len1, len2, len;
 	int i;
 	GdkRGBA color;
-	GQueue points1 = G_QUEUE_INIT;
-	GSList *points2 = NULL;
-	GList *li;
-	GSList *sli;
+	SolutionCurve fwd, back;
 	GtkPlotData *data;
-	double fudgey;
+	double fudgey, atol;
 
 	if (slopefield_func == NULL)
 		return;
@@ -4029,115 +4123,63 @@ slopefield_draw_solution (double x, double y, double dx, gboolean is_gui)
 	gdk_rgba_parse (&color, "red");
 
 	fudgey = (ploty2-ploty1)/100;
-
-	len1 = 0;
-	cx = x;
-	cy = y;
-	while (cx < plotx2 && cy > ploty1-fudgey && cy < ploty2+fudgey) {
-		double *pt;
-		gboolean ex = FALSE;
-		double k1, k2, k3, k4, sl;
-
-		/* standard Runge-Kutta */
-		k1 = call_xy_or_z_function (slopefield_func,
-					    cx, cy, &ex);
-		if G_UNLIKELY (ex) break;
-		k2 = call_xy_or_z_function (slopefield_func,
-					    cx+(dx/2), cy+(dx/2)*k1, &ex);
-		if G_UNLIKELY (ex) break;
-		k3 = call_xy_or_z_function (slopefield_func,
-					    cx+(dx/2), cy+(dx/2)*k2, &ex);
-		if G_UNLIKELY (ex) break;
-		k4 = call_xy_or_z_function (slopefield_func,
-					    cx+dx, cy+dx*k3, &ex);
-		if G_UNLIKELY (ex) break;
-
-		sl = (k1+2*k2+2*k3+k4)/6.0;
-
-		cy += sl * dx;
-		cx += dx;
-		
-		len1 ++;
-
-		pt = g_new (double, 2);
-		pt[0] = cx;
-		pt[1] = cy;
-
-		g_queue_push_tail (&points1, pt);
-	}
-
-	len2 = 0;
-	cx = x;
-	cy = y;
-	while (cx > plotx1 && cy > ploty1-fudgey && cy < ploty2+fudgey) {
-		double *pt;
-		gboolean ex = FALSE;
-		double k1, k2, k3, k4, sl;
-
-		/* standard Runge-Kutta */
-		k1 = call_xy_or_z_function (slopefield_func,
-					    cx, cy, &ex);
-		if G_UNLIKELY (ex) break;
-		k2 = call_xy_or_z_function (slopefield_func,
-					    cx-(dx/2), cy-(dx/2)*k1, &ex);
-		if G_UNLIKELY (ex) break;
-		k3 = call_xy_or_z_function (slopefield_func,
-					    cx-(dx/2), cy-(dx/2)*k2, &ex);
-		if G_UNLIKELY (ex) break;
-		k4 = call_xy_or_z_function (slopefield_func,
-					    cx-dx, cy-dx*k3, &ex);
-		if G_UNLIKELY (ex) break;
-
-		sl = (k1+2*k2+2*k3+k4)/6.0;
-
-		cy -= sl* dx;
-		cx -= dx;
-		
-		len2 ++;
-
-		pt = g_new (double, 2);
-		pt[0] = cx;
-		pt[1] = cy;
-
-		points2 = g_slist_prepend (points2, pt);
-	}
+	atol = (ploty2-ploty1) * 1e-6;
+
+	fwd.xx = g_array_new (FALSE, FALSE, sizeof (double));
+	fwd.yy = g_array_new (FALSE, FALSE, sizeof (double));
+	fwd.ylo = ploty1-fudgey;
+	fwd.yhi = ploty2+fudgey;
+	back = fwd;
+	back.xx = g_array_new (FALSE, FALSE, sizeof (double));
+	back.yy = g_array_new (FALSE, FALSE, sizeof (double));
+
+	if (x < plotx2) {
+		cy = y;
+		gel_ode_dopri5 (slopefield_solution_func, &fwd, 1,
+				x, &cy, plotx2,
+				1e-6 /* rtol */, atol, dx /* hmax */,
+				0.0 /* output every step */,
+				slopefield_solution_out, NULL);
+	}
+	if (x > plotx1 && ! gel_interrupted) {
+		cy = y;
+		gel_ode_dopri5 (slopefield_solution_func, &back, 1,
+				x, &cy, plotx1,
+				1e-6 /* rtol */, atol, dx /* hmax */,
+				0.0 /* output every step */,
+				slopefield_solution_out, NULL);
+	}
+
+	/* both start with the point (x,y) itself */
+	len1 = MAX ((int)fwd.xx->len - 1, 0);
+	len2 = MAX ((int)back.xx->len - 1, 0);
 
 	len = len1 + 1 + len2;
 	xx = g_new0 (double, len);
 	yy = g_new0 (double, len);
 
 	i = 0;
-	for (sli = points2; sli != NULL; sli = sli->next) {
-		double *pt = sli->data;
-		sli->data = NULL;
-
-		xx[i] = pt[0];
-		yy[i] = pt[1];
-
-		g_free (pt);
-
+	for (; len2 > 0; len2--) {
+		xx[i] = g_array_index (back.xx, double, len2);
+		yy[i] = g_array_index (back.yy, double, len2);
 		i++;
 	}
 
 	xx[i] = x;
 	yy[i] = y;
-
 	i++;
 
-	for (li = points1.head; li != NULL; li = li->next) {
-		double *pt = li->data;
-		li->data = NULL;
-
-		xx[i] = pt[0];
-		yy[i] = pt[1];
-
-		g_free (pt);
-
-		i++;
+	if (len1 > 0) {
+		memcpy (xx+i, ((double *)fwd.xx->data) + 1,
+			len1 * sizeof (double));
+		memcpy (yy+i, ((double *)fwd.yy->data) + 1,
+			len1 * sizeof (double));
 	}
 
-	g_queue_clear (&points1);
-	g_slist_free (points2);
+	g_array_free (fwd.xx, TRUE);
+	g_array_free (fwd.yy, TRUE);
+	g_array_free (back.xx, TRUE);
+	g_array_free (back.yy, TRUE);
 
 	/* Adjust ends */
 	/*clip_line_ends (xx, yy, len);*/
@@ -4164,12 +4206,12 @@ static void
 vectorfield_draw_solution (double x, double y, double dt, double tlen, gboolean is_gui)
 {
 	double *xx, *yy;
-	double cx, cy, t;
+	double cxy[2];
 	int len;
-	int i;
 	GdkRGBA color;
+	SolutionCurve sc;
 	GtkPlotData *data;
-	gboolean ex;
+	double atol;
 
 	if (vectorfield_func_x == NULL ||
 	    vectorfield_func_y == NULL ||
@@ -4183,64 +4225,22 @@ vectorfield_draw_solution (double x, double y, double dt, double tlen, gboolean
 
 	gdk_rgba_parse (&color, "red");
 
-	len = (int)(tlen / dt) + 2;
-	xx = g_new0 (double, len);
-	yy = g_new0 (double, len);
+	atol = MIN (plotx2-plotx1, ploty2-ploty1) * 1e-6;
 
-	i = 1;
-	xx[0] = x;
-	yy[0] = y;
-	cx = x;
-	cy = y;
-	t = 0.0;
-	while (t < tlen && i < len) {
-		double xk1, xk2, xk3, xk4, xsl;
-		double yk1, yk2, yk3, yk4, ysl;
-
-		ex = FALSE;
-		/* standard Runge-Kutta */
-		xk1 = call_xy_or_z_function (vectorfield_func_x,
-					     cx, cy, &ex);
-		if G_UNLIKELY (ex) break;
-		yk1 = call_xy_or_z_function (vectorfield_func_y,
-					     cx, cy, &ex);
-		if G_UNLIKELY (ex) break;
-
-		xk2 = call_xy_or_z_function (vectorfield_func_x,
-					     cx+(dt/2)*xk1, cy+(dt/2)*yk1, &ex);
-		if G_UNLIKELY (ex) break;
-		yk2 = call_xy_or_z_function (vectorfield_func_y,
-					     cx+(dt/2)*xk1, cy+(dt/2)*yk1, &ex);
-		if G_UNLIKELY (ex) break;
-
-		xk3 = call_xy_or_z_function (vectorfield_func_x,
-					     cx+(dt/2)*xk2, cy+(dt/2)*yk2, &ex);
-		if G_UNLIKELY (ex) break;
-		yk3 = call_xy_or_z_function (vectorfield_func_y,
-					     cx+(dt/2)*xk2, cy+(dt/2)*yk2, &ex);
-		if G_UNLIKELY (ex) break;
-
-		xk4 = call_xy_or_z_function (vectorfield_func_x,
-					     cx+dt*xk3, cy+dt*yk3, &ex);
-		if G_UNLIKELY (ex) break;
-		yk4 = call_xy_or_z_function (vectorfield_func_y,
-					     cx+dt*xk3, cy+dt*yk3, &ex);
-		if G_UNLIKELY (ex) break;
-
-		xsl = (xk1+2*xk2+2*xk3+xk4)/6.0;
-		ysl = (yk1+2*yk2+2*yk3+yk4)/6.0;
-
-		cx += xsl * dt;
-		cy += ysl * dt;
-
-		xx[i] = cx;
-		yy[i] = cy;
-
-		i ++;
-		t += dt;
-	}
-
-	len = i;
+	sc.xx = g_array_new (FALSE, FALSE, sizeof (double));
+	sc.yy = g_array_new (FALSE, FALSE, sizeof (double));
+
+	cxy[0] = x;
+	cxy[1] = y;
+	gel_ode_dopri5 (vectorfield_solution_func, &sc, 2,
+			0.0, cxy, tlen,
+			1e-6 /* rtol */, atol, dt /* hmax */,
+			0.0 /* output every step */,
+			vectorfield_solution_out, NULL);
+
+	len = sc.xx->len;
+	xx = (double *)g_array_free (sc.xx, FALSE);
+	yy = (double *)g_array_free (sc.yy, FALSE);
 
 	data = draw_line (xx, yy, len,
 			  2 /* thickness */,
@@ -4303,7 +4303,7 @@ replot_fields (void)
 				tmp = g_strdup_printf ("%s,%s",
 						       lp_x_name,
 						       lp_y_name);
-				label = label_func (-1, slopefield_func, tmp, slopefield_name);
+				label = gel_plot_label_func (-1, slopefield_func, tmp, slopefield_name);
 				g_free (tmp);
 				/* FIXME: gtkextra is broken (adding the "  ")
 				 * and I don't feel like fixing it */
@@ -4368,8 +4368,8 @@ replot_fields (void)
 				tmp = g_strdup_printf ("%s,%s",
 						       lp_x_name,
 						       lp_y_name);
-				l1 = label_func (-1, vectorfield_func_x, tmp, vectorfield_name_x);
-				l2 = label_func (-1, vectorfield_func_y, tmp, vectorfield_name_y);
+				l1 = gel_plot_label_func (-1, vectorfield_func_x, tmp, vectorfield_name_x);
+				l2 = gel_plot_label_func (-1, vectorfield_func_y, tmp, vectorfield_name_y);
 				g_free (tmp);
 				/* FIXME: gtkextra is broken (adding the "  ")
 				 * and I don't feel like fixing it */
@@ -4436,14 +4436,192 @@ typedef struct {
 #endif
 #endif
 
+/* Samples of the line plot functions kept across zooms and pans so that
+ * only the parts of the range that are not yet covered (or not finely
+ * enough) get evaluated.  Sorted by x, points added during a recompute
+ * are collected in added and merged in at the end. */
+typedef struct {
+	GArray *pts;
+	GArray *added;
+} LineSamples;
+
+static LineSamples line_samples[MAXFUNC] = { { NULL, NULL } };
+
+/* bumped whenever the samples are dropped, a plot job started before
+ * that has stale values */
+static int line_samples_serial = 0;
+
+/* d_globals_serial () when the samples were taken, setting any global
+ * may change what the plotted functions compute */
+static guint line_samples_globals = 0;
+
+#define LINE_SAMPLES_MAX 65536
+
+static void
+line_samples_clear (void)
+{
+	int i;
+
+	for (i = 0; i < MAXFUNC; i++) {
+		if (line_samples[i].pts != NULL)
+			g_array_free (line_samples[i].pts, TRUE);
+		line_samples[i].pts = NULL;
+		if (line_samples[i].added != NULL)
+			g_array_free (line_samples[i].added, TRUE);
+		line_samples[i].added = NULL;
+	}
+	line_samples_globals = d_globals_serial ();
+	line_samples_serial++;
+}
+
+/* Drop the samples if a global was set since they were taken */
+static void
+line_samples_check (void)
+{
+	if (line_samples_globals != d_globals_serial ())
+		line_samples_clear ();
+}
+
+/* the cached point nearest to x, within tol and within the plot range */
+static const Point *
+line_samples_lookup (int funci, double x, double tol)
+{
+	GArray *a = line_samples[funci].pts;
+	const Point *pts;
+	const Point *best = NULL;
+	int lo, hi;
+
+	if (a == NULL || a->len == 0 || tol <= 0.0)
+		return NULL;
+
+	pts = (const Point *)a->data;
+
+	/* first point with pts[lo].x >= x */
+	lo = 0;
+	hi = a->len;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (pts[mid].x < x)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < (int)a->len && pts[lo].x - x <= tol)
+		best = &pts[lo];
+	if (lo > 0 && x - pts[lo-1].x <= tol &&
+	    (best == NULL || x - pts[lo-1].x < best->x - x))
+		best = &pts[lo-1];
+
+	if (best != NULL &&
+	    (best->x < plotx1 || best->x > plotx2))
+		return NULL;
+
+	return best;
+}
+
+static int
+point_compare (gconstpointer a, gconstpointer b)
+{
+	double xa = ((const Point *)a)->x;
+	double xb = ((const Point *)b)->x;
+
+	if (xa < xb)
+		return -1;
+	else if (xa > xb)
+		return 1;
+	else
+		return 0;
+}
+
+/* merge the points taken during the last recompute into the cache */
+static void
+line_samples_merge (int funci)
+{
+	LineSamples *ls = &line_samples[funci];
+	GArray *merged;
+	const Point *a, *b;
+	guint i, j, alen, blen;
+
+	if (ls->added == NULL || ls->added->len == 0)
+		return;
+
+	/* an interrupted function might have reported bogus
+	 * exceptions, and a function that sets globals might compute
+	 * something else for the same x next time */
+	if (gel_interrupted ||
+	    line_samples_globals != d_globals_serial ()) {
+		g_array_set_size (ls->added, 0);
+		return;
+	}
+
+	g_array_sort (ls->added, point_compare);
+
+	if (ls->pts == NULL) {
+		ls->pts = ls->added;
+		ls->added = NULL;
+		return;
+	}
+
+	/* too many, keep only what is in view now */
+	if (ls->pts->len + ls->added->len > LINE_SAMPLES_MAX) {
+		GArray *kept = g_array_new (FALSE, FALSE, sizeof (Point));
+		for (i = 0; i < ls->pts->len; i++) {
+			Point *pt = &g_array_index (ls->pts, Point, i);
+			if (pt->x >= plotx1 && pt->x <= plotx2)
+				g_array_append_val (kept, *pt);
+		}
+		g_array_free (ls->pts, TRUE);
+		ls->pts = kept;
+		if (ls->pts->len + ls->added->len > LINE_SAMPLES_MAX)
+			g_array_set_size (ls->pts, 0);
+	}
+
+	a = (const Point *)ls->pts->data;
+	alen = ls->pts->len;
+	b = (const Point *)ls->added->data;
+	blen = ls->added->len;
+
+	merged = g_array_sized_new (FALSE, FALSE, sizeof (Point), alen + blen);
+	i = j = 0;
+	while (i < alen || j < blen) {
+		if (j >= blen || (i < alen && a[i].x <= b[j].x))
+			g_array_append_val (merged, a[i++]);
+		else
+			g_array_append_val (merged, b[j++]);
+	}
+
+	g_array_free (ls->pts, TRUE);
+	ls->pts = merged;
+	g_array_set_size (ls->added, 0);
+}
+
+/* Get the point at x, or a cached point at most tol away from x */
 static Point *
-function_get_us_a_point (int funci, double x)
+function_get_us_a_point (int funci, double x, double tol)
 {
 	gboolean ex = FALSE;
 	double rety;
+	const Point *cached;
 	Point *pt = g_new0 (Point, 1);
-	mpw_set_d (plot_arg->val.value, x);
-	rety = call_func (plot_ctx, plot_func[funci], plot_arg, &ex, NULL);
+
+	cached = line_samples_lookup (funci, x, tol);
+	if (cached != NULL) {
+		x = cached->x;
+		rety = cached->y;
+		ex = ! isfinite (rety);
+	} else {
+		LineSamples *ls = &line_samples[funci];
+		Point sample;
+
+		rety = call_func_x (plot_func[funci], x, &ex);
+
+		sample.x = x;
+		sample.y = ex ? BADPTVAL : rety;
+		if (ls->added == NULL)
+			ls->added = g_array_new (FALSE, FALSE, sizeof (Point));
+		g_array_append_val (ls->added, sample);
+	}
 
 	if G_UNLIKELY (ex) {
 		pt->x = x;
@@ -4527,7 +4705,11 @@ bisect_points (int funci, GQueue *points, GList *li, double sizex, double sizey,
 
 	if (do_bisect) {
 		(*count)++;
-		newpt = function_get_us_a_point (funci, pt->x + (nextpt->x-pt->x)/2.0);
+		/* a cached point in the middle half of the interval is
+		 * just as good */
+		newpt = function_get_us_a_point (funci,
+						 pt->x + (nextpt->x-pt->x)/2.0,
+						 (nextpt->x-pt->x)/4.0);
 		g_queue_insert_after (points, li, newpt);
 
 		if (level < 3) {
@@ -4553,8 +4735,13 @@ recompute_function (int funci, double **x, double **y, int *len, gboolean fittin
 	GList *li;
 	double sizex, sizey;
 	double tmpploty1, tmpploty2;
+	double tol, lastx;
 
 	lentried = WIDTH/2;/* FIXME: perhaps settable */
+	if (plot_coarse)
+		lentried = WIDTH/16;
+	tol = 0.4*(plotx2-plotx1)/(lentried-1);
+	lastx = -G_MAXDOUBLE;
 
 	/* up to 1% of the interval is fuzzed */
 	maxfuzz = 0.01*(plotx2-plotx1)/(lentried-1);
@@ -4581,7 +4768,15 @@ recompute_function (int funci, double **x, double **y, int *len, gboolean fittin
 			thex = plotx2;
 
 		count++;
-		pt = function_get_us_a_point (funci, thex);
+		/* reuse a cached point if there is one closer than
+		 * about half the step */
+		pt = function_get_us_a_point (funci, thex, tol);
+		if G_UNLIKELY (pt->x <= lastx) {
+			/* already used that one */
+			g_free (pt);
+			pt = function_get_us_a_point (funci, thex, 0.0);
+		}
+		lastx = pt->x;
 		g_queue_push_tail (points, pt);
 
 		if G_UNLIKELY (hookrun++ >= 10) {
@@ -4617,8 +4812,9 @@ recompute_function (int funci, double **x, double **y, int *len, gboolean fittin
 		sizex = 0.01;
 
 
-	/* adaptively bisect intervals */
-	li = g_queue_peek_head_link (points);
+	/* adaptively bisect intervals, not on the coarse pass, it
+	 * would just evaluate what the plot job is about to */
+	li = plot_coarse ? NULL : g_queue_peek_head_link (points);
 	while (li != NULL && li->next != NULL) {
 		Point *pt = li->data;
 		GList *orignext = li->next;
@@ -4709,6 +4905,8 @@ recompute_function (int funci, double **x, double **y, int *len, gboolean fittin
 	}
 
 	g_queue_free (points);
+
+	line_samples_merge (funci);
 }
 
 #if 0
@@ -4753,6 +4951,9 @@ static void
 recompute_functions (gboolean fitting)
 {
 	int i;
+
+	line_samples_check ();
+
 	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
 		double *x, *y;
 		int len;
@@ -4766,6 +4967,468 @@ recompute_functions (gboolean fitting)
 	}
 }
 
+/* Refining the plot in the background after the view was changed from
+ * the plot window (zoom, pan, fit).  A coarse plot is drawn right away
+ * and the points of the full sampling that are not yet known are
+ * evaluated by a plot job, in a worker thread if all the functions
+ * compile (see dfunc.h), otherwise from the main loop a few milliseconds
+ * at a time, as the interpreter can only be run from the main thread.
+ * When done, the values go into the line samples cache (or the surface
+ * grid) and the plot is redrawn from those.  Changing the view or the
+ * functions cancels the job. */
+typedef struct {
+	GelEFunc *func;
+	GelDFunc *df;
+	int funci;
+	int n;
+	int nargs;
+	double *args;
+	double *out;
+	gboolean *ex;
+} PlotTask;
+
+typedef struct {
+	int mode;
+	int serial;
+	int ntasks;
+	PlotTask tasks[MAXFUNC];
+
+	volatile gint cancelled;
+	/* the worker saw gel_interrupted, the results it has are bogus */
+	volatile gint interrupted;
+	GThread *thread;
+	guint source;
+
+	/* main loop evaluation */
+	int task;
+	int pos;
+	gboolean in_step;
+} PlotJob;
+
+static PlotJob *plot_job = NULL;
+
+/* points done by one call in the worker, between checks for
+ * cancellation */
+#define PLOT_JOB_CHUNK 4096
+/* how long one main loop step may evaluate, in seconds */
+#define PLOT_JOB_SLICE 0.02
+
+static PlotJob *
+plot_job_new (void)
+{
+	PlotJob *job = g_new0 (PlotJob, 1);
+	job->mode = plot_mode;
+	job->serial = line_samples_serial;
+	return job;
+}
+
+static void
+plot_job_free (PlotJob *job)
+{
+	int i;
+
+	for (i = 0; i < job->ntasks; i++) {
+		PlotTask *task = &job->tasks[i];
+		if (task->df != NULL)
+			gel_dfunc_free (task->df);
+		g_free (task->args);
+		g_free (task->out);
+		g_free (task->ex);
+	}
+	g_free (job);
+}
+
+static PlotTask *
+plot_job_add_task (PlotJob *job, GelEFunc *func, int funci,
+		   int nargs, double *args, int n)
+{
+	PlotTask *task = &job->tasks[job->ntasks++];
+
+	task->func = func;
+	task->funci = funci;
+	task->nargs = nargs;
+	task->args = args;
+	task->n = n;
+	task->out = g_new (double, n);
+	task->ex = g_new0 (gboolean, n);
+
+	return task;
+}
+
+/* Put the results where the plotting code looks first and replot.
+ * Only the evaluation is done by the job, the replot (plot_axis) with
+ * its bisection near jumps still runs here in the main loop, but it
+ * mostly finds the points in the cache by now. */
+static void
+plot_job_apply (PlotJob *job)
+{
+	int i, j;
+
+	/* an interrupted evaluation marks all the points it did not get
+	 * to as bad, those must not end up in the cache */
+	if (g_atomic_int_get (&job->interrupted) ||
+	    gel_interrupted)
+		return;
+
+	/* a global was set and the functions might compute something
+	 * else now, or the plot was redone differently */
+	line_samples_check ();
+	if (job->serial != line_samples_serial ||
+	    job->mode != plot_mode)
+		return;
+
+	if (job->mode == MODE_LINEPLOT) {
+		for (i = 0; i < job->ntasks; i++) {
+			PlotTask *task = &job->tasks[i];
+			LineSamples *ls = &line_samples[task->funci];
+
+			if (plot_func[task->funci] != task->func)
+				continue;
+
+			if (ls->added == NULL)
+				ls->added = g_array_new (FALSE, FALSE, sizeof (Point));
+			for (j = 0; j < task->n; j++) {
+				Point pt;
+				pt.x = task->args[j];
+				pt.y = task->ex[j] ? BADPTVAL : task->out[j];
+				g_array_append_val (ls->added, pt);
+			}
+			line_samples_merge (task->funci);
+		}
+	} else if (job->mode == MODE_SURFACE) {
+		PlotTask *task = &job->tasks[0];
+
+		if (surface_func != task->func ||
+		    surface_data == NULL)
+			return;
+
+		/* surface_func_data checks that the points still match */
+		surface_grid_free ();
+		surface_grid_args = task->args;
+		surface_grid_z = task->out;
+		surface_grid_ex = task->ex;
+		surface_grid_len = task->n;
+		task->args = NULL;
+		task->out = NULL;
+		task->ex = NULL;
+	}
+
+	plot_axis ();
+}
+
+static gboolean
+plot_job_done (gpointer data)
+{
+	PlotJob *job = data;
+
+	if (job->thread != NULL) {
+		g_thread_join (job->thread);
+		job->thread = NULL;
+	}
+	job->source = 0;
+
+	if (job != plot_job) {
+		/* cancelled while the thread was running */
+		plot_job_free (job);
+		return FALSE;
+	}
+
+	if (g_atomic_int_get (&job->interrupted)) {
+		/* just keep the coarse plot */
+		gel_interrupted = FALSE;
+		plot_job = NULL;
+		plot_job_free (job);
+		return FALSE;
+	}
+
+	if (plot_in_progress > 0 || gel_calc_running > 0) {
+		/* wait until whatever is running now is done */
+		job->source = g_timeout_add (50, plot_job_done, job);
+		return FALSE;
+	}
+
+	plot_job = NULL;
+	plot_job_apply (job);
+	plot_job_free (job);
+
+	return FALSE;
+}
+
+static gpointer
+plot_job_thread (gpointer data)
+{
+	PlotJob *job = data;
+	int i, j;
+
+	for (i = 0; i < job->ntasks; i++) {
+		PlotTask *task = &job->tasks[i];
+		for (j = 0; j < task->n; j += PLOT_JOB_CHUNK) {
+			if (g_atomic_int_get (&job->cancelled))
+				goto done;
+			gel_dfunc_eval_many (task->df,
+					     MIN (PLOT_JOB_CHUNK, task->n - j),
+					     task->args + j * task->nargs,
+					     task->out + j,
+					     task->ex + j,
+					     0 /* nthreads */,
+					     NULL /* hook */);
+			if G_UNLIKELY (gel_interrupted) {
+				g_atomic_int_set (&job->interrupted, 1);
+				goto done;
+			}
+		}
+	}
+
+done:
+	g_idle_add (plot_job_done, job);
+	return NULL;
+}
+
+static gboolean
+plot_job_step (gpointer data)
+{
+	PlotJob *job = data;
+	GTimer *timer;
+
+	/* the interpreter is busy */
+	if (plot_in_progress > 0 || gel_calc_running > 0)
+		return TRUE;
+
+	job->in_step = TRUE;
+	plot_in_progress ++;
+	gel_calc_running ++;
+
+	timer = g_timer_new ();
+	while (job->task < job->ntasks &&
+	       ! job->cancelled &&
+	       ! gel_interrupted) {
+		PlotTask *task = &job->tasks[job->task];
+		double *args;
+
+		if (job->pos >= task->n) {
+			job->task++;
+			job->pos = 0;
+			continue;
+		}
+
+		args = task->args + job->pos * task->nargs;
+		if (task->nargs == 1)
+			task->out[job->pos] =
+				call_func_x (task->func, args[0],
+					     &task->ex[job->pos]);
+		else
+			task->out[job->pos] =
+				call_xy_or_z_function (task->func,
+						       args[0], args[1],
+						       &task->ex[job->pos]);
+		job->pos++;
+
+		if (g_timer_elapsed (timer, NULL) > PLOT_JOB_SLICE)
+			break;
+	}
+	g_timer_destroy (timer);
+
+	plot_in_progress --;
+	gel_calc_running --;
+	job->in_step = FALSE;
+
+	if (job->cancelled) {
+		/* plot_job_cancel left the freeing to us */
+		plot_job_free (job);
+		return FALSE;
+	}
+
+	if (gel_interrupted) {
+		/* just keep the coarse plot */
+		gel_interrupted = FALSE;
+		plot_job = NULL;
+		plot_job_free (job);
+		return FALSE;
+	}
+
+	if (job->task < job->ntasks)
+		return TRUE;
+
+	job->source = 0;
+	plot_job = NULL;
+	plot_job_apply (job);
+	plot_job_free (job);
+
+	return FALSE;
+}
+
+static void
+plot_job_run (PlotJob *job)
+{
+	gboolean compiled = TRUE;
+	int i;
+
+	/* each job gets its own copy of the compiled functions, the
+	 * ones in plot_dfuncs can be freed at any time */
+	for (i = 0; i < job->ntasks; i++) {
+		PlotTask *task = &job->tasks[i];
+		if (task->func->nargs == task->nargs)
+			task->df = gel_dfunc_compile (task->func, task->nargs);
+		if (task->df != NULL && ! gel_dfunc_prepare (task->df)) {
+			gel_dfunc_free (task->df);
+			task->df = NULL;
+		}
+		if (task->df == NULL)
+			compiled = FALSE;
+	}
+
+	plot_job = job;
+
+	if (compiled)
+		job->thread = g_thread_try_new ("plot", plot_job_thread,
+						job, NULL);
+
+	/* no thread to be had, evaluate from the main loop then */
+	if (job->thread == NULL)
+		job->source = g_timeout_add (10, plot_job_step, job);
+}
+
+static void
+plot_job_cancel (void)
+{
+	PlotJob *job = plot_job;
+
+	if (job == NULL)
+		return;
+
+	plot_job = NULL;
+	g_atomic_int_set (&job->cancelled, 1);
+
+	/* plot_job_done or plot_job_step free it */
+	if (job->thread != NULL || job->in_step)
+		return;
+
+	if (job->source != 0)
+		g_source_remove (job->source);
+	plot_job_free (job);
+}
+
+/* Needed before anything that uses the plot as it stands (export,
+ * printing, fitting), do the rest right now */
+static void
+plot_job_finish (void)
+{
+	if (plot_job == NULL || plot_in_progress > 0)
+		return;
+
+	plot_job_cancel ();
+	plot_axis ();
+}
+
+/* The points of the full line sampling that are not in the cache, NULL
+ * if there are too few of them to bother */
+static PlotJob *
+plot_job_new_lines (void)
+{
+	PlotJob *job = NULL;
+	int lentried = WIDTH/2;
+	double tol = 0.4*(plotx2-plotx1)/(lentried-1);
+	int i, j, total = 0;
+
+	line_samples_check ();
+
+	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
+		GArray *args = g_array_new (FALSE, FALSE, sizeof (double));
+		int n;
+
+		for (j = 0; j < lentried; j++) {
+			double x = plotx1 + ((plotx2-plotx1)*(double)j)/(lentried-1);
+			if (line_samples_lookup (i, x, tol) == NULL)
+				g_array_append_val (args, x);
+		}
+
+		n = args->len;
+		if (n == 0) {
+			g_array_free (args, TRUE);
+			continue;
+		}
+
+		if (job == NULL)
+			job = plot_job_new ();
+		plot_job_add_task (job, plot_func[i], i, 1,
+				   (double *)g_array_free (args, FALSE), n);
+		total += n;
+	}
+
+	/* about as much as the coarse pass */
+	if (job != NULL && total < WIDTH/16) {
+		plot_job_free (job);
+		job = NULL;
+	}
+
+	return job;
+}
+
+/* The full surface grid, the plot axes must already be set up */
+static PlotJob *
+plot_job_new_surface (void)
+{
+	PlotJob *job;
+	double *args;
+	int n;
+
+	if (surface_func == NULL ||
+	    surface_data == NULL)
+		return NULL;
+
+	args = surface_grid_make_args ((surfacex2-surfacex1)/SURFACE_STEPS,
+				       (surfacey2-surfacey1)/SURFACE_STEPS,
+				       &n);
+	if (args == NULL)
+		return NULL;
+
+	job = plot_job_new ();
+	plot_job_add_task (job, surface_func, 0, 2, args, n);
+
+	return job;
+}
+
+/* plot_axis for changes of the view from the plot window */
+static void
+plot_axis_progressive (void)
+{
+	PlotJob *job = NULL;
+
+	plot_job_cancel ();
+
+	if (plot_mode == MODE_LINEPLOT) {
+		job = plot_job_new_lines ();
+		if (job == NULL) {
+			plot_axis ();
+			return;
+		}
+		plot_coarse = TRUE;
+		plot_axis ();
+		plot_coarse = FALSE;
+	} else if (plot_mode == MODE_SURFACE &&
+		   surface_func != NULL &&
+		   surface_data != NULL) {
+		plot_coarse = TRUE;
+		plot_axis ();
+		plot_coarse = FALSE;
+		job = plot_job_new_surface ();
+	} else {
+		plot_axis ();
+		return;
+	}
+
+	if (job == NULL)
+		return;
+
+	/* the coarse pass was interrupted, leave it at that */
+	if (gel_interrupted) {
+		plot_job_free (job);
+		return;
+	}
+
+	plot_job_run (job);
+}
+
 static void
 plot_functions (gboolean do_window_present,
 		gboolean from_gui,
@@ -4850,7 +5513,7 @@ plot_functions (gboolean do_window_present,
 						   CAIRO_LINE_JOIN_ROUND,
 						   2, &color);
 
-		label = label_func (i, plot_func[i],
+		label = gel_plot_label_func (i, plot_func[i],
 				    lp_x_name,
 				    plot_func_name[i]);
 		gtk_plot_data_set_legend (line_data[i], label);
@@ -4931,11 +5594,11 @@ plot_functions (gboolean do_window_present,
 		if (parametric_name != NULL) {
 			label = g_strdup (parametric_name);
 		} else if (parametric_func_z) {
-			label = label_func (-1, parametric_func_z, "t", NULL);
+			label = gel_plot_label_func (-1, parametric_func_z, "t", NULL);
 		} else {
 			char *l1, *l2;
-			l1 = label_func (-1, parametric_func_x, "t", NULL);
-			l2 = label_func (-1, parametric_func_y, "t", NULL);
+			l1 = gel_plot_label_func (-1, parametric_func_x, "t", NULL);
+			l2 = gel_plot_label_func (-1, parametric_func_y, "t", NULL);
 			label = g_strconcat (l1, ", ", l2, NULL);
 			g_free (l1);
 			g_free (l2);
@@ -5061,7 +5724,7 @@ plot_surface_functions (gboolean do_window_present, gboolean fit_function)
 
 		surface_setup_steps ();
 
-		gtk_plot_surface_build_mesh (GTK_PLOT_SURFACE (surface_data));
+		surface_build_mesh ();
 		/* plot_minz and plot_maxz are set in build_mesh
 		 * calling the function */
 
@@ -5087,7 +5750,7 @@ plot_surface_functions (gboolean do_window_present, gboolean fit_function)
 
 		gtk_widget_show (GTK_WIDGET (surface_data));
 
-		label = label_func (-1, surface_func, /* FIXME: correct variable */ "...", surface_func_name);
+		label = gel_plot_label_func (-1, surface_func, /* FIXME: correct variable */ "...", surface_func_name);
 		gtk_plot_data_set_legend (surface_data, label);
 		g_free (label);
 	} else if (surface_data_x != NULL &&
@@ -6617,6 +7280,7 @@ surface_from_dialog (void)
 	reset_surfacez1 = surfacez1 = z1;
 	reset_surfacez2 = surfacez2 = z2;
 
+	plot_dfuncs_clear ();
 	if (surface_func != NULL) {
 		d_freefunc (surface_func);
 		surface_func = NULL;
@@ -6688,6 +7352,9 @@ line_plot_clear_funcs (void)
 {
 	int i;
 
+	plot_dfuncs_clear ();
+	line_samples_clear ();
+
 	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
 		d_freefunc (plot_func[i]);
 		plot_func[i] = NULL;
@@ -7386,6 +8053,7 @@ SurfacePlot_op (GelCtx *ctx, GelETree * * a, int *exception)
 		goto whack_copied_funcs;
 	}
 
+	plot_dfuncs_clear ();
 	if (surface_func != NULL) {
 		d_freefunc (surface_func);
 	}
@@ -8267,6 +8935,7 @@ SurfacePlotClear_op (GelCtx *ctx, GelETree * * a, int *exception)
 	}
   
 	  
+	plot_dfuncs_clear ();
 	if (surface_func != NULL) {
 		d_freefunc (surface_func);
 		surface_func = NULL;
@@ -8428,6 +9097,11 @@ LinePlotMouseLocation_op (GelCtx *ctx, GelETree * * a, int *exception)
 void
 gel_plot_canvas_thaw_completely (void)
 {
+	/* this is called when a toplevel command finishes, don't keep
+	 * samples that are no good anymore around */
+	if (plot_in_progress == 0)
+		line_samples_check ();
+
 	if (plot_canvas_freeze_count > 0) {
 		plot_canvas_freeze_count = 0;
 		if (plot_canvas != NULL /* sanity */) {
@@ -10060,6 +10734,7 @@ SurfacePlotData_op (GelCtx *ctx, GelETree * * a, int *exception)
 	else
 		surface_func_name = NULL;
 
+	plot_dfuncs_clear ();
 	surface_func = NULL;
 	surface_data_x = x;
 	x = NULL;
@@ -10215,6 +10890,7 @@ SurfacePlotDataGrid_op (GelCtx *ctx, GelETree * * a, int *exception)
 	else
 		surface_func_name = NULL;
 
+	plot_dfuncs_clear ();
 	surface_func = NULL;
 	surface_data_x = x;
 	x = NULL;
@@ -10293,6 +10969,8 @@ ExportPlot_op (GelCtx *ctx, GelETree * * a, int *exception)
 		return NULL;
 	}
 
+	plot_job_finish ();
+
 	if (strcasecmp (type, "png") == 0) {
 		GdkPixbuf *pix;
 
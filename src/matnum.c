@@ -0,0 +1,1234 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#include "calc.h"
+#include "mpwrap.h"
+
+#include "matnum.h"
+
+/* entry i,j of the n by n matrix a stored by columns */
+#define A(i,j) a[(i) + (j)*n]
+
+/*
+ * Doubles
+ */
+
+gboolean
+gel_matnum_lu_d (double *a, int n, int *perm, gboolean pivot)
+{
+	int i, j, k;
+
+	for (k = 0; k < n; k++) {
+		int p = k;
+		double piv;
+
+		if (pivot) {
+			double max = fabs (A(k,k));
+			for (i = k+1; i < n; i++) {
+				if (fabs (A(i,k)) > max) {
+					max = fabs (A(i,k));
+					p = i;
+				}
+			}
+		}
+		if (perm != NULL)
+			perm[k] = p;
+
+		if (A(p,k) == 0.0)
+			return FALSE;
+
+		if (p != k) {
+			for (j = 0; j < n; j++) {
+				double tmp = A(k,j);
+				A(k,j) = A(p,j);
+				A(p,j) = tmp;
+			}
+		}
+
+		piv = A(k,k);
+		for (i = k+1; i < n; i++)
+			A(i,k) /= piv;
+		for (j = k+1; j < n; j++) {
+			double akj = A(k,j);
+			if (akj == 0.0)
+				continue;
+			for (i = k+1; i < n; i++)
+				A(i,j) -= A(i,k) * akj;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Apply I - beta v v^T (v is zero above row k) to the columns j0..j1 of
+ * the m row matrix a from the left */
+static void
+householder_left_d (double *a, int m, int k, const double *v, double beta,
+		    int j0, int j1)
+{
+	int i, j;
+
+	for (j = j0; j <= j1; j++) {
+		double *col = a + j*m;
+		double s = 0.0;
+		for (i = k; i < m; i++)
+			s += v[i] * col[i];
+		s *= beta;
+		if (s == 0.0)
+			continue;
+		for (i = k; i < m; i++)
+			col[i] -= s * v[i];
+	}
+}
+
+/* the same from the right to the rows i0..i1 of the m row matrix a */
+static void
+householder_right_d (double *a, int m, int ncols, int k, const double *v,
+		     double beta, int i0, int i1)
+{
+	double *s = g_new0 (double, i1 - i0 + 1);
+	int i, j;
+
+	for (j = k; j < ncols; j++) {
+		double vj = v[j];
+		double *col = a + j*m;
+		if (vj == 0.0)
+			continue;
+		for (i = i0; i <= i1; i++)
+			s[i-i0] += col[i] * vj;
+	}
+	for (j = k; j < ncols; j++) {
+		double vj = beta * v[j];
+		double *col = a + j*m;
+		if (vj == 0.0)
+			continue;
+		for (i = i0; i <= i1; i++)
+			col[i] -= s[i-i0] * vj;
+	}
+
+	g_free (s);
+}
+
+/* The Householder vector taking x[k..m-1] to a multiple of e_k, returns
+ * beta for I - beta v v^T, 0 if nothing needs to be done */
+static double
+householder_vector_d (const double *x, int m, int k, double *v)
+{
+	double norm = 0.0, alpha, vnorm2;
+	int i;
+
+	for (i = k; i < m; i++)
+		norm = hypot (norm, x[i]);
+	if (norm == 0.0)
+		return 0.0;
+
+	alpha = (x[k] > 0.0) ? -norm : norm;
+	for (i = 0; i < k; i++)
+		v[i] = 0.0;
+	for (i = k; i < m; i++)
+		v[i] = x[i];
+	v[k] -= alpha;
+
+	vnorm2 = 0.0;
+	for (i = k; i < m; i++)
+		vnorm2 += v[i] * v[i];
+	if (vnorm2 == 0.0)
+		return 0.0;
+
+	return 2.0 / vnorm2;
+}
+
+void
+gel_matnum_qr_d (double *a, int m, int n, double *q)
+{
+	double *v = g_new (double, m);
+	int i, j, k;
+
+	if (q != NULL) {
+		memset (q, 0, sizeof (double) * m * m);
+		for (i = 0; i < m; i++)
+			q[i + i*m] = 1.0;
+	}
+
+	for (k = 0; k < MIN (m-1, n); k++) {
+		double beta = householder_vector_d (a + k*m, m, k, v);
+		if (beta == 0.0)
+			continue;
+		householder_left_d (a, m, k, v, beta, k, n-1);
+		if (q != NULL)
+			householder_right_d (q, m, m, k, v, beta, 0, m-1);
+		for (i = k+1; i < m; i++)
+			a[i + k*m] = 0.0;
+	}
+
+	/* make the diagonal of R nonnegative */
+	for (k = 0; k < MIN (m, n); k++) {
+		if (a[k + k*m] >= 0.0)
+			continue;
+		for (j = k; j < n; j++)
+			a[k + j*m] = -a[k + j*m];
+		if (q != NULL) {
+			for (i = 0; i < m; i++)
+				q[i + k*m] = -q[i + k*m];
+		}
+	}
+
+	g_free (v);
+}
+
+void
+gel_matnum_hessenberg_d (double *a, int n, double *q)
+{
+	double *v = g_new (double, n);
+	int i, k;
+
+	if (q != NULL) {
+		memset (q, 0, sizeof (double) * n * n);
+		for (i = 0; i < n; i++)
+			q[i + i*n] = 1.0;
+	}
+
+	for (k = 0; k < n-2; k++) {
+		double beta = householder_vector_d (a + k*n, n, k+1, v);
+		if (beta == 0.0)
+			continue;
+		householder_left_d (a, n, k+1, v, beta, k, n-1);
+		householder_right_d (a, n, n, k+1, v, beta, 0, n-1);
+		if (q != NULL)
+			householder_right_d (q, n, n, k+1, v, beta, 0, n-1);
+		for (i = k+2; i < n; i++)
+			A(i,k) = 0.0;
+	}
+
+	g_free (v);
+}
+
+#define SIGN(a,b) ((b) >= 0.0 ? fabs (a) : -fabs (a))
+
+/* The Francis double shift QR iteration of EISPACK's hqr, written
+ * with one based indices as in the original */
+gboolean
+gel_matnum_hqr_d (double *h, int n, double *wr, double *wi)
+{
+#define H(i,j) h[((i)-1) + ((j)-1)*n]
+	int nn, m, l, k, j, its, i, mmin;
+	double z = 0, y, x, w, v, u, t, s, r = 0, q = 0, p = 0, anorm;
+
+	anorm = 0.0;
+	for (i = 1; i <= n; i++)
+		for (j = MAX (i-1, 1); j <= n; j++)
+			anorm += fabs (H(i,j));
+
+	nn = n;
+	t = 0.0;
+	while (nn >= 1) {
+		its = 0;
+		do {
+			/* look for a small subdiagonal element */
+			for (l = nn; l >= 2; l--) {
+				s = fabs (H(l-1,l-1)) + fabs (H(l,l));
+				if (s == 0.0)
+					s = anorm;
+				if (fabs (H(l,l-1)) <= DBL_EPSILON * s) {
+					H(l,l-1) = 0.0;
+					break;
+				}
+			}
+			x = H(nn,nn);
+			if (l == nn) {
+				/* one root found */
+				wr[nn-1] = x + t;
+				wi[nn-1] = 0.0;
+				nn--;
+			} else {
+				y = H(nn-1,nn-1);
+				w = H(nn,nn-1) * H(nn-1,nn);
+				if (l == nn-1) {
+					/* two roots found */
+					p = 0.5 * (y - x);
+					q = p * p + w;
+					z = sqrt (fabs (q));
+					x += t;
+					if (q >= 0.0) {
+						z = p + SIGN (z, p);
+						wr[nn-2] = wr[nn-1] = x + z;
+						if (z != 0.0)
+							wr[nn-1] = x - w / z;
+						wi[nn-2] = wi[nn-1] = 0.0;
+					} else {
+						wr[nn-2] = wr[nn-1] = x + p;
+						wi[nn-2] = z;
+						wi[nn-1] = -z;
+					}
+					nn -= 2;
+				} else {
+					if (its == GEL_MATNUM_MAX_ITER)
+						return FALSE;
+					if (its == 10 || its == 20) {
+						/* exceptional shift */
+						t += x;
+						for (i = 1; i <= nn; i++)
+							H(i,i) -= x;
+						s = fabs (H(nn,nn-1)) + fabs (H(nn-1,nn-2));
+						y = x = 0.75 * s;
+						w = -0.4375 * s * s;
+					}
+					its++;
+					/* look for two consecutive small
+					 * subdiagonal elements */
+					for (m = nn-2; m >= l; m--) {
+						z = H(m,m);
+						r = x - z;
+						s = y - z;
+						p = (r * s - w) / H(m+1,m) + H(m,m+1);
+						q = H(m+1,m+1) - z - r - s;
+						r = H(m+2,m+1);
+						s = fabs (p) + fabs (q) + fabs (r);
+						p /= s;
+						q /= s;
+						r /= s;
+						if (m == l)
+							break;
+						u = fabs (H(m,m-1)) * (fabs (q) + fabs (r));
+						v = fabs (p) * (fabs (H(m-1,m-1)) + fabs (z) + fabs (H(m+1,m+1)));
+						if (u <= DBL_EPSILON * v)
+							break;
+					}
+					for (i = m+2; i <= nn; i++) {
+						H(i,i-2) = 0.0;
+						if (i != m+2)
+							H(i,i-3) = 0.0;
+					}
+					/* double QR step on rows l to nn and
+					 * columns m to nn */
+					for (k = m; k <= nn-1; k++) {
+						if (k != m) {
+							p = H(k,k-1);
+							q = H(k+1,k-1);
+							r = 0.0;
+							if (k != nn-1)
+								r = H(k+2,k-1);
+							if ((x = fabs (p) + fabs (q) + fabs (r)) != 0.0) {
+								p /= x;
+								q /= x;
+								r /= x;
+							}
+						}
+						s = SIGN (sqrt (p*p + q*q + r*r), p);
+						if (s == 0.0)
+							continue;
+						if (k == m) {
+							if (l != m)
+								H(k,k-1) = -H(k,k-1);
+						} else {
+							H(k,k-1) = -s * x;
+						}
+						p += s;
+						x = p / s;
+						y = q / s;
+						z = r / s;
+						q /= p;
+						r /= p;
+						for (j = k; j <= nn; j++) {
+							p = H(k,j) + q * H(k+1,j);
+							if (k != nn-1) {
+								p += r * H(k+2,j);
+								H(k+2,j) -= p * z;
+							}
+							H(k+1,j) -= p * y;
+							H(k,j) -= p * x;
+						}
+						mmin = nn < k+3 ? nn : k+3;
+						for (i = l; i <= mmin; i++) {
+							p = x * H(i,k) + y * H(i,k+1);
+							if (k != nn-1) {
+								p += z * H(i,k+2);
+								H(i,k+2) -= p * r;
+							}
+							H(i,k+1) -= p * q;
+							H(i,k) -= p;
+						}
+					}
+				}
+			}
+		} while (l < nn-1);
+	}
+#undef H
+
+	return TRUE;
+}
+
+/* Householder reduction of the symmetric a to tridiagonal form as in
+ * EISPACK's tred2 (one based), d gets the diagonal and e the
+ * subdiagonal in e[1..n-1].  With vectors a gets the transformation,
+ * otherwise it is destroyed. */
+static void
+tridiagonalize_d (double *a, int n, double *d, double *e, gboolean vectors)
+{
+#define T(i,j) a[((i)-1) + ((j)-1)*n]
+#define D(i) d[(i)-1]
+#define E(i) e[(i)-1]
+	int l, k, j, i;
+	double scale, hh, h, g, f;
+
+	for (i = n; i >= 2; i--) {
+		l = i - 1;
+		h = scale = 0.0;
+		if (l > 1) {
+			for (k = 1; k <= l; k++)
+				scale += fabs (T(i,k));
+			if (scale == 0.0) {
+				E(i) = T(i,l);
+			} else {
+				for (k = 1; k <= l; k++) {
+					T(i,k) /= scale;
+					h += T(i,k) * T(i,k);
+				}
+				f = T(i,l);
+				g = (f >= 0.0) ? -sqrt (h) : sqrt (h);
+				E(i) = scale * g;
+				h -= f * g;
+				T(i,l) = f - g;
+				f = 0.0;
+				for (j = 1; j <= l; j++) {
+					if (vectors)
+						T(j,i) = T(i,j) / h;
+					g = 0.0;
+					for (k = 1; k <= j; k++)
+						g += T(j,k) * T(i,k);
+					for (k = j+1; k <= l; k++)
+						g += T(k,j) * T(i,k);
+					E(j) = g / h;
+					f += E(j) * T(i,j);
+				}
+				hh = f / (h + h);
+				for (j = 1; j <= l; j++) {
+					f = T(i,j);
+					E(j) = g = E(j) - hh * f;
+					for (k = 1; k <= j; k++)
+						T(j,k) -= (f * E(k) + g * T(i,k));
+				}
+			}
+		} else {
+			E(i) = T(i,l);
+		}
+		D(i) = h;
+	}
+	D(1) = 0.0;
+	E(1) = 0.0;
+
+	for (i = 1; i <= n; i++) {
+		if ( ! vectors) {
+			D(i) = T(i,i);
+			continue;
+		}
+		l = i - 1;
+		if (D(i) != 0.0) {
+			for (j = 1; j <= l; j++) {
+				g = 0.0;
+				for (k = 1; k <= l; k++)
+					g += T(i,k) * T(k,j);
+				for (k = 1; k <= l; k++)
+					T(k,j) -= g * T(k,i);
+			}
+		}
+		D(i) = T(i,i);
+		T(i,i) = 1.0;
+		for (j = 1; j <= l; j++)
+			T(j,i) = T(i,j) = 0.0;
+	}
+
+	/* shift so that e[i] is the entry below d[i] */
+	for (i = 2; i <= n; i++)
+		E(i-1) = E(i);
+	E(n) = 0.0;
+#undef T
+}
+
+/* The implicit QL iteration of EISPACK's tql2 on the tridiagonal
+ * matrix, z (if not NULL) accumulates the rotations */
+static gboolean
+tridiagonal_ql_d (double *d, double *e, int n, double *z)
+{
+#define Z(i,j) z[((i)-1) + ((j)-1)*n]
+	int m, l, iter, i, k;
+	double s, r, p, g, f, dd, c, b;
+
+	for (l = 1; l <= n; l++) {
+		iter = 0;
+		do {
+			for (m = l; m <= n-1; m++) {
+				dd = fabs (D(m)) + fabs (D(m+1));
+				if (fabs (E(m)) <= DBL_EPSILON * dd)
+					break;
+			}
+			if (m != l) {
+				if (iter++ == GEL_MATNUM_MAX_ITER)
+					return FALSE;
+				g = (D(l+1) - D(l)) / (2.0 * E(l));
+				r = hypot (g, 1.0);
+				g = D(m) - D(l) + E(l) / (g + SIGN (r, g));
+				s = c = 1.0;
+				p = 0.0;
+				for (i = m-1; i >= l; i--) {
+					f = s * E(i);
+					b = c * E(i);
+					E(i+1) = (r = hypot (f, g));
+					if (r == 0.0) {
+						/* underflow, start over */
+						D(i+1) -= p;
+						E(m) = 0.0;
+						break;
+					}
+					s = f / r;
+					c = g / r;
+					g = D(i+1) - p;
+					r = (D(i) - g) * s + 2.0 * c * b;
+					D(i+1) = g + (p = s * r);
+					g = c * r - b;
+					if (z != NULL) {
+						for (k = 1; k <= n; k++) {
+							f = Z(k,i+1);
+							Z(k,i+1) = s * Z(k,i) + c * f;
+							Z(k,i) = c * Z(k,i) - s * f;
+						}
+					}
+				}
+				if (r == 0.0 && i >= l)
+					continue;
+				D(l) -= p;
+				E(l) = g;
+				E(m) = 0.0;
+			}
+		} while (m != l);
+	}
+#undef Z
+#undef D
+#undef E
+
+	return TRUE;
+}
+
+gboolean
+gel_matnum_symmetric_eigen_d (double *a, int n, double *w, gboolean vectors)
+{
+	double *e = g_new (double, n);
+	int i, j, k;
+
+	tridiagonalize_d (a, n, w, e, vectors);
+	if ( ! tridiagonal_ql_d (w, e, n, vectors ? a : NULL)) {
+		g_free (e);
+		return FALSE;
+	}
+	g_free (e);
+
+	/* sort ascending, selection sort is fine next to the rest */
+	for (i = 0; i < n-1; i++) {
+		k = i;
+		for (j = i+1; j < n; j++)
+			if (w[j] < w[k])
+				k = j;
+		if (k == i)
+			continue;
+		{
+			double tmp = w[i];
+			w[i] = w[k];
+			w[k] = tmp;
+		}
+		if (vectors) {
+			for (j = 0; j < n; j++) {
+				double tmp = A(j,i);
+				A(j,i) = A(j,k);
+				A(j,k) = tmp;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/*
+ * mpw numbers
+ */
+
+static void
+swap_mpw (mpw_ptr x, mpw_ptr y, mpw_ptr tmp)
+{
+	mpw_set (tmp, x);
+	mpw_set (x, y);
+	mpw_set (y, tmp);
+}
+
+gboolean
+gel_matnum_lu_mpw (mpw_t *a, int n, int *perm, gboolean pivot)
+{
+	mpw_t max, tmp, piv;
+	gboolean ret = TRUE;
+	int i, j, k;
+
+	mpw_init (max);
+	mpw_init (tmp);
+	mpw_init (piv);
+
+	for (k = 0; k < n; k++) {
+		int p = k;
+
+		if (pivot) {
+			mpw_abs (max, A(k,k));
+			for (i = k+1; i < n; i++) {
+				mpw_abs (tmp, A(i,k));
+				if (mpw_cmp (tmp, max) > 0) {
+					mpw_set (max, tmp);
+					p = i;
+				}
+			}
+		}
+		if (perm != NULL)
+			perm[k] = p;
+
+		if (mpw_zero_p (A(p,k))) {
+			ret = FALSE;
+			break;
+		}
+
+		if (p != k) {
+			for (j = 0; j < n; j++)
+				swap_mpw (A(k,j), A(p,j), tmp);
+		}
+
+		mpw_set (piv, A(k,k));
+		for (i = k+1; i < n; i++)
+			mpw_div (A(i,k), A(i,k), piv);
+		for (j = k+1; j < n; j++) {
+			if (mpw_zero_p (A(k,j)))
+				continue;
+			for (i = k+1; i < n; i++) {
+				if (mpw_zero_p (A(i,k)))
+					continue;
+				mpw_mul (tmp, A(i,k), A(k,j));
+				mpw_sub (A(i,j), A(i,j), tmp);
+			}
+		}
+
+		if G_UNLIKELY (gel_interrupted) {
+			ret = FALSE;
+			break;
+		}
+	}
+
+	mpw_clear (max);
+	mpw_clear (tmp);
+	mpw_clear (piv);
+
+	return ret;
+}
+
+/* Temporaries for the Householder reflections I - beta v v^H, where v
+ * (and its conjugate vc) is zero above row k */
+typedef struct {
+	int m;
+	mpw_t *v;
+	mpw_t *vc;
+	mpw_t beta;
+	mpw_t s;
+	mpw_t tmp;
+	mpw_t tmp2;
+} HouseMpw;
+
+static void
+house_init (HouseMpw *hh, int m)
+{
+	int i;
+
+	hh->m = m;
+	hh->v = g_new (mpw_t, m);
+	hh->vc = g_new (mpw_t, m);
+	for (i = 0; i < m; i++) {
+		mpw_init (hh->v[i]);
+		mpw_init (hh->vc[i]);
+	}
+	mpw_init (hh->beta);
+	mpw_init (hh->s);
+	mpw_init (hh->tmp);
+	mpw_init (hh->tmp2);
+}
+
+static void
+house_clear (HouseMpw *hh)
+{
+	int i;
+
+	for (i = 0; i < hh->m; i++) {
+		mpw_clear (hh->v[i]);
+		mpw_clear (hh->vc[i]);
+	}
+	g_free (hh->v);
+	g_free (hh->vc);
+	mpw_clear (hh->beta);
+	mpw_clear (hh->s);
+	mpw_clear (hh->tmp);
+	mpw_clear (hh->tmp2);
+}
+
+/* Set up the reflection taking x[k..m-1] to a multiple of e_k, FALSE
+ * if there is nothing to do */
+static gboolean
+house_vector (HouseMpw *hh, mpw_t *x, int k)
+{
+	int i, m = hh->m;
+
+	/* s = |x|^2 */
+	mpw_set_ui (hh->s, 0);
+	for (i = k; i < m; i++) {
+		mpw_abs_sq (hh->tmp, x[i]);
+		mpw_add (hh->s, hh->s, hh->tmp);
+	}
+	if (mpw_zero_p (hh->s))
+		return FALSE;
+	mpw_sqrt (hh->s, hh->s);
+	mpw_make_float (hh->s);
+
+	/* v = x - alpha e_k, alpha = -|x| x_k/|x_k| */
+	for (i = k; i < m; i++)
+		mpw_set (hh->v[i], x[i]);
+	if (mpw_zero_p (x[k])) {
+		mpw_add (hh->v[k], hh->v[k], hh->s);
+	} else {
+		mpw_abs (hh->tmp, x[k]);
+		mpw_div (hh->tmp, x[k], hh->tmp);
+		mpw_mul (hh->tmp, hh->tmp, hh->s);
+		mpw_add (hh->v[k], hh->v[k], hh->tmp);
+	}
+
+	/* beta = 2/|v|^2 */
+	mpw_set_ui (hh->s, 0);
+	for (i = k; i < m; i++) {
+		mpw_abs_sq (hh->tmp, hh->v[i]);
+		mpw_add (hh->s, hh->s, hh->tmp);
+		mpw_conj (hh->vc[i], hh->v[i]);
+	}
+	if (mpw_zero_p (hh->s))
+		return FALSE;
+	mpw_set_ui (hh->beta, 2);
+	mpw_div (hh->beta, hh->beta, hh->s);
+
+	return TRUE;
+}
+
+/* apply to the columns j0..j1 of the m row matrix a from the left */
+static void
+house_left (HouseMpw *hh, mpw_t *a, int k, int j0, int j1)
+{
+	int i, j, m = hh->m;
+
+	for (j = j0; j <= j1; j++) {
+		mpw_t *col = a + j*m;
+		mpw_set_ui (hh->s, 0);
+		for (i = k; i < m; i++) {
+			mpw_mul (hh->tmp, hh->vc[i], col[i]);
+			mpw_add (hh->s, hh->s, hh->tmp);
+		}
+		if (mpw_zero_p (hh->s))
+			continue;
+		mpw_mul (hh->s, hh->s, hh->beta);
+		for (i = k; i < m; i++) {
+			mpw_mul (hh->tmp, hh->s, hh->v[i]);
+			mpw_sub (col[i], col[i], hh->tmp);
+		}
+	}
+}
+
+/* apply to the rows i0..i1 of a (with rows rows and the reflection
+ * acting on its columns) from the right */
+static void
+house_right (HouseMpw *hh, mpw_t *a, int rows, int k, int i0, int i1)
+{
+	int i, j, m = hh->m;
+
+	for (i = i0; i <= i1; i++) {
+		mpw_set_ui (hh->s, 0);
+		for (j = k; j < m; j++) {
+			mpw_mul (hh->tmp, a[i + j*rows], hh->v[j]);
+			mpw_add (hh->s, hh->s, hh->tmp);
+		}
+		if (mpw_zero_p (hh->s))
+			continue;
+		mpw_mul (hh->s, hh->s, hh->beta);
+		for (j = k; j < m; j++) {
+			mpw_mul (hh->tmp, hh->s, hh->vc[j]);
+			mpw_sub (a[i + j*rows], a[i + j*rows], hh->tmp);
+		}
+	}
+}
+
+static void
+set_identity_mpw (mpw_t *q, int m)
+{
+	int i, j;
+
+	for (j = 0; j < m; j++)
+		for (i = 0; i < m; i++)
+			mpw_set_ui (q[i + j*m], (i == j) ? 1 : 0);
+}
+
+void
+gel_matnum_qr_mpw (mpw_t *a, int m, int n, mpw_t *q)
+{
+	HouseMpw hh;
+	int i, j, k;
+
+	house_init (&hh, m);
+
+	if (q != NULL)
+		set_identity_mpw (q, m);
+
+	for (k = 0; k < MIN (m-1, n); k++) {
+		if ( ! house_vector (&hh, a + k*m, k))
+			continue;
+		house_left (&hh, a, k, k, n-1);
+		if (q != NULL)
+			house_right (&hh, q, m, k, 0, m-1);
+		for (i = k+1; i < m; i++)
+			mpw_set_ui (a[i + k*m], 0);
+	}
+
+	/* make the diagonal of R real and nonnegative, A = (QD)(D^*R) for
+	 * a diagonal unitary D */
+	for (k = 0; k < MIN (m, n); k++) {
+		mpw_ptr rkk = a[k + k*m];
+		if (mpw_zero_p (rkk) ||
+		    ( ! mpw_is_complex (rkk) && mpw_sgn (rkk) > 0))
+			continue;
+		mpw_abs (hh.tmp, rkk);
+		mpw_div (hh.tmp, rkk, hh.tmp);
+		mpw_conj (hh.tmp2, hh.tmp);
+		for (j = k; j < n; j++)
+			mpw_mul (a[k + j*m], a[k + j*m], hh.tmp2);
+		/* exactly real */
+		mpw_abs (a[k + k*m], a[k + k*m]);
+		if (q != NULL) {
+			for (i = 0; i < m; i++)
+				mpw_mul (q[i + k*m], q[i + k*m], hh.tmp);
+		}
+	}
+
+	house_clear (&hh);
+}
+
+void
+gel_matnum_hessenberg_mpw (mpw_t *a, int n, mpw_t *q)
+{
+	HouseMpw hh;
+	int i, k;
+
+	house_init (&hh, n);
+
+	if (q != NULL)
+		set_identity_mpw (q, n);
+
+	for (k = 0; k < n-2; k++) {
+		if ( ! house_vector (&hh, a + k*n, k+1))
+			continue;
+		house_left (&hh, a, k+1, k, n-1);
+		house_right (&hh, a, n, k+1, 0, n-1);
+		if (q != NULL)
+			house_right (&hh, q, n, k+1, 0, n-1);
+		for (i = k+2; i < n; i++)
+			mpw_set_ui (A(i,k), 0);
+
+		if G_UNLIKELY (gel_interrupted)
+			break;
+	}
+
+	house_clear (&hh);
+}
+
+/* Givens rotation [c s; -conj(s) c] (c real) zeroing y in (x,y) */
+static void
+givens_mpw (mpw_ptr c, mpw_ptr s, mpw_ptr x, mpw_ptr y,
+	    mpw_ptr tmp, mpw_ptr tmp2)
+{
+	if (mpw_zero_p (y)) {
+		mpw_set_ui (c, 1);
+		mpw_set_ui (s, 0);
+		return;
+	}
+	if (mpw_zero_p (x)) {
+		/* s = conj(y)/|y| */
+		mpw_set_ui (c, 0);
+		mpw_abs (tmp, y);
+		mpw_conj (s, y);
+		mpw_div (s, s, tmp);
+		return;
+	}
+
+	/* r = sqrt(|x|^2+|y|^2), c = |x|/r, s = (x/|x|) conj(y)/r */
+	mpw_abs_sq (tmp, x);
+	mpw_abs_sq (tmp2, y);
+	mpw_add (tmp, tmp, tmp2);
+	mpw_sqrt (tmp, tmp);
+	mpw_abs (c, x);
+	mpw_div (s, x, c);
+	mpw_div (c, c, tmp);
+	mpw_conj (tmp2, y);
+	mpw_mul (s, s, tmp2);
+	mpw_div (s, s, tmp);
+}
+
+/* (x,y) <- (c x + s y, -conj(s) x + c y) */
+static void
+rotate_mpw (mpw_ptr x, mpw_ptr y, mpw_ptr c, mpw_ptr s, mpw_ptr sc,
+	    mpw_ptr tmp, mpw_ptr tmp2)
+{
+	mpw_mul (tmp, c, x);
+	mpw_mul (tmp2, s, y);
+	mpw_add (tmp, tmp, tmp2);
+	mpw_mul (tmp2, sc, x);
+	mpw_mul (y, c, y);
+	mpw_sub (y, y, tmp2);
+	mpw_set (x, tmp);
+}
+
+/* |x| <= eps * s */
+static gboolean
+negligible_mpw (mpw_ptr x, mpw_ptr s, mpw_ptr eps, mpw_ptr tmp, mpw_ptr tmp2)
+{
+	mpw_abs (tmp, x);
+	mpw_mul (tmp2, eps, s);
+	return mpw_cmp (tmp, tmp2) <= 0;
+}
+
+/* Order by the real part and then by the imaginary part */
+static int
+compare_eigenvalues_mpw (mpw_ptr x, mpw_ptr y, mpw_ptr tmp, mpw_ptr tmp2)
+{
+	int c;
+
+	mpw_re (tmp, x);
+	mpw_re (tmp2, y);
+	c = mpw_cmp (tmp, tmp2);
+	if (c != 0)
+		return c;
+	mpw_im (tmp, x);
+	mpw_im (tmp2, y);
+	return mpw_cmp (tmp, tmp2);
+}
+
+gboolean
+gel_matnum_eigen_mpw (mpw_t *a, int n, mpw_t *w, mpw_t *v)
+{
+	mpw_t *z = NULL;
+	mpw_t *cs, *ss, *x;
+	mpw_t eps, norm, s, mu, c, sn, sc, tmp, tmp2, tmp3;
+	gboolean real = TRUE;
+	gboolean ret = TRUE;
+	int lo, hi, l, k, i, j, iter;
+
+	for (i = 0; i < n*n; i++) {
+		if (mpw_is_complex (a[i])) {
+			real = FALSE;
+			break;
+		}
+	}
+
+	mpw_init (eps);
+	mpw_init (norm);
+	mpw_init (s);
+	mpw_init (mu);
+	mpw_init (c);
+	mpw_init (sn);
+	mpw_init (sc);
+	mpw_init (tmp);
+	mpw_init (tmp2);
+	mpw_init (tmp3);
+	cs = g_new (mpw_t, n);
+	ss = g_new (mpw_t, n);
+	for (i = 0; i < n; i++) {
+		mpw_init (cs[i]);
+		mpw_init (ss[i]);
+	}
+
+	mpw_set_ui (eps, 1);
+	mpw_make_float (eps);
+	mpw_set_ui (tmp, 2);
+	mpw_set_ui (tmp2, gel_calcstate.float_prec);
+	mpw_pow (tmp, tmp, tmp2);
+	mpw_div (eps, eps, tmp);
+
+	if (v != NULL) {
+		z = g_new (mpw_t, n*n);
+		for (i = 0; i < n*n; i++)
+			mpw_init (z[i]);
+	}
+
+	for (i = 0; i < n*n; i++)
+		mpw_make_float (a[i]);
+	gel_matnum_hessenberg_mpw (a, n, z);
+
+	/* the sum of the absolute values is enough for a scale */
+	mpw_set_ui (norm, 0);
+	for (i = 0; i < n*n; i++) {
+		mpw_abs (tmp, a[i]);
+		mpw_add (norm, norm, tmp);
+	}
+
+	/* The shifted QR iteration with Givens rotations on the active
+	 * block lo..hi, with vectors the whole Schur form is kept up to
+	 * date, otherwise only the block */
+	hi = n-1;
+	iter = 0;
+	while (hi > 0) {
+		if G_UNLIKELY (gel_interrupted) {
+			ret = FALSE;
+			break;
+		}
+
+		for (l = hi; l > 0; l--) {
+			mpw_abs (s, A(l-1,l-1));
+			mpw_abs (tmp, A(l,l));
+			mpw_add (s, s, tmp);
+			if (mpw_zero_p (s))
+				mpw_set (s, norm);
+			if (negligible_mpw (A(l,l-1), s, eps, tmp, tmp2)) {
+				mpw_set_ui (A(l,l-1), 0);
+				break;
+			}
+		}
+		if (l == hi) {
+			hi--;
+			iter = 0;
+			continue;
+		}
+		lo = l;
+
+		if (iter++ >= GEL_MATNUM_MAX_ITER) {
+			ret = FALSE;
+			break;
+		}
+
+		if (iter % 10 == 0) {
+			/* exceptional shift */
+			mpw_abs (mu, A(hi,hi-1));
+			mpw_add (mu, mu, A(hi,hi));
+		} else {
+			/* Wilkinson shift, the eigenvalue of the trailing
+			 * 2x2 block closer to its last entry,
+			 * (a+d)/2 +- sqrt(((a-d)/2)^2 + bc) */
+			mpw_sub (tmp, A(hi-1,hi-1), A(hi,hi));
+			mpw_div_ui (tmp, tmp, 2);
+			mpw_mul (tmp2, tmp, tmp);
+			mpw_mul (tmp3, A(hi-1,hi), A(hi,hi-1));
+			mpw_add (tmp2, tmp2, tmp3);
+			mpw_sqrt (tmp2, tmp2);
+			/* mu = d + tmp +- tmp2, take the smaller
+			 * |tmp +- tmp2| */
+			mpw_add (s, tmp, tmp2);
+			mpw_sub (tmp3, tmp, tmp2);
+			mpw_abs (c, s);
+			mpw_abs (sn, tmp3);
+			if (mpw_cmp (c, sn) <= 0)
+				mpw_add (mu, A(hi,hi), s);
+			else
+				mpw_add (mu, A(hi,hi), tmp3);
+		}
+
+		for (k = lo; k <= hi; k++)
+			mpw_sub (A(k,k), A(k,k), mu);
+
+		/* H - mu I = QR, rotations from the left */
+		for (k = lo; k < hi; k++) {
+			int jend = (v != NULL) ? n-1 : hi;
+			givens_mpw (cs[k], ss[k], A(k,k), A(k+1,k), tmp, tmp2);
+			mpw_conj (sc, ss[k]);
+			for (j = k; j <= jend; j++)
+				rotate_mpw (A(k,j), A(k+1,j), cs[k], ss[k], sc,
+					    tmp, tmp2);
+			mpw_set_ui (A(k+1,k), 0);
+		}
+		/* RQ + mu I, the adjoints from the right */
+		for (k = lo; k < hi; k++) {
+			int istart = (v != NULL) ? 0 : lo;
+			int iend = MIN (k+2, hi);
+			/* (col k, col k+1) <- (c ck + conj(s) ck1,
+			 *                      -s ck + c ck1) */
+			mpw_conj (sc, ss[k]);
+			for (i = istart; i <= iend; i++)
+				rotate_mpw (A(i,k), A(i,k+1), cs[k], sc, ss[k],
+					    tmp, tmp2);
+			if (z != NULL) {
+				for (i = 0; i < n; i++)
+					rotate_mpw (z[i + k*n], z[i + (k+1)*n],
+						    cs[k], sc, ss[k],
+						    tmp, tmp2);
+			}
+		}
+
+		for (k = lo; k <= hi; k++)
+			mpw_add (A(k,k), A(k,k), mu);
+	}
+
+	if ( ! ret)
+		goto done;
+
+	for (i = 0; i < n; i++)
+		mpw_set (w[i], A(i,i));
+
+	if (v != NULL) {
+		/* eigenvectors of the triangular T = Z^* A Z by back
+		 * substitution, then multiplied by Z */
+		mpw_t small;
+		x = g_new (mpw_t, n);
+		for (i = 0; i < n; i++)
+			mpw_init (x[i]);
+		mpw_init (small);
+		mpw_mul (small, eps, norm);
+		if (mpw_zero_p (small))
+			mpw_set (small, eps);
+
+		for (k = 0; k < n; k++) {
+			mpw_set_ui (x[k], 1);
+			for (i = k-1; i >= 0; i--) {
+				mpw_set_ui (s, 0);
+				for (j = i+1; j <= k; j++) {
+					mpw_mul (tmp, A(i,j), x[j]);
+					mpw_add (s, s, tmp);
+				}
+				/* close eigenvalues, perturb */
+				mpw_sub (tmp3, A(i,i), A(k,k));
+				mpw_abs (tmp, tmp3);
+				if (mpw_cmp (tmp, small) < 0)
+					mpw_set (tmp3, small);
+				mpw_div (x[i], s, tmp3);
+				mpw_neg (x[i], x[i]);
+			}
+
+			/* v_k = Z x, normalized */
+			mpw_set_ui (norm, 0);
+			for (i = 0; i < n; i++) {
+				mpw_t *vi = &v[i + k*n];
+				mpw_set_ui (*vi, 0);
+				for (j = 0; j <= k; j++) {
+					mpw_mul (tmp, z[i + j*n], x[j]);
+					mpw_add (*vi, *vi, tmp);
+				}
+				mpw_abs_sq (tmp, *vi);
+				mpw_add (norm, norm, tmp);
+			}
+			mpw_sqrt (norm, norm);
+
+			/* make the largest entry real and positive */
+			j = 0;
+			mpw_set_ui (tmp2, 0);
+			for (i = 0; i < n; i++) {
+				mpw_abs (tmp, v[i + k*n]);
+				if (mpw_cmp (tmp, tmp2) > 0) {
+					mpw_set (tmp2, tmp);
+					j = i;
+				}
+			}
+			if ( ! mpw_zero_p (tmp2)) {
+				mpw_conj (tmp, v[j + k*n]);
+				mpw_div (tmp, tmp, tmp2);
+				mpw_div (tmp, tmp, norm);
+				for (i = 0; i < n; i++)
+					mpw_mul (v[i + k*n], v[i + k*n], tmp);
+			}
+		}
+
+		for (i = 0; i < n; i++)
+			mpw_clear (x[i]);
+		g_free (x);
+		mpw_clear (small);
+	}
+
+	/* For real matrices tiny imaginary parts are rounding errors,
+	 * the threshold is the square root of the precision relative to
+	 * the norm since close eigenvalues are only found to about
+	 * that */
+	if (real) {
+		mpw_sqrt (tmp3, eps);
+		mpw_set_ui (s, 0);
+		for (i = 0; i < n; i++) {
+			mpw_abs (tmp, w[i]);
+			mpw_add (s, s, tmp);
+		}
+		mpw_mul (s, s, tmp3);
+		for (i = 0; i < n; i++) {
+			mpw_im (tmp, w[i]);
+			mpw_abs (tmp, tmp);
+			if (mpw_cmp (tmp, s) <= 0) {
+				mpw_re (w[i], w[i]);
+				if (v != NULL) {
+					for (j = 0; j < n; j++)
+						mpw_re (v[j + i*n], v[j + i*n]);
+				}
+			}
+		}
+	}
+
+	/* sort, along with the vectors */
+	for (i = 0; i < n-1; i++) {
+		k = i;
+		for (j = i+1; j < n; j++)
+			if (compare_eigenvalues_mpw (w[j], w[k], tmp, tmp2) < 0)
+				k = j;
+		if (k == i)
+			continue;
+		swap_mpw (w[i], w[k], tmp);
+		if (v != NULL) {
+			for (j = 0; j < n; j++)
+				swap_mpw (v[j + i*n], v[j + k*n], tmp);
+		}
+	}
+
+done:
+	if (z != NULL) {
+		for (i = 0; i < n*n; i++)
+			mpw_clear (z[i]);
+		g_free (z);
+	}
+	for (i = 0; i < n; i++) {
+		mpw_clear (cs[i]);
+		mpw_clear (ss[i]);
+	}
+	g_free (cs);
+	g_free (ss);
+	mpw_clear (eps);
+	mpw_clear (norm);
+	mpw_clear (s);
+	mpw_clear (mu);
+	mpw_clear (c);
+	mpw_clear (sn);
+	mpw_clear (sc);
+	mpw_clear (tmp);
+	mpw_clear (tmp2);
+	mpw_clear (tmp3);
+
+	return ret;
+}
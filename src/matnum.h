@@ -0,0 +1,105 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MATNUM_H_
+#define _MATNUM_H_
+
+#include <glib.h>
+#include "mpwrap.h"
+
+/* Numerical linear algebra on dense matrices: LU with partial pivoting,
+ * Householder QR, Hessenberg reduction, shifted QR iteration for the
+ * eigenvalues of general matrices and tridiagonal QL for symmetric
+ * ones.  Matrices are arrays stored by columns (entry i,j at i+j*m for m
+ * rows).  The double versions are for real matrices, the mpw versions
+ * follow the current float precision and take complex entries. */
+
+/* Real matrices of more than this many rows are done in doubles, as
+ * multiple precision would take far too long */
+#define GEL_MATNUM_DOUBLE_SIZE 32
+
+/* maximum number of QR (or QL) iterations per eigenvalue */
+#define GEL_MATNUM_MAX_ITER 60
+
+/* LU decomposition in place, a gets L below the diagonal (with an
+ * implicit unit diagonal) and U on and above it.  With pivot the rows
+ * are interchanged to get the largest pivot, perm[k] is the row swapped
+ * with row k at step k.  Returns FALSE if a pivot is zero (the matrix
+ * is singular, or without pivoting the decomposition does not exist),
+ * a is then left half done. */
+gboolean	gel_matnum_lu_d			(double *a,
+						 int n,
+						 int *perm,
+						 gboolean pivot);
+gboolean	gel_matnum_lu_mpw		(mpw_t *a,
+						 int n,
+						 int *perm,
+						 gboolean pivot);
+
+/* Householder QR of the m by n matrix a, a gets R and the m by m q (if
+ * not NULL) gets Q.  The diagonal of R is made real and nonnegative. */
+void		gel_matnum_qr_d			(double *a,
+						 int m,
+						 int n,
+						 double *q);
+void		gel_matnum_qr_mpw		(mpw_t *a,
+						 int m,
+						 int n,
+						 mpw_t *q);
+
+/* Reduce a to upper Hessenberg form by Householder similarities, q (if
+ * not NULL) gets the transformation */
+void		gel_matnum_hessenberg_d		(double *a,
+						 int n,
+						 double *q);
+void		gel_matnum_hessenberg_mpw	(mpw_t *a,
+						 int n,
+						 mpw_t *q);
+
+/* Eigenvalues of a real upper Hessenberg matrix by the Francis double
+ * shift QR iteration, wr and wi get the real and imaginary parts, the
+ * complex ones in conjugate pairs.  h is destroyed.  FALSE if it does
+ * not converge. */
+gboolean	gel_matnum_hqr_d		(double *h,
+						 int n,
+						 double *wr,
+						 double *wi);
+
+/* Eigenvalues (ascending in w) of a real symmetric matrix by reduction
+ * to tridiagonal form and the implicit QL iteration.  If vectors is
+ * TRUE, a gets the corresponding orthonormal eigenvectors as columns,
+ * otherwise it is destroyed. */
+gboolean	gel_matnum_symmetric_eigen_d	(double *a,
+						 int n,
+						 double *w,
+						 gboolean vectors);
+
+/* Eigenvalues of a general (complex) matrix by Hessenberg reduction
+ * and the shifted QR iteration, sorted by the real and then the
+ * imaginary part.  If v is not NULL it gets unit length eigenvectors
+ * as columns.  a is destroyed.  FALSE if it does not converge. */
+gboolean	gel_matnum_eigen_mpw		(mpw_t *a,
+						 int n,
+						 mpw_t *w,
+						 mpw_t *v);
+
+#endif /* _MATNUM_H_ */
@@ -23,6 +23,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include <glib.h>
 #include "calc.h"
 #include "mpwrap.h"
@@ -34,6 +36,7 @@
 #include "matrixw.h"
 
 #include "matop.h"
+#include "modarith.h"
 
 gboolean
 gel_is_matrix_value_only (GelMatrixW *m)
@@ -237,12 +240,133 @@ gel_matrix_conjugate_transpose (GelMatrixW *m)
 	}
 }
 
+/* The entries of a value only integer matrix, rowwise */
+static mpz_t *
+integer_matrix_to_mpz (GelMatrixW *m)
+{
+	int i, j, w, h;
+	mpz_t *a;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	a = g_new (mpz_t, w*h);
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			GelETree *t = gel_matrixw_get_index (m, i, j);
+			if (t == NULL)
+				mpz_init (a[j*w+i]);
+			else
+				mpz_init_set (a[j*w+i],
+					      mpw_peek_real_mpz (t->val.value));
+		}
+	}
+	return a;
+}
+
+/* Fills res (already of the right size and private) from the rowwise
+ * entries in a, and frees a */
+static void
+integer_matrix_from_mpz (GelMatrixW *res, mpz_t *a)
+{
+	int i, j, w, h;
+
+	w = gel_matrixw_width (res);
+	h = gel_matrixw_height (res);
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			mpz_ptr z = a[j*w+i];
+			if (mpz_sgn (z) == 0) {
+				mpz_clear (z);
+				gel_matrixw_set_index (res, i, j) = NULL;
+			} else {
+				mpw_t v;
+				mpw_init (v);
+				mpw_set_mpz_use (v, z);
+				gel_matrixw_set_index (res, i, j) =
+					gel_makenum_use (v);
+			}
+		}
+	}
+	g_free (a);
+}
+
+static void
+clear_mpz_array (mpz_t *a, int len)
+{
+	int i;
+	for (i = 0; i < len; i++)
+		mpz_clear (a[i]);
+	g_free (a);
+}
+
+/* Multiply integer matrices modulo an integer without going through
+ * mpw, see modarith.h */
+static void
+integer_matrix_multiply_mod (GelMatrixW *res, GelMatrixW *m1, GelMatrixW *m2,
+			     mpw_ptr modulo)
+{
+	int i, w, h, n;
+	mpz_t *a, *b, *c;
+	const GelModCtx *mc = gel_modctx_get (mpw_peek_real_mpz (modulo));
+
+	w = gel_matrixw_width (res);
+	h = gel_matrixw_height (res);
+	n = gel_matrixw_width (m1);
+
+	a = integer_matrix_to_mpz (m1);
+	b = integer_matrix_to_mpz (m2);
+	c = g_new (mpz_t, w*h);
+	for (i = 0; i < w*h; i++)
+		mpz_init (c[i]);
+
+	gel_mod_matrix_mul (mc, c, a, b, h, n, w);
+
+	clear_mpz_array (a, h*n);
+	clear_mpz_array (b, n*w);
+	integer_matrix_from_mpz (res, c);
+}
+
+/* res = m^power modulo an integer for a square integer matrix m and
+ * power >= 1, res should be new */
+void
+gel_value_matrix_pow_mod (GelMatrixW *res, GelMatrixW *m,
+			  unsigned long power, mpw_ptr modulo)
+{
+	int i, n;
+	mpz_t *a, *c;
+	const GelModCtx *mc = gel_modctx_get (mpw_peek_real_mpz (modulo));
+
+	n = gel_matrixw_width (m);
+	gel_matrixw_set_size (res, n, n);
+	gel_matrixw_make_private (res, TRUE /* kill_type_caches */);
+
+	a = integer_matrix_to_mpz (m);
+	c = g_new (mpz_t, n*n);
+	for (i = 0; i < n*n; i++)
+		mpz_init (c[i]);
+
+	gel_mod_matrix_pow (mc, c, a, n, power);
+
+	clear_mpz_array (a, n*n);
+	integer_matrix_from_mpz (res, c);
+}
+
 void
 gel_value_matrix_multiply (GelMatrixW *res, GelMatrixW *m1, GelMatrixW *m2,
 			   mpw_ptr modulo)
 {
 	int i, j, k, w, h, m1w;
 	mpw_t tmp;
+
+	if (modulo != NULL &&
+	    mpw_peek_real_mpz (modulo) != NULL &&
+	    gel_is_matrix_value_only_integer (m1) &&
+	    gel_is_matrix_value_only_integer (m2)) {
+		gel_matrixw_make_private (res, TRUE /* kill_type_caches */);
+		integer_matrix_multiply_mod (res, m1, m2, modulo);
+		return;
+	}
+
 	mpw_init(tmp);
 	gel_matrixw_make_private(res, TRUE /* kill_type_caches */);
 
@@ -744,3 +868,354 @@ gel_value_matrix_det (GelCtx *ctx, mpw_t rop, GelMatrixW *m)
 	}
 	return TRUE;
 }
+
+/*
+ * Elementwise arithmetic on float matrices in doubles.  When the float
+ * precision is exactly that of a double, and the entries are floats of
+ * at most that precision (or integers that convert exactly), IEEE +, -,
+ * *, / and sqrt round correctly to nearest just as mpfr does, so doubles
+ * give the very same results.  We gather the entries into packed arrays,
+ * run plain loops over those and make a packed result.  Powers and
+ * sin, cos and such are not done, libm does not round those correctly
+ * and could be a bit off from mpfr.  Anything doubles would get wrong
+ * (division by zero, under or overflow, ...) makes us return NULL and
+ * the caller does the usual thing.
+ */
+
+/* zero or a normal double, anything else mpfr would do better */
+#define DOUBLE_OK(x) ((x) == 0.0 || \
+		      (fabs (x) >= DBL_MIN && fabs (x) <= DBL_MAX))
+
+static gboolean
+value_get_double (mpw_ptr v, double *d, gboolean *isfloat)
+{
+	mpfr_ptr f;
+	mpz_ptr z;
+
+	if (mpw_is_complex (v))
+		return FALSE;
+
+	if ((f = mpw_peek_real_mpf (v)) != NULL) {
+		if (mpfr_get_prec (f) > DBL_MANT_DIG)
+			return FALSE;
+		*d = mpfr_get_d (f, GMP_RNDN);
+		*isfloat = TRUE;
+	} else if ((z = mpw_peek_real_mpz (v)) != NULL) {
+		if (mpz_sizeinbase (z, 2) > gel_calcstate.float_prec)
+			return FALSE;
+		*d = mpz_get_d (z);
+		*isfloat = FALSE;
+	} else {
+		return FALSE;
+	}
+	return DOUBLE_OK (*d);
+}
+
+/* entries of m into a packed row major array, the float flags go into
+ * isfloat, if not NULL, otherwise all entries must be floats */
+static double *
+matrix_get_doubles (GelMatrixW *m, gboolean *isfloat)
+{
+	int i, j, w, h;
+	gsize k = 0;
+	double *a;
+
+	/* with excess precision doubles would get rounded twice */
+	if (FLT_EVAL_METHOD != 0 ||
+	    gel_calcstate.float_prec != DBL_MANT_DIG)
+		return NULL;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	a = g_new (double, (gsize)w * h);
+
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			GelETree *t = gel_matrixw_get_index (m, i, j);
+			gboolean f = FALSE;
+			if (t == NULL) {
+				a[k] = 0.0;
+			} else if (t->type != GEL_VALUE_NODE ||
+				   ! value_get_double (t->val.value,
+						       &a[k], &f)) {
+				g_free (a);
+				return NULL;
+			}
+			if (isfloat == NULL && ! f) {
+				g_free (a);
+				return NULL;
+			}
+			if (isfloat != NULL)
+				isfloat[k] = f;
+			k++;
+		}
+	}
+	return a;
+}
+
+static GelMatrixW *
+matrix_from_doubles (const double *r, int w, int h)
+{
+	GelMatrix *mat;
+	int i, j;
+	gsize k = 0;
+
+	mat = gel_matrix_new ();
+	gel_matrix_set_size (mat, w, h, FALSE /* padding */);
+	for (j = 0; j < h; j++) {
+		for (i = 0; i < w; i++) {
+			mpw_t x;
+			mpw_init (x);
+			mpw_set_d (x, r[k++]);
+			gel_matrix_index (mat, i, j) = gel_makenum_use (x);
+		}
+	}
+	return gel_matrixw_new_with_matrix_value_only_real_nonrational (mat);
+}
+
+/* the operators double_op knows */
+static gboolean
+double_op_supported (int oper)
+{
+	switch (oper) {
+	case GEL_E_PLUS:
+	case GEL_E_ELTPLUS:
+	case GEL_E_MINUS:
+	case GEL_E_ELTMINUS:
+	case GEL_E_MUL:
+	case GEL_E_ELTMUL:
+	case GEL_E_DIV:
+	case GEL_E_ELTDIV:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* r = a oper b for n entries, the loops are kept trivial so that the
+ * compiler can vectorize them.  bstride is 0 for a scalar b. */
+static gboolean
+double_op (int oper, double *r, const double *a, const double *b,
+	   int bstride, gsize n)
+{
+	gsize k;
+
+	switch (oper) {
+	case GEL_E_PLUS:
+	case GEL_E_ELTPLUS:
+		if (bstride == 0) {
+			double s = b[0];
+			for (k = 0; k < n; k++)
+				r[k] = a[k] + s;
+		} else {
+			for (k = 0; k < n; k++)
+				r[k] = a[k] + b[k];
+		}
+		break;
+	case GEL_E_MINUS:
+	case GEL_E_ELTMINUS:
+		if (bstride == 0) {
+			double s = b[0];
+			for (k = 0; k < n; k++)
+				r[k] = a[k] - s;
+		} else {
+			for (k = 0; k < n; k++)
+				r[k] = a[k] - b[k];
+		}
+		break;
+	case GEL_E_MUL:
+	case GEL_E_ELTMUL:
+		if (bstride == 0) {
+			double s = b[0];
+			for (k = 0; k < n; k++)
+				r[k] = a[k] * s;
+		} else {
+			for (k = 0; k < n; k++)
+				r[k] = a[k] * b[k];
+		}
+		break;
+	case GEL_E_DIV:
+	case GEL_E_ELTDIV:
+		if (bstride == 0) {
+			double s = b[0];
+			for (k = 0; k < n; k++)
+				r[k] = a[k] / s;
+		} else {
+			for (k = 0; k < n; k++)
+				r[k] = a[k] / b[k];
+		}
+		break;
+	default:
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Would mpw give the same as doubles for this entry?  Division by zero
+ * is an error and a zero product or quotient of nonzero numbers is an
+ * underflow. */
+static gboolean
+double_op_ok (int oper, double r, double a, double b)
+{
+	if ( ! DOUBLE_OK (r))
+		return FALSE;
+
+	switch (oper) {
+	case GEL_E_MUL:
+	case GEL_E_ELTMUL:
+		return r != 0.0 || a == 0.0 || b == 0.0;
+	case GEL_E_DIV:
+	case GEL_E_ELTDIV:
+		return b != 0.0 && (r != 0.0 || a == 0.0);
+	default:
+		return TRUE;
+	}
+}
+
+static GelMatrixW *
+finish_double_op (int oper, double *r, const double *a, const double *b,
+		  int bstride, int w, int h)
+{
+	GelMatrixW *res = NULL;
+	gsize k, n = (gsize)w * h;
+
+	if (double_op (oper, r, a, b, bstride, n)) {
+		for (k = 0; k < n; k++) {
+			if ( ! double_op_ok (oper, r[k], a[k], b[k * bstride]))
+				break;
+		}
+		if (k == n)
+			res = matrix_from_doubles (r, w, h);
+	}
+	return res;
+}
+
+/* m1 oper m2 element by element, same size matrices */
+GelMatrixW *
+gel_value_matrix_eltbyelt_double (GelMatrixW *m1, GelMatrixW *m2, int oper)
+{
+	GelMatrixW *res = NULL;
+	double *a, *b, *r;
+	gboolean *fa, *fb;
+	int w, h;
+	gsize k, n;
+
+	w = gel_matrixw_width (m1);
+	h = gel_matrixw_height (m1);
+	n = (gsize)w * h;
+	if (n == 0 || gel_calcstate.float_prec != DBL_MANT_DIG ||
+	    ! double_op_supported (oper))
+		return NULL;
+
+	fa = g_new (gboolean, n);
+	fb = g_new (gboolean, n);
+	a = matrix_get_doubles (m1, fa);
+	b = a != NULL ? matrix_get_doubles (m2, fb) : NULL;
+
+	if (b != NULL) {
+		/* with no float around the result would be exact */
+		for (k = 0; k < n; k++) {
+			if ( ! fa[k] && ! fb[k])
+				break;
+		}
+		if (k == n) {
+			r = g_new (double, n);
+			res = finish_double_op (oper, r, a, b, 1, w, h);
+			g_free (r);
+		}
+	}
+
+	g_free (a);
+	g_free (b);
+	g_free (fa);
+	g_free (fb);
+	return res;
+}
+
+/* m oper x, or x oper m if scalar_first, for a scalar x */
+GelMatrixW *
+gel_value_matrix_scalar_double (GelMatrixW *m, mpw_ptr x,
+				gboolean scalar_first, int oper)
+{
+	GelMatrixW *res = NULL;
+	double *a, *r;
+	double s;
+	gboolean sfloat;
+	int w, h;
+	gsize k, n;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	n = (gsize)w * h;
+	if (n == 0 || gel_calcstate.float_prec != DBL_MANT_DIG ||
+	    ! double_op_supported (oper))
+		return NULL;
+
+	if ( ! value_get_double (x, &s, &sfloat))
+		return NULL;
+
+	/* with a float scalar any entry goes, otherwise all must be floats */
+	if (sfloat) {
+		gboolean *fa = g_new (gboolean, n);
+		a = matrix_get_doubles (m, fa);
+		g_free (fa);
+	} else {
+		a = matrix_get_doubles (m, NULL);
+	}
+	if (a == NULL)
+		return NULL;
+
+	r = g_new (double, n);
+	if ( ! scalar_first) {
+		res = finish_double_op (oper, r, a, &s, 0, w, h);
+	} else if (oper == GEL_E_PLUS || oper == GEL_E_ELTPLUS ||
+		   oper == GEL_E_MUL || oper == GEL_E_ELTMUL) {
+		res = finish_double_op (oper, r, a, &s, 0, w, h);
+	} else {
+		/* not commutative, broadcast the scalar */
+		double *b = g_new (double, n);
+		for (k = 0; k < n; k++)
+			b[k] = s;
+		res = finish_double_op (oper, r, b, a, 1, w, h);
+		g_free (b);
+	}
+
+	g_free (a);
+	g_free (r);
+	return res;
+}
+
+/* func on every entry of a float matrix, NULL if the result would not
+ * be a matrix of normal doubles, such as sqrt of a negative number.
+ * func must be correctly rounded, like sqrt, to agree with mpfr. */
+GelMatrixW *
+gel_value_matrix_func_double (GelMatrixW *m, double (*func) (double))
+{
+	GelMatrixW *res = NULL;
+	double *a, *r;
+	int w, h;
+	gsize k, n;
+
+	w = gel_matrixw_width (m);
+	h = gel_matrixw_height (m);
+	n = (gsize)w * h;
+	if (n == 0 ||
+	    (a = matrix_get_doubles (m, NULL)) == NULL)
+		return NULL;
+
+	r = g_new (double, n);
+	for (k = 0; k < n; k++)
+		r[k] = (*func) (a[k]);
+	for (k = 0; k < n; k++) {
+		/* zero for a nonzero argument is an underflow */
+		if ( ! DOUBLE_OK (r[k]) ||
+		    (r[k] == 0.0 && a[k] != 0.0))
+			break;
+	}
+	if (k == n)
+		res = matrix_from_doubles (r, w, h);
+
+	g_free (a);
+	g_free (r);
+	return res;
+}
@@ -36,7 +36,21 @@ gboolean gel_is_matrix_value_only_rational (GelMatrixW *m);
 gboolean gel_is_matrix_value_only_integer (GelMatrixW *m);
 void gel_matrix_conjugate_transpose (GelMatrixW *m);
 void gel_value_matrix_multiply (GelMatrixW *res, GelMatrixW *m1, GelMatrixW *m2, mpw_ptr modulo);
+/* res = m^power for an integer square matrix m, power >= 1, modulo a
+ * positive integer, res should be a new matrix */
+void gel_value_matrix_pow_mod (GelMatrixW *res, GelMatrixW *m,
+			       unsigned long power, mpw_ptr modulo);
 gboolean gel_value_matrix_det (GelCtx *ctx, mpw_t rop, GelMatrixW *m);
+/* Elementwise operations on float matrices in doubles, oper is one of
+ * the GEL_E_ arithmetic operators.  These return a new matrix, or NULL
+ * if the float precision or the entries are such that doubles would not
+ * give the same answer, in which case the generic code should be used. */
+GelMatrixW *gel_value_matrix_eltbyelt_double (GelMatrixW *m1, GelMatrixW *m2,
+					      int oper);
+GelMatrixW *gel_value_matrix_scalar_double (GelMatrixW *m, mpw_ptr x,
+					    gboolean scalar_first, int oper);
+GelMatrixW *gel_value_matrix_func_double (GelMatrixW *m,
+					  double (*func) (double));
 /*NOTE: if simul is passed then we assume that it's the same size as m*/
 /* return FALSE if singular */
 gboolean gel_value_matrix_gauss (GelCtx *ctx,
@@ -284,6 +284,8 @@ make_us_a_copy (GelMatrixW *m, int neww, int newh)
 
 	if (m->m->use == 1)
 		return;
+
+	gel_eval_stats.matrix_copies++;
 	
 	old = m->m;
 	
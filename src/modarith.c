@@ -0,0 +1,315 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <limits.h>
+#include <string.h>
+
+#include "modarith.h"
+
+#if defined(__SIZEOF_INT128__) && ULONG_MAX >= 0xffffffffffffffffUL
+#define MOD_WORD 1
+typedef unsigned __int128 mod_u128;
+#endif
+
+struct _GelModCtx {
+	mpz_t m;
+	gboolean word;		/* 2 < m < 2^63 and native words are used */
+	gboolean montgomery;	/* m is odd, word elements are x*2^64 mod m */
+	guint64 wm;		/* m as a word */
+	guint64 nminv;		/* -m^-1 mod 2^64 */
+	guint64 r2;		/* 2^128 mod m */
+};
+
+static GelModCtx modctx_cache;
+static gboolean modctx_cache_valid = FALSE;
+
+const GelModCtx *
+gel_modctx_get (mpz_srcptr m)
+{
+	GelModCtx *mc = &modctx_cache;
+
+	if (modctx_cache_valid && mpz_cmp (mc->m, m) == 0)
+		return mc;
+
+	if ( ! modctx_cache_valid)
+		mpz_init (mc->m);
+	mpz_set (mc->m, m);
+	modctx_cache_valid = TRUE;
+
+	mc->word = FALSE;
+	mc->montgomery = FALSE;
+#ifdef MOD_WORD
+	if (mpz_cmp_ui (m, 2) > 0 &&
+	    mpz_sizeinbase (m, 2) <= 63) {
+		guint64 r;
+		mc->word = TRUE;
+		mc->wm = mpz_get_ui (m);
+		/* 2^64 mod m and 2^128 mod m */
+		r = (0 - mc->wm) % mc->wm;
+		mc->r2 = (guint64)(((mod_u128)r * r) % mc->wm);
+		if (mc->wm & 1) {
+			guint64 inv = mc->wm;
+			int i;
+			/* Newton, each step doubles the correct bits,
+			 * m is its own inverse mod 8 */
+			for (i = 0; i < 5; i++)
+				inv *= 2 - mc->wm * inv;
+			mc->nminv = 0 - inv;
+			mc->montgomery = TRUE;
+		}
+	}
+#endif
+	return mc;
+}
+
+#ifdef MOD_WORD
+
+/* t*2^-64 mod m for t < m*2^64 */
+static inline guint64
+redc (const GelModCtx *mc, mod_u128 t)
+{
+	guint64 u = (guint64)t * mc->nminv;
+	/* m < 2^63 so this does not overflow */
+	guint64 r = (guint64)((t + (mod_u128)u * mc->wm) >> 64);
+	return r >= mc->wm ? r - mc->wm : r;
+}
+
+static inline guint64
+mulmod (const GelModCtx *mc, guint64 a, guint64 b)
+{
+	if (mc->montgomery)
+		return redc (mc, (mod_u128)a * b);
+	else
+		return (guint64)(((mod_u128)a * b) % mc->wm);
+}
+
+static inline guint64
+addmod (const GelModCtx *mc, guint64 a, guint64 b)
+{
+	guint64 s = a + b;
+	return s >= mc->wm ? s - mc->wm : s;
+}
+
+static inline guint64
+word_in (const GelModCtx *mc, mpz_srcptr x)
+{
+	guint64 w = mpz_fdiv_ui (x, mc->wm);
+	if (mc->montgomery)
+		return redc (mc, (mod_u128)w * mc->r2);
+	else
+		return w;
+}
+
+static inline void
+word_out (const GelModCtx *mc, mpz_ptr rop, guint64 w)
+{
+	if (mc->montgomery)
+		w = redc (mc, w);
+	mpz_set_ui (rop, w);
+}
+
+static void
+word_matrix_mul (const GelModCtx *mc, guint64 *c, const guint64 *a,
+		 const guint64 *b, int h, int n, int w)
+{
+	int i, j, k;
+
+	memset (c, 0, sizeof (guint64) * h * w);
+	for (i = 0; i < h; i++) {
+		guint64 *ci = c + (gsize)i*w;
+		for (k = 0; k < n; k++) {
+			guint64 aik = a[(gsize)i*n + k];
+			const guint64 *bk = b + (gsize)k*w;
+			if (aik == 0)
+				continue;
+			for (j = 0; j < w; j++)
+				ci[j] = addmod (mc, ci[j],
+						mulmod (mc, aik, bk[j]));
+		}
+	}
+}
+
+#endif /* MOD_WORD */
+
+void
+gel_mod_powm (mpz_ptr rop, mpz_srcptr b, mpz_srcptr e, mpz_srcptr m)
+{
+#ifdef MOD_WORD
+	const GelModCtx *mc = gel_modctx_get (m);
+
+	if (mc->word && mpz_sgn (e) >= 0) {
+		guint64 x = word_in (mc, b);
+		/* one in the representation */
+		guint64 r = mc->montgomery ? redc (mc, mc->r2) : 1;
+		long i;
+
+		for (i = (long)mpz_sizeinbase (e, 2) - 1; i >= 0; i--) {
+			r = mulmod (mc, r, r);
+			if (mpz_tstbit (e, i))
+				r = mulmod (mc, r, x);
+		}
+		word_out (mc, rop, r);
+		return;
+	}
+#endif
+	mpz_powm (rop, b, e, m);
+}
+
+/* c = ab mod m with mpz, reduced once per entry */
+static void
+mpz_matrix_mul (mpz_srcptr m, mpz_t *c, mpz_t *a, mpz_t *b,
+		int h, int n, int w)
+{
+	int i, j, k;
+
+	for (i = 0; i < h; i++) {
+		for (j = 0; j < w; j++) {
+			mpz_ptr cij = c[(gsize)i*w + j];
+			mpz_set_ui (cij, 0);
+			for (k = 0; k < n; k++)
+				mpz_addmul (cij, a[(gsize)i*n + k],
+					    b[(gsize)k*w + j]);
+			mpz_fdiv_r (cij, cij, m);
+		}
+	}
+}
+
+void
+gel_mod_matrix_mul (const GelModCtx *mc, mpz_t *c, mpz_t *a, mpz_t *b,
+		    int h, int n, int w)
+{
+#ifdef MOD_WORD
+	if (mc->word) {
+		guint64 *wa = g_new (guint64, (gsize)h*n);
+		guint64 *wb = g_new (guint64, (gsize)n*w);
+		guint64 *wc = g_new (guint64, (gsize)h*w);
+		gsize i;
+
+		for (i = 0; i < (gsize)h*n; i++)
+			wa[i] = word_in (mc, a[i]);
+		for (i = 0; i < (gsize)n*w; i++)
+			wb[i] = word_in (mc, b[i]);
+		word_matrix_mul (mc, wc, wa, wb, h, n, w);
+		for (i = 0; i < (gsize)h*w; i++)
+			word_out (mc, c[i], wc[i]);
+
+		g_free (wa);
+		g_free (wb);
+		g_free (wc);
+		return;
+	}
+#endif
+	mpz_matrix_mul (mc->m, c, a, b, h, n, w);
+}
+
+void
+gel_mod_matrix_pow (const GelModCtx *mc, mpz_t *res, mpz_t *a, int n,
+		    unsigned long e)
+{
+	gsize i, nn = (gsize)n*n;
+
+	g_return_if_fail (e >= 1);
+
+#ifdef MOD_WORD
+	if (mc->word) {
+		guint64 *x = g_new (guint64, nn);
+		guint64 *r = g_new (guint64, nn);
+		guint64 *t = g_new (guint64, nn);
+		guint64 *sw;
+		gboolean have_r = FALSE;
+
+		for (i = 0; i < nn; i++)
+			x[i] = word_in (mc, a[i]);
+
+		/* right to left binary powering */
+		for (;;) {
+			if (e & 1) {
+				if (have_r) {
+					word_matrix_mul (mc, t, r, x, n, n, n);
+					sw = r; r = t; t = sw;
+				} else {
+					memcpy (r, x, sizeof (guint64) * nn);
+					have_r = TRUE;
+				}
+			}
+			e >>= 1;
+			if (e == 0)
+				break;
+			word_matrix_mul (mc, t, x, x, n, n, n);
+			sw = x; x = t; t = sw;
+		}
+
+		for (i = 0; i < nn; i++)
+			word_out (mc, res[i], r[i]);
+
+		g_free (x);
+		g_free (r);
+		g_free (t);
+		return;
+	}
+#endif
+	{
+		mpz_t *x = g_new (mpz_t, nn);
+		mpz_t *t = g_new (mpz_t, nn);
+		mpz_t *r = g_new (mpz_t, nn);
+		mpz_t *sw;
+		gboolean have_r = FALSE;
+
+		for (i = 0; i < nn; i++) {
+			mpz_init (x[i]);
+			mpz_init (t[i]);
+			mpz_init (r[i]);
+			mpz_fdiv_r (x[i], a[i], mc->m);
+		}
+
+		for (;;) {
+			if (e & 1) {
+				if (have_r) {
+					mpz_matrix_mul (mc->m, t, r, x,
+							n, n, n);
+					sw = r; r = t; t = sw;
+				} else {
+					for (i = 0; i < nn; i++)
+						mpz_set (r[i], x[i]);
+					have_r = TRUE;
+				}
+			}
+			e >>= 1;
+			if (e == 0)
+				break;
+			mpz_matrix_mul (mc->m, t, x, x, n, n, n);
+			sw = x; x = t; t = sw;
+		}
+
+		for (i = 0; i < nn; i++) {
+			mpz_set (res[i], r[i]);
+			mpz_clear (x[i]);
+			mpz_clear (t[i]);
+			mpz_clear (r[i]);
+		}
+		g_free (x);
+		g_free (t);
+		g_free (r);
+	}
+}
@@ -0,0 +1,71 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MODARITH_H_
+#define _MODARITH_H_
+
+#include <glib.h>
+#ifdef HAVE_GMP2_INCLUDE_DIR
+#include <gmp2/gmp.h>
+#else
+#include <gmp.h>
+#endif
+
+/* Integer arithmetic modulo m for the modulo mode of the evaluator.  A
+ * modulus context is computed once per modulus (the last one is
+ * cached).  Odd moduli below 2^63 are done natively in 64 bit words in
+ * Montgomery form (multiplication by REDC, so there are no divisions),
+ * even ones below 2^63 by 128 bit remainders.  Larger moduli use mpz
+ * with the reduction done once per dot product instead of once per
+ * term.  Inputs are any integers, outputs are in [0,m). */
+
+typedef struct _GelModCtx GelModCtx;
+
+/* The context for the modulus m > 0, owned by the cache, valid until
+ * the next call with a different modulus */
+const GelModCtx * gel_modctx_get	(mpz_srcptr m);
+
+/* rop = b^e mod m for e >= 0 */
+void		gel_mod_powm		(mpz_ptr rop,
+					 mpz_srcptr b,
+					 mpz_srcptr e,
+					 mpz_srcptr m);
+
+/* c = ab mod m for a h by n matrix a and n by w matrix b, all stored
+ * rowwise, c should be initialized and not overlap a or b */
+void		gel_mod_matrix_mul	(const GelModCtx *mc,
+					 mpz_t *c,
+					 mpz_t *a,
+					 mpz_t *b,
+					 int h,
+					 int n,
+					 int w);
+
+/* res = a^e mod m for an n by n matrix a stored rowwise, e >= 1, res
+ * should be initialized and not overlap a.  In the word case everything
+ * stays in Montgomery form until the end. */
+void		gel_mod_matrix_pow	(const GelModCtx *mc,
+					 mpz_t *res,
+					 mpz_t *a,
+					 int n,
+					 unsigned long e);
+
+#endif /* _MODARITH_H_ */
@@ -33,6 +33,7 @@
 #include "util.h"
 
 #include "mpwrap.h"
+#include "modarith.h"
 
 /* for backward compat */
 #ifndef G_MAXINT32
@@ -59,59 +60,68 @@ MpwRealNum *gel_one = NULL;
 
 static int default_mpfr_prec = 0;
 
+GEL_THREAD_LOCAL MpwStats mpw_stats = { 0 };
+
+/* The free lists are per thread so that worker threads need no locking */
 #define FREE_LIST_SIZE 1125
-static __mpz_struct free_mpz[FREE_LIST_SIZE];
-static __mpz_struct *free_mpz_top = free_mpz;
-static __mpq_struct free_mpq[FREE_LIST_SIZE];
-static __mpq_struct *free_mpq_top = free_mpq;
-static __mpfr_struct free_mpfr[FREE_LIST_SIZE];
-static __mpfr_struct *free_mpfr_top = free_mpfr;
+static GEL_THREAD_LOCAL __mpz_struct free_mpz[FREE_LIST_SIZE];
+static GEL_THREAD_LOCAL int free_mpz_n = 0;
+static GEL_THREAD_LOCAL __mpq_struct free_mpq[FREE_LIST_SIZE];
+static GEL_THREAD_LOCAL int free_mpq_n = 0;
+static GEL_THREAD_LOCAL __mpfr_struct free_mpfr[FREE_LIST_SIZE];
+static GEL_THREAD_LOCAL int free_mpfr_n = 0;
 
 #define GET_INIT_MPZ(THE_z)				\
-	if (free_mpz_top == free_mpz) {			\
+	if (free_mpz_n == 0) {			\
 		mpz_init (THE_z);			\
+		mpw_stats.mpz_misses++;		\
 	} else {					\
-		free_mpz_top--;				\
-		memcpy (THE_z, free_mpz_top, sizeof (__mpz_struct));	\
+		mpw_stats.mpz_hits++;		\
+		free_mpz_n--;				\
+		memcpy (THE_z, &free_mpz[free_mpz_n], sizeof (__mpz_struct));	\
 	}
 #define CLEAR_FREE_MPZ(THE_z)				\
-	if (free_mpz_top == &free_mpz[FREE_LIST_SIZE-1] || \
+	if (free_mpz_n == FREE_LIST_SIZE-1 || \
 	    mpz_size (THE_z) > 2) {			\
 		mpz_clear (THE_z);			\
 	} else {					\
-		memcpy (free_mpz_top, THE_z, sizeof (__mpz_struct));	\
-		free_mpz_top++;				\
+		memcpy (&free_mpz[free_mpz_n], THE_z, sizeof (__mpz_struct));	\
+		free_mpz_n++;				\
 	}
 #define GET_INIT_MPQ(THE_q)				\
-	if (free_mpq_top == free_mpq) {			\
+	if (free_mpq_n == 0) {			\
 		mpq_init (THE_q);			\
+		mpw_stats.mpq_misses++;		\
 	} else {					\
-		free_mpq_top--;				\
-		memcpy (THE_q, free_mpq_top, sizeof (__mpq_struct));	\
+		mpw_stats.mpq_hits++;		\
+		free_mpq_n--;				\
+		memcpy (THE_q, &free_mpq[free_mpq_n], sizeof (__mpq_struct));	\
 	}
 #define CLEAR_FREE_MPQ(THE_q)				\
-	if (free_mpq_top == &free_mpq[FREE_LIST_SIZE-1] || \
+	if (free_mpq_n == FREE_LIST_SIZE-1 || \
 	    mpz_size (mpq_denref (THE_q)) > 2 ||	\
 	    mpz_size (mpq_numref (THE_q)) > 2) {	\
 		mpq_clear (THE_q);			\
 	} else {					\
-		memcpy (free_mpq_top, THE_q, sizeof (__mpq_struct));	\
-		free_mpq_top++;				\
+		memcpy (&free_mpq[free_mpq_n], THE_q, sizeof (__mpq_struct));	\
+		free_mpq_n++;				\
 	}
 #define GET_INIT_MPF(THE_f)				\
-	if (free_mpfr_top == free_mpfr) {		\
+	if (free_mpfr_n == 0) {		\
 		mpfr_init (THE_f);			\
+		mpw_stats.mpf_misses++;		\
 	} else {					\
-		free_mpfr_top--;			\
-		memcpy (THE_f, free_mpfr_top, sizeof (__mpfr_struct));	\
+		mpw_stats.mpf_hits++;		\
+		free_mpfr_n--;			\
+		memcpy (THE_f, &free_mpfr[free_mpfr_n], sizeof (__mpfr_struct));	\
 	}
 #define CLEAR_FREE_MPF(THE_f)				\
-	if (free_mpfr_top == &free_mpfr[FREE_LIST_SIZE-1] || \
+	if (free_mpfr_n == FREE_LIST_SIZE-1 || \
 	    mpfr_get_prec (THE_f) != default_mpfr_prec) { \
 		mpfr_clear (THE_f);			\
 	} else {					\
-		memcpy (free_mpfr_top, THE_f, sizeof (__mpfr_struct));	\
-		free_mpfr_top++;			\
+		memcpy (&free_mpfr[free_mpfr_n], THE_f, sizeof (__mpfr_struct));	\
+		free_mpfr_n++;			\
 	}
 
 #define MAKE_CPLX_OPS(THE_op,THE_r,THE_i) {		\
@@ -136,13 +146,22 @@ static __mpfr_struct *free_mpfr_top = free_mpfr;
 
 #ifdef MEM_DEBUG_FRIENDLY
 # define GET_NEW_REAL(n) (n = g_new0 (MpwRealNum, 1));
+
+void
+mpw_spill_free_reals (void)
+{
+}
 #else
 
 /* In tests it seems that this achieves better then 4096 */
 #define GEL_CHUNK_SIZE 4048
 #define ALIGNED_SIZE(t) (sizeof(t) + sizeof (t) % G_MEM_ALIGN)
 
-static MpwRealNum *free_reals = NULL;
+static GEL_THREAD_LOCAL MpwRealNum *free_reals = NULL;
+
+/* free lists given back by threads, see gel_spill_free_trees */
+static GSList *spill_reals = NULL;
+static GMutex spill_reals_lock;
 
 static void
 _gel_make_free_reals (void)
@@ -150,6 +169,21 @@ _gel_make_free_reals (void)
 	guint i;
 	char *p;
 
+	if (g_atomic_pointer_get (&spill_reals) != NULL) {
+		g_mutex_lock (&spill_reals_lock);
+		if (spill_reals != NULL) {
+			free_reals = spill_reals->data;
+			spill_reals = g_slist_delete_link (spill_reals,
+							   spill_reals);
+		}
+		g_mutex_unlock (&spill_reals_lock);
+
+		if (free_reals != NULL)
+			return;
+	}
+
+	mpw_stats.real_chunks++;
+
 	p = g_malloc ((GEL_CHUNK_SIZE / ALIGNED_SIZE (MpwRealNum)) *
 		      ALIGNED_SIZE (MpwRealNum));
 	for (i = 0; i < (GEL_CHUNK_SIZE / ALIGNED_SIZE (MpwRealNum)); i++) {
@@ -163,11 +197,26 @@ _gel_make_free_reals (void)
 #define GET_NEW_REAL(n) {				\
 	if G_UNLIKELY (free_reals == NULL) {		\
 		_gel_make_free_reals ();		\
+	} else {					\
+		mpw_stats.real_hits++;			\
 	}						\
 	(n) = free_reals;				\
     	free_reals = free_reals->alloc.next;		\
 }
 
+void
+mpw_spill_free_reals (void)
+{
+	if (free_reals == NULL)
+		return;
+
+	g_mutex_lock (&spill_reals_lock);
+	spill_reals = g_slist_prepend (spill_reals, free_reals);
+	g_mutex_unlock (&spill_reals_lock);
+
+	free_reals = NULL;
+}
+
 #endif
 
 #define MAKE_COPY(n) {					\
@@ -177,7 +226,8 @@ _gel_make_free_reals (void)
 		m->alloc.usage = 1;			\
 		mpwl_init_type(m,(n)->type);		\
 		mpwl_set(m,(n));			\
-		(n)->alloc.usage --;			\
+		if ( ! MPWL_IS_CONST (n))		\
+			(n)->alloc.usage --;		\
 		(n) = m;				\
 	}						\
 }
@@ -187,34 +237,29 @@ _gel_make_free_reals (void)
 		GET_NEW_REAL(m);			\
 		m->alloc.usage = 1;			\
 		mpwl_init_type(m,type);			\
-		(n)->alloc.usage --;			\
+		if ( ! MPWL_IS_CONST (n))		\
+			(n)->alloc.usage --;		\
 		(n) = m;				\
 	}						\
 }
 #define DEALLOC_MPWL(n) {				\
+	if ( ! MPWL_IS_CONST (n)) {			\
 		(n)->alloc.usage--;			\
 		if((n)->alloc.usage==0)			\
 			mpwl_free((n));			\
+	}						\
 }
-#define ALLOC_MPWL(n) {					\
-		(n)->alloc.usage++;			\
-}
+#define ALLOC_MPWL(n) MPWL_REF(n)
 #define MAKE_REAL(n) {					\
 		if((n)->i != gel_zero) {		\
-			(n)->i->alloc.usage--;		\
-			if((n)->i->alloc.usage==0)	\
-				mpwl_free((n)->i);	\
+			DEALLOC_MPWL ((n)->i);		\
 			(n)->i = gel_zero;		\
-			gel_zero->alloc.usage++;	\
 		}					\
 }
 #define MAKE_IMAG(n) {					\
 	if((n)->r != gel_zero) {			\
-		(n)->r->alloc.usage--;			\
-		if((n)->r->alloc.usage==0)		\
-			mpwl_free((n)->r);		\
+		DEALLOC_MPWL ((n)->r);			\
 		(n)->r = gel_zero;			\
-		gel_zero->alloc.usage++;		\
 	}						\
 }
 
@@ -2146,16 +2191,16 @@ mpwl_powm (MpwRealNum *rop,
 	switch(op2->type) {
 	case MPW_INTEGER:
 		if (sgn2 > 0) {
-			mpz_powm (r.data.ival,
-				  op1->data.ival,
-				  op2->data.ival,
-				  mod->data.ival);
+			gel_mod_powm (r.data.ival,
+				      op1->data.ival,
+				      op2->data.ival,
+				      mod->data.ival);
 		} else {
 			mpz_neg (op2->data.ival, op2->data.ival);
-			mpz_powm (r.data.ival,
-				  op1->data.ival,
-				  op2->data.ival,
-				  mod->data.ival);
+			gel_mod_powm (r.data.ival,
+				      op1->data.ival,
+				      op2->data.ival,
+				      mod->data.ival);
 			mpz_neg (op2->data.ival, op2->data.ival);
 			if G_UNLIKELY ( ! mpz_invert (r.data.ival,
 						      r.data.ival,
@@ -2439,8 +2484,8 @@ mpwl_catalan_constant (MpwRealNum *rop)
 
 /* Random state stuff: FIXME: this is evil */
 /* static unsigned long randstate_seed = 0; */
-static gmp_randstate_t rand_state;
-static gboolean rand_state_inited = FALSE;
+static GEL_THREAD_LOCAL gmp_randstate_t rand_state;
+static GEL_THREAD_LOCAL gboolean rand_state_inited = FALSE;
 
 static inline void
 init_randstate (void)
@@ -3236,11 +3281,8 @@ mpwl_getstring(MpwRealNum * num, int max_digits,
 {								\
 	if ((rop)->i != gel_zero &&				\
 	    mpwl_zero_p ((rop)->i)) {				\
-		(rop)->i->alloc.usage--;			\
-		if ((rop)->i->alloc.usage==0)			\
-			mpwl_free ((rop)->i);			\
+		DEALLOC_MPWL ((rop)->i);			\
 		(rop)->i = gel_zero;				\
-		gel_zero->alloc.usage ++;			\
 	}							\
 }
 
@@ -3249,20 +3291,33 @@ mpwl_getstring(MpwRealNum * num, int max_digits,
 /*************************************************************************/
 
 /*set default precision*/
+static void
+whack_mpf_cache (void)
+{
+	int i;
+
+	for (i = 0; i < free_mpfr_n; i++) {
+		mpfr_clear (&free_mpfr[i]);
+	}
+	free_mpfr_n = 0;
+}
+
 void
 mpw_set_default_prec (unsigned long int prec)
 {
-	__mpfr_struct *p;
-
 	mpfr_set_default_prec (prec);
+	whack_mpf_cache ();
+	default_mpfr_prec = prec;
+}
 
-	/* whack the mpf cache */
-	for (p = free_mpfr; p != free_mpfr_top; p++) {
-		mpfr_clear (p);
+/* The mpfr default precision is per thread */
+void
+mpw_thread_sync_prec (void)
+{
+	if (mpfr_get_default_prec () != default_mpfr_prec) {
+		mpfr_set_default_prec (default_mpfr_prec);
+		whack_mpf_cache ();
 	}
-	free_mpfr_top = free_mpfr;
-
-	default_mpfr_prec = prec;
 }
 
 /*initialize a number*/
@@ -3278,24 +3333,43 @@ void
 mpw_init_set(mpw_ptr rop, mpw_ptr op)
 {
 	rop->r = op->r;
-	rop->r->alloc.usage++;
+	ALLOC_MPWL (rop->r);
 	rop->i = op->i;
-	rop->i->alloc.usage++;
+	ALLOC_MPWL (rop->i);
 	mpw_uncomplex (rop);
 }
 
 #undef mpw_init_set_no_uncomplex
 
+static MpwRealNum *
+mpwl_new_copy (MpwRealNum *op)
+{
+	MpwRealNum *m;
+
+	if (MPWL_IS_CONST (op))
+		return op;
+
+	GET_NEW_REAL (m);
+	m->alloc.usage = 1;
+	mpwl_init_type (m, op->type);
+	mpwl_set (m, op);
+	return m;
+}
+
+void
+mpw_init_set_unshared (mpw_ptr rop, mpw_ptr op)
+{
+	rop->r = mpwl_new_copy (op->r);
+	rop->i = mpwl_new_copy (op->i);
+	mpw_uncomplex (rop);
+}
+
 /*clear memory held by number*/
 void
 mpw_clear(mpw_ptr op)
 {
-	op->r->alloc.usage--;
-	op->i->alloc.usage--;
-	if(op->r->alloc.usage==0)
-		mpwl_free (op->r);
-	if(op->i->alloc.usage==0)
-		mpwl_free (op->i);
+	DEALLOC_MPWL (op->r);
+	DEALLOC_MPWL (op->i);
 }
 
 /*make them the same type without loosing information*/
@@ -3324,9 +3398,9 @@ mpw_set(mpw_ptr rop,mpw_ptr op)
 	mpw_clear (rop);
 
 	rop->r = op->r;
-	rop->r->alloc.usage++;
+	ALLOC_MPWL (rop->r);
 	rop->i = op->i;
-	rop->i->alloc.usage++;
+	ALLOC_MPWL (rop->i);
 	/* it shouldn't need uncomplexing*/
 	/* mpw_uncomplex(rop); */
 }
@@ -3360,19 +3434,13 @@ mpw_set_si(mpw_ptr rop,signed long int i)
 	MAKE_REAL(rop);
 	if(i==0) {
 		if(rop->r != gel_zero) {
-			rop->r->alloc.usage--;
-			if(rop->r->alloc.usage==0)
-				mpwl_free (rop->r);
+			DEALLOC_MPWL (rop->r);
 			rop->r = gel_zero;
-			gel_zero->alloc.usage++;
 		}
 	} else if(i==1) {
 		if(rop->r != gel_one) {
-			rop->r->alloc.usage--;
-			if(rop->r->alloc.usage==0)
-				mpwl_free (rop->r);
+			DEALLOC_MPWL (rop->r);
 			rop->r = gel_one;
-			gel_one->alloc.usage++;
 		}
 	} else {
 		MAKE_EMPTY(rop->r, MPW_INTEGER);
@@ -3386,19 +3454,13 @@ mpw_set_ui(mpw_ptr rop,unsigned long int i)
 	MAKE_REAL(rop);
 	if(i==0) {
 		if(rop->r != gel_zero) {
-			rop->r->alloc.usage--;
-			if(rop->r->alloc.usage==0)
-				mpwl_free (rop->r);
+			DEALLOC_MPWL (rop->r);
 			rop->r = gel_zero;
-			gel_zero->alloc.usage++;
 		}
 	} else if(i==1) {
 		if(rop->r != gel_one) {
-			rop->r->alloc.usage--;
-			if(rop->r->alloc.usage==0)
-				mpwl_free (rop->r);
+			DEALLOC_MPWL (rop->r);
 			rop->r = gel_one;
-			gel_one->alloc.usage++;
 		}
 	} else {
 		MAKE_EMPTY(rop->r, MPW_INTEGER);
@@ -3410,9 +3472,7 @@ void
 mpw_set_mpz_use (mpw_ptr rop, mpz_ptr op)
 {
 	MAKE_REAL(rop);
-	rop->r->alloc.usage--;
-	if(rop->r->alloc.usage==0)
-		mpwl_free(rop->r);
+	DEALLOC_MPWL (rop->r);
 	GET_NEW_REAL (rop->r);
 	rop->r->type = MPW_INTEGER;
 	rop->r->alloc.usage = 1;
@@ -3423,9 +3483,7 @@ void
 mpw_set_mpq_use (mpw_ptr rop, mpq_ptr op)
 {
 	MAKE_REAL(rop);
-	rop->r->alloc.usage--;
-	if(rop->r->alloc.usage==0)
-		mpwl_free(rop->r);
+	DEALLOC_MPWL (rop->r);
 	GET_NEW_REAL (rop->r);
 	rop->r->type = MPW_RATIONAL;
 	rop->r->alloc.usage = 1;
@@ -3436,9 +3494,7 @@ void
 mpw_set_mpf_use (mpw_ptr rop, mpfr_ptr op)
 {
 	MAKE_REAL(rop);
-	rop->r->alloc.usage--;
-	if(rop->r->alloc.usage==0)
-		mpwl_free(rop->r);
+	DEALLOC_MPWL (rop->r);
 	GET_NEW_REAL (rop->r);
 	rop->r->type = MPW_FLOAT;
 	rop->r->alloc.usage = 1;
@@ -4983,9 +5039,7 @@ mpw_i (mpw_ptr rop)
 	mpw_clear (rop);
 
 	rop->r = gel_zero;
-	gel_zero->alloc.usage++;
 	rop->i = gel_one;
-	gel_one->alloc.usage++;
 }
 
 void
@@ -5096,6 +5150,53 @@ mpw_symbolic_eql(mpw_ptr op1, mpw_ptr op2)
 		return FALSE;
 }
 
+static guint
+mpz_symbolic_hash (mpz_ptr z)
+{
+	size_t i, n = mpz_size (z);
+	guint h = mpz_sgn (z) + 1;
+
+	for (i = 0; i < n; i++) {
+		mp_limb_t l = mpz_getlimbn (z, i);
+		h = h * 1000003 ^ (guint)l;
+		if (sizeof (mp_limb_t) > sizeof (guint))
+			h = h * 1000003 ^ (guint)(l >> (8 * sizeof (guint)));
+	}
+	return h;
+}
+
+static guint
+mpwl_symbolic_hash (MpwRealNum *op)
+{
+	double d;
+
+	switch (op->type) {
+	case MPW_INTEGER:
+		return mpz_symbolic_hash (op->data.ival);
+	case MPW_RATIONAL:
+		return mpz_symbolic_hash (mpq_numref (op->data.rval)) * 31 +
+			mpz_symbolic_hash (mpq_denref (op->data.rval));
+	case MPW_FLOAT:
+		/* equal floats of any precision round to the same double,
+		 * and 0.0 and -0.0 are equal */
+		if (mpfr_zero_p (op->data.fval))
+			return 0x9e3779b9;
+		d = mpfr_get_d (op->data.fval, GMP_RNDN);
+		return g_double_hash (&d);
+	default:
+		return 0;
+	}
+}
+
+guint
+mpw_symbolic_hash (mpw_ptr op)
+{
+	guint h = mpwl_symbolic_hash (op->r) ^ (op->r->type << 29);
+	if (MPW_IS_COMPLEX (op))
+		h = h * 31 + (mpwl_symbolic_hash (op->i) ^ (op->i->type << 29));
+	return h;
+}
+
 gboolean 
 mpw_eql_ui(mpw_ptr op, unsigned long int i)
 {
@@ -5204,11 +5305,12 @@ mpw_init_mp(void)
 	GET_NEW_REAL(gel_zero);
 	mpwl_init_type(gel_zero,MPW_INTEGER);
 	mpwl_set_ui(gel_zero,0);
-	gel_zero->alloc.usage = 1;
+	/* never 1, so the constants are never changed in place */
+	gel_zero->alloc.usage = 2;
 	GET_NEW_REAL(gel_one);
 	mpwl_init_type(gel_one,MPW_INTEGER);
 	mpwl_set_ui(gel_one,1);
-	gel_one->alloc.usage = 1;
+	gel_one->alloc.usage = 2;
 	done = TRUE;
 }
 
@@ -70,9 +70,36 @@ struct _mpw_t {
 extern MpwRealNum *gel_zero;
 extern MpwRealNum *gel_one;
 
+/* gel_zero and gel_one are shared by all threads, so their reference
+ * counts are never touched, they are never freed nor changed in place */
+#define MPWL_IS_CONST(n) ((n) == gel_zero || (n) == gel_one)
+#define MPWL_REF(n) { if ( ! MPWL_IS_CONST (n)) (n)->alloc.usage++; }
+
+/* Storage private to each thread, the free lists and such */
+#if defined(__GNUC__) || defined(__clang__)
+#define GEL_THREAD_LOCAL __thread
+#define GEL_HAVE_THREAD_LOCAL 1
+#else
+#define GEL_THREAD_LOCAL
+#endif
+
 typedef struct _mpw_t mpw_t[1];
 typedef struct _mpw_t *mpw_ptr;
 
+/* Allocation counters for the free lists, see EvalStats */
+typedef struct {
+	unsigned long real_hits;	/* MpwRealNum taken off free_reals */
+	unsigned long real_chunks;	/* chunks allocated to refill free_reals */
+	unsigned long mpz_hits;
+	unsigned long mpz_misses;
+	unsigned long mpq_hits;
+	unsigned long mpq_misses;
+	unsigned long mpf_hits;
+	unsigned long mpf_misses;
+} MpwStats;
+
+extern GEL_THREAD_LOCAL MpwStats mpw_stats;
+
 /* FIXME: this is evil, error_num is used elsewhere, should
  * be some more generalized error interface */
 enum {
@@ -97,18 +124,27 @@ static inline void
 mpw_init_inline (mpw_ptr op)
 {
 	op->r = gel_zero;
-	gel_zero->alloc.usage++;
 	op->i = gel_zero;
-	gel_zero->alloc.usage++;
 }
 #define mpw_init(op) mpw_init_inline(op)
 
 /* don't try to decomplexify the number */
 #define mpw_init_set_no_uncomplex(rop,op) \
 {	(rop)->r = (op)->r; \
-	(rop)->r->alloc.usage++; \
+	MPWL_REF ((rop)->r); \
 	(rop)->i = (op)->i; \
-	(rop)->i->alloc.usage++; }
+	MPWL_REF ((rop)->i); }
+
+/* like mpw_init_set, but shares no storage with op, so that rop can
+ * be handed to another thread */
+void mpw_init_set_unshared (mpw_ptr rop, mpw_ptr op);
+
+/* make the calling thread use the current default precision, for
+ * threads other than the main one */
+void mpw_thread_sync_prec (void);
+
+/* give the free reals of the calling thread to the other threads */
+void mpw_spill_free_reals (void);
 
 
 /*clear memory held by number*/
@@ -252,6 +288,8 @@ gboolean mpw_eql(mpw_ptr op1, mpw_ptr op2);
 
 /* must also be of same type! */
 gboolean mpw_symbolic_eql(mpw_ptr op1, mpw_ptr op2);
+/* hash such that mpw_symbolic_eql numbers hash the same */
+guint mpw_symbolic_hash(mpw_ptr op);
 
 gboolean mpw_eql_ui(mpw_ptr op, unsigned long int i);
 
@@ -189,8 +189,6 @@ gboolean
 mympz_is_prime (mpz_srcptr n, int miller_rabin_reps)
 {
 	int ret;
-	static mpz_t test;
-	static gboolean inited_test = FALSE; 
 	int sgn;
 
 	sgn = mpz_sgn (n);
@@ -220,15 +218,6 @@ mympz_is_prime (mpz_srcptr n, int miller_rabin_reps)
 	if ( ! mympz_strong_pseudoprime_test_2_3_5_7 (n))
 		return 0;
 
-	if G_UNLIKELY ( ! inited_test) {
-		/* set test to 25*10^9 */
-		mpz_init_set_ui (test, 10);
-		mpz_pow_ui (test, test, 9);
-		mpz_mul_ui (test, test, 25);
-
-		inited_test = TRUE;
-	}
-
 	/* if n < 25*10^9, we are now sure this
 	   is a prime since the only n less than that
 	   that is a composite and strong pseudoprime to 2,3,5,7
@@ -236,7 +225,7 @@ mympz_is_prime (mpz_srcptr n, int miller_rabin_reps)
         ref:
            Neil Koblitz, A Course in Number Theory and Cryptography,
 	   Springer, 1987 */
-	if (mpz_cmp (n, test) <= 0)
+	if (mpz_cmp_d (n, 25e9) <= 0)
 		return 1;
 
 	if (gel_evalnode_hook != NULL)
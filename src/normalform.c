@@ -0,0 +1,506 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "normalform.h"
+
+#define E(a,n,i,j) ((a)[(gsize)(i)*(n)+(j)])
+
+static mpz_t *
+mat_copy (mpz_t *a, gsize len)
+{
+	mpz_t *b = g_new (mpz_t, len);
+	gsize i;
+	for (i = 0; i < len; i++)
+		mpz_init_set (b[i], a[i]);
+	return b;
+}
+
+static void
+mat_free (mpz_t *a, gsize len)
+{
+	gsize i;
+	for (i = 0; i < len; i++)
+		mpz_clear (a[i]);
+	g_free (a);
+}
+
+static void
+mat_identity (mpz_t *a, int n)
+{
+	int i, j;
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			mpz_set_ui (E(a,n,i,j), i == j ? 1 : 0);
+}
+
+static void
+rows_swap (mpz_t *a, int n, int i1, int i2, int c)
+{
+	int j;
+	if (i1 == i2)
+		return;
+	for (j = c; j < n; j++)
+		mpz_swap (E(a,n,i1,j), E(a,n,i2,j));
+}
+
+static void
+cols_swap (mpz_t *a, int m, int n, int j1, int j2, int r)
+{
+	int i;
+	if (j1 == j2)
+		return;
+	for (i = r; i < m; i++)
+		mpz_swap (E(a,n,i,j1), E(a,n,i,j2));
+}
+
+/* From column c on, (r1,r2) <- (s r1 + t r2, x r2 - y r1), which is
+ * unimodular when sx + ty = 1.  Reduced modulo mod if not NULL. */
+static void
+rows_combine (mpz_t *a, int n, int i1, int i2, int c,
+	      mpz_srcptr s, mpz_srcptr t, mpz_srcptr x, mpz_srcptr y,
+	      mpz_srcptr mod, mpz_ptr tmp)
+{
+	int j;
+	for (j = c; j < n; j++) {
+		mpz_ptr p = E(a,n,i1,j);
+		mpz_ptr q = E(a,n,i2,j);
+		mpz_mul (tmp, s, p);
+		mpz_addmul (tmp, t, q);
+		mpz_mul (q, x, q);
+		mpz_submul (q, y, p);
+		mpz_swap (p, tmp);
+		if (mod != NULL) {
+			mpz_fdiv_r (p, p, mod);
+			mpz_fdiv_r (q, q, mod);
+		}
+	}
+}
+
+/* The same with columns, from row r on */
+static void
+cols_combine (mpz_t *a, int m, int n, int j1, int j2, int r,
+	      mpz_srcptr s, mpz_srcptr t, mpz_srcptr x, mpz_srcptr y,
+	      mpz_srcptr mod, mpz_ptr tmp)
+{
+	int i;
+	for (i = r; i < m; i++) {
+		mpz_ptr p = E(a,n,i,j1);
+		mpz_ptr q = E(a,n,i,j2);
+		mpz_mul (tmp, s, p);
+		mpz_addmul (tmp, t, q);
+		mpz_mul (q, x, q);
+		mpz_submul (q, y, p);
+		mpz_swap (p, tmp);
+		if (mod != NULL) {
+			mpz_fdiv_r (p, p, mod);
+			mpz_fdiv_r (q, q, mod);
+		}
+	}
+}
+
+/* r1 <- r1 - q r2 from column c on */
+static void
+rows_submul (mpz_t *a, int n, int i1, int i2, int c, mpz_srcptr q)
+{
+	int j;
+	for (j = c; j < n; j++)
+		mpz_submul (E(a,n,i1,j), q, E(a,n,i2,j));
+}
+
+static void
+row_neg (mpz_t *a, int n, int i, int c)
+{
+	int j;
+	for (j = c; j < n; j++)
+		mpz_neg (E(a,n,i,j), E(a,n,i,j));
+}
+
+/* Cofactors for zeroing b against a: g = sa + tb, x = a/g, y = b/g.
+ * If a divides b just subtract a multiple, gcdext may pick cofactors
+ * that move the entries around and the elimination would never end. */
+static void
+xgcd (mpz_ptr g, mpz_ptr s, mpz_ptr t, mpz_ptr x, mpz_ptr y,
+      mpz_srcptr a, mpz_srcptr b)
+{
+	if (mpz_divisible_p (b, a)) {
+		mpz_set (g, a);
+		mpz_set_ui (s, 1);
+		mpz_set_ui (t, 0);
+		mpz_set_ui (x, 1);
+		mpz_divexact (y, b, a);
+		return;
+	}
+	mpz_gcdext (g, s, t, a, b);
+	mpz_divexact (x, a, g);
+	mpz_divexact (y, b, g);
+}
+
+/* Fraction free Gauss on the first n columns of the m by n matrix a
+ * (destroyed), choosing pivot rows as we go.  If the rank is n, det is
+ * set to the minor of the pivot rows (with sign if m = n) and returns
+ * TRUE */
+static gboolean
+bareiss (mpz_ptr det, mpz_t *a, int m, int n)
+{
+	mpz_t prev;
+	int i, j, k;
+	gboolean neg = FALSE;
+
+	mpz_init_set_ui (prev, 1);
+	for (k = 0; k < n; k++) {
+		if (mpz_sgn (E(a,n,k,k)) == 0) {
+			for (i = k+1; i < m; i++)
+				if (mpz_sgn (E(a,n,i,k)) != 0)
+					break;
+			if (i >= m) {
+				mpz_clear (prev);
+				return FALSE;
+			}
+			rows_swap (a, n, k, i, k);
+			neg = ! neg;
+		}
+		for (i = k+1; i < m; i++) {
+			for (j = k+1; j < n; j++) {
+				mpz_ptr e = E(a,n,i,j);
+				mpz_mul (e, e, E(a,n,k,k));
+				mpz_submul (e, E(a,n,i,k), E(a,n,k,j));
+				mpz_divexact (e, e, prev);
+			}
+		}
+		mpz_set (prev, E(a,n,k,k));
+	}
+	if (neg)
+		mpz_neg (det, prev);
+	else
+		mpz_set (det, prev);
+	mpz_clear (prev);
+	return TRUE;
+}
+
+void
+gel_int_det (mpz_ptr det, mpz_t *a, int n)
+{
+	mpz_t *b;
+
+	if (n == 0) {
+		mpz_set_ui (det, 1);
+		return;
+	}
+	b = mat_copy (a, (gsize)n*n);
+	if ( ! bareiss (det, b, n, n))
+		mpz_set_ui (det, 0);
+	mat_free (b, (gsize)n*n);
+}
+
+gboolean
+gel_int_lattice_det (mpz_ptr d, mpz_t *a, int m, int n)
+{
+	mpz_t *b;
+	gboolean ret;
+
+	if (m < n || n == 0)
+		return FALSE;
+	b = mat_copy (a, (gsize)m*n);
+	ret = bareiss (d, b, m, n);
+	mpz_abs (d, d);
+	mat_free (b, (gsize)m*n);
+	return ret;
+}
+
+void
+gel_int_hnf (mpz_t *a, int m, int n, mpz_t *u)
+{
+	mpz_t g, s, t, x, y, tmp;
+	int r, c, i;
+
+	mpz_inits (g, s, t, x, y, tmp, NULL);
+	if (u != NULL)
+		mat_identity (u, m);
+
+	r = 0;
+	for (c = 0; c < n && r < m; c++) {
+		for (i = r+1; i < m; i++) {
+			if (mpz_sgn (E(a,n,i,c)) == 0)
+				continue;
+			if (mpz_sgn (E(a,n,r,c)) == 0) {
+				rows_swap (a, n, r, i, c);
+				if (u != NULL)
+					rows_swap (u, m, r, i, 0);
+				continue;
+			}
+			xgcd (g, s, t, x, y, E(a,n,r,c), E(a,n,i,c));
+			rows_combine (a, n, r, i, c, s, t, x, y, NULL, tmp);
+			if (u != NULL)
+				rows_combine (u, m, r, i, 0, s, t, x, y,
+					      NULL, tmp);
+		}
+		if (mpz_sgn (E(a,n,r,c)) == 0)
+			continue;
+		if (mpz_sgn (E(a,n,r,c)) < 0) {
+			row_neg (a, n, r, c);
+			if (u != NULL)
+				row_neg (u, m, r, 0);
+		}
+		for (i = 0; i < r; i++) {
+			mpz_fdiv_q (tmp, E(a,n,i,c), E(a,n,r,c));
+			if (mpz_sgn (tmp) == 0)
+				continue;
+			rows_submul (a, n, i, r, c, tmp);
+			if (u != NULL)
+				rows_submul (u, m, i, r, 0, tmp);
+		}
+		r++;
+	}
+
+	mpz_clears (g, s, t, x, y, tmp, NULL);
+}
+
+/* The rows generate a lattice L whose determinant divides R, so L
+ * contains R Z^n.  Once column k is down to one entry p, the row with
+ * pivot h = gcd(p,R) is s row_k + t R e_k, and the vectors of L with
+ * the first k+1 coordinates zero form a lattice whose determinant
+ * divides R/h, so we can continue modulo that. */
+void
+gel_int_hnf_mod (mpz_t *a, int m, int n, mpz_srcptr d)
+{
+	mpz_t R, g, s, t, x, y, tmp;
+	int i, j, k;
+
+	mpz_inits (R, g, s, t, x, y, tmp, NULL);
+	mpz_abs (R, d);
+
+	for (i = 0; i < m*n; i++)
+		mpz_fdiv_r (a[i], a[i], R);
+
+	for (k = 0; k < n; k++) {
+		for (i = k+1; i < m; i++) {
+			if (mpz_sgn (E(a,n,i,k)) == 0)
+				continue;
+			if (mpz_sgn (E(a,n,k,k)) == 0) {
+				rows_swap (a, n, k, i, k);
+				continue;
+			}
+			xgcd (g, s, t, x, y, E(a,n,k,k), E(a,n,i,k));
+			rows_combine (a, n, k, i, k, s, t, x, y, R, tmp);
+		}
+
+		mpz_gcdext (g, s, t, E(a,n,k,k), R);
+		mpz_set (E(a,n,k,k), g);
+		for (j = k+1; j < n; j++) {
+			mpz_mul (E(a,n,k,j), E(a,n,k,j), s);
+			mpz_fdiv_r (E(a,n,k,j), E(a,n,k,j), R);
+		}
+
+		mpz_divexact (R, R, g);
+		for (i = k+1; i < m; i++)
+			for (j = k+1; j < n; j++)
+				mpz_fdiv_r (E(a,n,i,j), E(a,n,i,j), R);
+	}
+
+	/* reduce above the pivots */
+	for (j = 1; j < n; j++) {
+		for (i = 0; i < j; i++) {
+			mpz_fdiv_q (tmp, E(a,n,i,j), E(a,n,j,j));
+			if (mpz_sgn (tmp) != 0)
+				rows_submul (a, n, i, j, j, tmp);
+		}
+	}
+
+	mpz_clears (R, g, s, t, x, y, tmp, NULL);
+}
+
+/* Move the smallest nonzero entry of the lower right block from (k,k)
+ * to (k,k), returns FALSE if the block is zero */
+static gboolean
+snf_pivot (mpz_t *a, int m, int n, int k, mpz_t *u, mpz_t *v)
+{
+	int i, j, bi = -1, bj = -1;
+
+	for (i = k; i < m; i++) {
+		for (j = k; j < n; j++) {
+			if (mpz_sgn (E(a,n,i,j)) != 0 &&
+			    (bi < 0 ||
+			     mpz_cmpabs (E(a,n,i,j), E(a,n,bi,bj)) < 0)) {
+				bi = i;
+				bj = j;
+			}
+		}
+	}
+	if (bi < 0)
+		return FALSE;
+
+	rows_swap (a, n, k, bi, 0);
+	if (u != NULL)
+		rows_swap (u, m, k, bi, 0);
+	cols_swap (a, m, n, k, bj, 0);
+	if (v != NULL)
+		cols_swap (v, n, n, k, bj, 0);
+	return TRUE;
+}
+
+/* Clear column k below and row k to the right of (k,k), modulo mod if
+ * not NULL */
+static void
+snf_clear (mpz_t *a, int m, int n, int k, mpz_t *u, mpz_t *v,
+	   mpz_srcptr mod, mpz_t g, mpz_t s, mpz_t t, mpz_t x, mpz_t y,
+	   mpz_t tmp)
+{
+	int i, j;
+	gboolean again;
+
+	do {
+		for (i = k+1; i < m; i++) {
+			if (mpz_sgn (E(a,n,i,k)) == 0)
+				continue;
+			if (mpz_sgn (E(a,n,k,k)) == 0) {
+				rows_swap (a, n, k, i, k);
+				if (u != NULL)
+					rows_swap (u, m, k, i, 0);
+				continue;
+			}
+			xgcd (g, s, t, x, y, E(a,n,k,k), E(a,n,i,k));
+			rows_combine (a, n, k, i, k, s, t, x, y, mod, tmp);
+			if (u != NULL)
+				rows_combine (u, m, k, i, 0, s, t, x, y,
+					      NULL, tmp);
+		}
+		for (j = k+1; j < n; j++) {
+			if (mpz_sgn (E(a,n,k,j)) == 0)
+				continue;
+			if (mpz_sgn (E(a,n,k,k)) == 0) {
+				cols_swap (a, m, n, k, j, k);
+				if (v != NULL)
+					cols_swap (v, n, n, k, j, 0);
+				continue;
+			}
+			xgcd (g, s, t, x, y, E(a,n,k,k), E(a,n,k,j));
+			cols_combine (a, m, n, k, j, k, s, t, x, y, mod, tmp);
+			if (v != NULL)
+				cols_combine (v, n, n, k, j, 0, s, t, x, y,
+					      NULL, tmp);
+		}
+		/* clearing the row may have filled the column again */
+		again = FALSE;
+		for (i = k+1; i < m; i++) {
+			if (mpz_sgn (E(a,n,i,k)) != 0) {
+				again = TRUE;
+				break;
+			}
+		}
+	} while (again);
+}
+
+void
+gel_int_snf (mpz_t *a, int m, int n, mpz_t *u, mpz_t *v)
+{
+	mpz_t g, s, t, x, y, tmp;
+	int i, j, k, mn = MIN (m, n);
+
+	mpz_inits (g, s, t, x, y, tmp, NULL);
+	if (u != NULL)
+		mat_identity (u, m);
+	if (v != NULL)
+		mat_identity (v, n);
+
+	for (k = 0; k < mn; k++) {
+		gboolean divides;
+
+		if ( ! snf_pivot (a, m, n, k, u, v))
+			break;
+		do {
+			snf_clear (a, m, n, k, u, v, NULL,
+				   g, s, t, x, y, tmp);
+
+			/* the pivot must divide the rest, if not add
+			 * the offending row and go again */
+			divides = TRUE;
+			for (i = k+1; i < m && divides; i++) {
+				for (j = k+1; j < n; j++) {
+					if ( ! mpz_divisible_p (E(a,n,i,j),
+								E(a,n,k,k))) {
+						divides = FALSE;
+						break;
+					}
+				}
+			}
+			if ( ! divides) {
+				i--;
+				mpz_set_si (tmp, -1);
+				rows_submul (a, n, k, i, k, tmp);
+				if (u != NULL)
+					rows_submul (u, m, k, i, 0, tmp);
+			}
+		} while ( ! divides);
+
+		if (mpz_sgn (E(a,n,k,k)) < 0) {
+			row_neg (a, n, k, k);
+			if (u != NULL)
+				row_neg (u, m, k, 0);
+		}
+	}
+
+	mpz_clears (g, s, t, x, y, tmp, NULL);
+}
+
+/* The rows generate a lattice containing dZ^n and row and column
+ * operations keep it so, so we can compute modulo d.  In the end the
+ * lattice is generated by the diagonal entries p_k and d, that is by
+ * gcd(p_k,d), and those just need to be put into a divisibility
+ * chain. */
+void
+gel_int_snf_mod (mpz_t *s, mpz_t *a, int m, int n, mpz_srcptr d)
+{
+	mpz_t D, g, cs, ct, x, y, tmp;
+	int i, j, k;
+
+	mpz_inits (D, g, cs, ct, x, y, tmp, NULL);
+	mpz_abs (D, d);
+
+	for (i = 0; i < m*n; i++)
+		mpz_fdiv_r (a[i], a[i], D);
+
+	for (k = 0; k < n; k++) {
+		if ( ! snf_pivot (a, m, n, k, NULL, NULL)) {
+			for (; k < n; k++)
+				mpz_set (s[k], D);
+			break;
+		}
+		snf_clear (a, m, n, k, NULL, NULL, D, g, cs, ct, x, y, tmp);
+		mpz_gcd (s[k], E(a,n,k,k), D);
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = i+1; j < n; j++) {
+			if (mpz_divisible_p (s[j], s[i]))
+				continue;
+			mpz_gcd (g, s[i], s[j]);
+			mpz_divexact (tmp, s[i], g);
+			mpz_mul (s[j], s[j], tmp);
+			mpz_set (s[i], g);
+		}
+	}
+
+	mpz_clears (D, g, cs, ct, x, y, tmp, NULL);
+}
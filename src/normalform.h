@@ -0,0 +1,88 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NORMALFORM_H_
+#define _NORMALFORM_H_
+
+#include <glib.h>
+#ifdef HAVE_GMP2_INCLUDE_DIR
+#include <gmp2/gmp.h>
+#else
+#include <gmp.h>
+#endif
+
+/* Hermite and Smith normal forms of integer matrices.  Matrices are
+ * arrays of initialized mpz_t stored rowwise, an m by n matrix has m*n
+ * entries.
+ *
+ * The Hermite normal form H = UA is in row echelon form with positive
+ * pivots, entries above each pivot are in [0,pivot) and zero rows are
+ * at the bottom.  The Smith normal form S = UAV is diagonal with
+ * nonnegative entries s1 | s2 | ... (zeros last).  U and V are
+ * unimodular.
+ *
+ * When the rows of a span all of Q^n and no transformations are needed
+ * everything can be done modulo a multiple D of the determinant of the
+ * lattice the rows generate (it contains DZ^n), which bounds all the
+ * entries by D.  A nonzero n by n minor is such a multiple. */
+
+/* det = determinant of the n by n matrix a (fraction free Gauss) */
+void		gel_int_det		(mpz_ptr det,
+					 mpz_t *a,
+					 int n);
+
+/* If the m by n matrix a has rank n, set d to the absolute value of
+ * some nonzero n by n minor and return TRUE, else return FALSE */
+gboolean	gel_int_lattice_det	(mpz_ptr d,
+					 mpz_t *a,
+					 int m,
+					 int n);
+
+/* a is replaced by its Hermite normal form, if u is not NULL it gets
+ * the m by m transformation */
+void		gel_int_hnf		(mpz_t *a,
+					 int m,
+					 int n,
+					 mpz_t *u);
+
+/* The same for a of rank n (so m >= n) modulo d as above */
+void		gel_int_hnf_mod		(mpz_t *a,
+					 int m,
+					 int n,
+					 mpz_srcptr d);
+
+/* a is replaced by its Smith normal form, if u and v are not NULL they
+ * get the m by m and n by n transformations */
+void		gel_int_snf		(mpz_t *a,
+					 int m,
+					 int n,
+					 mpz_t *u,
+					 mpz_t *v);
+
+/* The n invariant factors of a of rank n into s, modulo d as above,
+ * a is destroyed */
+void		gel_int_snf_mod		(mpz_t *s,
+					 mpz_t *a,
+					 int m,
+					 int n,
+					 mpz_srcptr d);
+
+#endif /* _NORMALFORM_H_ */
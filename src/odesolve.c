@@ -0,0 +1,718 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <float.h>
+
+#include "calc.h"
+#include "mpwrap.h"
+
+#include "odesolve.h"
+
+/* The Dormand-Prince 5(4) tableau, the last row of a is also the fifth
+ * order solution, e is the difference to the fourth order one and d are
+ * for the dense output */
+static const double c2 = 1.0/5.0, c3 = 3.0/10.0, c4 = 4.0/5.0, c5 = 8.0/9.0;
+static const double a21 = 1.0/5.0;
+static const double a31 = 3.0/40.0, a32 = 9.0/40.0;
+static const double a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+static const double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0,
+	a53 = 64448.0/6561.0, a54 = -212.0/729.0;
+static const double a61 = 9017.0/3168.0, a62 = -355.0/33.0,
+	a63 = 46732.0/5247.0, a64 = 49.0/176.0, a65 = -5103.0/18656.0;
+static const double a71 = 35.0/384.0, a73 = 500.0/1113.0,
+	a74 = 125.0/192.0, a75 = -2187.0/6784.0, a76 = 11.0/84.0;
+static const double e1 = 71.0/57600.0, e3 = -71.0/16695.0,
+	e4 = 71.0/1920.0, e5 = -17253.0/339200.0, e6 = 22.0/525.0,
+	e7 = -1.0/40.0;
+static const double d1 = -12715105075.0/11282082432.0,
+	d3 = 87487479700.0/32700410799.0, d4 = -10690763975.0/1880347072.0,
+	d5 = 701980252875.0/199316789632.0, d6 = -1453857185.0/822651844.0,
+	d7 = 69997945.0/29380423.0;
+
+/* the same as strings for the mpw version, so that they are exact
+ * rationals there */
+static const char *mpw_coefs[][2] = {
+#define C2 0
+	{ "1", "5" },
+#define C3 1
+	{ "3", "10" },
+#define C4 2
+	{ "4", "5" },
+#define C5 3
+	{ "8", "9" },
+#define A21 4
+	{ "1", "5" },
+#define A31 5
+	{ "3", "40" }, { "9", "40" },
+#define A41 7
+	{ "44", "45" }, { "-56", "15" }, { "32", "9" },
+#define A51 10
+	{ "19372", "6561" }, { "-25360", "2187" }, { "64448", "6561" },
+	{ "-212", "729" },
+#define A61 14
+	{ "9017", "3168" }, { "-355", "33" }, { "46732", "5247" },
+	{ "49", "176" }, { "-5103", "18656" },
+#define A71 19
+	{ "35", "384" }, { "0", "1" }, { "500", "1113" }, { "125", "192" },
+	{ "-2187", "6784" }, { "11", "84" },
+#define E1 25
+	{ "71", "57600" }, { "0", "1" }, { "-71", "16695" }, { "71", "1920" },
+	{ "-17253", "339200" }, { "22", "525" }, { "-1", "40" },
+#define D1 32
+	{ "-12715105075", "11282082432" }, { "0", "1" },
+	{ "87487479700", "32700410799" }, { "-10690763975", "1880347072" },
+	{ "701980252875", "199316789632" }, { "-1453857185", "822651844" },
+	{ "69997945", "29380423" }
+#define NCOEFS 39
+};
+
+/* weighted rms norm */
+static double
+err_norm (int n, const double *e, const double *y, const double *ynew,
+	  double rtol, double atol)
+{
+	double sum = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		double sc = atol + rtol * MAX (fabs (y[i]), fabs (ynew[i]));
+		double q = e[i] / sc;
+		sum += q * q;
+	}
+	return sqrt (sum / n);
+}
+
+static double
+initial_step (int n, const double *y, const double *dy,
+	      double rtol, double atol, double span)
+{
+	double d0 = 0.0, d1 = 0.0, h;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		double sc = atol + rtol * fabs (y[i]);
+		d0 += (y[i] / sc) * (y[i] / sc);
+		d1 += (dy[i] / sc) * (dy[i] / sc);
+	}
+	d0 = sqrt (d0 / n);
+	d1 = sqrt (d1 / n);
+	if (d0 < 1e-5 || d1 < 1e-5)
+		h = 1e-6 * span;
+	else
+		h = 0.01 * d0 / d1;
+	return MIN (h, span);
+}
+
+/* next step size from the error, limited to shrink at most by 5 and
+ * grow at most by 10 (or not at all right after a rejection) */
+static double
+step_factor (double err, gboolean after_reject)
+{
+	double fac;
+
+	if (err <= 0.0)
+		fac = 10.0;
+	else
+		fac = 0.9 * pow (err, -0.2);
+	fac = CLAMP (fac, 0.2, 10.0);
+	if (after_reject)
+		fac = MIN (fac, 1.0);
+	return fac;
+}
+
+GelOdeResult
+gel_ode_dopri5 (GelOdeFunc f,
+		gpointer data,
+		int n,
+		double t0,
+		double *y,
+		double t1,
+		double rtol,
+		double atol,
+		double hmax,
+		double outstep,
+		GelOdeOutFunc out,
+		int *nevals)
+{
+	double *k1, *k2, *k3, *k4, *k5, *k6, *k7, *yt, *ynew, *yerr;
+	double *r1, *r2, *r3, *r4, *r5;
+	double dir, span, h, t;
+	gboolean reject = FALSE;
+	GelOdeResult res = GEL_ODE_DONE;
+	long kout = 1;
+	int evals = 0;
+	int steps = 0;
+	int i;
+
+	g_return_val_if_fail (n > 0, GEL_ODE_FAILED);
+
+	k1 = g_new (double, 15 * n);
+	k2 = k1 + n;
+	k3 = k2 + n;
+	k4 = k3 + n;
+	k5 = k4 + n;
+	k6 = k5 + n;
+	k7 = k6 + n;
+	yt = k7 + n;
+	ynew = yt + n;
+	yerr = ynew + n;
+	r1 = yerr + n;
+	r2 = r1 + n;
+	r3 = r2 + n;
+	r4 = r3 + n;
+	r5 = r4 + n;
+
+	if (out != NULL && ! (*out) (t0, y, data)) {
+		res = GEL_ODE_STOPPED;
+		goto done;
+	}
+	if (t0 == t1)
+		goto done;
+
+	dir = (t1 > t0) ? 1.0 : -1.0;
+	span = fabs (t1 - t0);
+	if (hmax <= 0.0 || hmax > span)
+		hmax = span;
+
+	evals++;
+	if ( ! (*f) (t0, y, k1, data)) {
+		res = GEL_ODE_FAILED;
+		goto done;
+	}
+
+	h = MIN (initial_step (n, y, k1, rtol, atol, span), hmax);
+	t = t0;
+
+	for (;;) {
+		double hh, err, tnew;
+		gboolean last = FALSE;
+		gboolean ok;
+
+		if G_UNLIKELY (gel_interrupted) {
+			res = GEL_ODE_INTERRUPTED;
+			break;
+		}
+		if G_UNLIKELY (++steps > GEL_ODE_MAX_STEPS) {
+			res = GEL_ODE_TOO_MANY_STEPS;
+			break;
+		}
+		if G_UNLIKELY (h < 16 * G_MINDOUBLE ||
+			       h < 4 * DBL_EPSILON * MAX (fabs (t), span)) {
+			res = GEL_ODE_STEP_TOO_SMALL;
+			break;
+		}
+
+		if (h >= fabs (t1 - t) * (1.0 - 1e-12)) {
+			h = fabs (t1 - t);
+			last = TRUE;
+		}
+		hh = dir * h;
+
+		for (i = 0; i < n; i++)
+			yt[i] = y[i] + hh * a21 * k1[i];
+		ok = (*f) (t + c2 * hh, yt, k2, data);
+		for (i = 0; ok && i < n; i++)
+			yt[i] = y[i] + hh * (a31 * k1[i] + a32 * k2[i]);
+		ok = ok && (*f) (t + c3 * hh, yt, k3, data);
+		for (i = 0; ok && i < n; i++)
+			yt[i] = y[i] + hh * (a41 * k1[i] + a42 * k2[i] +
+					     a43 * k3[i]);
+		ok = ok && (*f) (t + c4 * hh, yt, k4, data);
+		for (i = 0; ok && i < n; i++)
+			yt[i] = y[i] + hh * (a51 * k1[i] + a52 * k2[i] +
+					     a53 * k3[i] + a54 * k4[i]);
+		ok = ok && (*f) (t + c5 * hh, yt, k5, data);
+		for (i = 0; ok && i < n; i++)
+			yt[i] = y[i] + hh * (a61 * k1[i] + a62 * k2[i] +
+					     a63 * k3[i] + a64 * k4[i] +
+					     a65 * k5[i]);
+		tnew = last ? t1 : t + hh;
+		ok = ok && (*f) (tnew, yt, k6, data);
+		for (i = 0; ok && i < n; i++)
+			ynew[i] = y[i] + hh * (a71 * k1[i] + a73 * k3[i] +
+					       a74 * k4[i] + a75 * k5[i] +
+					       a76 * k6[i]);
+		ok = ok && (*f) (tnew, ynew, k7, data);
+		evals += 6;
+
+		if ( ! ok) {
+			/* perhaps we stepped out of the domain, try
+			 * smaller steps */
+			h *= 0.25;
+			reject = TRUE;
+			continue;
+		}
+
+		for (i = 0; i < n; i++)
+			yerr[i] = hh * (e1 * k1[i] + e3 * k3[i] + e4 * k4[i] +
+					e5 * k5[i] + e6 * k6[i] + e7 * k7[i]);
+		err = err_norm (n, yerr, y, ynew, rtol, atol);
+
+		if ( ! (err <= 1.0)) {
+			/* also catches a NaN error */
+			h *= isfinite (err) ? step_factor (err, FALSE) : 0.25;
+			reject = TRUE;
+			continue;
+		}
+
+		/* accepted */
+		if (out != NULL && outstep > 0.0) {
+			double tout = t0 + dir * kout * outstep;
+
+			for (i = 0; i < n; i++) {
+				double ydiff = ynew[i] - y[i];
+				double bspl = hh * k1[i] - ydiff;
+				r1[i] = y[i];
+				r2[i] = ydiff;
+				r3[i] = bspl;
+				r4[i] = ydiff - hh * k7[i] - bspl;
+				r5[i] = hh * (d1 * k1[i] + d3 * k3[i] +
+					      d4 * k4[i] + d5 * k5[i] +
+					      d6 * k6[i] + d7 * k7[i]);
+			}
+
+			/* a point that falls on t1 is left for the final
+			 * output below */
+			while (dir * (tnew - tout) >=
+			       (last ? 1e-8 * outstep : 0.0)) {
+				double th = (tout - t) / hh;
+				double th1 = 1.0 - th;
+				for (i = 0; i < n; i++)
+					yt[i] = r1[i] + th * (r2[i] + th1 * (r3[i] + th * (r4[i] + th1 * r5[i])));
+				if ( ! (*out) (tout, yt, data)) {
+					res = GEL_ODE_STOPPED;
+					break;
+				}
+				kout++;
+				tout = t0 + dir * kout * outstep;
+			}
+			if (res != GEL_ODE_DONE)
+				break;
+		}
+
+		for (i = 0; i < n; i++) {
+			y[i] = ynew[i];
+			k1[i] = k7[i];
+		}
+		t = tnew;
+
+		if (out != NULL && (outstep <= 0.0 || last)) {
+			if ( ! (*out) (t, y, data)) {
+				res = GEL_ODE_STOPPED;
+				break;
+			}
+		}
+
+		if (last)
+			break;
+
+		h = MIN (h * step_factor (err, reject), hmax);
+		reject = FALSE;
+	}
+
+done:
+	g_free (k1);
+
+	if (nevals != NULL)
+		*nevals = evals;
+
+	return res;
+}
+
+/* the error norm from mpw numbers, tmp is scratch */
+static double
+err_norm_mpw (int n, mpw_t *e, mpw_t *y, mpw_t *ynew,
+	      double rtol, double atol, mpw_ptr tmp)
+{
+	double sum = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		double ay, aynew, ae, sc, q;
+
+		mpw_abs (tmp, y[i]);
+		ay = mpw_get_double (tmp);
+		mpw_abs (tmp, ynew[i]);
+		aynew = mpw_get_double (tmp);
+		mpw_abs (tmp, e[i]);
+		ae = mpw_get_double (tmp);
+		if G_UNLIKELY (gel_error_num != 0) {
+			/* overflow, let the step be rejected */
+			gel_error_num = 0;
+			return G_MAXDOUBLE;
+		}
+
+		sc = atol + rtol * MAX (ay, aynew);
+		q = ae / sc;
+		sum += q * q;
+	}
+	return sqrt (sum / n);
+}
+
+/* r = y + h * sum coef[j] * k[j] for the j in the list (ended by -1) */
+static void
+combine_mpw (int n, mpw_t *r, mpw_t *y, mpw_ptr h, mpw_t *coef,
+	     mpw_t **k, const int *js, mpw_ptr tmp, mpw_ptr sum)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		mpw_set_ui (sum, 0);
+		for (j = 0; js[j] >= 0; j++) {
+			mpw_mul (tmp, coef[j], k[js[j]][i]);
+			mpw_add (sum, sum, tmp);
+		}
+		mpw_mul (sum, sum, h);
+		if (y != NULL)
+			mpw_add (r[i], y[i], sum);
+		else
+			mpw_set (r[i], sum);
+	}
+}
+
+GelOdeResult
+gel_ode_dopri5_mpw (GelOdeMpwFunc f,
+		    gpointer data,
+		    int n,
+		    mpw_ptr t0,
+		    mpw_t *y,
+		    mpw_ptr t1,
+		    double rtol,
+		    double atol,
+		    mpw_ptr outstep,
+		    GelOdeMpwOutFunc out,
+		    int *nevals)
+{
+	static const int j1[] = { 0, -1 };
+	static const int j2[] = { 0, 1, -1 };
+	static const int j3[] = { 0, 1, 2, -1 };
+	static const int j4[] = { 0, 1, 2, 3, -1 };
+	static const int j5[] = { 0, 1, 2, 3, 4, -1 };
+	static const int j6[] = { 0, 1, 2, 3, 4, 5, -1 };
+	static const int j7[] = { 0, 1, 2, 3, 4, 5, 6, -1 };
+	mpw_t coefs[NCOEFS];
+	mpw_t *k[7], *yt, *ynew, *yerr, *r[5];
+	mpw_t t, tnew, tc, hh, tmp, tmp2, tout, span_m;
+	double dir, span, h, tabs, outd = 0.0;
+	gboolean reject = FALSE;
+	GelOdeResult res = GEL_ODE_DONE;
+	long kout = 1;
+	int evals = 0;
+	int steps = 0;
+	int i, j;
+
+	g_return_val_if_fail (n > 0, GEL_ODE_FAILED);
+
+	for (i = 0; i < NCOEFS; i++) {
+		mpw_init (coefs[i]);
+		mpw_init (tmp);
+		mpw_set_str_int (coefs[i], mpw_coefs[i][0], 10);
+		mpw_set_str_int (tmp, mpw_coefs[i][1], 10);
+		mpw_div (coefs[i], coefs[i], tmp);
+		mpw_clear (tmp);
+	}
+	for (j = 0; j < 7; j++) {
+		k[j] = g_new (mpw_t, n);
+		for (i = 0; i < n; i++)
+			mpw_init (k[j][i]);
+	}
+	for (j = 0; j < 5; j++) {
+		r[j] = g_new (mpw_t, n);
+		for (i = 0; i < n; i++)
+			mpw_init (r[j][i]);
+	}
+	yt = g_new (mpw_t, n);
+	ynew = g_new (mpw_t, n);
+	yerr = g_new (mpw_t, n);
+	for (i = 0; i < n; i++) {
+		mpw_init (yt[i]);
+		mpw_init (ynew[i]);
+		mpw_init (yerr[i]);
+		mpw_make_float (y[i]);
+	}
+	mpw_init (t);
+	mpw_init (tnew);
+	mpw_init (tc);
+	mpw_init (hh);
+	mpw_init (tmp);
+	mpw_init (tmp2);
+	mpw_init (tout);
+	mpw_init (span_m);
+
+	if (out != NULL && ! (*out) (t0, y, data)) {
+		res = GEL_ODE_STOPPED;
+		goto done;
+	}
+	if (mpw_cmp (t0, t1) == 0)
+		goto done;
+
+	dir = (mpw_cmp (t1, t0) > 0) ? 1.0 : -1.0;
+	mpw_sub (span_m, t1, t0);
+	mpw_abs (span_m, span_m);
+	span = mpw_get_double (span_m);
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		res = GEL_ODE_FAILED;
+		goto done;
+	}
+
+	if (outstep != NULL)
+		outd = fabs (mpw_get_double (outstep));
+	if G_UNLIKELY (gel_error_num != 0) {
+		gel_error_num = 0;
+		res = GEL_ODE_FAILED;
+		goto done;
+	}
+
+	evals++;
+	if ( ! (*f) (t0, y, k[0], data)) {
+		res = GEL_ODE_FAILED;
+		goto done;
+	}
+
+	/* initial step from the double values */
+	{
+		double *yd = g_new (double, 2 * n);
+		for (i = 0; i < n; i++) {
+			mpw_abs (tmp, y[i]);
+			yd[i] = mpw_get_double (tmp);
+			mpw_abs (tmp, k[0][i]);
+			yd[n + i] = mpw_get_double (tmp);
+		}
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			h = 1e-6 * span;
+		} else {
+			h = initial_step (n, yd, yd + n, rtol, atol, span);
+		}
+		g_free (yd);
+	}
+
+	mpw_set (t, t0);
+	mpw_make_float (t);
+
+	for (;;) {
+		double err, rest;
+		gboolean last = FALSE;
+		gboolean ok;
+
+		if G_UNLIKELY (gel_interrupted) {
+			res = GEL_ODE_INTERRUPTED;
+			break;
+		}
+		if G_UNLIKELY (++steps > GEL_ODE_MAX_STEPS) {
+			res = GEL_ODE_TOO_MANY_STEPS;
+			break;
+		}
+
+		mpw_sub (tmp, t1, t);
+		mpw_abs (tmp, tmp);
+		rest = mpw_get_double (tmp);
+		tabs = fabs (mpw_get_double (t));
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			res = GEL_ODE_FAILED;
+			break;
+		}
+
+		if G_UNLIKELY (h < 16 * G_MINDOUBLE ||
+			       h < 4 * DBL_EPSILON * MAX (tabs, span)) {
+			res = GEL_ODE_STEP_TOO_SMALL;
+			break;
+		}
+
+		if (h >= rest * (1.0 - 1e-12)) {
+			/* take exactly the rest */
+			mpw_sub (hh, t1, t);
+			last = TRUE;
+		} else {
+			mpw_set_d (hh, dir * h);
+		}
+
+#define STAGE(dst,c,js) \
+		combine_mpw (n, dst, y, hh, &coefs[c], k, js, tmp, tmp2)
+#define STAGE_T(c) \
+		mpw_mul (tc, coefs[c], hh); \
+		mpw_add (tc, tc, t);
+
+		STAGE (yt, A21, j1);
+		STAGE_T (C2);
+		ok = (*f) (tc, yt, k[1], data);
+		if (ok) {
+			STAGE (yt, A31, j2);
+			STAGE_T (C3);
+			ok = (*f) (tc, yt, k[2], data);
+		}
+		if (ok) {
+			STAGE (yt, A41, j3);
+			STAGE_T (C4);
+			ok = (*f) (tc, yt, k[3], data);
+		}
+		if (ok) {
+			STAGE (yt, A51, j4);
+			STAGE_T (C5);
+			ok = (*f) (tc, yt, k[4], data);
+		}
+		if (last)
+			mpw_set (tnew, t1);
+		else
+			mpw_add (tnew, t, hh);
+		if (ok) {
+			STAGE (yt, A61, j5);
+			ok = (*f) (tnew, yt, k[5], data);
+		}
+		if (ok) {
+			STAGE (ynew, A71, j6);
+			ok = (*f) (tnew, ynew, k[6], data);
+		}
+#undef STAGE
+#undef STAGE_T
+		evals += 6;
+
+		if ( ! ok) {
+			h *= 0.25;
+			reject = TRUE;
+			continue;
+		}
+
+		combine_mpw (n, yerr, NULL, hh, &coefs[E1], k, j7, tmp, tmp2);
+		err = err_norm_mpw (n, yerr, y, ynew, rtol, atol, tmp);
+
+		if ( ! (err <= 1.0)) {
+			h *= isfinite (err) && err < G_MAXDOUBLE ?
+				step_factor (err, FALSE) : 0.25;
+			reject = TRUE;
+			continue;
+		}
+
+		/* accepted */
+		if (out != NULL && outstep != NULL) {
+			combine_mpw (n, r[4], NULL, hh, &coefs[D1], k, j7,
+				     tmp, tmp2);
+			for (i = 0; i < n; i++) {
+				/* r1 = y, r2 = ydiff, r3 = bspl,
+				   r4 = ydiff - hh*k7 - bspl */
+				mpw_set (r[0][i], y[i]);
+				mpw_sub (r[1][i], ynew[i], y[i]);
+				mpw_mul (r[2][i], hh, k[0][i]);
+				mpw_sub (r[2][i], r[2][i], r[1][i]);
+				mpw_mul (r[3][i], hh, k[6][i]);
+				mpw_sub (r[3][i], r[1][i], r[3][i]);
+				mpw_sub (r[3][i], r[3][i], r[2][i]);
+			}
+
+			for (;;) {
+				mpw_set_si (tout, kout);
+				mpw_mul (tout, tout, outstep);
+				if (dir < 0)
+					mpw_sub (tout, t0, tout);
+				else
+					mpw_add (tout, t0, tout);
+
+				mpw_sub (tc, tnew, tout);
+				if (dir * mpw_get_double (tc) <
+				    (last ? 1e-8 * outd : 0.0))
+					break;
+
+				/* th = (tout - t) / hh, interpolate
+				   r1 + th*(r2 + (1-th)*(r3 + th*(r4 + (1-th)*r5))) */
+				mpw_sub (tc, tout, t);
+				mpw_div (tc, tc, hh);
+				mpw_ui_sub (tmp2, 1, tc);
+				for (i = 0; i < n; i++) {
+					mpw_mul (tmp, tmp2, r[4][i]);
+					mpw_add (tmp, tmp, r[3][i]);
+					mpw_mul (tmp, tmp, tc);
+					mpw_add (tmp, tmp, r[2][i]);
+					mpw_mul (tmp, tmp, tmp2);
+					mpw_add (tmp, tmp, r[1][i]);
+					mpw_mul (tmp, tmp, tc);
+					mpw_add (yt[i], tmp, r[0][i]);
+				}
+				if ( ! (*out) (tout, yt, data)) {
+					res = GEL_ODE_STOPPED;
+					break;
+				}
+				kout++;
+			}
+			if (res != GEL_ODE_DONE)
+				break;
+		}
+
+		for (i = 0; i < n; i++) {
+			mpw_set (y[i], ynew[i]);
+			mpw_set (k[0][i], k[6][i]);
+		}
+		mpw_set (t, tnew);
+
+		if (out != NULL && (outstep == NULL || last)) {
+			if ( ! (*out) (t, y, data)) {
+				res = GEL_ODE_STOPPED;
+				break;
+			}
+		}
+
+		if (last)
+			break;
+
+		h = h * step_factor (err, reject);
+		reject = FALSE;
+	}
+
+done:
+	for (i = 0; i < NCOEFS; i++)
+		mpw_clear (coefs[i]);
+	for (j = 0; j < 7; j++) {
+		for (i = 0; i < n; i++)
+			mpw_clear (k[j][i]);
+		g_free (k[j]);
+	}
+	for (j = 0; j < 5; j++) {
+		for (i = 0; i < n; i++)
+			mpw_clear (r[j][i]);
+		g_free (r[j]);
+	}
+	for (i = 0; i < n; i++) {
+		mpw_clear (yt[i]);
+		mpw_clear (ynew[i]);
+		mpw_clear (yerr[i]);
+	}
+	g_free (yt);
+	g_free (ynew);
+	g_free (yerr);
+	mpw_clear (t);
+	mpw_clear (tnew);
+	mpw_clear (tc);
+	mpw_clear (hh);
+	mpw_clear (tmp);
+	mpw_clear (tmp2);
+	mpw_clear (tout);
+	mpw_clear (span_m);
+
+	if (nevals != NULL)
+		*nevals = evals;
+
+	return res;
+}
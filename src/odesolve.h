@@ -0,0 +1,93 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ODESOLVE_H_
+#define _ODESOLVE_H_
+
+#include <glib.h>
+#include "mpwrap.h"
+
+/* Adaptive Dormand-Prince 5(4) integrator for y'=f(t,y) with y a vector
+ * of n values, with error control and the dense output of Hairer,
+ * Norsett and Wanner (Solving Ordinary Differential Equations I).  There
+ * is a version in doubles and one in mpw numbers (so that it follows the
+ * current float precision and can handle complex values). */
+
+typedef enum {
+	GEL_ODE_DONE = 0,	/* got to t1 */
+	GEL_ODE_STOPPED,	/* the output function asked to stop */
+	GEL_ODE_FAILED,		/* f could not be evaluated */
+	GEL_ODE_STEP_TOO_SMALL,	/* could not reach the tolerance */
+	GEL_ODE_TOO_MANY_STEPS,
+	GEL_ODE_INTERRUPTED
+} GelOdeResult;
+
+/* maximum number of steps (accepted and rejected) before giving up */
+#define GEL_ODE_MAX_STEPS 500000
+
+/* Store f(t,y) in dy, return FALSE if it cannot be evaluated */
+typedef gboolean (*GelOdeFunc) (double t, const double *y, double *dy,
+				gpointer data);
+/* Gets the solution at the output points, return FALSE to stop */
+typedef gboolean (*GelOdeOutFunc) (double t, const double *y,
+				   gpointer data);
+
+/* Integrate from t0 to t1 (t1 may be less than t0), y holds the initial
+ * value on entry and the last value computed on return.  The error in
+ * each component is kept under atol + rtol*|y|.  If hmax > 0 the steps
+ * are at most that long.  out (if not NULL) is called at t0, then every
+ * outstep (a distance, so positive even if t1 < t0) towards t1 with
+ * values from the dense output and finally at t1, or at the end of every
+ * step if outstep <= 0.  If nevals is not
+ * NULL it gets the number of evaluations of f. */
+GelOdeResult	gel_ode_dopri5		(GelOdeFunc f,
+					 gpointer data,
+					 int n,
+					 double t0,
+					 double *y,
+					 double t1,
+					 double rtol,
+					 double atol,
+					 double hmax,
+					 double outstep,
+					 GelOdeOutFunc out,
+					 int *nevals);
+
+typedef gboolean (*GelOdeMpwFunc) (mpw_ptr t, mpw_t *y, mpw_t *dy,
+				   gpointer data);
+typedef gboolean (*GelOdeMpwOutFunc) (mpw_ptr t, mpw_t *y,
+				      gpointer data);
+
+/* The same in mpw numbers, the error control is done in doubles.
+ * outstep may be NULL for output at every step. */
+GelOdeResult	gel_ode_dopri5_mpw	(GelOdeMpwFunc f,
+					 gpointer data,
+					 int n,
+					 mpw_ptr t0,
+					 mpw_t *y,
+					 mpw_ptr t1,
+					 double rtol,
+					 double atol,
+					 mpw_ptr outstep,
+					 GelOdeMpwOutFunc out,
+					 int *nevals);
+
+#endif /* _ODESOLVE_H_ */
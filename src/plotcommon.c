@@ -0,0 +1,159 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vicious.h>
+
+#include "calc.h"
+#include "eval.h"
+#include "util.h"
+#include "dict.h"
+#include "geloutput.h"
+#include "mpwrap.h"
+
+#include "plotcommon.h"
+
+char *
+gel_plot_label_func (int i, GelEFunc *func, const char *var, const char *name)
+{
+	char *text = NULL;
+
+	if (name != NULL) {
+		return g_strdup (name);
+	} else if (func->id != NULL) {
+		text = g_strdup_printf ("%s(%s)", func->id->token, var);
+	} else if (func->type == GEL_USER_FUNC) {
+		int old_style, len;
+		GelOutput *out = gel_output_new ();
+		D_ENSURE_USER_BODY (func);
+		gel_output_setup_string (out, 0, NULL);
+
+		/* FIXME: the push/pop of style is UGLY */
+		old_style = gel_calcstate.output_style;
+		gel_calcstate.output_style = GEL_OUTPUT_NORMAL;
+		gel_print_etree (out, func->data.user, TRUE /* toplevel */);
+		gel_calcstate.output_style = old_style;
+
+		text = gel_output_snarf_string (out);
+		gel_output_unref (out);
+
+		len = strlen (text);
+
+		if (len > 2 &&
+		    text[0] == '(' &&
+		    text[len-1] == ')') {
+			char *s;
+			text[len-1] = '\0';
+			s = g_strdup (&text[1]);
+			g_free (text);
+			text = s;
+			len-=2;
+		}
+
+		/* only print bodies of short functions */
+		if (len > 64) {
+			g_free (text);
+			text = NULL;
+		}
+	}
+
+	if (text == NULL) {
+		if (i < 0)
+			text = g_strdup_printf (_("Function"));
+		else
+			text = g_strdup_printf (_("Function #%d"), i+1);
+	}
+
+	return text;
+}
+
+double
+gel_plot_call_func (GelCtx *ctx,
+		    GelEFunc *func,
+		    GelETree **args,
+		    int nargs,
+		    gboolean *ex,
+		    GelETree **func_ret)
+{
+	GelETree *ret;
+	double retd;
+	GelETree *fargs[4];
+	int i;
+
+	g_return_val_if_fail (nargs >= 0 && nargs <= 3, 0);
+
+	for (i = 0; i < nargs; i++)
+		fargs[i] = args[i];
+	fargs[nargs] = NULL;
+
+	ret = gel_funccall (ctx, func, fargs, nargs);
+
+	/* FIXME: handle errors! */
+	if G_UNLIKELY (gel_error_num != 0)
+		gel_error_num = 0;
+
+	/* only do one level of indirection to avoid infinite loops */
+	if (ret != NULL && ret->type == GEL_FUNCTION_NODE) {
+		if (ret->func.func->nargs == nargs) {
+			GelETree *ret2;
+			ret2 = gel_funccall (ctx, ret->func.func, fargs, nargs);
+			gel_freetree (ret);
+			ret = ret2;
+			/* FIXME: handle errors! */
+			if G_UNLIKELY (gel_error_num != 0)
+				gel_error_num = 0;
+		} else if (func_ret != NULL) {
+			*func_ret = ret;
+#ifdef HUGE_VAL
+			return HUGE_VAL;
+#else
+			return 0;
+#endif
+		}
+	}
+
+	if (ret == NULL || ret->type != GEL_VALUE_NODE) {
+		*ex = TRUE;
+		gel_freetree (ret);
+#ifdef HUGE_VAL
+		return HUGE_VAL;
+#else
+		return 0;
+#endif
+	}
+
+	retd = mpw_get_double (ret->val.value);
+	if G_UNLIKELY (gel_error_num != 0) {
+		*ex = TRUE;
+		gel_error_num = 0;
+#ifdef HUGE_VAL
+		retd = HUGE_VAL;
+#endif
+	}
+
+	gel_freetree (ret);
+	return retd;
+}
@@ -0,0 +1,45 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLOTCOMMON_H_
+#define PLOTCOMMON_H_
+
+/* Helpers shared by the gui plotting (graphing.c) and the command line
+ * plotting (plotrender.c) */
+
+/* The legend label for a plotted function, name if given, else the
+ * function name with var as the argument, else the body of a short
+ * anonymous function, else "Function #i+1" (or "Function" if i < 0).
+ * Returns a newly allocated string. */
+char *	gel_plot_label_func	(int i, GelEFunc *func, const char *var,
+				 const char *name);
+
+/* Call func with the nargs (at most 3) arguments in args with the
+ * interpreter and return the result as a double.  If it returns a
+ * function of nargs arguments, that gets called too.  If it returns a
+ * function of a different number of arguments and func_ret is not NULL,
+ * that function is put into func_ret (the caller frees it).  On error
+ * ex is set to TRUE. */
+double	gel_plot_call_func	(GelCtx *ctx, GelEFunc *func,
+				 GelETree **args, int nargs,
+				 gboolean *ex, GelETree **func_ret);
+
+#endif /* PLOTCOMMON_H_ */
@@ -0,0 +1,1170 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef HAVE_CAIRO
+#include <cairo.h>
+#ifdef CAIRO_HAS_SVG_SURFACE
+#include <cairo-svg.h>
+#endif
+#ifdef CAIRO_HAS_PDF_SURFACE
+#include <cairo-pdf.h>
+#endif
+#ifdef CAIRO_HAS_PS_SURFACE
+#include <cairo-ps.h>
+#endif
+#endif
+
+#include <vicious.h>
+
+#include "calc.h"
+#include "eval.h"
+#include "util.h"
+#include "dict.h"
+#include "funclib.h"
+#include "matrixw.h"
+#include "geloutput.h"
+#include "mpwrap.h"
+#include "dfunc.h"
+#include "plotcommon.h"
+
+#include "plotrender.h"
+
+/* The same sizes and layout as the plot window in the gui */
+#define MAXFUNC 10
+#define MINPLOT (1e-10)
+#define WIDTH 700
+#define HEIGHT 500
+#define PROPORTION 0.85
+#define PROPORTION3D 0.80
+#define PROPORTION_OFFSETX 0.1
+#define PROPORTION_OFFSETY 0.075
+#define PROPORTION3D_OFFSET 0.12
+
+/* two samples per pixel column */
+#define LINE_SAMPLES (2 * (int)(WIDTH * PROPORTION))
+/* the gui surface uses a 30 by 30 grid */
+#define SURFACE_STEPS 30
+
+typedef enum {
+	MODE_NONE = 0,
+	MODE_LINEPLOT,
+	MODE_SURFACE
+} PlotMode;
+
+static PlotMode plot_mode = MODE_NONE;
+
+static GelEFunc *plot_func[MAXFUNC] = { NULL };
+static char *plot_label[MAXFUNC] = { NULL };
+static double *plot_y[MAXFUNC] = { NULL };
+static gboolean *plot_ex[MAXFUNC] = { NULL };
+static double *plot_x = NULL;
+static double plotx1 = -10;
+static double plotx2 = 10;
+static double ploty1 = -10;
+static double ploty2 = 10;
+
+static GelEFunc *surface_func = NULL;
+static char *surface_label = NULL;
+static double *surface_z = NULL;
+static gboolean *surface_ex = NULL;
+static double surfacex1 = -10;
+static double surfacex2 = 10;
+static double surfacey1 = -10;
+static double surfacey2 = 10;
+static double surfacez1 = -10;
+static double surfacez2 = 10;
+static double surface_minz = 0;
+static double surface_maxz = 0;
+
+static GelCtx *plot_ctx = NULL;
+static GelETree *plot_arg[3] = { NULL, NULL, NULL };
+
+#include "funclibhelper.cP"
+
+#define GET_DOUBLE(var,argnum,func) \
+	{ \
+	if (a[argnum]->type != GEL_VALUE_NODE) { \
+		gel_errorout (_("%s: argument number %d not a number"), func, argnum+1); \
+		goto whack_copied_funcs; \
+	} \
+	var = mpw_get_double (a[argnum]->val.value); \
+	}
+
+static gboolean
+get_limits_from_matrix (GelETree *m, double *lim, int n)
+{
+	int i;
+
+	if (m->type != GEL_MATRIX_NODE ||
+	    gel_matrixw_elements (m->mat.matrix) != n) {
+		gel_errorout (_("Graph limits not given as a %d-vector"), n);
+		return FALSE;
+	}
+
+	for (i = 0; i < n; i++) {
+		GelETree *t = gel_matrixw_vindex (m->mat.matrix, i);
+		if (t->type != GEL_VALUE_NODE) {
+			gel_errorout (_("Graph limits not given as numbers"));
+			return FALSE;
+		}
+		lim[i] = mpw_get_double (t->val.value);
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Evaluate with the interpreter, for functions the double precision
+ * compiler does not handle */
+static double
+call_func (GelEFunc *func, int nargs, const double *args, gboolean *ex)
+{
+	GelETree *fargs[3];
+	int i, n;
+
+	if G_UNLIKELY (plot_ctx == NULL) {
+		plot_ctx = gel_eval_get_context ();
+		for (i = 0; i < 3; i++) {
+			mpw_t xx;
+			mpw_init (xx);
+			plot_arg[i] = gel_makenum_use (xx);
+		}
+	}
+
+	if (func->nargs == 1 && nargs == 2) {
+		/* a function of a complex variable */
+		mpw_set_d_complex (plot_arg[0]->val.value, args[0], args[1]);
+		fargs[0] = plot_arg[0];
+		n = 1;
+	} else if (func->nargs == 3 && nargs == 2) {
+		/* x, y and z=x+iy */
+		mpw_set_d (plot_arg[0]->val.value, args[0]);
+		mpw_set_d (plot_arg[1]->val.value, args[1]);
+		mpw_set_d_complex (plot_arg[2]->val.value, args[0], args[1]);
+		fargs[0] = plot_arg[0];
+		fargs[1] = plot_arg[1];
+		fargs[2] = plot_arg[2];
+		n = 3;
+	} else {
+		for (i = 0; i < nargs; i++) {
+			mpw_set_d (plot_arg[i]->val.value, args[i]);
+			fargs[i] = plot_arg[i];
+		}
+		n = nargs;
+	}
+
+	return gel_plot_call_func (plot_ctx, func, fargs, n, ex, NULL);
+}
+
+/* Sample f at n points, args holds nargs values for each point.  The
+ * compiled evaluator is used (in parallel) whenever possible. */
+static void
+sample_function (GelEFunc *f, int nargs, int n, const double *args,
+		 double *out, gboolean *ex)
+{
+	GelDFunc *df = NULL;
+	int i;
+
+	if (f->nargs == nargs)
+		df = gel_dfunc_compile (f, nargs);
+	if (df != NULL && gel_dfunc_prepare (df)) {
+		gel_dfunc_eval_many (df, n, args, out, ex,
+				     0 /* nthreads */, gel_evalnode_hook);
+		gel_dfunc_free (df);
+		return;
+	}
+	if (df != NULL)
+		gel_dfunc_free (df);
+
+	for (i = 0; i < n; i++) {
+		if G_UNLIKELY (gel_interrupted) {
+			ex[i] = TRUE;
+			continue;
+		}
+		ex[i] = FALSE;
+		out[i] = call_func (f, nargs, args + (gsize)i * nargs, &ex[i]);
+		if ( ! ex[i] && ! isfinite (out[i]))
+			ex[i] = TRUE;
+	}
+}
+
+static void
+line_plot_clear (void)
+{
+	int i;
+
+	for (i = 0; i < MAXFUNC; i++) {
+		if (plot_func[i] != NULL)
+			d_freefunc (plot_func[i]);
+		plot_func[i] = NULL;
+		g_free (plot_label[i]);
+		plot_label[i] = NULL;
+		g_free (plot_y[i]);
+		plot_y[i] = NULL;
+		g_free (plot_ex[i]);
+		plot_ex[i] = NULL;
+	}
+	g_free (plot_x);
+	plot_x = NULL;
+}
+
+static void
+surface_plot_clear (void)
+{
+	if (surface_func != NULL)
+		d_freefunc (surface_func);
+	surface_func = NULL;
+	g_free (surface_label);
+	surface_label = NULL;
+	g_free (surface_z);
+	surface_z = NULL;
+	g_free (surface_ex);
+	surface_ex = NULL;
+}
+
+static void
+sample_line_plot (gboolean fity)
+{
+	double miny = G_MAXDOUBLE;
+	double maxy = -G_MAXDOUBLE;
+	int i, k;
+
+	plot_x = g_new (double, LINE_SAMPLES);
+	for (k = 0; k < LINE_SAMPLES; k++)
+		plot_x[k] = plotx1 + (plotx2 - plotx1) * k / (LINE_SAMPLES - 1);
+
+	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
+		plot_y[i] = g_new (double, LINE_SAMPLES);
+		plot_ex[i] = g_new (gboolean, LINE_SAMPLES);
+		sample_function (plot_func[i], 1, LINE_SAMPLES, plot_x,
+				 plot_y[i], plot_ex[i]);
+		for (k = 0; k < LINE_SAMPLES; k++) {
+			if (plot_ex[i][k])
+				continue;
+			miny = MIN (miny, plot_y[i][k]);
+			maxy = MAX (maxy, plot_y[i][k]);
+		}
+	}
+
+	if (fity && miny <= maxy) {
+		double size = maxy - miny;
+		if (size <= 0)
+			size = 1.0;
+		ploty1 = miny - size * 0.05;
+		ploty2 = maxy + size * 0.05;
+
+		/* sanity */
+		if (ploty2 <= ploty1)
+			ploty2 = ploty1 + 0.1;
+		if (ploty1 < -(G_MAXDOUBLE/2))
+			ploty1 = -(G_MAXDOUBLE/2);
+		if (ploty2 > (G_MAXDOUBLE/2))
+			ploty2 = (G_MAXDOUBLE/2);
+	}
+}
+
+static void
+sample_surface_plot (gboolean fitz)
+{
+	int n = (SURFACE_STEPS + 1) * (SURFACE_STEPS + 1);
+	double *args;
+	int i, j, k;
+
+	args = g_new (double, 2 * n);
+	k = 0;
+	for (j = 0; j <= SURFACE_STEPS; j++) {
+		double y = surfacey1 + (surfacey2 - surfacey1) * j / SURFACE_STEPS;
+		for (i = 0; i <= SURFACE_STEPS; i++) {
+			args[k++] = surfacex1 + (surfacex2 - surfacex1) * i / SURFACE_STEPS;
+			args[k++] = y;
+		}
+	}
+
+	surface_z = g_new (double, n);
+	surface_ex = g_new (gboolean, n);
+	sample_function (surface_func, 2, n, args, surface_z, surface_ex);
+	g_free (args);
+
+	surface_minz = G_MAXDOUBLE;
+	surface_maxz = -G_MAXDOUBLE;
+	for (k = 0; k < n; k++) {
+		if (surface_ex[k])
+			continue;
+		surface_minz = MIN (surface_minz, surface_z[k]);
+		surface_maxz = MAX (surface_maxz, surface_z[k]);
+	}
+	if (surface_minz > surface_maxz) {
+		surface_minz = surfacez1;
+		surface_maxz = surfacez2;
+	}
+
+	if (fitz) {
+		double size = surface_maxz - surface_minz;
+		if (size <= 0)
+			size = 1.0;
+		surfacez1 = surface_minz - size * 0.05;
+		surfacez2 = surface_maxz + size * 0.05;
+	}
+}
+
+#ifdef HAVE_CAIRO
+
+static double
+nice_step (double range, int nticks)
+{
+	double raw = range / nticks;
+	double p = pow (10, floor (log10 (raw)));
+	double f = raw / p;
+
+	if (f < 1.5)
+		return p;
+	else if (f < 3)
+		return 2 * p;
+	else if (f < 7)
+		return 5 * p;
+	else
+		return 10 * p;
+}
+
+static void
+show_text (cairo_t *cr, double x, double y, const char *text,
+	   double xalign, double yalign)
+{
+	cairo_text_extents_t ext;
+
+	cairo_text_extents (cr, text, &ext);
+	cairo_move_to (cr,
+		       x - ext.x_bearing - ext.width * xalign,
+		       y - ext.y_bearing - ext.height * yalign);
+	cairo_show_text (cr, text);
+}
+
+static void
+tick_label (char *buf, gsize len, double v, double step)
+{
+	if (fabs (v) < step * 1e-6)
+		v = 0.0;
+	g_snprintf (buf, len, "%g", v);
+}
+
+/* hue goes from blue at the bottom to red at the top as in the gui */
+static void
+gradient_color (double value, double *r, double *g, double *b)
+{
+	double h, f;
+	int i;
+
+	value = CLAMP (value, 0.0, 1.0);
+	h = (1.0 - value) * 4.0;
+	i = (int)floor (h);
+	f = h - i;
+	switch (i) {
+	case 0: *r = 1; *g = f; *b = 0; break;
+	case 1: *r = 1-f; *g = 1; *b = 0; break;
+	case 2: *r = 0; *g = 1; *b = f; break;
+	case 3: *r = 0; *g = 1-f; *b = 1; break;
+	default: *r = 0; *g = 0; *b = 1; break;
+	}
+}
+
+static void
+draw_line_plot (cairo_t *cr)
+{
+	static const double colors[][3] = {
+		{ 0.0, 0.0, 0.55 },	/* darkblue */
+		{ 0.0, 0.39, 0.0 },	/* darkgreen */
+		{ 0.55, 0.0, 0.0 },	/* darkred */
+		{ 1.0, 0.0, 1.0 },	/* magenta */
+		{ 0.0, 0.0, 0.0 },	/* black */
+		{ 1.0, 0.55, 0.0 },	/* darkorange */
+		{ 0.0, 0.0, 1.0 },	/* blue */
+		{ 0.0, 1.0, 0.0 },	/* green */
+		{ 1.0, 0.0, 0.0 },	/* red */
+		{ 0.65, 0.16, 0.16 }	/* brown */
+	};
+	double left = WIDTH * PROPORTION_OFFSETX;
+	double top = HEIGHT * PROPORTION_OFFSETY;
+	double w = WIDTH * PROPORTION;
+	double h = HEIGHT * PROPORTION;
+	double sx = w / (plotx2 - plotx1);
+	double sy = h / (ploty2 - ploty1);
+	double step, v, ly;
+	char buf[64];
+	int i, k;
+
+#define PX(x) (left + ((x) - plotx1) * sx)
+#define PY(y) (top + h - ((y) - ploty1) * sy)
+
+	cairo_select_font_face (cr, "sans-serif",
+				CAIRO_FONT_SLANT_NORMAL,
+				CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size (cr, 11);
+
+	/* the axes through the origin */
+	cairo_set_line_width (cr, 1);
+	cairo_set_source_rgb (cr, 0.75, 0.75, 0.75);
+	if (plotx1 < 0 && plotx2 > 0) {
+		cairo_move_to (cr, PX (0), top);
+		cairo_line_to (cr, PX (0), top + h);
+	}
+	if (ploty1 < 0 && ploty2 > 0) {
+		cairo_move_to (cr, left, PY (0));
+		cairo_line_to (cr, left + w, PY (0));
+	}
+	cairo_stroke (cr);
+
+	/* frame, ticks and labels */
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_rectangle (cr, left, top, w, h);
+	cairo_stroke (cr);
+
+	step = nice_step (plotx2 - plotx1, 10);
+	for (v = ceil (plotx1 / step) * step; v <= plotx2 + step * 1e-9; v += step) {
+		cairo_move_to (cr, PX (v), top + h);
+		cairo_line_to (cr, PX (v), top + h - 5);
+		cairo_stroke (cr);
+		tick_label (buf, sizeof (buf), v, step);
+		show_text (cr, PX (v), top + h + 4, buf, 0.5, 0.0);
+	}
+	step = nice_step (ploty2 - ploty1, 10);
+	for (v = ceil (ploty1 / step) * step; v <= ploty2 + step * 1e-9; v += step) {
+		cairo_move_to (cr, left, PY (v));
+		cairo_line_to (cr, left + 5, PY (v));
+		cairo_stroke (cr);
+		tick_label (buf, sizeof (buf), v, step);
+		show_text (cr, left - 4, PY (v), buf, 1.0, 0.5);
+	}
+
+	/* the functions */
+	cairo_save (cr);
+	cairo_rectangle (cr, left, top, w, h);
+	cairo_clip (cr);
+	cairo_set_line_width (cr, 2);
+	cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
+		gboolean pen_down = FALSE;
+
+		cairo_set_source_rgb (cr, colors[i][0], colors[i][1],
+				      colors[i][2]);
+		for (k = 0; k < LINE_SAMPLES; k++) {
+			double py;
+
+			if (plot_ex[i][k]) {
+				pen_down = FALSE;
+				continue;
+			}
+			/* keep far off points from overflowing the
+			 * device coordinates */
+			py = CLAMP (PY (plot_y[i][k]), -HEIGHT, 2 * HEIGHT);
+			if (pen_down)
+				cairo_line_to (cr, PX (plot_x[k]), py);
+			else
+				cairo_move_to (cr, PX (plot_x[k]), py);
+			pen_down = TRUE;
+		}
+		cairo_stroke (cr);
+	}
+	cairo_restore (cr);
+
+	/* legends */
+	ly = top + 8;
+	for (i = 0; i < MAXFUNC && plot_func[i] != NULL; i++) {
+		cairo_text_extents_t ext;
+
+		cairo_text_extents (cr, plot_label[i], &ext);
+		cairo_set_source_rgb (cr, colors[i][0], colors[i][1],
+				      colors[i][2]);
+		cairo_set_line_width (cr, 2);
+		cairo_move_to (cr, left + w - ext.width - 40, ly + 6);
+		cairo_line_to (cr, left + w - ext.width - 16, ly + 6);
+		cairo_stroke (cr);
+		cairo_set_source_rgb (cr, 0, 0, 0);
+		show_text (cr, left + w - 8, ly + 6, plot_label[i], 1.0, 0.5);
+		ly += 16;
+	}
+
+#undef PX
+#undef PY
+}
+
+typedef struct {
+	double depth;
+	int cell;
+} SurfaceCell;
+
+static int
+surface_cell_compare (const void *a, const void *b)
+{
+	const SurfaceCell *ca = a;
+	const SurfaceCell *cb = b;
+	/* the farthest cell gets drawn first */
+	if (ca->depth > cb->depth)
+		return -1;
+	else if (ca->depth < cb->depth)
+		return 1;
+	return 0;
+}
+
+static void
+draw_surface_plot (cairo_t *cr)
+{
+	/* the default view of the gui */
+	const double phi = 30.0 * G_PI / 180.0;
+	const double theta = 30.0 * G_PI / 180.0;
+	const int nx = SURFACE_STEPS + 1;
+	double left = WIDTH * PROPORTION3D_OFFSET;
+	double top = HEIGHT * PROPORTION3D_OFFSET;
+	double w = WIDTH * PROPORTION3D;
+	double h = HEIGHT * PROPORTION3D;
+	double *px, *py, *pd;
+	double umin, umax, vmin, vmax, scale, cx, cy;
+	double cube[8][3];
+	SurfaceCell *cells;
+	int ncells;
+	int i, j, k;
+	char buf[64];
+
+	px = g_new (double, nx * nx);
+	py = g_new (double, nx * nx);
+	pd = g_new (double, nx * nx);
+
+	/* project the unit cube to get the scale */
+	umin = vmin = G_MAXDOUBLE;
+	umax = vmax = -G_MAXDOUBLE;
+	for (k = 0; k < 8; k++) {
+		double x = (k & 1) ? 0.5 : -0.5;
+		double y = (k & 2) ? 0.5 : -0.5;
+		double z = (k & 4) ? 0.5 : -0.5;
+		double u = x * cos (phi) - y * sin (phi);
+		double d = x * sin (phi) + y * cos (phi);
+		double v = z * cos (theta) + d * sin (theta);
+		cube[k][0] = u;
+		cube[k][1] = v;
+		cube[k][2] = d * cos (theta) - z * sin (theta);
+		umin = MIN (umin, u);
+		umax = MAX (umax, u);
+		vmin = MIN (vmin, v);
+		vmax = MAX (vmax, v);
+	}
+	scale = MIN (w / (umax - umin), h / (vmax - vmin));
+	cx = left + w / 2 - scale * (umin + umax) / 2;
+	cy = top + h / 2 + scale * (vmin + vmax) / 2;
+
+	for (j = 0; j < nx; j++) {
+		for (i = 0; i < nx; i++) {
+			double x = (double)i / SURFACE_STEPS - 0.5;
+			double y = (double)j / SURFACE_STEPS - 0.5;
+			double z, u, d, v;
+
+			k = j * nx + i;
+			z = (surface_z[k] - surfacez1) / (surfacez2 - surfacez1) - 0.5;
+			u = x * cos (phi) - y * sin (phi);
+			d = x * sin (phi) + y * cos (phi);
+			v = z * cos (theta) + d * sin (theta);
+			px[k] = cx + scale * u;
+			py[k] = cy - scale * v;
+			pd[k] = d * cos (theta) - z * sin (theta);
+		}
+	}
+
+	cairo_select_font_face (cr, "sans-serif",
+				CAIRO_FONT_SLANT_NORMAL,
+				CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size (cr, 11);
+
+	/* the box */
+	cairo_set_line_width (cr, 1);
+	cairo_set_source_rgb (cr, 0.75, 0.75, 0.75);
+	for (k = 0; k < 8; k++) {
+		int b;
+		for (b = 1; b < 8; b <<= 1) {
+			int l = k | b;
+			if (l == k)
+				continue;
+			cairo_move_to (cr, cx + scale * cube[k][0],
+				       cy - scale * cube[k][1]);
+			cairo_line_to (cr, cx + scale * cube[l][0],
+				       cy - scale * cube[l][1]);
+		}
+	}
+	cairo_stroke (cr);
+
+	/* axis ranges at the corners of the box */
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	g_snprintf (buf, sizeof (buf), "x: %g .. %g", surfacex1, surfacex2);
+	show_text (cr, cx + scale * (cube[0][0] + cube[1][0]) / 2,
+		   cy - scale * (cube[0][1] + cube[1][1]) / 2 + 4, buf,
+		   0.5, 0.0);
+	g_snprintf (buf, sizeof (buf), "y: %g .. %g", surfacey1, surfacey2);
+	show_text (cr, cx + scale * (cube[1][0] + cube[3][0]) / 2 + 6,
+		   cy - scale * (cube[1][1] + cube[3][1]) / 2 + 4, buf,
+		   0.0, 0.0);
+	g_snprintf (buf, sizeof (buf), "z: %g .. %g", surfacez1, surfacez2);
+	show_text (cr, cx + scale * cube[0][0] - 6,
+		   cy - scale * (cube[0][1] + cube[4][1]) / 2, buf,
+		   1.0, 0.5);
+
+	/* painter's algorithm over the grid cells, cells with a corner
+	 * outside of the box are left out as in the gui */
+	cells = g_new (SurfaceCell, SURFACE_STEPS * SURFACE_STEPS);
+	ncells = 0;
+	for (j = 0; j < SURFACE_STEPS; j++) {
+		for (i = 0; i < SURFACE_STEPS; i++) {
+			int c[4];
+			gboolean skip = FALSE;
+
+			c[0] = j * nx + i;
+			c[1] = c[0] + 1;
+			c[2] = c[0] + nx + 1;
+			c[3] = c[0] + nx;
+			for (k = 0; k < 4; k++) {
+				if (surface_ex[c[k]] ||
+				    surface_z[c[k]] < surfacez1 ||
+				    surface_z[c[k]] > surfacez2) {
+					skip = TRUE;
+					break;
+				}
+			}
+			if (skip)
+				continue;
+			cells[ncells].cell = c[0];
+			cells[ncells].depth = pd[c[0]] + pd[c[1]] +
+				pd[c[2]] + pd[c[3]];
+			ncells++;
+		}
+	}
+	qsort (cells, ncells, sizeof (SurfaceCell), surface_cell_compare);
+
+	cairo_set_line_width (cr, 0.5);
+	cairo_set_line_join (cr, CAIRO_LINE_JOIN_ROUND);
+	for (k = 0; k < ncells; k++) {
+		int c0 = cells[k].cell;
+		int c[4];
+		double zavg, r, g, b;
+		double minz = MAX (surfacez1, surface_minz);
+		double maxz = MIN (surfacez2, surface_maxz);
+
+		c[0] = c0;
+		c[1] = c0 + 1;
+		c[2] = c0 + nx + 1;
+		c[3] = c0 + nx;
+
+		zavg = (surface_z[c[0]] + surface_z[c[1]] +
+			surface_z[c[2]] + surface_z[c[3]]) / 4;
+		if (maxz > minz)
+			gradient_color ((zavg - minz) / (maxz - minz), &r, &g, &b);
+		else
+			gradient_color (0.5, &r, &g, &b);
+
+		cairo_move_to (cr, px[c[0]], py[c[0]]);
+		cairo_line_to (cr, px[c[1]], py[c[1]]);
+		cairo_line_to (cr, px[c[2]], py[c[2]]);
+		cairo_line_to (cr, px[c[3]], py[c[3]]);
+		cairo_close_path (cr);
+		cairo_set_source_rgb (cr, r, g, b);
+		cairo_fill_preserve (cr);
+		cairo_set_source_rgb (cr, 0, 0, 0);
+		cairo_stroke (cr);
+	}
+
+	/* the label */
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	show_text (cr, WIDTH - 8, 8, surface_label, 1.0, 0.0);
+
+	g_free (cells);
+	g_free (px);
+	g_free (py);
+	g_free (pd);
+}
+
+static void
+draw_plot (cairo_t *cr)
+{
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_paint (cr);
+
+	if (plot_mode == MODE_LINEPLOT)
+		draw_line_plot (cr);
+	else if (plot_mode == MODE_SURFACE)
+		draw_surface_plot (cr);
+}
+
+static gboolean
+export_plot (const char *file, const char *type)
+{
+	cairo_surface_t *surface = NULL;
+	cairo_status_t status;
+	cairo_t *cr;
+	gboolean png = FALSE;
+
+	if (strcasecmp (type, "png") == 0) {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+						      WIDTH, HEIGHT);
+		png = TRUE;
+#ifdef CAIRO_HAS_SVG_SURFACE
+	} else if (strcasecmp (type, "svg") == 0) {
+		surface = cairo_svg_surface_create (file, WIDTH, HEIGHT);
+#endif
+#ifdef CAIRO_HAS_PDF_SURFACE
+	} else if (strcasecmp (type, "pdf") == 0) {
+		surface = cairo_pdf_surface_create (file, WIDTH, HEIGHT);
+#endif
+#ifdef CAIRO_HAS_PS_SURFACE
+	} else if (strcasecmp (type, "eps") == 0 ||
+		   strcasecmp (type, "ps") == 0) {
+		surface = cairo_ps_surface_create (file, WIDTH, HEIGHT);
+		if (strcasecmp (type, "eps") == 0)
+			cairo_ps_surface_set_eps (surface, TRUE);
+#endif
+	} else {
+		gel_errorout (_("%s: unknown file type, can be \"png\", \"svg\", \"pdf\", \"eps\", or \"ps\"."), "ExportPlot");
+		return FALSE;
+	}
+
+	cr = cairo_create (surface);
+	draw_plot (cr);
+	status = cairo_status (cr);
+	cairo_destroy (cr);
+
+	if (status == CAIRO_STATUS_SUCCESS && png)
+		status = cairo_surface_write_to_png (surface, file);
+
+	cairo_surface_finish (surface);
+	if (status == CAIRO_STATUS_SUCCESS)
+		status = cairo_surface_status (surface);
+	cairo_surface_destroy (surface);
+
+	if (status != CAIRO_STATUS_SUCCESS) {
+		gel_errorout (_("%s: export failed"), "ExportPlot");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+#else /* ! HAVE_CAIRO */
+
+static gboolean
+export_plot (const char *file, const char *type)
+{
+	gel_errorout (_("%s: genius was compiled without cairo, cannot export"), "ExportPlot");
+	return FALSE;
+}
+
+#endif /* HAVE_CAIRO */
+
+static GelETree *
+LinePlot_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	double x1, x2, y1, y2;
+	int funcs = 0;
+	gboolean fity = FALSE;
+	GelEFunc *func[MAXFUNC] = { NULL };
+	int i;
+
+	for (i = 0;
+	     i < MAXFUNC && a[i] != NULL && a[i]->type == GEL_FUNCTION_NODE;
+	     i++) {
+		func[funcs] = d_copyfunc (a[i]->func.func);
+		func[funcs]->context = -1;
+		funcs++;
+	}
+
+	if G_UNLIKELY (a[i] != NULL && a[i]->type == GEL_FUNCTION_NODE) {
+		gel_errorout (_("%s: only up to 10 functions supported"), "LinePlot");
+		goto whack_copied_funcs;
+	}
+
+	if G_UNLIKELY (funcs == 0) {
+		gel_errorout (_("%s: argument not a function"), "LinePlot");
+		goto whack_copied_funcs;
+	}
+
+	/* Defaults */
+	x1 = -10;
+	x2 = 10;
+	y1 = -10;
+	y2 = 10;
+
+	if (a[i] != NULL) {
+		if (a[i]->type == GEL_MATRIX_NODE) {
+			double lim[4];
+			if (gel_matrixw_elements (a[i]->mat.matrix) == 4) {
+				if ( ! get_limits_from_matrix (a[i], lim, 4))
+					goto whack_copied_funcs;
+				x1 = lim[0];
+				x2 = lim[1];
+				y1 = lim[2];
+				y2 = lim[3];
+				fity = FALSE;
+			} else if (gel_matrixw_elements (a[i]->mat.matrix) == 2) {
+				if ( ! get_limits_from_matrix (a[i], lim, 2))
+					goto whack_copied_funcs;
+				x1 = lim[0];
+				x2 = lim[1];
+				fity = TRUE;
+			} else {
+				gel_errorout (_("Graph limits not given as a 2-vector or a 4-vector"));
+				goto whack_copied_funcs;
+			}
+			i++;
+		} else {
+			GET_DOUBLE(x1, i, "LinePlot");
+			i++;
+			if (a[i] != NULL) {
+				GET_DOUBLE(x2, i, "LinePlot");
+				i++;
+				fity = TRUE;
+				if (a[i] != NULL) {
+					GET_DOUBLE(y1, i, "LinePlot");
+					i++;
+					fity = FALSE;
+					if (a[i] != NULL) {
+						GET_DOUBLE(y2, i, "LinePlot");
+						i++;
+					}
+				}
+			}
+			if G_UNLIKELY (gel_error_num != 0) {
+				gel_error_num = 0;
+				goto whack_copied_funcs;
+			}
+		}
+	}
+
+	if G_UNLIKELY (x1 > x2) {
+		double s = x1;
+		x1 = x2;
+		x2 = s;
+	}
+
+	if G_UNLIKELY (y1 > y2) {
+		double s = y1;
+		y1 = y2;
+		y2 = s;
+	}
+
+	if G_UNLIKELY (x1 == x2) {
+		gel_errorout (_("%s: invalid X range"), "LinePlot");
+		goto whack_copied_funcs;
+	}
+
+	if G_UNLIKELY (y1 == y2) {
+		gel_errorout (_("%s: invalid Y range"), "LinePlot");
+		goto whack_copied_funcs;
+	}
+
+	line_plot_clear ();
+
+	for (i = 0; i < MAXFUNC && func[i] != NULL; i++) {
+		plot_func[i] = func[i];
+		plot_label[i] = gel_plot_label_func (i, func[i], "x", NULL);
+		func[i] = NULL;
+	}
+
+	plotx1 = x1;
+	plotx2 = MAX (x2, x1 + MINPLOT);
+	ploty1 = y1;
+	ploty2 = MAX (y2, y1 + MINPLOT);
+
+	plot_mode = MODE_LINEPLOT;
+	sample_line_plot (fity);
+
+	if G_UNLIKELY (gel_interrupted)
+		return NULL;
+	else
+		return gel_makenum_null ();
+
+whack_copied_funcs:
+	for (i = 0; i < MAXFUNC && func[i] != NULL; i++) {
+		d_freefunc (func[i]);
+		func[i] = NULL;
+	}
+
+	return NULL;
+}
+
+static GelETree *
+SurfacePlot_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	double x1, x2, y1, y2, z1, z2;
+	int i;
+	GelEFunc *func = NULL;
+	gboolean fitz = FALSE;
+
+	i = 0;
+
+	if (a[i] == NULL || a[i]->type != GEL_FUNCTION_NODE) {
+		gel_errorout (_("%s: argument not a function"), "SurfacePlot");
+		goto whack_copied_funcs;
+	}
+
+	func = d_copyfunc (a[i]->func.func);
+	func->context = -1;
+
+	i++;
+
+	if (a[i] != NULL && a[i]->type == GEL_FUNCTION_NODE) {
+		gel_errorout (_("%s: only one function supported"), "SurfacePlot");
+		goto whack_copied_funcs;
+	}
+
+	/* Defaults */
+	x1 = -10;
+	x2 = 10;
+	y1 = -10;
+	y2 = 10;
+	z1 = -10;
+	z2 = 10;
+
+	if (a[i] != NULL) {
+		if (a[i]->type == GEL_MATRIX_NODE) {
+			double lim[6];
+			if (gel_matrixw_elements (a[i]->mat.matrix) == 6) {
+				if ( ! get_limits_from_matrix (a[i], lim, 6))
+					goto whack_copied_funcs;
+				z1 = lim[4];
+				z2 = lim[5];
+				fitz = FALSE;
+			} else if (gel_matrixw_elements (a[i]->mat.matrix) == 4) {
+				if ( ! get_limits_from_matrix (a[i], lim, 4))
+					goto whack_copied_funcs;
+				fitz = TRUE;
+			} else {
+				gel_errorout (_("Graph limits not given as a 4-vector or a 6-vector"));
+				goto whack_copied_funcs;
+			}
+			x1 = lim[0];
+			x2 = lim[1];
+			y1 = lim[2];
+			y2 = lim[3];
+			i++;
+		} else {
+			GET_DOUBLE(x1, i, "SurfacePlot");
+			i++;
+			if (a[i] != NULL) {
+				GET_DOUBLE(x2, i, "SurfacePlot");
+				i++;
+				if (a[i] != NULL) {
+					GET_DOUBLE(y1, i, "SurfacePlot");
+					i++;
+					if (a[i] != NULL) {
+						GET_DOUBLE(y2, i, "SurfacePlot");
+						i++;
+						fitz = TRUE;
+						if (a[i] != NULL) {
+							GET_DOUBLE(z1, i, "SurfacePlot");
+							i++;
+							fitz = FALSE;
+							if (a[i] != NULL) {
+								GET_DOUBLE(z2, i, "SurfacePlot");
+								i++;
+							}
+						}
+					}
+				}
+			}
+			if G_UNLIKELY (gel_error_num != 0) {
+				gel_error_num = 0;
+				goto whack_copied_funcs;
+			}
+		}
+	}
+
+	if (x1 > x2) {
+		double s = x1;
+		x1 = x2;
+		x2 = s;
+	}
+
+	if (y1 > y2) {
+		double s = y1;
+		y1 = y2;
+		y2 = s;
+	}
+
+	if (z1 > z2) {
+		double s = z1;
+		z1 = z2;
+		z2 = s;
+	}
+
+	if (x1 == x2) {
+		gel_errorout (_("%s: invalid X range"), "SurfacePlot");
+		goto whack_copied_funcs;
+	}
+
+	if (y1 == y2) {
+		gel_errorout (_("%s: invalid Y range"), "SurfacePlot");
+		goto whack_copied_funcs;
+	}
+
+	if (z1 == z2) {
+		gel_errorout (_("%s: invalid Z range"), "SurfacePlot");
+		goto whack_copied_funcs;
+	}
+
+	surface_plot_clear ();
+
+	surface_func = func;
+	surface_label = gel_plot_label_func (-1, func, "x,y", NULL);
+	func = NULL;
+
+	surfacex1 = x1;
+	surfacex2 = x2;
+	surfacey1 = y1;
+	surfacey2 = y2;
+	surfacez1 = z1;
+	surfacez2 = z2;
+
+	plot_mode = MODE_SURFACE;
+	sample_surface_plot (fitz);
+
+	if (gel_interrupted)
+		return NULL;
+	else
+		return gel_makenum_null ();
+
+whack_copied_funcs:
+	if (func != NULL) {
+		d_freefunc (func);
+		func = NULL;
+	}
+
+	return NULL;
+}
+
+static GelETree *
+LinePlotClear_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	line_plot_clear ();
+	plot_mode = MODE_LINEPLOT;
+
+	return gel_makenum_null ();
+}
+
+static GelETree *
+SurfacePlotClear_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	surface_plot_clear ();
+	plot_mode = MODE_SURFACE;
+
+	return gel_makenum_null ();
+}
+
+/* There is no window or canvas, these just let scripts written for the
+ * gui run unchanged */
+static GelETree *
+PlotCanvasFreeze_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	return gel_makenum_null ();
+}
+
+static GelETree *
+PlotCanvasThaw_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	return gel_makenum_null ();
+}
+
+static GelETree *
+PlotWindowPresent_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	return gel_makenum_null ();
+}
+
+static GelETree *
+ExportPlot_op (GelCtx *ctx, GelETree * * a, int *exception)
+{
+	char *file;
+	char *type;
+
+	if (a[0]->type != GEL_STRING_NODE ||
+	    ve_string_empty(a[0]->str.str)) {
+		gel_errorout (_("%s: first argument not a nonempty string"), "ExportPlot");
+		return NULL;
+	}
+	file = a[0]->str.str;
+
+	if (a[1] == NULL) {
+		char *dot = strrchr (file, '.');
+		if (dot == NULL) {
+			gel_errorout (_("%s: type not specified and filename has no extension"), "ExportPlot");
+			return NULL;
+		}
+		type = dot+1;
+	} else {
+		if (a[1]->type != GEL_STRING_NODE ||
+		    ve_string_empty(a[1]->str.str)) {
+			gel_errorout (_("%s: second argument not a nonempty string"), "ExportPlot");
+			return NULL;
+		}
+		type = a[1]->str.str;
+
+		if (a[2] != NULL) {
+			gel_errorout (_("%s: too many arguments"), "ExportPlot");
+			return NULL;
+		}
+	}
+
+	if (plot_mode == MODE_NONE ||
+	    (plot_mode == MODE_LINEPLOT && plot_func[0] == NULL) ||
+	    (plot_mode == MODE_SURFACE && surface_func == NULL)) {
+		gel_errorout (_("%s: nothing has been plotted, cannot export"), "ExportPlot");
+		return NULL;
+	}
+
+	if ( ! export_plot (file, type))
+		return NULL;
+
+	return gel_makenum_bool (TRUE);
+}
+
+void
+gel_add_headless_graph_functions (void)
+{
+	GelEFunc *f;
+
+	gel_new_category ("plotting", N_("Plotting"), TRUE /* internal */);
+
+	VFUNC (LinePlot, 2, "func,args", "plotting", N_("Plot a function with a line.  First come the functions (up to 10) then optionally limits as x1,x2,y1,y2"));
+	VFUNC (SurfacePlot, 2, "func,args", "plotting", N_("Plot a surface function which takes either two arguments or a complex number.  First comes the function then optionally limits as x1,x2,y1,y2,z1,z2"));
+
+	FUNC (LinePlotClear, 0, "", "plotting", N_("Show the line plot window and clear out functions"));
+	FUNC (SurfacePlotClear, 0, "", "plotting", N_("Show the surface (3d) plot window and clear out functions"));
+
+	FUNC (PlotCanvasFreeze, 0, "", "plotting", N_("Freeze the plot canvas, that is, inhibit drawing"));
+	FUNC (PlotCanvasThaw, 0, "", "plotting", N_("Thaw the plot canvas and redraw the plot immediately"));
+	FUNC (PlotWindowPresent, 0, "", "plotting", N_("Raise the plot window, and create the window if necessary"));
+
+	VFUNC (ExportPlot, 2, "filename,type", "plotting", N_("Export the current plot to a file.  The file type is given by the string type, which can be \"png\", \"svg\", \"pdf\", \"eps\", or \"ps\"."));
+}
@@ -0,0 +1,31 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLOTRENDER_H_
+#define PLOTRENDER_H_
+
+/* Plotting for the command line genius: LinePlot, SurfacePlot and
+ * friends keep the plot in memory and ExportPlot draws it straight to a
+ * png, svg, pdf, eps or ps file with cairo, no display needed.  The
+ * gui has its own versions of these in graphing.c */
+void gel_add_headless_graph_functions (void);
+
+#endif /* PLOTRENDER_H_ */
@@ -0,0 +1,601 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "calc.h"
+#include "mpwrap.h"
+
+#include "polynomial.h"
+
+mpw_t *
+gel_poly_new (int len)
+{
+	mpw_t *a;
+	int i;
+
+	if (len <= 0)
+		return NULL;
+	a = g_new (mpw_t, len);
+	for (i = 0; i < len; i++)
+		mpw_init (a[i]);
+	return a;
+}
+
+void
+gel_poly_free (mpw_t *a, int len)
+{
+	int i;
+	for (i = 0; i < len; i++)
+		mpw_clear (a[i]);
+	g_free (a);
+}
+
+mpw_t *
+gel_poly_copy (mpw_t *a, int len)
+{
+	mpw_t *r;
+	int i;
+
+	if (len <= 0)
+		return NULL;
+	r = g_new (mpw_t, len);
+	for (i = 0; i < len; i++)
+		mpw_init_set (r[i], a[i]);
+	return r;
+}
+
+int
+gel_poly_trim_len (mpw_t *a, int len)
+{
+	while (len > 0 && mpw_zero_p (a[len-1]))
+		len--;
+	return len;
+}
+
+/* Trim the array in place, the storage is kept */
+static mpw_t *
+poly_trim (mpw_t *a, int len, int *lr)
+{
+	int l = gel_poly_trim_len (a, len);
+	int i;
+
+	if (l == len) {
+		*lr = len;
+		return a;
+	}
+	for (i = l; i < len; i++)
+		mpw_clear (a[i]);
+	*lr = l;
+	if (l == 0) {
+		g_free (a);
+		return NULL;
+	}
+	return a;
+}
+
+static mpw_t *
+poly_add_sub (mpw_t *a, int la, mpw_t *b, int lb, int *lr, gboolean sub)
+{
+	int len = MAX (la, lb);
+	mpw_t *r;
+	int i;
+
+	if (len == 0) {
+		*lr = 0;
+		return NULL;
+	}
+	r = g_new (mpw_t, len);
+	for (i = 0; i < len; i++) {
+		if (i < la && i < lb) {
+			mpw_init (r[i]);
+			if (sub)
+				mpw_sub (r[i], a[i], b[i]);
+			else
+				mpw_add (r[i], a[i], b[i]);
+		} else if (i < la) {
+			mpw_init_set (r[i], a[i]);
+		} else {
+			mpw_init_set (r[i], b[i]);
+			if (sub)
+				mpw_neg (r[i], r[i]);
+		}
+	}
+	return poly_trim (r, len, lr);
+}
+
+mpw_t *
+gel_poly_add (mpw_t *a, int la, mpw_t *b, int lb, int *lr)
+{
+	return poly_add_sub (a, la, b, lb, lr, FALSE);
+}
+
+mpw_t *
+gel_poly_sub (mpw_t *a, int la, mpw_t *b, int lb, int *lr)
+{
+	return poly_add_sub (a, la, b, lb, lr, TRUE);
+}
+
+/*
+ * Multiplication, all of these add a*b into r which has la+lb-1
+ * initialized coefficients
+ */
+
+static void
+mul_school (mpw_t *r, mpw_t *a, int la, mpw_t *b, int lb, mpw_ptr tmp)
+{
+	int i, j;
+
+	for (i = 0; i < la; i++) {
+		if (mpw_zero_p (a[i]))
+			continue;
+		for (j = 0; j < lb; j++) {
+			if (mpw_zero_p (b[j]))
+				continue;
+			mpw_mul (tmp, a[i], b[j]);
+			mpw_add (r[i+j], r[i+j], tmp);
+		}
+	}
+}
+
+/* both of length n */
+static void
+mul_karatsuba (mpw_t *r, mpw_t *a, mpw_t *b, int n, mpw_ptr tmp)
+{
+	mpw_t *s, *t, *z0, *z1, *z2;
+	int m, h, i;
+
+	if (n < GEL_POLY_KARATSUBA_CUTOFF) {
+		mul_school (r, a, n, b, n, tmp);
+		return;
+	}
+
+	/* a = a0 + x^m a1 with a0 of length m and a1 of length h >= m,
+	 * then ab = z0 + x^m ((a0+a1)(b0+b1) - z0 - z2) + x^2m z2 where
+	 * z0 = a0 b0 and z2 = a1 b1 */
+	m = n / 2;
+	h = n - m;
+
+	s = gel_poly_new (h);
+	t = gel_poly_new (h);
+	z0 = gel_poly_new (2*m-1);
+	z1 = gel_poly_new (2*h-1);
+	z2 = gel_poly_new (2*h-1);
+
+	for (i = 0; i < h; i++) {
+		if (i < m) {
+			mpw_add (s[i], a[i], a[m+i]);
+			mpw_add (t[i], b[i], b[m+i]);
+		} else {
+			mpw_set (s[i], a[m+i]);
+			mpw_set (t[i], b[m+i]);
+		}
+	}
+
+	mul_karatsuba (z0, a, b, m, tmp);
+	mul_karatsuba (z2, a+m, b+m, h, tmp);
+	mul_karatsuba (z1, s, t, h, tmp);
+
+	for (i = 0; i < 2*m-1; i++) {
+		mpw_add (r[i], r[i], z0[i]);
+		mpw_sub (z1[i], z1[i], z0[i]);
+	}
+	for (i = 0; i < 2*h-1; i++) {
+		mpw_add (r[2*m+i], r[2*m+i], z2[i]);
+		mpw_sub (z1[i], z1[i], z2[i]);
+		mpw_add (r[m+i], r[m+i], z1[i]);
+	}
+
+	gel_poly_free (s, h);
+	gel_poly_free (t, h);
+	gel_poly_free (z0, 2*m-1);
+	gel_poly_free (z1, 2*h-1);
+	gel_poly_free (z2, 2*h-1);
+}
+
+static void
+mul_into (mpw_t *r, mpw_t *a, int la, mpw_t *b, int lb, mpw_ptr tmp)
+{
+	int i;
+
+	if (la < lb) {
+		mpw_t *p = a;
+		int l = la;
+		a = b;
+		la = lb;
+		b = p;
+		lb = l;
+	}
+
+	if (lb < GEL_POLY_KARATSUBA_CUTOFF) {
+		mul_school (r, a, la, b, lb, tmp);
+		return;
+	}
+
+	/* cut the longer one into pieces as long as the shorter one */
+	for (i = 0; i < la; i += lb) {
+		int n = MIN (lb, la - i);
+		if (n == lb)
+			mul_karatsuba (r + i, a + i, b, lb, tmp);
+		else
+			mul_into (r + i, b, lb, a + i, n, tmp);
+	}
+}
+
+mpw_t *
+gel_poly_mul (mpw_t *a, int la, mpw_t *b, int lb, int *lr)
+{
+	mpw_t *r;
+	mpw_t tmp;
+	int len;
+
+	if (la == 0 || lb == 0) {
+		*lr = 0;
+		return NULL;
+	}
+
+	len = la + lb - 1;
+	r = gel_poly_new (len);
+	mpw_init (tmp);
+	mul_into (r, a, la, b, lb, tmp);
+	mpw_clear (tmp);
+
+	return poly_trim (r, len, lr);
+}
+
+/* the first n coefficients of ab, r is new */
+static mpw_t *
+mul_low (mpw_t *a, int la, mpw_t *b, int lb, int n)
+{
+	mpw_t *p, *r;
+	int lp, i;
+
+	p = gel_poly_mul (a, MIN (la, n), b, MIN (lb, n), &lp);
+	r = gel_poly_new (n);
+	for (i = 0; i < n && i < lp; i++)
+		mpw_set (r[i], p[i]);
+	gel_poly_free (p, lp);
+	return r;
+}
+
+mpw_t *
+gel_poly_pow (mpw_t *a, int la, unsigned long e, int *lr)
+{
+	mpw_t *r, *sq;
+	int len, lsq;
+
+	r = gel_poly_new (1);
+	mpw_set_ui (r[0], 1);
+	len = 1;
+	if (e == 0) {
+		*lr = 1;
+		return r;
+	}
+	if (la == 0) {
+		gel_poly_free (r, 1);
+		*lr = 0;
+		return NULL;
+	}
+
+	sq = gel_poly_copy (a, la);
+	lsq = la;
+	for (;;) {
+		if (e & 1) {
+			int ln;
+			mpw_t *n = gel_poly_mul (r, len, sq, lsq, &ln);
+			gel_poly_free (r, len);
+			r = n;
+			len = ln;
+		}
+		e >>= 1;
+		if (e == 0 || gel_interrupted)
+			break;
+		{
+			int ln;
+			mpw_t *n = gel_poly_mul (sq, lsq, sq, lsq, &ln);
+			gel_poly_free (sq, lsq);
+			sq = n;
+			lsq = ln;
+		}
+	}
+	gel_poly_free (sq, lsq);
+
+	*lr = len;
+	return r;
+}
+
+mpw_t *
+gel_poly_derivative (mpw_t *a, int la, int *lr)
+{
+	mpw_t *r;
+	int i;
+
+	if (la <= 1) {
+		*lr = 0;
+		return NULL;
+	}
+	r = gel_poly_new (la-1);
+	for (i = 1; i < la; i++)
+		mpw_mul_ui (r[i-1], a[i], i);
+	return poly_trim (r, la-1, lr);
+}
+
+/*
+ * Division
+ */
+
+/* The first n coefficients of the power series 1/f, f[0] != 0, by the
+ * Newton iteration g <- g (2 - f g) which doubles the correct terms */
+static mpw_t *
+inverse_series (mpw_t *f, int lf, int n)
+{
+	mpw_t *g, *e, *ng;
+	int len, len2, i;
+
+	g = gel_poly_new (n);
+	mpw_set_ui (g[0], 1);
+	mpw_div (g[0], g[0], f[0]);
+
+	len = 1;
+	while (len < n) {
+		len2 = MIN (2*len, n);
+		/* e = 2 - f g mod x^len2 */
+		e = mul_low (f, lf, g, len, len2);
+		for (i = 0; i < len2; i++)
+			mpw_neg (e[i], e[i]);
+		mpw_add_ui (e[0], e[0], 2);
+		ng = mul_low (g, len, e, len2, len2);
+		gel_poly_free (e, len2);
+		for (i = 0; i < len2; i++)
+			mpw_set (g[i], ng[i]);
+		gel_poly_free (ng, len2);
+		len = len2;
+
+		if G_UNLIKELY (gel_interrupted)
+			break;
+	}
+
+	return g;
+}
+
+/* Quotient of length lq = la-lb+1 from the reversed polynomials,
+ * rev(q) = rev(a) / rev(b) mod x^lq */
+static mpw_t *
+quotient_newton (mpw_t *a, int la, mpw_t *b, int lb, int lq)
+{
+	mpw_t *ra, *rb, *inv, *rq, *q;
+	int i;
+
+	ra = g_new (mpw_t, lq);
+	for (i = 0; i < lq; i++)
+		mpw_init_set (ra[i], a[la-1-i]);
+	rb = g_new (mpw_t, MIN (lb, lq));
+	for (i = 0; i < MIN (lb, lq); i++)
+		mpw_init_set (rb[i], b[lb-1-i]);
+
+	inv = inverse_series (rb, MIN (lb, lq), lq);
+	rq = mul_low (ra, lq, inv, lq, lq);
+
+	q = g_new (mpw_t, lq);
+	for (i = 0; i < lq; i++)
+		mpw_init_set (q[i], rq[lq-1-i]);
+
+	gel_poly_free (ra, lq);
+	gel_poly_free (rb, MIN (lb, lq));
+	gel_poly_free (inv, lq);
+	gel_poly_free (rq, lq);
+
+	return q;
+}
+
+static gboolean
+poly_any_float (mpw_t *a, int la)
+{
+	int i;
+	for (i = 0; i < la; i++)
+		if (mpw_is_complex_float (a[i]))
+			return TRUE;
+	return FALSE;
+}
+
+gboolean
+gel_poly_divrem (mpw_t *a, int la, mpw_t *b, int lb,
+		 mpw_t **q, int *lq, mpw_t **r, int *lr)
+{
+	mpw_t *qq, *rr = NULL;
+	int lqq, lrr = 0, i, j;
+
+	la = gel_poly_trim_len (a, la);
+	lb = gel_poly_trim_len (b, lb);
+	if (lb == 0)
+		return FALSE;
+
+	if (la < lb) {
+		if (q != NULL) {
+			*q = NULL;
+			*lq = 0;
+		}
+		if (r != NULL) {
+			*r = gel_poly_copy (a, la);
+			*lr = la;
+		}
+		return TRUE;
+	}
+
+	lqq = la - lb + 1;
+
+	/* with floats the inverse series is too unstable */
+	if (lb >= GEL_POLY_NEWTON_CUTOFF &&
+	    lqq >= GEL_POLY_NEWTON_CUTOFF &&
+	    ! poly_any_float (a, la) &&
+	    ! poly_any_float (b, lb)) {
+		qq = quotient_newton (a, la, b, lb, lqq);
+		if (r != NULL) {
+			int lp;
+			mpw_t *p = gel_poly_mul (qq, lqq, b, lb, &lp);
+			rr = gel_poly_sub (a, MIN (la, lb-1), p,
+					   MIN (lp, lb-1), &lrr);
+			gel_poly_free (p, lp);
+		}
+	} else {
+		/* long division */
+		mpw_t tmp;
+
+		mpw_init (tmp);
+		qq = gel_poly_new (lqq);
+		rr = gel_poly_copy (a, la);
+		for (i = lqq-1; i >= 0; i--) {
+			mpw_ptr c = rr[i+lb-1];
+			if (mpw_zero_p (c))
+				continue;
+			mpw_div (qq[i], c, b[lb-1]);
+			for (j = 0; j < lb-1; j++) {
+				if (mpw_zero_p (b[j]))
+					continue;
+				mpw_mul (tmp, qq[i], b[j]);
+				mpw_sub (rr[i+j], rr[i+j], tmp);
+			}
+			mpw_set_ui (c, 0);
+		}
+		mpw_clear (tmp);
+		rr = poly_trim (rr, la, &lrr);
+	}
+
+	qq = poly_trim (qq, lqq, &lqq);
+
+	if (q != NULL) {
+		*q = qq;
+		*lq = lqq;
+	} else {
+		gel_poly_free (qq, lqq);
+	}
+	if (r != NULL) {
+		*r = rr;
+		*lr = lrr;
+	} else {
+		gel_poly_free (rr, lrr);
+	}
+
+	return TRUE;
+}
+
+/* Make a monic in place */
+static void
+poly_make_monic (mpw_t *a, int la, mpw_ptr tmp)
+{
+	int i;
+
+	if (la == 0)
+		return;
+	mpw_set (tmp, a[la-1]);
+	for (i = 0; i < la-1; i++)
+		mpw_div (a[i], a[i], tmp);
+	mpw_set_ui (a[la-1], 1);
+}
+
+mpw_t *
+gel_poly_gcd (mpw_t *a, int la, mpw_t *b, int lb, int *lr)
+{
+	mpw_t *x, *y;
+	int lx, ly;
+	gboolean floats;
+	mpw_t tmp, tol;
+
+	la = gel_poly_trim_len (a, la);
+	lb = gel_poly_trim_len (b, lb);
+
+	floats = poly_any_float (a, la) || poly_any_float (b, lb);
+
+	mpw_init (tmp);
+	mpw_init (tol);
+	if (floats) {
+		/* 2^(-prec/2) */
+		mpw_set_ui (tol, 2);
+		mpw_set_ui (tmp, gel_calcstate.float_prec / 2);
+		mpw_pow (tol, tol, tmp);
+		mpw_set_ui (tmp, 1);
+		mpw_make_float (tmp);
+		mpw_div (tol, tmp, tol);
+	}
+
+	x = gel_poly_copy (a, la);
+	lx = la;
+	y = gel_poly_copy (b, lb);
+	ly = lb;
+	poly_make_monic (x, lx, tmp);
+	poly_make_monic (y, ly, tmp);
+
+	while (ly > 0) {
+		mpw_t *r;
+		int lrem;
+
+		if G_UNLIKELY (gel_interrupted)
+			break;
+
+		gel_poly_divrem (x, lx, y, ly, NULL, NULL, &r, &lrem);
+		if (floats) {
+			/* y is monic, drop what is just rounding */
+			while (lrem > 0) {
+				mpw_abs (tmp, r[lrem-1]);
+				if (mpw_cmp (tmp, tol) > 0)
+					break;
+				lrem--;
+				mpw_clear (r[lrem]);
+			}
+			if (lrem == 0) {
+				g_free (r);
+				r = NULL;
+			}
+		}
+		poly_make_monic (r, lrem, tmp);
+
+		gel_poly_free (x, lx);
+		x = y;
+		lx = ly;
+		y = r;
+		ly = lrem;
+	}
+	gel_poly_free (y, ly);
+
+	mpw_clear (tmp);
+	mpw_clear (tol);
+
+	*lr = lx;
+	return x;
+}
+
+void
+gel_poly_eval (mpw_ptr rop, mpw_t *a, int la, mpw_ptr x)
+{
+	mpw_t res;
+	int i;
+
+	mpw_init (res);
+	for (i = la-1; i >= 0; i--) {
+		mpw_mul (res, res, x);
+		mpw_add (res, res, a[i]);
+	}
+	mpw_set (rop, res);
+	mpw_clear (res);
+}
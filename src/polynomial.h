@@ -0,0 +1,105 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POLYNOMIAL_H_
+#define _POLYNOMIAL_H_
+
+#include <glib.h>
+#include "mpwrap.h"
+
+/* Dense polynomials in one variable, stored as a contiguous array of
+ * mpw coefficients from the constant term up.  The coefficients may be
+ * exact or floats (or complex).  Results are always trimmed, so the
+ * last coefficient is nonzero, and the zero polynomial has length 0
+ * (and a NULL array).  The arrays are allocated with g_new. */
+
+/* Multiply by splitting in halves (Karatsuba) once both factors have at
+ * least this many coefficients */
+#define GEL_POLY_KARATSUBA_CUTOFF 24
+/* Divide exact polynomials via a Newton iteration for the inverse power
+ * series once both the divisor and the quotient have at least this many
+ * coefficients */
+#define GEL_POLY_NEWTON_CUTOFF 64
+
+/* len new zero coefficients */
+mpw_t *		gel_poly_new		(int len);
+void		gel_poly_free		(mpw_t *a,
+					 int len);
+mpw_t *		gel_poly_copy		(mpw_t *a,
+					 int len);
+
+/* Length of a without the zero leading coefficients */
+int		gel_poly_trim_len	(mpw_t *a,
+					 int len);
+
+/* These return a new array and its length in lr */
+mpw_t *		gel_poly_add		(mpw_t *a,
+					 int la,
+					 mpw_t *b,
+					 int lb,
+					 int *lr);
+mpw_t *		gel_poly_sub		(mpw_t *a,
+					 int la,
+					 mpw_t *b,
+					 int lb,
+					 int *lr);
+mpw_t *		gel_poly_mul		(mpw_t *a,
+					 int la,
+					 mpw_t *b,
+					 int lb,
+					 int *lr);
+/* a^e by repeated squaring */
+mpw_t *		gel_poly_pow		(mpw_t *a,
+					 int la,
+					 unsigned long e,
+					 int *lr);
+mpw_t *		gel_poly_derivative	(mpw_t *a,
+					 int la,
+					 int *lr);
+
+/* Division with remainder a = qb + r with deg r < deg b, q or r may be
+ * NULL if not wanted.  Returns FALSE if b is zero. */
+gboolean	gel_poly_divrem		(mpw_t *a,
+					 int la,
+					 mpw_t *b,
+					 int lb,
+					 mpw_t **q,
+					 int *lq,
+					 mpw_t **r,
+					 int *lr);
+
+/* The monic greatest common divisor by the Euclidean algorithm.  If any
+ * coefficient is a float, remainder coefficients that are small
+ * relative to the divisor (about half the float precision) are taken
+ * to be zero. */
+mpw_t *		gel_poly_gcd		(mpw_t *a,
+					 int la,
+					 mpw_t *b,
+					 int lb,
+					 int *lr);
+
+/* rop = a(x) by Horner's rule, rop should be initialized */
+void		gel_poly_eval		(mpw_ptr rop,
+					 mpw_t *a,
+					 int la,
+					 mpw_ptr x);
+
+#endif /* _POLYNOMIAL_H_ */
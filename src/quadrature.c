@@ -0,0 +1,526 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <float.h>
+
+#include "calc.h"
+#include "mpwrap.h"
+
+#include "quadrature.h"
+
+/* The Gauss-Kronrod 7-15 nodes and weights from QUADPACK, the Gauss
+ * nodes are the odd ones and the center */
+static const double xgk[8] = {
+	0.991455371120812639206854697526329,
+	0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926,
+	0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013,
+	0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245,
+	0.000000000000000000000000000000000
+};
+static const double wgk[8] = {
+	0.022935322010529224963732008058970,
+	0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518,
+	0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550,
+	0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649,
+	0.209482141084727828012999174891714
+};
+static const double wg[4] = {
+	0.129484966168869693270611432679082,
+	0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975,
+	0.417959183673469387755102040816327
+};
+
+typedef struct {
+	double a, b;
+	double result;
+	double err;
+} QuadInterval;
+
+/* the 15 points for [a,b], the center first and then pairs symmetric
+ * about it */
+static void
+gk15_points (double a, double b, double *x)
+{
+	double c = 0.5 * (a + b);
+	double hl = 0.5 * (b - a);
+	int j;
+
+	x[0] = c;
+	for (j = 0; j < 7; j++) {
+		x[1+2*j] = c - hl * xgk[j];
+		x[2+2*j] = c + hl * xgk[j];
+	}
+}
+
+/* QUADPACK's qk15 from the values at gk15_points */
+static void
+gk15_rule (QuadInterval *in, const double *fv)
+{
+	double hl = 0.5 * (in->b - in->a);
+	double dhl = fabs (hl);
+	double resg, resk, resabs, resasc, reskh, err;
+	int j;
+
+	resg = fv[0] * wg[3];
+	resk = fv[0] * wgk[7];
+	resabs = fabs (resk);
+	for (j = 0; j < 7; j++) {
+		double fsum = fv[1+2*j] + fv[2+2*j];
+		resk += wgk[j] * fsum;
+		resabs += wgk[j] * (fabs (fv[1+2*j]) + fabs (fv[2+2*j]));
+		if (j & 1)
+			resg += wg[j/2] * fsum;
+	}
+
+	reskh = 0.5 * resk;
+	resasc = wgk[7] * fabs (fv[0] - reskh);
+	for (j = 0; j < 7; j++)
+		resasc += wgk[j] * (fabs (fv[1+2*j] - reskh) +
+				    fabs (fv[2+2*j] - reskh));
+
+	resabs *= dhl;
+	resasc *= dhl;
+	err = fabs ((resk - resg) * hl);
+	if (resasc != 0.0 && err != 0.0)
+		err = resasc * MIN (1.0, pow (200.0 * err / resasc, 1.5));
+	if (resabs > DBL_MIN / (50.0 * DBL_EPSILON))
+		err = MAX (50.0 * DBL_EPSILON * resabs, err);
+
+	in->result = resk * hl;
+	in->err = err;
+}
+
+/* a max heap on the error */
+static void
+heap_push (GArray *heap, const QuadInterval *in)
+{
+	QuadInterval *h;
+	int i;
+
+	g_array_append_val (heap, *in);
+	h = (QuadInterval *)heap->data;
+	i = heap->len - 1;
+	while (i > 0 && h[(i-1)/2].err < h[i].err) {
+		QuadInterval tmp = h[i];
+		h[i] = h[(i-1)/2];
+		h[(i-1)/2] = tmp;
+		i = (i-1)/2;
+	}
+}
+
+static QuadInterval
+heap_pop (GArray *heap)
+{
+	QuadInterval *h = (QuadInterval *)heap->data;
+	QuadInterval top = h[0];
+	int n, i;
+
+	h[0] = h[heap->len - 1];
+	g_array_set_size (heap, heap->len - 1);
+	h = (QuadInterval *)heap->data;
+	n = heap->len;
+	i = 0;
+	for (;;) {
+		int l = 2*i + 1;
+		int r = 2*i + 2;
+		int m = i;
+		QuadInterval tmp;
+		if (l < n && h[l].err > h[m].err)
+			m = l;
+		if (r < n && h[r].err > h[m].err)
+			m = r;
+		if (m == i)
+			break;
+		tmp = h[i];
+		h[i] = h[m];
+		h[m] = tmp;
+		i = m;
+	}
+
+	return top;
+}
+
+/* at most this many intervals are bisected at once, all those with
+ * errors at least half of the worst one */
+#define GK_BATCH 32
+
+GelQuadResult
+gel_quad_gk15 (GelQuadFunc f,
+	       gpointer data,
+	       double a,
+	       double b,
+	       double atol,
+	       double rtol,
+	       double *result,
+	       double *abserr,
+	       int *nevals)
+{
+	GArray *heap;
+	QuadInterval in;
+	QuadInterval split[GK_BATCH];
+	double *x, *fv;
+	double res, err;
+	GelQuadResult ret = GEL_QUAD_DONE;
+	int evals = 0;
+	int nsplit, i, j;
+
+	*result = 0.0;
+	if (abserr != NULL)
+		*abserr = 0.0;
+	if (nevals != NULL)
+		*nevals = 0;
+	if (a == b)
+		return GEL_QUAD_DONE;
+
+	x = g_new (double, 2 * 15 * GK_BATCH);
+	fv = g_new (double, 2 * 15 * GK_BATCH);
+	heap = g_array_new (FALSE, FALSE, sizeof (QuadInterval));
+
+	in.a = a;
+	in.b = b;
+	gk15_points (a, b, x);
+	evals += 15;
+	if ( ! (*f) (x, fv, 15, data)) {
+		ret = GEL_QUAD_FAILED;
+		goto done;
+	}
+	gk15_rule (&in, fv);
+	heap_push (heap, &in);
+
+	for (;;) {
+		QuadInterval *h = (QuadInterval *)heap->data;
+
+		/* sum up anew each time rather than keep adjusting,
+		 * that would accumulate rounding errors */
+		res = err = 0.0;
+		for (i = 0; i < (int)heap->len; i++) {
+			res += h[i].result;
+			err += h[i].err;
+		}
+		if ( ! isfinite (res) || ! isfinite (err)) {
+			ret = GEL_QUAD_FAILED;
+			break;
+		}
+		if (err <= MAX (atol, rtol * fabs (res)))
+			break;
+		if G_UNLIKELY (gel_interrupted) {
+			ret = GEL_QUAD_INTERRUPTED;
+			break;
+		}
+
+		nsplit = 0;
+		while (nsplit < GK_BATCH &&
+		       heap->len > 0 &&
+		       heap->len + nsplit < GEL_QUAD_MAX_INTERVALS &&
+		       (nsplit == 0 ||
+			((QuadInterval *)heap->data)[0].err >=
+			0.5 * split[0].err)) {
+			double mid;
+			in = heap_pop (heap);
+			mid = 0.5 * (in.a + in.b);
+			/* cannot be split any further */
+			if (mid == in.a || mid == in.b) {
+				heap_push (heap, &in);
+				break;
+			}
+			split[nsplit++] = in;
+		}
+		if (nsplit == 0) {
+			ret = GEL_QUAD_NOT_CONVERGED;
+			break;
+		}
+
+		for (i = 0; i < nsplit; i++) {
+			double mid = 0.5 * (split[i].a + split[i].b);
+			gk15_points (split[i].a, mid, x + 30*i);
+			gk15_points (mid, split[i].b, x + 30*i + 15);
+		}
+		evals += 30 * nsplit;
+		if ( ! (*f) (x, fv, 30 * nsplit, data)) {
+			ret = GEL_QUAD_FAILED;
+			break;
+		}
+		for (i = 0; i < nsplit; i++) {
+			double mid = 0.5 * (split[i].a + split[i].b);
+			for (j = 0; j < 2; j++) {
+				in.a = j == 0 ? split[i].a : mid;
+				in.b = j == 0 ? mid : split[i].b;
+				gk15_rule (&in, fv + 30*i + 15*j);
+				heap_push (heap, &in);
+			}
+		}
+	}
+
+	*result = res;
+	if (abserr != NULL)
+		*abserr = err;
+
+done:
+	if (nevals != NULL)
+		*nevals = evals;
+	g_array_free (heap, TRUE);
+	g_free (x);
+	g_free (fv);
+
+	return ret;
+}
+
+/* The largest t for which the tanh-sinh weight pi/2 cosh(t)/cosh(u)^2,
+ * u = pi/2 sinh(t), is still above 2^(-2prec).  Done with logarithms as
+ * the weights underflow doubles long before. */
+static double
+tanh_sinh_tmax (int prec)
+{
+	double lim = -2.0 * prec * M_LN2;
+	double t = 0.0;
+
+	for (;;) {
+		double u = M_PI_2 * sinh (t);
+		double lw = log (M_PI_2 * cosh (t)) -
+			2.0 * (u + log1p (exp (-2.0 * u)) - M_LN2);
+		if (lw < lim)
+			return t;
+		t += 1.0/64.0;
+	}
+}
+
+static void
+grow_mpw_array (mpw_t **arr, int *alloc, int needed)
+{
+	int i, old = *alloc;
+
+	if (needed <= old)
+		return;
+	*alloc = MAX (needed, 2 * old);
+	*arr = g_renew (mpw_t, *arr, *alloc);
+	for (i = old; i < *alloc; i++)
+		mpw_init ((*arr)[i]);
+}
+
+static void
+free_mpw_array (mpw_t *arr, int alloc)
+{
+	int i;
+
+	for (i = 0; i < alloc; i++)
+		mpw_clear (arr[i]);
+	g_free (arr);
+}
+
+GelQuadResult
+gel_quad_tanh_sinh_mpw (GelQuadMpwFunc f,
+			gpointer data,
+			mpw_ptr a,
+			mpw_ptr b,
+			double tol,
+			mpw_ptr result,
+			double *abserr,
+			int *nevals)
+{
+	mpw_t *x = NULL, *fx = NULL, *wt = NULL;
+	int xalloc = 0, fxalloc = 0, wtalloc = 0;
+	mpw_t d, pi2, t, u, r, w, sum, s, prev, tmp;
+	double tmax, asum = 0.0, err = G_MAXDOUBLE;
+	GelQuadResult ret = GEL_QUAD_NOT_CONVERGED;
+	int evals = 0;
+	int level;
+
+	mpw_set_ui (result, 0);
+	if (abserr != NULL)
+		*abserr = 0.0;
+	if (nevals != NULL)
+		*nevals = 0;
+	if (mpw_cmp (a, b) == 0)
+		return GEL_QUAD_DONE;
+
+	tmax = tanh_sinh_tmax (gel_calcstate.float_prec);
+
+	mpw_init (d);
+	mpw_init (pi2);
+	mpw_init (t);
+	mpw_init (u);
+	mpw_init (r);
+	mpw_init (w);
+	mpw_init (sum);
+	mpw_init (s);
+	mpw_init (prev);
+	mpw_init (tmp);
+
+	/* d = (b-a)/2 */
+	mpw_sub (d, b, a);
+	mpw_make_float (d);
+	mpw_div_ui (d, d, 2);
+	mpw_pi (pi2);
+	mpw_div_ui (pi2, pi2, 2);
+	mpw_set_ui (sum, 0);
+	mpw_make_float (sum);
+
+	for (level = 0; level <= GEL_QUAD_MAX_LEVEL; level++) {
+		double h = ldexp (1.0, -level);
+		double dh;
+		int n = 0;
+		gboolean left_done = FALSE;
+		gboolean right_done = FALSE;
+		int k, i;
+
+		/* all multiples of h on the first level, only the new
+		 * odd ones after that */
+		for (k = (level == 0) ? 0 : 1;
+		     k * h <= tmax;
+		     k += (level == 0) ? 1 : 2) {
+			if (k == 0) {
+				grow_mpw_array (&x, &xalloc, n + 1);
+				grow_mpw_array (&wt, &wtalloc, n + 1);
+				mpw_add (x[n], a, d);
+				mpw_set (wt[n], pi2);
+				n++;
+				continue;
+			}
+
+			/* r = 1 - tanh(u) = 2/(1+exp(2u)) is the distance
+			 * of the node from the endpoint, computed directly
+			 * so that it stays accurate close to the endpoint,
+			 * the weight is pi/2 cosh(t) r (2-r) */
+			mpw_set_d (t, k * h);
+			mpw_sinh (u, t);
+			mpw_mul (u, u, pi2);
+			mpw_mul_ui (u, u, 2);
+			mpw_exp (r, u);
+			mpw_add_ui (r, r, 1);
+			mpw_set_ui (tmp, 2);
+			mpw_div (r, tmp, r);
+
+			mpw_cosh (w, t);
+			mpw_mul (w, w, pi2);
+			mpw_mul (w, w, r);
+			mpw_sub (tmp, tmp, r);
+			mpw_mul (w, w, tmp);
+
+			grow_mpw_array (&x, &xalloc, n + 2);
+			grow_mpw_array (&wt, &wtalloc, n + 2);
+
+			/* stop at each end once the nodes run into the
+			 * endpoint, f might be singular there */
+			mpw_mul (tmp, d, r);
+			if ( ! left_done) {
+				mpw_add (x[n], a, tmp);
+				if (mpw_cmp (x[n], a) == 0) {
+					left_done = TRUE;
+				} else {
+					mpw_set (wt[n], w);
+					n++;
+				}
+			}
+			if ( ! right_done) {
+				mpw_sub (x[n], b, tmp);
+				if (mpw_cmp (x[n], b) == 0) {
+					right_done = TRUE;
+				} else {
+					mpw_set (wt[n], w);
+					n++;
+				}
+			}
+			if (left_done && right_done)
+				break;
+		}
+
+		grow_mpw_array (&fx, &fxalloc, n);
+		evals += n;
+		if ( ! (*f) (x, fx, n, data)) {
+			ret = GEL_QUAD_FAILED;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			mpw_mul (tmp, fx[i], wt[i]);
+			mpw_add (sum, sum, tmp);
+			mpw_abs (tmp, tmp);
+			asum += mpw_get_double (tmp);
+		}
+
+		/* s = sum * d * h */
+		mpw_set_d (tmp, h);
+		mpw_mul (s, sum, tmp);
+		mpw_mul (s, s, d);
+
+		mpw_abs (tmp, d);
+		dh = mpw_get_double (tmp) * h;
+
+		if (level > 0) {
+			mpw_sub (tmp, s, prev);
+			mpw_abs (tmp, tmp);
+			err = mpw_get_double (tmp);
+		}
+		mpw_set (prev, s);
+		mpw_set (result, s);
+
+		if G_UNLIKELY (gel_error_num != 0) {
+			gel_error_num = 0;
+			ret = GEL_QUAD_FAILED;
+			break;
+		}
+
+		/* the error roughly squares with each level, so two
+		 * levels that agree are plenty */
+		if (level >= 2 && err <= tol * asum * dh) {
+			ret = GEL_QUAD_DONE;
+			break;
+		}
+
+		if G_UNLIKELY (gel_interrupted) {
+			ret = GEL_QUAD_INTERRUPTED;
+			break;
+		}
+	}
+
+	if (abserr != NULL)
+		*abserr = err;
+	if (nevals != NULL)
+		*nevals = evals;
+
+	free_mpw_array (x, xalloc);
+	free_mpw_array (fx, fxalloc);
+	free_mpw_array (wt, wtalloc);
+	mpw_clear (d);
+	mpw_clear (pi2);
+	mpw_clear (t);
+	mpw_clear (u);
+	mpw_clear (r);
+	mpw_clear (w);
+	mpw_clear (sum);
+	mpw_clear (s);
+	mpw_clear (prev);
+	mpw_clear (tmp);
+
+	return ret;
+}
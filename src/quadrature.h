@@ -0,0 +1,81 @@
+/* GENIUS Calculator
+ * Copyright (C) 2026 Jiri (George) Lebl
+ *
+ * Author: Jiri (George) Lebl
+ *
+ * This file is part of Genius.
+ *
+ * Genius is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _QUADRATURE_H_
+#define _QUADRATURE_H_
+
+#include <glib.h>
+#include "mpwrap.h"
+
+/* Adaptive numerical integration.  An adaptive Gauss-Kronrod 7-15 rule
+ * with bisection of the worst intervals (as in QUADPACK) in doubles, and
+ * a tanh-sinh (double exponential) rule in mpw numbers, which does not
+ * evaluate at the endpoints and so handles singularities there, and
+ * which follows the current float precision.  The integrand is always
+ * asked for a whole batch of points at once. */
+
+typedef enum {
+	GEL_QUAD_DONE = 0,	/* the tolerance was reached */
+	GEL_QUAD_FAILED,	/* f could not be evaluated */
+	GEL_QUAD_NOT_CONVERGED,	/* ran out of intervals or levels */
+	GEL_QUAD_INTERRUPTED
+} GelQuadResult;
+
+/* maximum number of subintervals for the Gauss-Kronrod rule */
+#define GEL_QUAD_MAX_INTERVALS 2000
+/* maximum number of halvings of the tanh-sinh step */
+#define GEL_QUAD_MAX_LEVEL 10
+
+/* Store f at the n points x in y, return FALSE if it cannot be
+ * evaluated */
+typedef gboolean (*GelQuadFunc) (const double *x, double *y, int n,
+				 gpointer data);
+typedef gboolean (*GelQuadMpwFunc) (mpw_t *x, mpw_t *y, int n,
+				    gpointer data);
+
+/* Integrate f from a to b (b may be less than a) until the estimated
+ * error is at most MAX(atol, rtol*|result|).  On GEL_QUAD_NOT_CONVERGED
+ * result still gets the best value found.  abserr (the error estimate)
+ * and nevals (the number of points evaluated) may be NULL. */
+GelQuadResult	gel_quad_gk15		(GelQuadFunc f,
+					 gpointer data,
+					 double a,
+					 double b,
+					 double atol,
+					 double rtol,
+					 double *result,
+					 double *abserr,
+					 int *nevals);
+
+/* The same with the tanh-sinh rule.  The error is kept under
+ * tol times the integral of |f|.  result should be initialized.  f may
+ * have complex values. */
+GelQuadResult	gel_quad_tanh_sinh_mpw	(GelQuadMpwFunc f,
+					 gpointer data,
+					 mpw_ptr a,
+					 mpw_ptr b,
+					 double tol,
+					 mpw_ptr result,
+					 double *abserr,
+					 int *nevals);
+
+#endif /* _QUADRATURE_H_ */
@@ -147,7 +147,7 @@ typedef enum {
 	GEL_VALUE_NODE,
 	GEL_MATRIX_NODE,
 	GEL_SET_NODE, /* FIXME: Note implemented */
-	GEL_POLYNOMIAL_NODE, /* FIXME: Note implemented */
+	GEL_POLYNOMIAL_NODE, /* dense polynomial in one variable */
 	GEL_OPERATOR_NODE,
 	GEL_IDENTIFIER_NODE,
 	GEL_STRING_NODE,
@@ -210,21 +210,10 @@ struct _GelETreeSet {
 struct _GelETreePolynomial {
 	GelETreeType type;
 	GelETree *next;
-	guint16 largest; /* largest exponent */
-	guint8 vars; /* number of variables */
-
-	/* This needs redoing.  No need to store
-	   this in the ETree struct since we want to
-	   conserve memory.  Probably need an array
-	   type for this. */
-	/*
-	guint16 arraysize;
-	*/
-
-	mpw_ptr *indexes; /* indexes when written out in standard form
-			     from smallest to largest.  If more then one
-			     variable then this is '(largest+1)^vars'
-			     size array */
+	int len; /* number of coefficients, the last one is nonzero, 0 for
+		    the zero polynomial */
+	mpw_t *coefs; /* dense, from the constant term up, see
+			 polynomial.h */
 };
 
 struct _GelETreeOperator {